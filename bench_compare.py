@@ -0,0 +1,148 @@
+#!/usr/bin/env python
+################################################################################
+# The Sandbox Libraries (Python) - Output Checker Benchmark                    #
+#                                                                              #
+# Copyright (C) 2009-2013 LIU Yu, <pineapple.liu@gmail.com>                    #
+# All rights reserved.                                                         #
+#                                                                              #
+# Redistribution and use in source and binary forms, with or without           #
+# modification, are permitted provided that the following conditions are met:  #
+#                                                                              #
+# 1. Redistributions of source code must retain the above copyright notice,    #
+#    this list of conditions and the following disclaimer.                     #
+#                                                                              #
+# 2. Redistributions in binary form must reproduce the above copyright notice, #
+#    this list of conditions and the following disclaimer in the documentation #
+#    and/or other materials provided with the distribution.                    #
+#                                                                              #
+# 3. Neither the name of the author(s) nor the names of its contributors may   #
+#    be used to endorse or promote products derived from this software without #
+#    specific prior written permission.                                        #
+#                                                                              #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"  #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE    #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE   #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE     #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR          #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF         #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS     #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)      #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE   #
+# POSSIBILITY OF SUCH DAMAGE.                                                  #
+################################################################################
+
+import os
+import sys
+import tempfile
+import time
+
+try:
+    # check platform type
+    system, machine = os.uname()[0], os.uname()[4]
+    if system not in ('Linux', ) or machine not in ('i686', 'x86_64', ):
+        raise AssertionError("Unsupported platform type.\n")
+    # check package availability / version
+    import sandbox
+    if not hasattr(sandbox, '__version__') or sandbox.__version__ < "0.3.5-3" \
+            or not hasattr(sandbox, 'S_TRUST_FULL'):
+        raise AssertionError("Unsupported sandbox version.\n")
+    from sandbox import *
+    if not hasattr(sandbox, 'S_COMPARE_FLOAT'):
+        raise AssertionError("Unsupported sandbox version.\n")
+except ImportError:
+    sys.stderr.write("Required package(s) missing.\n")
+    sys.exit(os.EX_UNAVAILABLE)
+except AssertionError as e:
+    sys.stderr.write(str(e))
+    sys.exit(os.EX_UNAVAILABLE)
+
+
+def main(args):
+    # benchmark configuration, the prisoner copies its input to its output
+    size = (int(args[2]) if len(args) > 2 else 1024) << 20
+    sample = 4 << 20
+    modes = (('none', S_COMPARE_NONE, False),
+             ('byte', S_COMPARE_BYTE, False),
+             ('token', S_COMPARE_TOKEN, False),
+             ('nocase', S_COMPARE_NOCASE, False),
+             ('float', S_COMPARE_FLOAT, False),
+             ('token', S_COMPARE_TOKEN, True),
+             ('float', S_COMPARE_FLOAT, True))
+    # one line of integers, words and decimals per row of the answer, the
+    # output is either identical, or reformatted with different whitespace
+    block = b"".join(b"%d %s %.6f\n" % (i * 7919, b"abcDEF"[i % 6:],
+        i / 7.0) for i in range(1 << 14))
+    data = dict()
+    for reformat in (False, True):
+        f = tempfile.TemporaryFile(dir=os.environ.get("TMPDIR", "/tmp"))
+        chunk = block.replace(b"\n", b" \t") if reformat else block
+        for i in range(size // len(block)):
+            f.write(chunk)
+        f.flush()
+        data[reformat] = f
+    answer = data[False]
+    length = os.fstat(answer.fileno()).st_size
+    devnull = open(os.devnull, "wb")
+    sys.stdout.write("%8s %10s %10s %12s\n" % ("compare", "output",
+        "time(s)", "rate(MB/s)"))
+    for (name, compare, reformat) in modes:
+        i = data[reformat]
+        i.seek(0)
+        s = Sandbox(args[1:2], stdin=i, stdout=devnull, answer=answer,
+            compare=compare, trust=S_TRUST_FULL, quota=dict(wallclock=600000))
+        t = time.time()
+        s.run()
+        t = time.time() - t
+        if s.result != S_RESULT_OK:
+            sys.stderr.write("unexpected result: %d\n" % s.result)
+            return os.EX_SOFTWARE
+        sys.stdout.write("%8s %10s %10.3f %12.1f\n" % (name,
+            ("spaced" if reformat else "verbatim"), t, length / t / 1e6))
+    # the naive checker compares whitespace-separated tokens one at a time,
+    # on a sample of the output to bound memory consumption
+    for reformat in (False, True):
+        out = os.pread(data[reformat].fileno(), sample, 0)
+        ans = os.pread(answer.fileno(), sample, 0)
+        t = time.time()
+        if not naive_check(out, ans):
+            sys.stderr.write("unexpected result of naive checker\n")
+            return os.EX_SOFTWARE
+        t = time.time() - t
+        sys.stdout.write("%8s %10s %10.3f %12.1f\n" % ("naive",
+            ("spaced" if reformat else "verbatim"), t * length / sample,
+            sample / t / 1e6))
+    for f in data.values():
+        f.close()
+    devnull.close()
+    return os.EX_OK
+
+
+# byte-by-byte token comparison, tolerating a token truncated at the sample
+# boundary
+def naive_check(out, ans):
+    i = j = 0
+    n, m = len(out), len(ans)
+    space = b" \t\n\r\v\f"
+    while True:
+        while i < n and out[i] in space:
+            i += 1
+        while j < m and ans[j] in space:
+            j += 1
+        if i == n or j == m:
+            return True
+        while i < n and j < m and out[i] not in space:
+            if out[i] != ans[j]:
+                return False
+            i += 1
+            j += 1
+        if i < n and j < m and ans[j] not in space:
+            return False
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.stderr.write("synopsis: python " + __file__ + " /bin/cat "
+            "[megabytes]\n")
+        sys.exit(os.EX_USAGE)
+    sys.exit(main(sys.argv))
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+################################################################################
+# The Sandbox Libraries (Python) - Pool Latency Benchmark                      #
+#                                                                              #
+# Copyright (C) 2009-2013 LIU Yu, <pineapple.liu@gmail.com>                    #
+# All rights reserved.                                                         #
+#                                                                              #
+# Redistribution and use in source and binary forms, with or without           #
+# modification, are permitted provided that the following conditions are met:  #
+#                                                                              #
+# 1. Redistributions of source code must retain the above copyright notice,    #
+#    this list of conditions and the following disclaimer.                     #
+#                                                                              #
+# 2. Redistributions in binary form must reproduce the above copyright notice, #
+#    this list of conditions and the following disclaimer in the documentation #
+#    and/or other materials provided with the distribution.                    #
+#                                                                              #
+# 3. Neither the name of the author(s) nor the names of its contributors may   #
+#    be used to endorse or promote products derived from this software without #
+#    specific prior written permission.                                        #
+#                                                                              #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"  #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE    #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE   #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE     #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR          #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF         #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS     #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)      #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE   #
+# POSSIBILITY OF SUCH DAMAGE.                                                  #
+################################################################################
+
+import os
+import sys
+import time
+
+try:
+    # check platform type
+    system, machine = os.uname()[0], os.uname()[4]
+    if system not in ('Linux', ) or machine not in ('i686', 'x86_64', ):
+        raise AssertionError("Unsupported platform type.\n")
+    # check package availability / version
+    import sandbox
+    if not hasattr(sandbox, '__version__') or sandbox.__version__ < "0.3.5-3" \
+            or not hasattr(sandbox, 'S_TRUST_FULL'):
+        raise AssertionError("Unsupported sandbox version.\n")
+    from sandbox import *
+    if not hasattr(Sandbox, 'prefork'):
+        raise AssertionError("Unsupported sandbox version.\n")
+except ImportError:
+    sys.stderr.write("Required package(s) missing.\n")
+    sys.exit(os.EX_UNAVAILABLE)
+except AssertionError as e:
+    sys.stderr.write(str(e))
+    sys.exit(os.EX_UNAVAILABLE)
+
+
+def main(args):
+    # benchmark configuration
+    rounds = 200
+    modes = (('ptrace', dict()),
+             ('trusted', dict(trust=S_TRUST_FULL)))
+    devnull = open(os.devnull, "wb")
+    sys.stdout.write("%8s %8s %10s %10s %10s\n" % ("mode", "launch",
+        "p50(ms)", "p90(ms)", "p99(ms)"))
+    for (name, kwds) in modes:
+        base = Sandbox(args[1:], **kwds)
+        for pooled in (False, True):
+            if pooled:
+                base.prefork(4)
+            latency = []
+            for i in range(rounds):
+                # let the pool refill in the background between rounds
+                while pooled and base.pool['ready'] < base.pool['size']:
+                    time.sleep(0.001)
+                s = Sandbox(template=base, stdout=devnull, policy=AllowAll())
+                t = time.time()
+                s.run()
+                latency.append(time.time() - t)
+                if s.result != S_RESULT_OK:
+                    sys.stderr.write("unexpected result: %d\n" % s.result)
+                    return os.EX_SOFTWARE
+            latency.sort()
+            sys.stdout.write("%8s %8s %10.3f %10.3f %10.3f\n" % (name,
+                ("pooled" if pooled else "fresh"),
+                latency[rounds * 50 // 100] * 1000,
+                latency[rounds * 90 // 100] * 1000,
+                latency[rounds * 99 // 100] * 1000))
+        if base.pool['hit'] != rounds:
+            sys.stderr.write("pool missed %d launches\n" % base.pool['miss'])
+    devnull.close()
+    return os.EX_OK
+
+
+# policy that allows all system calls without asking for their returns
+class AllowAll(SandboxPolicy):
+    def __call__(self, e, a):
+        if e.type == S_EVENT_SYSCALL:
+            a.type = S_ACTION_CONT_NORET
+            return a
+        return SandboxPolicy.__call__(self, e, a)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.stderr.write("synopsis: python " + __file__ + " foo/hello.exe\n")
+        sys.exit(os.EX_USAGE)
+    sys.exit(main(sys.argv))
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+################################################################################
+# The Sandbox Libraries (Python) - Spawn Latency Benchmark                     #
+#                                                                              #
+# Copyright (C) 2009-2013 LIU Yu, <pineapple.liu@gmail.com>                    #
+# All rights reserved.                                                         #
+#                                                                              #
+# Redistribution and use in source and binary forms, with or without           #
+# modification, are permitted provided that the following conditions are met:  #
+#                                                                              #
+# 1. Redistributions of source code must retain the above copyright notice,    #
+#    this list of conditions and the following disclaimer.                     #
+#                                                                              #
+# 2. Redistributions in binary form must reproduce the above copyright notice, #
+#    this list of conditions and the following disclaimer in the documentation #
+#    and/or other materials provided with the distribution.                    #
+#                                                                              #
+# 3. Neither the name of the author(s) nor the names of its contributors may   #
+#    be used to endorse or promote products derived from this software without #
+#    specific prior written permission.                                        #
+#                                                                              #
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"  #
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE    #
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE   #
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE     #
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR          #
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF         #
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS     #
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      #
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)      #
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE   #
+# POSSIBILITY OF SUCH DAMAGE.                                                  #
+################################################################################
+
+import os
+import sys
+import time
+
+try:
+    # check platform type
+    system, machine = os.uname()[0], os.uname()[4]
+    if system not in ('Linux', ) or machine not in ('i686', 'x86_64', ):
+        raise AssertionError("Unsupported platform type.\n")
+    # check package availability / version
+    import sandbox
+    if not hasattr(sandbox, '__version__') or sandbox.__version__ < "0.3.5-3" \
+            or not hasattr(sandbox, 'S_TRUST_FULL'):
+        raise AssertionError("Unsupported sandbox version.\n")
+    from sandbox import *
+except ImportError:
+    sys.stderr.write("Required package(s) missing.\n")
+    sys.exit(os.EX_UNAVAILABLE)
+except AssertionError as e:
+    sys.stderr.write(str(e))
+    sys.exit(os.EX_UNAVAILABLE)
+
+
+def main(args):
+    # benchmark configuration
+    rounds = 50
+    sizes = (0, 64, 256, 1024)          # extra resident memory of parent (MB)
+    modes = (('ptrace', dict()),
+             ('notify', dict(backend=S_BACKEND_NOTIFY)),
+             ('trusted', dict(trust=S_TRUST_FULL)))
+    devnull = open(os.devnull, "wb")
+    ballast = []
+    sys.stdout.write("%8s %10s %10s %10s\n" % (("rss(MB)", ) +
+        tuple(name for (name, kwds) in modes)))
+    for size in sizes:
+        # grow the resident set of the parent with touched pages
+        while len(ballast) < size:
+            ballast.append(b'\x01' * 1048576)
+        row = []
+        for (name, kwds) in modes:
+            latency = []
+            for i in range(rounds):
+                s = Sandbox(args[1:], stdout=devnull, policy=AllowAll(), **kwds)
+                t = time.time()
+                s.run()
+                latency.append(time.time() - t)
+                if s.result != S_RESULT_OK:
+                    sys.stderr.write("unexpected result: %d\n" % s.result)
+                    return os.EX_SOFTWARE
+            latency.sort()
+            row.append(latency[rounds // 2] * 1000)
+        sys.stdout.write("%8d %10.3f %10.3f %10.3f\n" % ((size, ) + tuple(row)))
+    devnull.close()
+    return os.EX_OK
+
+
+# policy that allows all system calls without asking for their returns
+class AllowAll(SandboxPolicy):
+    def __call__(self, e, a):
+        if e.type == S_EVENT_SYSCALL:
+            a.type = S_ACTION_CONT_NORET
+            return a
+        return SandboxPolicy.__call__(self, e, a)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.stderr.write("synopsis: python " + __file__ + " foo/hello.exe\n")
+        sys.exit(os.EX_USAGE)
+    sys.exit(main(sys.argv))
@@ -91,7 +91,7 @@ BEGIN {
     	nevent = ievent + 1;
     eventlist[ievent] = sprintf("%s", substr($1, 9, 16));
 }
-/^[[:space:]]*S_ACTION_[[:alnum:]]+[[:space:]]+=[[:space:]]+[[:digit:]+][.]*/ {
+/^[[:space:]]*S_ACTION_[[:alnum:]_]+[[:space:]]+=[[:space:]]+[[:digit:]+][.]*/ {
     iaction = sprintf("%d", $3);
     if (naction <= iaction) 
     	naction = iaction + 1;
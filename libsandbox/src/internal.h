@@ -42,6 +42,7 @@
 #include <pthread.h>            /* pthread_mutex_{lock,unlock}() */
 #include <signal.h>             /* kill(), SIG* */
 #include <stdio.h>              /* fprintf(), fflush(), stderr */
+#include <sys/eventfd.h>        /* eventfd(), eventfd_{read,write}() */
 #include <time.h>               /* struct timespec */
 
 #ifdef __cplusplus
@@ -267,12 +268,25 @@ extern "C"
 #endif /* RELOCK */
 
 /* Macros for sandbox coordination */
-#define SIGEXIT          (SIGUSR1)
-#define SIGSTAT          (SIGUSR2)
+#define NOTICE_EXIT      (1UL << 0)     /* monitor threads should quit */
+#define NOTICE_KILL      (1UL << 1)     /* prisoner should be killed */
+#define NOTICE_STAT      (1UL << 2)     /* profile memory and cpu usage */
+#define NOTICE_PROF      (1UL << 3)     /* profile cpu usage */
 
 #define PROF_FREQ        (100)
 #define STAT_FREQ        (5)
 
+#ifndef NOTIFY
+#define NOTIFY(psbox,x) \
+{{{ \
+    __sync_fetch_and_or(&((psbox)->ctrl.notice.pending), (x)); \
+    if (eventfd_write(((psbox)->ctrl.notice.fd), 1) != 0) \
+    { \
+        WARN("failed to notify sandbox %p", (psbox)); \
+    } \
+}}} /* NOTIFY */
+#endif /* NOTIFY */
+
 /* Macros for testing sandbox status */
 #ifndef NOT_STARTED
 #define NOT_STARTED(psbox) \
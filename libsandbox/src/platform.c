@@ -40,13 +40,17 @@
 
 #include <ctype.h>              /* toupper() */
 #include <fcntl.h>              /* open(), close(), O_RDONLY */
+#include <limits.h>             /* PIPE_BUF */
 #include <math.h>               /* modfl(), lrintl() */
+#include <poll.h>               /* ppoll(), struct pollfd, POLLIN */
 #include <pthread.h>            /* pthread_{create,join,...}() */
 #include <signal.h>             /* kill(), SIG* */
 #include <stdio.h>              /* read(), sscanf(), sprintf() */
 #include <stdlib.h>             /* malloc(), free() */
 #include <string.h>             /* memset(), strsep() */
+#include <sys/ioctl.h>          /* ioctl(), FIONREAD */
 #include <sys/queue.h>          /* SLIST_*() */
+#include <sys/socket.h>         /* sendmsg(), recvmsg(), SCM_RIGHTS */
 #include <sys/times.h>          /* struct tms, struct timeval */
 #include <sys/types.h>          /* off_t */
 #include <sys/wait.h>           /* waitpid(), WNOHANG */
@@ -58,6 +62,62 @@
 #endif /* HAVE_SYS_PTRACE_H */
 #endif /* HAVE_PTRACE */
 
+#ifdef HAVE_SYSCALL_FILTER
+#include <linux/filter.h>       /* struct sock_{filter,fprog} */
+#endif /* HAVE_SYSCALL_FILTER */
+
+#ifdef HAVE_SYSCALL_NOTIFY
+#include <linux/audit.h>        /* AUDIT_ARCH_* */
+#include <sys/ioctl.h>          /* ioctl() */
+#endif /* HAVE_SYSCALL_NOTIFY */
+
+#ifdef HAVE_FS_RESTRICT
+#include <linux/landlock.h>     /* struct landlock_*_attr, LANDLOCK_* */
+#include <sys/stat.h>           /* fstat(), S_ISDIR() */
+#endif /* HAVE_FS_RESTRICT */
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>              /* sched_getaffinity(), cpu_set_t, CPU_*() */
+#endif /* HAVE_SCHED_H */
+
+#ifdef HAVE_TRACE_FORK
+#ifndef __x86_64__
+#error "fork servers are only implemented for x86_64"
+#endif /* __x86_64__ */
+#include <stddef.h>             /* offsetof() */
+#include <sys/stat.h>           /* stat() */
+#endif /* HAVE_TRACE_FORK */
+
+#ifdef HAVE_NAMESPACE
+#include <sys/mount.h>          /* mount(), umount2(), MS_*, MNT_DETACH */
+#include <sys/stat.h>           /* stat(), S_ISDIR() */
+#include <sys/statvfs.h>        /* statvfs(), ST_* */
+#endif /* HAVE_NAMESPACE */
+
+#if defined(HAVE_SCHED_H) && defined(CLONE_VM) && defined(CLONE_VFORK)
+#define HAVE_SPAWN_VFORK
+#include <sys/mman.h>           /* mmap(), munmap() */
+#endif /* HAVE_SCHED_H && CLONE_VM && CLONE_VFORK */
+
+#ifdef HAVE_SPLICE
+#include <sys/uio.h>            /* struct iovec */
+#endif /* HAVE_SPLICE */
+
+#ifdef HAVE_MEMFD
+#include <sys/sendfile.h>       /* sendfile() */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC             0x0001U
+#define MFD_ALLOW_SEALING       0x0002U
+#endif /* MFD_CLOEXEC */
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS             1033
+#define F_SEAL_SEAL             0x0001
+#define F_SEAL_SHRINK           0x0002
+#define F_SEAL_GROW             0x0004
+#define F_SEAL_WRITE            0x0008
+#endif /* F_ADD_SEALS */
+#endif /* HAVE_MEMFD */
+
 #ifdef HAVE_SYS_VFS_H
 #include <sys/vfs.h>            /* statfs() */
 #endif /* HAVE_SYS_VFS_H */
@@ -92,6 +152,10 @@ static bool check_procfs(pid_t);
 #error "some functions of libsandbox require procfs"
 #endif /* HAVE_PROCFS */
 
+#ifndef SYSFS
+#define SYSFS "/sys"
+#endif /* SYSFS */
+
 typedef enum
 {
     T_OPTION_NOP = 0, 
@@ -103,6 +167,9 @@ typedef enum
     T_OPTION_GETSIGINFO = 6, 
     T_OPTION_SETREGS = 7,
     T_OPTION_SETDATA = 8,
+    T_OPTION_FILTER = 9,
+    T_OPTION_DETACH = 10,
+    T_OPTION_SIGMASK = 11,
 } option_t;
 
 static long __trace(option_t, proc_t * const, void * const, long * const);
@@ -621,6 +688,159 @@ proc_dump(const proc_t * const pproc, const void * const addr,
 
 #ifdef HAVE_PROCFS
 
+#ifdef HAVE_SPAWN_VFORK
+typedef struct
+{
+    int (* fn)(void *);
+    void * arg;
+} spawn_t;
+
+static int
+__proc_spawned(void * arg)
+{
+    const spawn_t * const pspawn = (const spawn_t *)arg;
+    
+    /* Signal handlers of the parent must not run in the shared memory space,
+     * ignored signals remain ignored as they would be after execve() */
+    int signo;
+    for (signo = 1; signo < NSIG; signo++)
+    {
+        struct sigaction act;
+        if ((sigaction(signo, NULL, &act) == 0) && 
+            (act.sa_handler != SIG_DFL) && (act.sa_handler != SIG_IGN))
+        {
+            act.sa_handler = SIG_DFL;
+            act.sa_flags = 0;
+            sigaction(signo, &act, NULL);
+        }
+    }
+    
+    _exit(pspawn->fn(pspawn->arg));
+    return EXIT_FAILURE;
+}
+#endif /* HAVE_SPAWN_VFORK */
+
+pid_t
+proc_spawn(int (* fn)(void *), void * arg, int flags)
+{
+    FUNC_BEGIN("%p,%p,%d", fn, arg, flags);
+    assert(fn);
+    
+    pid_t pid = -1;
+#ifdef HAVE_SPAWN_VFORK
+    /* The parent's signals are blocked during clone(), such that no handler 
+     * runs in the child before it has reset the handlers */
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+    
+    void * stack = mmap(NULL, SBOX_SPAWN_STACK, PROT_READ | PROT_WRITE, 
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack != MAP_FAILED)
+    {
+        spawn_t spawn = {fn, arg};
+        pid = clone(__proc_spawned, (char *)stack + SBOX_SPAWN_STACK, 
+            CLONE_VM | CLONE_VFORK | SIGCHLD | flags, &spawn);
+        munmap(stack, SBOX_SPAWN_STACK);
+    }
+    else
+    {
+        WARN("failed to allocate stack for child process");
+    }
+    
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+#else
+    pid = proc_fork(flags);
+    if (pid == 0)
+    {
+        _exit(fn(arg));
+    }
+#endif /* HAVE_SPAWN_VFORK */
+    
+    FUNC_RET("%d", pid);
+}
+
+int
+proc_execfd(int fd, char * const argv[], char * const envp[])
+{
+    FUNC_BEGIN("%d,%p,%p", fd, argv, envp);
+    assert((fd >= 0) && argv && envp);
+    
+#ifdef HAVE_EXECVEAT
+    /* The executable file is not leaked to the program */
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0)
+    {
+        FUNC_RET("%d", -1);
+    }
+    syscall(SYS_execveat, fd, "", argv, envp, AT_EMPTY_PATH);
+#else
+    errno = EOPNOTSUPP;
+#endif /* HAVE_EXECVEAT */
+    
+    FUNC_RET("%d", -1);
+}
+
+pid_t
+proc_fork(int flags)
+{
+    FUNC_BEGIN("%d", flags);
+    
+    pid_t pid = -1;
+    if (flags == 0)
+    {
+        pid = fork();
+    }
+    else
+    {
+#if defined(HAVE_NAMESPACE) && defined(SYS_clone)
+        /* Without a new stack, the copy resumes on a copy of the stack of the 
+         * calling thread, as it would do with fork() */
+        pid = syscall(SYS_clone, SIGCHLD | flags, NULL, NULL, NULL, NULL);
+#else
+        errno = EOPNOTSUPP;
+#endif /* HAVE_NAMESPACE && SYS_clone */
+    }
+    
+    FUNC_RET("%d", pid);
+}
+
+bool
+proc_setid(uid_t uid, gid_t gid)
+{
+    FUNC_BEGIN("%lu,%lu", (unsigned long)uid, (unsigned long)gid);
+    
+#ifdef SYS_setresuid32
+    /* Legacy 32bit abis offer 16bit ids through the unsuffixed calls */
+    const long sc_setgroups = SYS_setgroups32;
+    const long sc_setresgid = SYS_setresgid32;
+    const long sc_setresuid = SYS_setresuid32;
+#else
+    const long sc_setgroups = SYS_setgroups;
+    const long sc_setresgid = SYS_setresgid;
+    const long sc_setresuid = SYS_setresuid;
+#endif /* SYS_setresuid32 */
+    
+    /* The groups of the host must not leak into the prisoner; dropping them
+     * requires privilege, and is meaningless otherwise */
+    if ((geteuid() == 0) && (syscall(sc_setgroups, 0, NULL) != 0))
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    /* Group identity goes first, while the privilege to change it remains */
+    if (syscall(sc_setresgid, gid, gid, gid) != 0)
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    if (syscall(sc_setresuid, uid, uid, uid) != 0)
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    FUNC_RET("%d", true);
+}
+
 static bool
 check_procfs(pid_t pid)
 {
@@ -668,390 +888,1851 @@ trace_me(void)
 }
 
 bool
-trace_next(proc_t * const pproc, trace_type_t type)
+trace_attach(pid_t pid)
 {
-    FUNC_BEGIN("%p,%d", pproc, type);
-    assert(pproc);
+    FUNC_BEGIN("%d", pid);
+    assert(pid > 0);
     
-    long opt = (long)type;
-    bool res = (__trace(T_OPTION_NEXT, pproc, NULL, &opt) == 0);
+    bool res = false;
+#ifdef HAVE_PTRACE
+    /* The process stops with SIGSTOP upon being attached, which is discarded
+     * when resuming the process */
+    siginfo_t info;
+    if (ptrace(PTRACE_ATTACH, pid, NULL, NULL) != 0)
+    {
+        FUNC_RET("%d", res);
+    }
+    while ((waitid(P_PID, pid, &info, WSTOPPED) != 0) && (errno == EINTR))
+    {
+        ;
+    }
+    res = (info.si_pid == pid) && (info.si_code == CLD_TRAPPED) && 
+          (info.si_status == SIGSTOP) && 
+          (ptrace(PTRACE_CONT, pid, NULL, NULL) == 0);
+#else
+#warning "trace_attach() is not implemented for this platform"
+#endif /* HAVE_PTRACE */
     
     FUNC_RET("%d", res);
 }
 
 bool
-trace_kill(const proc_t * const pproc, int signo)
+trace_me_filtered(const void * const prog, unsigned short len)
 {
-    FUNC_BEGIN("%p,%d", pproc, signo);
+    FUNC_BEGIN("%p,%hu", prog, len);
+    assert(prog && (len > 0));
+    
+    bool res = false;
+#ifdef HAVE_SYSCALL_FILTER
+    /* Without the PTRACE_O_TRACESECCOMP option of the tracer, filtered system 
+     * calls would fail with ENOSYS, so we wait for the tracer to set the option
+     * before installing the filter. */
+    if (kill(getpid(), SIGSTOP) != 0)
+    {
+        FUNC_RET("%d", res);
+    }
+    struct sock_fprog fprog = {len, (struct sock_filter *)prog};
+    res = (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0) && 
+          (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) == 0);
+#else
+#warning "trace_me_filtered() is not implemented for this platform"
+#endif /* HAVE_SYSCALL_FILTER */
+    
+    FUNC_RET("%d", res);
+}
+
+bool
+trace_filter(const proc_t * const pproc)
+{
+    FUNC_BEGIN("%p", pproc);
     assert(pproc);
     
-    /* Temporary variables */
-    pid_t pid = pproc->pid;
+    bool res = (__trace(T_OPTION_FILTER, (proc_t *)pproc, NULL, NULL) == 0);
     
-    /* When the prisoner process is to be killed with SIGKILL, we flush the
-     * pending opcode with a sequence of NOP. If there is pending syscall, we
-     * also replace the syscall number with SYS_pause. These precautions are
-     * essential for certain kernel versions where a killed program has chance
-     * to overrun for a few instructions. Otherwise, there is probability that
-     * the overrun may lead to undesired side effects or even security risk. */
+    FUNC_RET("%d", res);
+}
 
-    /* We only flush opcode when signo is SIGKILL. This is because the prisoner
-     * process may continue to execute after handling (or ignoring) a blockable
-     * signal. It only makes sense to flush the opcode if the prisoner process
-     * is guaranteed to die immediately. */
+bool
+trace_me_notified(const void * const prog, unsigned short len, int chan)
+{
+    FUNC_BEGIN("%p,%hu,%d", prog, len, chan);
+    assert(prog || (len == 0));
     
-    if (signo == SIGKILL)
+    bool res = false;
+#ifdef HAVE_SYSCALL_NOTIFY
+    /* Make a local copy of the filter with traced system calls delivered to
+     * the listener instead */
+    struct sock_filter insn[(len > 0) ? len : 1];
+    if (len > 0)
     {
-        /* Make a local copy of the proc stat buffer */
-        proc_t proc = {0};
-        memcpy(&proc, pproc, sizeof(proc_t));
-        if (!proc_probe(pid, PROBE_REGS | PROBE_OP, &proc))
-        {
-            WARN("failed to probe process: %d", pid);
-            goto skip_rewrite;
-        }
-        
-        /* Flush pending opcode with a sequence of NOP. */
-        unsigned long addr = proc.regs.NIP;
-        unsigned long nop = 0;
-        memset((void *)&nop, OP_NOP, sizeof(unsigned long));
-        __trace(T_OPTION_SETDATA, &proc, (void *)addr, (long *)&nop);
-        
-        /* Replace the pending system call with SYS_pause */
-        if (IS_SYSCALL(&proc))
+        memcpy(insn, prog, len * sizeof(struct sock_filter));
+    }
+    else
+    {
+        insn[len++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 
+            SECCOMP_RET_TRACE);
+    }
+    int i;
+    for (i = 0; i < len; i++)
+    {
+        if ((insn[i].code == (BPF_RET | BPF_K)) && 
+            ((insn[i].k & SECCOMP_RET_ACTION_FULL) == SECCOMP_RET_TRACE))
         {
-            if (proc.tflags.single_step)
-            {
-                proc.regs.NAX = SYS_pause;
-            }
-            else
-            {
-                proc.regs.ORIG_NAX = SYS_pause;
-            }
-#ifdef __x86_64__
-            proc.regs.cs = 0x33;
-#else /* __i386__ */
-            proc.regs.xcs = 0x23;
-#endif /* __x86_64__ */
-            __trace(T_OPTION_SETREGS, &proc, NULL, NULL);
+            insn[i].k = SECCOMP_RET_USER_NOTIF;
         }
-skip_rewrite:
-        ;
     }
-    
-    bool res = (kill(-pid, signo) == 0);
+    struct sock_fprog fprog = {len, insn};
+    
+    /* Once the filter is installed, filtered system calls block until the
+     * watcher answers them through the listener, so the watcher cannot be told
+     * about the listener afterwards. Instead, the lowest unused fd (with chan
+     * closed) is where the listener will be, and is reported in advance. */
+    int fd = dup(STDIN_FILENO);
+    if ((fd < 0) || (close(fd) != 0))
+    {
+        close(chan);
+        FUNC_RET("%d", res);
+    }
+    fd = (chan < fd) ? chan : fd;
+    if ((write(chan, &fd, sizeof(int)) != sizeof(int)) || (close(chan) != 0))
+    {
+        FUNC_RET("%d", res);
+    }
+    res = (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0) && 
+          (syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, 
+                   SECCOMP_FILTER_FLAG_NEW_LISTENER, &fprog) == fd);
+#else
+#warning "trace_me_notified() is not implemented for this platform"
+#endif /* HAVE_SYSCALL_NOTIFY */
     
     FUNC_RET("%d", res);
 }
 
-bool
-trace_end(const proc_t * const pproc)
+int
+trace_listener(pid_t pid, int chan)
 {
-    FUNC_BEGIN("%p", pproc);
-    assert(pproc);
+    FUNC_BEGIN("%d,%d", pid, chan);
     
-    bool res = (__trace(T_OPTION_END, (proc_t *)pproc, NULL, NULL) == 0);
+    int res = -1;
+#ifdef HAVE_SYSCALL_NOTIFY
+    int fd = -1;
+    if (read(chan, &fd, sizeof(int)) != sizeof(int))
+    {
+        FUNC_RET("%d", res);
+    }
+    DBUG("listener of process %d is expected at fd %d", pid, fd);
     
-    /* Discard zombie children */
-    while (waitpid(-pproc->pid, NULL, WNOHANG) >= 0)
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd < 0)
+    {
+        FUNC_RET("%d", res);
+    }
+    
+    /* The child process reports the listener before installing the filter, so
+     * retry until the listener is there, or the child process has gone */
+    struct pollfd pfd = {pidfd, POLLIN, 0};
+    while (((res = syscall(SYS_pidfd_getfd, pidfd, fd, 0)) < 0) && 
+           (errno == EBADF) && (poll(&pfd, 1, 1) == 0))
     {
         ;
     }
+    close(pidfd);
+#else
+#warning "trace_listener() is not implemented for this platform"
+#endif /* HAVE_SYSCALL_NOTIFY */
     
     FUNC_RET("%d", res);
 }
 
-/* Most trace_*() functions directly or indirectly invokes ptrace() in linux. 
- * But ptrace() only works when called from the *main* thread initially started 
- * tracing the prisoner process (and thus being the parent of the latter). The 
- * workaround is to make __trace() asynchronous. It places the desired option 
- * (and input) into global variables, and waits for sandbox_tracer() to perform
- * the desired options by calling __trace_impl(), which then calls ptrace().
- * sandbox_tracer() is guaranteed to be running in the *main* thread. */
-
-#define NO_ACTION(act) \
-    (((act) == T_OPTION_NOP) || ((act) == T_OPTION_ACK)) \
-/* NO_ACTION */
-
-static long
-__trace_impl(option_t option, proc_t * const pproc, void * const addr, 
-    long * const pdata)
+bool
+trace_notified(int fd, notif_t * const pnotif)
 {
-    FUNC_BEGIN("%d,%p,%p,%p", option, pproc, addr, pdata);
-    assert(!NO_ACTION(option));
-    assert(pproc);
+    FUNC_BEGIN("%d,%p", fd, pnotif);
+    assert(pnotif);
     
-    if (option == T_OPTION_END)
+    bool res = false;
+#ifdef HAVE_SYSCALL_NOTIFY
+    struct seccomp_notif req;
+    memset(&req, 0, sizeof(req));
+    if (ioctl(fd, SECCOMP_IOCTL_NOTIF_RECV, &req) != 0)
     {
-        FUNC_RET("%ld", 0L);
+        FUNC_RET("%d", res);
     }
     
-    long res = -1;
-    pid_t pid = pproc->pid;
-    
-    if (pproc->ppid != getpid())
+    int mode = SCMODE_MAX;
+#ifdef __x86_64__
+    if (req.data.arch == AUDIT_ARCH_X86_64)
     {
-        FUNC_RET("%ld", res);
+        mode = SCMODE_LINUX64;
     }
+    else if (req.data.arch == AUDIT_ARCH_I386)
+    {
+        mode = SCMODE_LINUX32;
+    }
+#else /* __i386__ */
+    if (req.data.arch == AUDIT_ARCH_I386)
+    {
+        mode = SCMODE_LINUX32;
+    }
+#endif /* __x86_64__ */
     
-#ifdef HAVE_PTRACE
-    switch (option)
+    pnotif->id = req.id;
+    pnotif->pid = req.pid;
+    pnotif->scinfo = MAKE_WORD(req.data.nr, mode);
+    int i;
+    for (i = 0; i < 6; i++)
     {
-    case T_OPTION_NEXT:
-        assert(pdata);
-        pproc->tflags.single_step = ((int)(*pdata) == TRACE_SINGLE_STEP);
-        if (pproc->tflags.single_step)
-        {
-            res = ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL);
-        }
-        else
-        {
-            res = ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
-        }
-        break;
-    case T_OPTION_GETREGS:
-        res = ptrace(PTRACE_GETREGS, pid, NULL, (void *)&pproc->regs);
-        break;
-    case T_OPTION_SETREGS:
-        res = ptrace(PTRACE_SETREGS, pid, NULL, (void *)&pproc->regs);
-        break;
-    case T_OPTION_GETSIGINFO:
-        res = ptrace(PTRACE_GETSIGINFO, pid, NULL, (void *)&pproc->siginfo);
-        break;
-    case T_OPTION_GETDATA:
-        assert(addr);
-        {
-            long temp = ptrace(PTRACE_PEEKDATA, pid, addr, NULL);
-            res = errno;
-            *pdata = (res != 0) ? (*pdata) : (temp);
-        }
-        break;
-    case T_OPTION_SETDATA:
-        assert(addr);
-        {
-            res = ptrace(PTRACE_POKEDATA, pid, addr, *pdata);
-        }
-        break;
-    default:
-        res = 0;
-        break;
+        pnotif->args[i] = (unsigned long)req.data.args[i];
     }
+    res = true;
 #else
-#warning "__trace_impl() is not implemented for this platform"
-#endif /* HAVE_PTRACE */
+#warning "trace_notified() is not implemented for this platform"
+#endif /* HAVE_SYSCALL_NOTIFY */
+    
+    FUNC_RET("%d", res);
+}
+
+bool
+trace_respond(int fd, const notif_t * const pnotif, int errnum)
+{
+    FUNC_BEGIN("%d,%p,%d", fd, pnotif, errnum);
+    assert(pnotif);
+    
+    bool res = false;
+#ifdef HAVE_SYSCALL_NOTIFY
+    struct seccomp_notif_resp resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.id = pnotif->id;
+    if (errnum == 0)
+    {
+        resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+    }
+    else
+    {
+        resp.error = -errnum;
+    }
+    res = (ioctl(fd, SECCOMP_IOCTL_NOTIF_SEND, &resp) == 0);
+#else
+#warning "trace_respond() is not implemented for this platform"
+#endif /* HAVE_SYSCALL_NOTIFY */
+    
+    FUNC_RET("%d", res);
+}
+
+bool
+trace_park(const proc_t * const pproc, unsigned long * pmask)
+{
+    FUNC_BEGIN("%p,%p", pproc, pmask);
+    assert(pproc && pmask);
+    
+    bool res = false;
+#ifdef HAVE_TRACE_FORK
+    /* The parked system call is re-entered by rewinding the syscall 
+     * instruction (2 bytes), which only native 64bit system calls use */
+    if ((pproc->tflags.syscall_mode != SCMODE_LINUX64) || 
+        (OPCODE16(pproc->op) != OP_SYSCALL))
+    {
+        FUNC_RET("%d", res);
+    }
+    
+    /* Only the calling thread is copied by fork(), so a multi-threaded process
+     * cannot be parked, i.e. /proc/<pid>/task should have no subdirectory but
+     * the one of the main thread */
+    char buffer[64];
+    struct stat st;
+    sprintf(buffer, PROCFS "/%d/task", pproc->pid);
+    if ((stat(buffer, &st) != 0) || (st.st_nlink != 3))
+    {
+        FUNC_RET("%d", res);
+    }
+    
+    /* Signal handlers (e.g. of timers armed by the program) must not run 
+     * once the process is no longer traced, so all signals are blocked, and
+     * left pending, until the mask is restored in the copies */
+    proc_t proc = *pproc;
+    long mask = ~0L;
+    if (__trace(T_OPTION_SIGMASK, &proc, NULL, &mask) != 0)
+    {
+        FUNC_RET("%d", res);
+    }
+    *pmask = (unsigned long)mask;
+    
+    proc.regs.ORIG_NAX = SYS_pause;
+    res = (__trace(T_OPTION_SETREGS, &proc, NULL, NULL) == 0);
+    if (!res)
+    {
+        __trace(T_OPTION_SIGMASK, &proc, NULL, &mask);
+        FUNC_RET("%d", res);
+    }
+    res = (__trace(T_OPTION_DETACH, &proc, NULL, NULL) == 0);
+#else
+#warning "trace_park() is not implemented for this platform"
+#endif /* HAVE_TRACE_FORK */
+    
+    FUNC_RET("%d", res);
+}
+
+#ifdef HAVE_TRACE_FORK
+
+static bool
+__trace_stopped(pid_t pid, int status, bool consume)
+{
+    FUNC_BEGIN("%d,%d,%d", pid, status, consume);
+    assert(pid > 0);
+    
+    siginfo_t info;
+    const int opt = WSTOPPED | (consume ? 0 : WNOWAIT);
+    int res = 0;
+    while (((res = waitid(P_PID, pid, &info, opt)) != 0) && (errno == EINTR))
+    {
+        ;
+    }
+    
+    FUNC_RET("%d", (res == 0) && (info.si_pid == pid) && 
+        (info.si_code == CLD_TRAPPED) && (info.si_status == status));
+}
+
+static bool
+__trace_inject(pid_t pid, const struct user_regs_struct * pbase, long * pres, 
+               long nr, long arg1, long arg2, long arg3, long arg4)
+{
+    FUNC_BEGIN("%d,%p,%p,%ld,%ld,%ld,%ld,%ld", pid, pbase, pres, nr, arg1, 
+               arg2, arg3, arg4);
+    assert((pid > 0) && pbase && pres);
+    
+    /* The process is stopped right before a syscall instruction (with the 
+     * registers in *pbase), and executes it once as the injected system call
+     * (with orig_rax being -1, there is no pending system call to restart) */
+    struct user_regs_struct regs = *pbase;
+    regs.rax = nr;
+    regs.orig_rax = -1;
+    regs.rdi = arg1;
+    regs.rsi = arg2;
+    regs.rdx = arg3;
+    regs.r10 = arg4;
+    
+    bool res = (ptrace(PTRACE_SETREGS, pid, NULL, &regs) == 0) && 
+        (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) == 0) && 
+        __trace_stopped(pid, SIGTRAP, true) && 
+        (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) == 0) && 
+        __trace_stopped(pid, SIGTRAP, true) && 
+        (ptrace(PTRACE_GETREGS, pid, NULL, &regs) == 0);
+    if (res)
+    {
+        *pres = (long)regs.rax;
+    }
+    
+    FUNC_RET("%d", res);
+}
+
+#endif /* HAVE_TRACE_FORK */
+
+pid_t
+trace_fork(const proc_t * const ppoint, unsigned long mask)
+{
+    FUNC_BEGIN("%p,%lx", ppoint, mask);
+    assert(ppoint);
+    
+    pid_t pid = -1;
+#ifdef HAVE_TRACE_FORK
+    const pid_t master = ppoint->pid;
+    
+    /* The parked process sleeps in pause() at the syscall instruction (which
+     * is 2 bytes long) of the parked system call */
+    struct user_regs_struct base = ppoint->regs;
+    base.rip -= 2;
+    
+    /* Make the parked process fork() once, and park it again at the same 
+     * instruction. The copy is traced by the calling thread from the start, 
+     * and is a sibling of the parked process with CLONE_PARENT. */
+    if ((ptrace(PTRACE_ATTACH, master, NULL, NULL) != 0) || 
+        !__trace_stopped(master, SIGSTOP, true))
+    {
+        FUNC_RET("%d", pid);
+    }
+    
+    /* With all signals blocked, pause() never returns, and is restarted upon
+     * each interruption. Found anywhere else, the parked process may have run
+     * untraced, and is killed. */
+    struct user_regs_struct regs;
+    const unsigned long unblockable = (1UL << (SIGKILL - 1)) | 
+        (1UL << (SIGSTOP - 1));
+    unsigned long blocked = 0;
+    if ((ptrace(PTRACE_GETREGS, master, NULL, &regs) != 0) || 
+        (regs.orig_rax != SYS_pause) || (regs.rip != ppoint->regs.rip) || 
+        (ptrace(PTRACE_GETSIGMASK, master, sizeof(blocked), &blocked) != 0) || 
+        ((blocked | unblockable) != ~0UL))
+    {
+        WARN("parked process left pause(): %d", master);
+        kill(master, SIGKILL);
+        while ((waitpid(master, NULL, __WALL) < 0) && (errno == EINTR))
+        {
+            ;
+        }
+        FUNC_RET("%d", pid);
+    }
+    
+    regs = base;
+    regs.rax = SYS_clone;
+    regs.orig_rax = -1;
+    regs.rdi = CLONE_PARENT | SIGCHLD;
+    regs.rsi = regs.rdx = regs.r10 = 0;
+    unsigned long msg = 0;
+    bool res = (ptrace(PTRACE_SETOPTIONS, master, NULL, 
+                       PTRACE_O_TRACEFORK) == 0) && 
+        (ptrace(PTRACE_SETREGS, master, NULL, &regs) == 0) && 
+        (ptrace(PTRACE_SYSCALL, master, NULL, NULL) == 0) && 
+        __trace_stopped(master, SIGTRAP, true) && 
+        (ptrace(PTRACE_SYSCALL, master, NULL, NULL) == 0) && 
+        __trace_stopped(master, SIGTRAP | (PTRACE_EVENT_FORK << 8), true) && 
+        (ptrace(PTRACE_GETEVENTMSG, master, NULL, &msg) == 0);
+    pid = res ? (pid_t)msg : -1;
+    res = res && (ptrace(PTRACE_SYSCALL, master, NULL, NULL) == 0) && 
+        __trace_stopped(master, SIGTRAP, true);
+    
+    regs = base;
+    regs.rax = SYS_pause;
+    regs.orig_rax = -1;
+    res = (ptrace(PTRACE_SETREGS, master, NULL, &regs) == 0) && res;
+    res = (ptrace(PTRACE_DETACH, master, NULL, NULL) == 0) && res;
+    
+    if (pid <= 0)
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    /* The copy starts with a SIGSTOP, and is the leader of its own session,
+     * such that it can be killed as a process group */
+    long ret = -1;
+    res = res && __trace_stopped(pid, SIGSTOP, true) && 
+        (ptrace(PTRACE_SETOPTIONS, pid, NULL, 0) == 0) && 
+        __trace_inject(pid, &base, &ret, SYS_setsid, 0, 0, 0, 0) && 
+        (ret == pid) && 
+        __trace_inject(pid, &base, &ret, SYS_prctl, PR_SET_PDEATHSIG, 
+                       SIGKILL, 0, 0) && 
+        (ret == 0);
+    
+    /* Receive the standard channels of the copy into a frame on its stack,
+     * below the red zone. Pointers in the frame are addresses in the copy. */
+    typedef struct
+    {
+        struct msghdr msg;
+        struct iovec iov;
+        char data[8];
+        union
+        {
+            struct cmsghdr hdr;
+            char buf[CMSG_SPACE(3 * sizeof(int))];
+        } ctl;
+    } frame_t;
+    
+    frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    const unsigned long addr = (base.rsp - 128 - sizeof(frame_t)) & ~15UL;
+    frame.msg.msg_iov = (struct iovec *)(addr + offsetof(frame_t, iov));
+    frame.msg.msg_iovlen = 1;
+    frame.msg.msg_control = (void *)(addr + offsetof(frame_t, ctl));
+    frame.msg.msg_controllen = sizeof(frame.ctl.buf);
+    frame.iov.iov_base = (void *)(addr + offsetof(frame_t, data));
+    frame.iov.iov_len = sizeof(frame.data);
+    
+    size_t offset;
+    for (offset = 0; res && (offset < sizeof(frame_t)); offset += sizeof(long))
+    {
+        long word;
+        memcpy(&word, (char *)&frame + offset, sizeof(long));
+        res = (ptrace(PTRACE_POKEDATA, pid, addr + offset, word) == 0);
+    }
+    res = res && __trace_inject(pid, &base, &ret, SYS_recvmsg, STDIN_FILENO, 
+                                addr, MSG_DONTWAIT, 0) && (ret > 0);
+    for (offset = 0; res && (offset < sizeof(frame_t)); offset += sizeof(long))
+    {
+        errno = 0;
+        long word = ptrace(PTRACE_PEEKDATA, pid, addr + offset, NULL);
+        res = (errno == 0);
+        memcpy((char *)&frame + offset, &word, sizeof(long));
+    }
+    
+    int fds[3] = {-1, -1, -1};
+    res = res && !(frame.msg.msg_flags & MSG_CTRUNC) && 
+        (frame.ctl.hdr.cmsg_level == SOL_SOCKET) && 
+        (frame.ctl.hdr.cmsg_type == SCM_RIGHTS) && 
+        (frame.ctl.hdr.cmsg_len == CMSG_LEN(sizeof(fds)));
+    if (res)
+    {
+        memcpy(fds, CMSG_DATA(&frame.ctl.hdr), sizeof(fds));
+    }
+    
+    int i;
+    for (i = 0; res && (i < 3); i++)
+    {
+        res = (fds[i] > STDERR_FILENO) && 
+            __trace_inject(pid, &base, &ret, SYS_dup2, fds[i], i, 0, 0) && 
+            (ret == i);
+    }
+    for (i = 0; res && (i < 3); i++)
+    {
+        res = __trace_inject(pid, &base, &ret, SYS_close, fds[i], 0, 0, 0) && 
+            (ret == 0);
+    }
+    
+    /* Resume the copy from the snapshot of the fork point, with the signal 
+     * mask of the program, such that it stops upon re-entering the parked 
+     * system call */
+    regs = ppoint->regs;
+    regs.rip = base.rip;
+    regs.rax = ppoint->regs.orig_rax;
+    regs.orig_rax = -1;
+    res = res && (ptrace(PTRACE_SETSIGMASK, pid, sizeof(mask), &mask) == 0) && 
+        (ptrace(PTRACE_SETREGS, pid, NULL, &regs) == 0) && 
+        (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) == 0) && 
+        __trace_stopped(pid, SIGTRAP, false);
+    
+    if (!res)
+    {
+        kill(pid, SIGKILL);
+        while ((waitpid(pid, NULL, 0) < 0) && (errno == EINTR))
+        {
+            ;
+        }
+        pid = -1;
+    }
+#else
+#warning "trace_fork() is not implemented for this platform"
+#endif /* HAVE_TRACE_FORK */
+    
+    FUNC_RET("%d", pid);
+}
+
+bool
+trace_next(proc_t * const pproc, trace_type_t type)
+{
+    FUNC_BEGIN("%p,%d", pproc, type);
+    assert(pproc);
+    
+    long opt = (long)type;
+    bool res = (__trace(T_OPTION_NEXT, pproc, NULL, &opt) == 0);
+    
+    FUNC_RET("%d", res);
+}
+
+bool
+trace_kill(const proc_t * const pproc, int signo)
+{
+    FUNC_BEGIN("%p,%d", pproc, signo);
+    assert(pproc);
+    
+    /* Temporary variables */
+    pid_t pid = pproc->pid;
+    
+    /* When the prisoner process is to be killed with SIGKILL, we flush the
+     * pending opcode with a sequence of NOP. If there is pending syscall, we
+     * also replace the syscall number with SYS_pause. These precautions are
+     * essential for certain kernel versions where a killed program has chance
+     * to overrun for a few instructions. Otherwise, there is probability that
+     * the overrun may lead to undesired side effects or even security risk. */
+
+    /* We only flush opcode when signo is SIGKILL. This is because the prisoner
+     * process may continue to execute after handling (or ignoring) a blockable
+     * signal. It only makes sense to flush the opcode if the prisoner process
+     * is guaranteed to die immediately. */
+    
+    if (signo == SIGKILL)
+    {
+        /* Make a local copy of the proc stat buffer */
+        proc_t proc = {0};
+        memcpy(&proc, pproc, sizeof(proc_t));
+        if (!proc_probe(pid, PROBE_REGS | PROBE_OP, &proc))
+        {
+            WARN("failed to probe process: %d", pid);
+            goto skip_rewrite;
+        }
+        
+        /* Flush pending opcode with a sequence of NOP. */
+        unsigned long addr = proc.regs.NIP;
+        unsigned long nop = 0;
+        memset((void *)&nop, OP_NOP, sizeof(unsigned long));
+        __trace(T_OPTION_SETDATA, &proc, (void *)addr, (long *)&nop);
+        
+        /* Replace the pending system call with SYS_pause */
+        if (IS_SYSCALL(&proc))
+        {
+            if (proc.tflags.single_step)
+            {
+                proc.regs.NAX = SYS_pause;
+            }
+            else
+            {
+                proc.regs.ORIG_NAX = SYS_pause;
+            }
+#ifdef __x86_64__
+            proc.regs.cs = 0x33;
+#else /* __i386__ */
+            proc.regs.xcs = 0x23;
+#endif /* __x86_64__ */
+            __trace(T_OPTION_SETREGS, &proc, NULL, NULL);
+        }
+skip_rewrite:
+        ;
+    }
+    
+    bool res = (kill(-pid, signo) == 0);
+    
+    FUNC_RET("%d", res);
+}
+
+bool
+trace_end(const proc_t * const pproc)
+{
+    FUNC_BEGIN("%p", pproc);
+    assert(pproc);
+    
+    bool res = (__trace(T_OPTION_END, (proc_t *)pproc, NULL, NULL) == 0);
+    
+    /* Discard zombie children */
+    while (waitpid(-pproc->pid, NULL, WNOHANG) >= 0)
+    {
+        ;
+    }
+    
+    FUNC_RET("%d", res);
+}
+
+/* Most trace_*() functions directly or indirectly invokes ptrace() in linux. 
+ * But ptrace() only works when called from the *main* thread initially started 
+ * tracing the prisoner process (and thus being the parent of the latter). The 
+ * workaround is to make __trace() asynchronous. It places the desired option 
+ * (and input) into global variables, and waits for sandbox_tracer() to perform
+ * the desired options by calling __trace_impl(), which then calls ptrace().
+ * sandbox_tracer() is guaranteed to be running in the *main* thread. */
+
+#define NO_ACTION(act) \
+    (((act) == T_OPTION_NOP) || ((act) == T_OPTION_ACK)) \
+/* NO_ACTION */
+
+static long
+__trace_impl(option_t option, proc_t * const pproc, void * const addr, 
+    long * const pdata)
+{
+    FUNC_BEGIN("%d,%p,%p,%p", option, pproc, addr, pdata);
+    assert(!NO_ACTION(option));
+    assert(pproc);
+    
+    if (option == T_OPTION_END)
+    {
+        FUNC_RET("%ld", 0L);
+    }
+    
+    long res = -1;
+    pid_t pid = pproc->pid;
+    
+    if (pproc->ppid != getpid())
+    {
+        FUNC_RET("%ld", res);
+    }
+    
+#ifdef HAVE_PTRACE
+    switch (option)
+    {
+    case T_OPTION_NEXT:
+        assert(pdata);
+        pproc->tflags.single_step = ((int)(*pdata) == TRACE_SINGLE_STEP);
+        if (pproc->tflags.single_step)
+        {
+            res = ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL);
+        }
+        else if ((int)(*pdata) == TRACE_FILTERED_CALL)
+        {
+            res = ptrace(PTRACE_CONT, pid, NULL, NULL);
+        }
+        else
+        {
+            res = ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+        }
+        break;
+#ifdef HAVE_SYSCALL_FILTER
+    case T_OPTION_FILTER:
+        res = ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESECCOMP);
+        break;
+#endif /* HAVE_SYSCALL_FILTER */
+    case T_OPTION_GETREGS:
+        res = ptrace(PTRACE_GETREGS, pid, NULL, (void *)&pproc->regs);
+        break;
+    case T_OPTION_DETACH:
+        res = ptrace(PTRACE_DETACH, pid, NULL, NULL);
+        break;
+#ifdef HAVE_TRACE_FORK
+    case T_OPTION_SIGMASK:
+        assert(pdata);
+        /* Swap the signal mask of the process with data */
+        {
+            unsigned long mask = 0;
+            res = ptrace(PTRACE_GETSIGMASK, pid, sizeof(mask), &mask);
+            if (res == 0)
+            {
+                res = ptrace(PTRACE_SETSIGMASK, pid, sizeof(mask), pdata);
+            }
+            *pdata = (res != 0) ? (*pdata) : ((long)mask);
+        }
+        break;
+#endif /* HAVE_TRACE_FORK */
+    case T_OPTION_SETREGS:
+        res = ptrace(PTRACE_SETREGS, pid, NULL, (void *)&pproc->regs);
+        break;
+    case T_OPTION_GETSIGINFO:
+        res = ptrace(PTRACE_GETSIGINFO, pid, NULL, (void *)&pproc->siginfo);
+        break;
+    case T_OPTION_GETDATA:
+        assert(addr);
+        {
+            long temp = ptrace(PTRACE_PEEKDATA, pid, addr, NULL);
+            res = errno;
+            *pdata = (res != 0) ? (*pdata) : (temp);
+        }
+        break;
+    case T_OPTION_SETDATA:
+        assert(addr);
+        {
+            res = ptrace(PTRACE_POKEDATA, pid, addr, *pdata);
+        }
+        break;
+    default:
+        res = 0;
+        break;
+    }
+#else
+#warning "__trace_impl() is not implemented for this platform"
+#endif /* HAVE_PTRACE */
     
     FUNC_RET("%ld", res);
 }
 
-/* Global variables for the trace subsystem */
+/* Global variables for the trace subsystem */
+
+typedef struct
+{
+    option_t option;
+    proc_t * pproc;
+    void * addr;
+    long data;
+    long result;
+    int errnum;
+} trace_info_t;
+
+static trace_info_t trace_info = {T_OPTION_NOP, NULL, NULL, 0, 0, 0};
+static pthread_cond_t trace_update = PTHREAD_COND_INITIALIZER;
+
+typedef struct __pool_item
+{
+    sandbox_t * psbox;
+    SLIST_ENTRY(__pool_item) entries;
+} sandbox_mgr_t;
+
+static SLIST_HEAD(__pool_struct, __pool_item) global_pool = \
+    SLIST_HEAD_INITIALIZER(global_pool);
+
+typedef struct __pool_struct sandbox_pool_t;
+
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t global_once = PTHREAD_ONCE_INIT;
+static pthread_t manager_thread;
+static int manager_efd = -1;
+
+static void global_init(void);
+
+static long
+__trace(option_t option, proc_t * const pproc, void * const addr, 
+    long * const pdata)
+{
+    FUNC_BEGIN("%d,%p,%p,%p", option, pproc, addr, pdata);
+    assert(!NO_ACTION(option));
+    assert(pproc);
+    
+    /* Shortcut to synchronous trace */
+    if (pthread_equal(pproc->tflags.trace_id, pthread_self()) && 
+        (option != T_OPTION_END))
+    {
+        FUNC_RET("%ld", __trace_impl(option, pproc, addr, pdata));
+    }
+    
+    long res = 0;
+    
+    P(&global_mutex);
+    
+    /* Wait while an existing option is being performed */
+    while (trace_info.option != T_OPTION_NOP)
+    {
+        DBUG("waiting for trace slot");
+        pthread_cond_wait(&trace_update, &global_mutex);
+    }
+    
+    DBUG("obtained trace slot");
+    
+    /* Propose the request */
+    trace_info.option = option;
+    trace_info.pproc = pproc;
+    trace_info.addr = addr;
+    trace_info.data = ((pdata != NULL) ? (*pdata) : (0));
+    trace_info.result = 0;
+    trace_info.errnum = errno;
+    pthread_cond_broadcast(&trace_update);
+    
+    /* Wait while the option is being performed */
+    while (trace_info.option != T_OPTION_ACK)
+    {
+        DBUG("requesting trace option: %s", s_trace_opt_name(trace_info.option));
+        pthread_cond_wait(&trace_update, &global_mutex);
+    }
+    
+    if (pdata != NULL)
+    {
+        *pdata = trace_info.data;
+    }
+    res = trace_info.result;
+    errno = trace_info.errnum;
+    
+    DBUG("collected trace results");
+    
+    /* Release slot */
+    trace_info.option = T_OPTION_NOP;
+    trace_info.pproc = NULL;
+    trace_info.addr = NULL;
+    trace_info.data = 0;
+    trace_info.result = 0;
+    trace_info.errnum = errno;
+    pthread_cond_broadcast(&trace_update);
+    
+    DBUG("released trace slot");
+    
+    V(&global_mutex);
+    
+    FUNC_RET("%ld", res);
+}
+
+void *
+sandbox_tracer(void * const dummy)
+{
+    FUNC_BEGIN("%p", dummy);
+    assert(dummy);
+    
+    sandbox_t * const psbox = (sandbox_t *)dummy;
+    
+    if (psbox == NULL)
+    {
+        FUNC_RET("%p", (void *)NULL);
+    }
+    
+    /* Start the manager thread upon the first sandbox execution */
+    if (pthread_once(&global_once, global_init) != 0)
+    {
+        WARN("failed to initialize the manager thread");
+    }
+    
+    /* Register sandbox to the pool */
+    P(&global_mutex);
+    sandbox_mgr_t * item = (sandbox_mgr_t *)malloc(sizeof(sandbox_mgr_t));
+    item->psbox = psbox;
+    SLIST_INSERT_HEAD(&global_pool, item, entries);
+    DBUG("registered sandbox %p to the pool", psbox);
+    V(&global_mutex);
+    
+    /* Detect and perform options while the sandbox is running */
+    bool end = false;
+    
+    P(&global_mutex);
+    while (!end)
+    {
+        /* Wait for an option request */
+        if (NO_ACTION(trace_info.option))
+        {
+            DBUG("waiting for new trace option");
+            pthread_cond_wait(&trace_update, &global_mutex);
+            if (NO_ACTION(trace_info.option))
+            {
+                continue;
+            }
+        }
+        
+        /* Leave options of other sandboxes to their own tracers */
+        proc_t * pproc = trace_info.pproc;
+        if (!pthread_equal(pproc->tflags.trace_id,  pthread_self()))
+        {
+            pthread_cond_wait(&trace_update, &global_mutex);
+            continue;
+        }
+        
+        DBUG("received trace option: %s", s_trace_opt_name(trace_info.option));
+        
+        if (trace_info.option == T_OPTION_END)
+        {
+            end = true;
+        }
+        
+        /* Notify the trace_*() to collect results */
+        trace_info.result = __trace_impl(trace_info.option, trace_info.pproc,
+            trace_info.addr, &trace_info.data);
+        trace_info.errnum = errno;
+        trace_info.option = T_OPTION_ACK;
+        pthread_cond_broadcast(&trace_update);
+        
+        while (trace_info.option == T_OPTION_ACK)
+        {
+            DBUG("sending trace option: %s", s_trace_opt_name(T_OPTION_ACK));
+            pthread_cond_wait(&trace_update, &global_mutex);
+        }
+        
+        DBUG("sent trace option: %s", s_trace_opt_name(T_OPTION_ACK));
+    }
+    V(&global_mutex);
+    
+    /* Remove sandbox from the pool */
+    P(&global_mutex);
+    assert(item);
+    SLIST_REMOVE(&global_pool, item, __pool_item, entries);
+    free(item);
+    DBUG("removed sandbox %p from the pool", psbox);
+    V(&global_mutex);
+    
+    FUNC_RET("%p", (void *)&psbox->result);
+}
+
+/* Global variables for cpu placement */
+
+#ifdef HAVE_SCHED_H
+static cpu_set_t global_cpuset;
+static int cpu_sibling_map[CPU_SETSIZE];
+static unsigned int cpu_usage[CPU_SETSIZE];
+#endif /* HAVE_SCHED_H */
+
+static pthread_mutex_t cpu_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef HAVE_SCHED_H
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+
+static void
+cpu_init(void)
+{
+    PROC_BEGIN();
+    
+    /* Load the set of cpu's available to this process, and the first sibling
+     * (hyperthread) of each available cpu, for placing sandbox instances */
+    CPU_ZERO(&global_cpuset);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &global_cpuset) != 0)
+    {
+        WARN("failed to get cpu affinity of current process");
+        CPU_ZERO(&global_cpuset);
+    }
+    
+    int cpu;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        cpu_sibling_map[cpu] = SBOX_CPU_ANY;
+        if (!CPU_ISSET(cpu, &global_cpuset))
+        {
+            continue;
+        }
+        char buffer[SBOX_PATH_MAX];
+        sprintf(buffer, SYSFS "/devices/system/cpu/cpu%d/topology/"
+            "thread_siblings_list", cpu);
+        FILE * fp = fopen(buffer, "r");
+        if (fp == NULL)
+        {
+            continue;
+        }
+        /* The list is formatted as comma separated cpu numbers and ranges,
+         * e.g. "0,4" or "0-1" */
+        int first = 0, last = 0;
+        while ((cpu_sibling_map[cpu] < 0) && (fscanf(fp, "%d", &first) == 1))
+        {
+            last = first;
+            int delim = fgetc(fp);
+            if ((delim == '-') && (fscanf(fp, "%d", &last) == 1))
+            {
+                delim = fgetc(fp);
+            }
+            for (; (first <= last) && (first < CPU_SETSIZE); first++)
+            {
+                if (first != cpu)
+                {
+                    cpu_sibling_map[cpu] = first;
+                    break;
+                }
+            }
+            if (delim != ',')
+            {
+                break;
+            }
+        }
+        fclose(fp);
+        DBUG("cpu %d has sibling %d", cpu, cpu_sibling_map[cpu]);
+    }
+    
+    PROC_END();
+}
+#endif /* HAVE_SCHED_H */
+
+int
+cpu_reserve(int cpu)
+{
+    FUNC_BEGIN("%d", cpu);
+    
+    int res = SBOX_CPU_ANY;
+    
+#ifdef HAVE_SCHED_H
+    pthread_once(&cpu_once, cpu_init);
+    
+    P(&cpu_mutex);
+    if (cpu >= 0)
+    {
+        if ((cpu < CPU_SETSIZE) && CPU_ISSET(cpu, &global_cpuset))
+        {
+            res = cpu;
+        }
+    }
+    else if (cpu == SBOX_CPU_AUTO)
+    {
+        /* The first pass looks for an idle cpu whose sibling is also idle, so 
+         * that the tracer threads can be placed on the sibling. The second 
+         * pass settles for any idle cpu. */
+        int pass, i;
+        for (pass = 0; (pass < 2) && (res < 0); pass++)
+        {
+            for (i = 0; (i < CPU_SETSIZE) && (res < 0); i++)
+            {
+                if (!CPU_ISSET(i, &global_cpuset) || (cpu_usage[i] > 0))
+                {
+                    continue;
+                }
+                const int sib = cpu_sibling_map[i];
+                if ((pass == 0) && (sib >= 0) && (cpu_usage[sib] > 0))
+                {
+                    continue;
+                }
+                res = i;
+            }
+        }
+    }
+    if (res >= 0)
+    {
+        ++cpu_usage[res];
+        DBUG("reserved cpu %d (%u)", res, cpu_usage[res]);
+    }
+    V(&cpu_mutex);
+#endif /* HAVE_SCHED_H */
+    
+    FUNC_RET("%d", res);
+}
 
-typedef struct
+int
+cpu_sibling(int cpu)
 {
-    option_t option;
-    proc_t * pproc;
-    void * addr;
-    long data;
-    long result;
-    int errnum;
-} trace_info_t;
+    FUNC_BEGIN("%d", cpu);
+    
+    int res = SBOX_CPU_ANY;
+    
+#ifdef HAVE_SCHED_H
+    if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+    {
+        FUNC_RET("%d", res);
+    }
+    
+    pthread_once(&cpu_once, cpu_init);
+    
+    P(&cpu_mutex);
+    const int sib = cpu_sibling_map[cpu];
+    if ((sib >= 0) && CPU_ISSET(sib, &global_cpuset) && (cpu_usage[sib] == 0))
+    {
+        res = sib;
+        ++cpu_usage[res];
+        DBUG("reserved cpu %d (%u) as sibling of cpu %d", res, cpu_usage[res],
+            cpu);
+    }
+    V(&cpu_mutex);
+#endif /* HAVE_SCHED_H */
+    
+    FUNC_RET("%d", res);
+}
 
-static trace_info_t trace_info = {T_OPTION_NOP, NULL, NULL, 0, 0, 0};
-static pthread_cond_t trace_update = PTHREAD_COND_INITIALIZER;
+void
+cpu_release(int cpu)
+{
+    PROC_BEGIN("%d", cpu);
+    
+#ifdef HAVE_SCHED_H
+    if ((cpu >= 0) && (cpu < CPU_SETSIZE))
+    {
+        P(&cpu_mutex);
+        if (cpu_usage[cpu] > 0)
+        {
+            --cpu_usage[cpu];
+            DBUG("released cpu %d (%u)", cpu, cpu_usage[cpu]);
+        }
+        V(&cpu_mutex);
+    }
+#endif /* HAVE_SCHED_H */
+    
+    PROC_END();
+}
 
-typedef struct __pool_item
+bool
+cpu_allowed(int cpu)
 {
-    sandbox_t * psbox;
-    SLIST_ENTRY(__pool_item) entries;
-} sandbox_mgr_t;
+    FUNC_BEGIN("%d", cpu);
+    
+#ifdef HAVE_SCHED_H
+    if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+    {
+        FUNC_RET("%d", false);
+    }
+    pthread_once(&cpu_once, cpu_init);
+    FUNC_RET("%d", CPU_ISSET(cpu, &global_cpuset) != 0);
+#else
+    FUNC_RET("%d", false);
+#endif /* HAVE_SCHED_H */
+}
 
-static SLIST_HEAD(__pool_struct, __pool_item) global_pool = \
-    SLIST_HEAD_INITIALIZER(global_pool);
+#ifdef HAVE_SCHED_H
+/* The saved affinity should fit in the opaque storage of cpu_saved_t */
+typedef char cpu_saved_check_t[(sizeof(cpu_set_t) <= 
+    sizeof(((cpu_saved_t *)0)->mask)) ? 1 : -1];
+#endif /* HAVE_SCHED_H */
 
-typedef struct __pool_struct sandbox_pool_t;
+bool
+cpu_bind(pthread_t tid, int cpu, cpu_saved_t * psaved)
+{
+    FUNC_BEGIN("%p,%d,%p", (void *)tid, cpu, psaved);
+    
+    if (psaved != NULL)
+    {
+        psaved->saved = false;
+    }
+    
+#ifdef HAVE_SCHED_H
+    cpu_set_t cpuset;
+    if (cpu >= 0)
+    {
+        if (cpu >= CPU_SETSIZE)
+        {
+            FUNC_RET("%d", false);
+        }
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+    }
+    else
+    {
+        pthread_once(&cpu_once, cpu_init);
+        cpuset = global_cpuset;
+        if (CPU_COUNT(&cpuset) == 0)
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    /* Save the affinity of the thread, which may have been set by the host 
+     * application, for cpu_restore() to put back */
+    if (psaved != NULL)
+    {
+        psaved->saved = (pthread_getaffinity_np(tid, sizeof(cpu_set_t), 
+            (cpu_set_t *)psaved->mask) == 0);
+    }
+    if (pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cpuset) != 0)
+    {
+        WARN("failed to bind thread %p to cpu %d", (void *)tid, cpu);
+        if (psaved != NULL)
+        {
+            psaved->saved = false;
+        }
+        FUNC_RET("%d", false);
+    }
+    DBUG("bound thread %p to cpu %d", (void *)tid, cpu);
+    FUNC_RET("%d", true);
+#else
+    FUNC_RET("%d", (cpu < 0));
+#endif /* HAVE_SCHED_H */
+}
 
-static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+bool
+cpu_restore(pthread_t tid, const cpu_saved_t * psaved)
+{
+    FUNC_BEGIN("%p,%p", (void *)tid, psaved);
+    assert(psaved);
+    
+#ifdef HAVE_SCHED_H
+    if (!psaved->saved)
+    {
+        FUNC_RET("%d", cpu_bind(tid, SBOX_CPU_ANY, NULL));
+    }
+    if (pthread_setaffinity_np(tid, sizeof(cpu_set_t), 
+        (const cpu_set_t *)psaved->mask) != 0)
+    {
+        WARN("failed to restore the affinity of thread %p", (void *)tid);
+        FUNC_RET("%d", false);
+    }
+    DBUG("restored the affinity of thread %p", (void *)tid);
+    FUNC_RET("%d", true);
+#else
+    FUNC_RET("%d", true);
+#endif /* HAVE_SCHED_H */
+}
+
+bool
+cpu_bind_proc(pid_t pid, int cpu)
+{
+    FUNC_BEGIN("%d,%d", pid, cpu);
+    
+#ifdef HAVE_SCHED_H
+    if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+    {
+        FUNC_RET("%d", false);
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (sched_setaffinity(pid, sizeof(cpu_set_t), &cpuset) != 0)
+    {
+        WARN("failed to bind process %d to cpu %d", pid, cpu);
+        FUNC_RET("%d", false);
+    }
+    DBUG("bound process %d to cpu %d", pid, cpu);
+    FUNC_RET("%d", true);
+#else
+    FUNC_RET("%d", false);
+#endif /* HAVE_SCHED_H */
+}
+
+int
+fs_abi(void)
+{
+    FUNC_BEGIN();
+    
+    int abi = 0;
+#ifdef HAVE_FS_RESTRICT
+    abi = syscall(SYS_landlock_create_ruleset, NULL, 0, 
+        LANDLOCK_CREATE_RULESET_VERSION);
+    if (abi < 0)
+    {
+        abi = 0;
+    }
+#endif /* HAVE_FS_RESTRICT */
+    
+    FUNC_RET("%d", abi);
+}
+
+bool
+fs_restrict(const char * const paths[], const int modes[], int n)
+{
+    FUNC_BEGIN("%p,%p,%d", paths, modes, n);
+    assert(paths && modes && (n >= 0));
+    
+#ifdef HAVE_FS_RESTRICT
+    const int abi = fs_abi();
+    if (abi <= 0)
+    {
+        errno = EOPNOTSUPP;
+        FUNC_RET("%d", false);
+    }
+    
+    /* Handle all access rights of the first ABI, plus the later ones known to 
+     * both the kernel headers and the running kernel. Rights not handled here 
+     * remain unrestricted. */
+    __u64 handled = (LANDLOCK_ACCESS_FS_MAKE_SYM << 1) - 1;
+    __u64 file_rights = LANDLOCK_ACCESS_FS_EXECUTE | 
+        LANDLOCK_ACCESS_FS_WRITE_FILE | LANDLOCK_ACCESS_FS_READ_FILE;
+#ifdef LANDLOCK_ACCESS_FS_REFER
+    if (abi >= 2)
+    {
+        handled |= LANDLOCK_ACCESS_FS_REFER;
+    }
+#endif /* LANDLOCK_ACCESS_FS_REFER */
+#ifdef LANDLOCK_ACCESS_FS_TRUNCATE
+    if (abi >= 3)
+    {
+        handled |= LANDLOCK_ACCESS_FS_TRUNCATE;
+        file_rights |= LANDLOCK_ACCESS_FS_TRUNCATE;
+    }
+#endif /* LANDLOCK_ACCESS_FS_TRUNCATE */
+    const __u64 read_rights = LANDLOCK_ACCESS_FS_EXECUTE | 
+        LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR;
+    
+    struct landlock_ruleset_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.handled_access_fs = handled;
+    int ruleset = syscall(SYS_landlock_create_ruleset, &attr, sizeof(attr), 0);
+    if (ruleset < 0)
+    {
+        WARN("failed to create landlock ruleset");
+        FUNC_RET("%d", false);
+    }
+    
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        __u64 allowed = 0;
+        switch (modes[i])
+        {
+        case S_FS_WRITE:
+            allowed = handled;
+            break;
+        case S_FS_READ:
+            allowed = read_rights;
+            break;
+        default:
+            break;
+        }
+        if (allowed == 0)
+        {
+            continue;
+        }
+        
+        /* Nothing to grant beneath a path that does not exist */
+        int fd = open(paths[i], O_PATH | O_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == ENOENT)
+            {
+                DBUG("skipped missing path \"%s\"", paths[i]);
+                continue;
+            }
+            WARN("failed to open \"%s\"", paths[i]);
+            close(ruleset);
+            FUNC_RET("%d", false);
+        }
+        
+        /* Directory rights are rejected for regular files */
+        struct stat s;
+        if ((fstat(fd, &s) == 0) && !S_ISDIR(s.st_mode))
+        {
+            allowed &= file_rights;
+        }
+        
+        struct landlock_path_beneath_attr rule;
+        memset(&rule, 0, sizeof(rule));
+        rule.allowed_access = allowed;
+        rule.parent_fd = fd;
+        int res = syscall(SYS_landlock_add_rule, ruleset, 
+            LANDLOCK_RULE_PATH_BENEATH, &rule, 0);
+        close(fd);
+        if (res != 0)
+        {
+            WARN("failed to add landlock rule for \"%s\"", paths[i]);
+            close(ruleset);
+            FUNC_RET("%d", false);
+        }
+        DBUG("landlock: \"%s\" 0x%llx", paths[i], (unsigned long long)allowed);
+    }
+    
+    /* Required for an unprivileged process to restrict itself */
+    if ((prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) || 
+        (syscall(SYS_landlock_restrict_self, ruleset, 0) != 0))
+    {
+        WARN("failed to enforce landlock ruleset");
+        close(ruleset);
+        FUNC_RET("%d", false);
+    }
+    close(ruleset);
+    
+    FUNC_RET("%d", true);
+#else
+    errno = EOPNOTSUPP;
+    FUNC_RET("%d", false);
+#endif /* HAVE_FS_RESTRICT */
+}
+
+int
+ns_clone_flags(int ns)
+{
+    FUNC_BEGIN("%d", ns);
+    
+    int flags = 0;
+#ifdef HAVE_NAMESPACE
+    /* The prisoner process must be the first process of its pid namespace, 
+     * whereas a privileged process creates the other namespaces without a 
+     * fresh user namespace */
+    if (ns & S_NS_PID)
+    {
+        flags |= CLONE_NEWPID;
+    }
+    if ((ns & S_NS_USER) && (geteuid() != (uid_t)0))
+    {
+        flags |= CLONE_NEWUSER;
+    }
+#endif /* HAVE_NAMESPACE */
+    
+    FUNC_RET("%d", flags);
+}
+
+#ifdef HAVE_NAMESPACE
+static bool
+__ns_write(const char * path, const char * buff)
+{
+    FUNC_BEGIN("%p,%p", path, buff);
+    assert(path && buff);
+    
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        FUNC_RET("%d", false);
+    }
+    const ssize_t len = (ssize_t)strlen(buff);
+    const bool res = (write(fd, buff, len) == len);
+    close(fd);
+    
+    FUNC_RET("%d", res);
+}
+#endif /* HAVE_NAMESPACE */
+
+bool
+ns_enter(int ns, uid_t uid, gid_t gid, const char * jail)
+{
+    FUNC_BEGIN("%d,%lu,%lu,%p", ns, (unsigned long)uid, (unsigned long)gid, 
+        jail);
+    assert(jail);
+    
+#ifdef HAVE_NAMESPACE
+    /* The fresh user namespace is created by clone(), where the identity of
+     * the calling process is not yet mapped, and supplementary groups cannot
+     * be dropped by an unprivileged process anyway */
+    char buff[SBOX_PATH_MAX + sizeof("/proc")];
+    if (ns_clone_flags(ns) & CLONE_NEWUSER)
+    {
+        if (!__ns_write("/proc/self/setgroups", "deny"))
+        {
+            WARN("failed to deny setgroups()");
+            FUNC_RET("%d", false);
+        }
+        snprintf(buff, sizeof(buff), "%lu %lu 1", (unsigned long)uid, 
+            (unsigned long)uid);
+        if (!__ns_write("/proc/self/uid_map", buff))
+        {
+            WARN("failed to map owner identity");
+            FUNC_RET("%d", false);
+        }
+        snprintf(buff, sizeof(buff), "%lu %lu 1", (unsigned long)gid, 
+            (unsigned long)gid);
+        if (!__ns_write("/proc/self/gid_map", buff))
+        {
+            WARN("failed to map group identity");
+            FUNC_RET("%d", false);
+        }
+        DBUG("user namespace: %lu:%lu", (unsigned long)uid, 
+            (unsigned long)gid);
+    }
+    
+    int flags = 0;
+    flags |= (ns & S_NS_MOUNT) ? CLONE_NEWNS : 0;
+    flags |= (ns & S_NS_NET) ? CLONE_NEWNET : 0;
+    flags |= (ns & S_NS_IPC) ? CLONE_NEWIPC : 0;
+    flags |= (ns & S_NS_UTS) ? CLONE_NEWUTS : 0;
+    if ((flags != 0) && (unshare(flags) != 0))
+    {
+        WARN("failed to unshare(0x%x)", flags);
+        FUNC_RET("%d", false);
+    }
+    DBUG("unshare: 0x%x", flags);
+    
+    /* Stop propagating mount events between the host and the prisoner, then 
+     * replace the procfs of the host, which exposes processes outside of the
+     * fresh pid namespace */
+    if (ns & S_NS_MOUNT)
+    {
+        if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0)
+        {
+            WARN("failed to make mount points private");
+            FUNC_RET("%d", false);
+        }
+        struct stat s;
+        snprintf(buff, sizeof(buff), "%s/proc", 
+            (strcmp(jail, "/") != 0) ? (jail) : (""));
+        if ((ns & S_NS_PID) && (stat(buff, &s) == 0) && S_ISDIR(s.st_mode))
+        {
+            if (mount("proc", buff, "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC,
+                NULL) != 0)
+            {
+                WARN("failed to mount procfs onto \"%s\"", buff);
+                FUNC_RET("%d", false);
+            }
+            DBUG("mount: \"%s\"", buff);
+        }
+    }
+    
+    FUNC_RET("%d", true);
+#else
+    errno = EOPNOTSUPP;
+    FUNC_RET("%d", (ns == S_NS_NONE));
+#endif /* HAVE_NAMESPACE */
+}
 
-static long
-__trace(option_t option, proc_t * const pproc, void * const addr, 
-    long * const pdata)
+#ifdef HAVE_NAMESPACE
+static unsigned long
+__ns_locked_flags(const char * path)
 {
-    FUNC_BEGIN("%d,%p,%p,%p", option, pproc, addr, pdata);
-    assert(!NO_ACTION(option));
-    assert(pproc);
-    
-    /* Shortcut to synchronous trace */
-    if (pthread_equal(pproc->tflags.trace_id, pthread_self()) && 
-        (option != T_OPTION_END))
+    FUNC_BEGIN("%p", path);
+    assert(path);
+    
+    /* Remounting a bind mount must not clear these flags of the mount beneath,
+     * which are locked if the mount is inherited from a more privileged user
+     * namespace */
+    unsigned long flags = 0;
+    struct statvfs sv;
+    if (statvfs(path, &sv) == 0)
     {
-        FUNC_RET("%ld", __trace_impl(option, pproc, addr, pdata));
+        flags |= (sv.f_flag & ST_NOSUID) ? MS_NOSUID : 0;
+        flags |= (sv.f_flag & ST_NODEV) ? MS_NODEV : 0;
+        flags |= (sv.f_flag & ST_NOEXEC) ? MS_NOEXEC : 0;
+        flags |= (sv.f_flag & ST_NOATIME) ? MS_NOATIME : 0;
+        flags |= (sv.f_flag & ST_NODIRATIME) ? MS_NODIRATIME : 0;
+        flags |= (sv.f_flag & ST_RELATIME) ? MS_RELATIME : 0;
     }
     
-    long res = 0;
-    
-    P(&global_mutex);
-    
-    /* Wait while an existing option is being performed */
-    while (trace_info.option != T_OPTION_NOP)
+    FUNC_RET("%lu", flags);
+}
+#endif /* HAVE_NAMESPACE */
+
+bool
+ns_mount_jail(const char * jail, bool readonly, const char * scratch, 
+              unsigned long long size, const char * prog, const char * target)
+{
+    FUNC_BEGIN("%p,%d,%p,%llu,%p,%p", jail, readonly, scratch, size, prog, 
+        target);
+    assert(jail && scratch && prog && target);
+    
+#ifdef HAVE_NAMESPACE
+    /* The jail becomes a mount point of its own, such that it can be remounted
+     * read-only without affecting the host (nor the mounts beneath) */
+    const unsigned long locked = __ns_locked_flags(jail);
+    if (mount(jail, jail, NULL, MS_BIND | MS_REC, NULL) != 0)
     {
-        DBUG("waiting for trace slot");
-        pthread_cond_wait(&trace_update, &global_mutex);
+        WARN("failed to bind-mount the jail");
+        FUNC_RET("%d", false);
     }
+    DBUG("mount: \"%s\" (bind)", jail);
     
-    DBUG("obtained trace slot");
-    
-    /* Propose the request */
-    trace_info.option = option;
-    trace_info.pproc = pproc;
-    trace_info.addr = addr;
-    trace_info.data = ((pdata != NULL) ? (*pdata) : (0));
-    trace_info.result = 0;
-    trace_info.errnum = errno;
-    pthread_cond_broadcast(&trace_update);
-    
-    /* Wait while the option is being performed */
-    while (trace_info.option != T_OPTION_ACK)
+    if (*scratch != '\0')
     {
-        DBUG("requesting trace option: %s", s_trace_opt_name(trace_info.option));
-        pthread_cond_wait(&trace_update, &global_mutex);
+        char path[SBOX_PATH_MAX * 2];
+        char data[64] = "mode=1777";
+        snprintf(path, sizeof(path), "%s%s", jail, scratch);
+        if (size > 0)
+        {
+            snprintf(data, sizeof(data), "mode=1777,size=%llu", size);
+        }
+        if (mount("tmpfs", path, "tmpfs", MS_NOSUID | MS_NODEV, data) != 0)
+        {
+            WARN("failed to mount tmpfs onto \"%s\"", path);
+            FUNC_RET("%d", false);
+        }
+        DBUG("mount: \"%s\" (tmpfs, %s)", path, data);
     }
     
-    if (pdata != NULL)
+    if (*prog != '\0')
     {
-        *pdata = trace_info.data;
+        /* Only a missing mount point is created, which has been checked to
+         * be right in the scratch tmpfs */
+        struct stat s;
+        int fd = -1;
+        if ((*scratch != '\0') && (stat(target, &s) != 0) && ((fd = 
+            open(target, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 
+            S_IRWXU)) >= 0))
+        {
+            close(fd);
+        }
+        if ((mount(prog, target, NULL, MS_BIND, NULL) != 0) || 
+            (mount(NULL, target, NULL, MS_BIND | MS_REMOUNT | MS_RDONLY | 
+             __ns_locked_flags(target), NULL) != 0))
+        {
+            WARN("failed to bind-mount \"%s\" onto \"%s\"", prog, target);
+            FUNC_RET("%d", false);
+        }
+        DBUG("mount: \"%s\" (bind, ro)", target);
     }
-    res = trace_info.result;
-    errno = trace_info.errnum;
     
-    DBUG("collected trace results");
+    if (readonly && (mount(NULL, jail, NULL, MS_BIND | MS_REMOUNT | MS_RDONLY |
+        MS_NOSUID | MS_NODEV | locked, NULL) != 0))
+    {
+        WARN("failed to remount the jail read-only");
+        FUNC_RET("%d", false);
+    }
     
-    /* Release slot */
-    trace_info.option = T_OPTION_NOP;
-    trace_info.pproc = NULL;
-    trace_info.addr = NULL;
-    trace_info.data = 0;
-    trace_info.result = 0;
-    trace_info.errnum = errno;
-    pthread_cond_broadcast(&trace_update);
+    FUNC_RET("%d", true);
+#else
+    errno = EOPNOTSUPP;
+    FUNC_RET("%d", false);
+#endif /* HAVE_NAMESPACE */
+}
+
+bool
+ns_pivot_jail(const char * jail, bool bound)
+{
+    FUNC_BEGIN("%p,%d", jail, bound);
+    assert(jail);
     
-    DBUG("released trace slot");
+#if defined(HAVE_NAMESPACE) && defined(SYS_pivot_root)
+    /* The new root must be a mount point */
+    if (!bound && (mount(jail, jail, NULL, MS_BIND | MS_REC, NULL) != 0))
+    {
+        WARN("failed to bind-mount the jail");
+        FUNC_RET("%d", false);
+    }
     
-    V(&global_mutex);
+    /* With pivot_root(".", "."), the old root is stacked onto the jail, and 
+     * is then detached along with all mounts of the host beneath */
+    if ((chdir(jail) != 0) || (syscall(SYS_pivot_root, ".", ".") != 0))
+    {
+        WARN("failed to pivot_root() to \"%s\"", jail);
+        FUNC_RET("%d", false);
+    }
+    if ((umount2(".", MNT_DETACH) != 0) || (chdir("/") != 0))
+    {
+        WARN("failed to detach the mount tree of the host");
+        FUNC_RET("%d", false);
+    }
+    DBUG("pivot_root: \"%s\"", jail);
     
-    FUNC_RET("%ld", res);
+    FUNC_RET("%d", true);
+#else
+    errno = EOPNOTSUPP;
+    FUNC_RET("%d", false);
+#endif /* HAVE_NAMESPACE && SYS_pivot_root */
 }
 
-void *
-sandbox_tracer(void * const dummy)
+bool
+fd_send(int sock, const void * buff, size_t len, const int fds[], int nfds)
 {
-    FUNC_BEGIN("%p", dummy);
-    assert(dummy);
+    FUNC_BEGIN("%d,%p,%zu,%p,%d", sock, buff, len, fds, nfds);
+    assert(buff && (fds || (nfds == 0)) && (nfds <= SBOX_FD_MAX));
     
-    sandbox_t * const psbox = (sandbox_t *)dummy;
+    union
+    {
+        char buff[CMSG_SPACE(sizeof(int) * SBOX_FD_MAX)];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+    
+    struct iovec iov = {(void *)buff, len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (nfds > 0)
+    {
+        msg.msg_control = ctrl.buff;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    }
     
-    if (psbox == NULL)
+    /* The receiving end may have gone, which should not raise SIGPIPE */
+    ssize_t res;
+    while (((res = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0) && (errno == EINTR))
     {
-        FUNC_RET("%p", (void *)NULL);
+        ;
     }
     
-    /* Register sandbox to the pool */
-    P(&global_mutex);
-    sandbox_mgr_t * item = (sandbox_mgr_t *)malloc(sizeof(sandbox_mgr_t));
-    item->psbox = psbox;
-    SLIST_INSERT_HEAD(&global_pool, item, entries);
-    DBUG("registered sandbox %p to the pool", psbox);
-    V(&global_mutex);
+    FUNC_RET("%d", res == (ssize_t)len);
+}
+
+ssize_t
+fd_recv(int sock, void * buff, size_t len, int fds[], int nfds)
+{
+    FUNC_BEGIN("%d,%p,%zu,%p,%d", sock, buff, len, fds, nfds);
+    assert(buff && (fds || (nfds == 0)) && (nfds <= SBOX_FD_MAX));
     
-    /* Detect and perform options while the sandbox is running */
-    bool end = false;
+    union
+    {
+        char buff[CMSG_SPACE(sizeof(int) * SBOX_FD_MAX)];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+    
+    struct iovec iov = {buff, len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buff;
+    msg.msg_controllen = sizeof(ctrl.buff);
+    
+    ssize_t res;
+    while (((res = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0) && 
+           (errno == EINTR))
+    {
+        ;
+    }
+    if (res < 0)
+    {
+        FUNC_RET("%zd", res);
+    }
     
-    P(&global_mutex);
-    while (!end)
+    /* Collect the received file descriptors, and close them all unless there
+     * are as many as expected */
+    int n = 0;
+    struct cmsghdr * cmsg;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; 
+         cmsg = CMSG_NXTHDR(&msg, cmsg))
     {
-        /* Wait for an option request */
-        if (NO_ACTION(trace_info.option))
-        {
-            DBUG("waiting for new trace option");
-            pthread_cond_wait(&trace_update, &global_mutex);
-            if (NO_ACTION(trace_info.option))
-            {
-                continue;
-            }
-        }
-        
-        proc_t * pproc = trace_info.pproc;
-        if (!pthread_equal(pproc->tflags.trace_id,  pthread_self()))
+        if ((cmsg->cmsg_level != SOL_SOCKET) || 
+            (cmsg->cmsg_type != SCM_RIGHTS))
         {
             continue;
         }
-        
-        DBUG("received trace option: %s", s_trace_opt_name(trace_info.option));
-        
-        if (trace_info.option == T_OPTION_END)
+        int * const data = (int *)CMSG_DATA(cmsg);
+        const int cnt = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int i;
+        for (i = 0; i < cnt; i++)
         {
-            end = true;
+            if (n < nfds)
+            {
+                fds[n] = data[i];
+            }
+            else
+            {
+                close(data[i]);
+            }
+            n++;
         }
-        
-        /* Notify the trace_*() to collect results */
-        trace_info.result = __trace_impl(trace_info.option, trace_info.pproc,
-            trace_info.addr, &trace_info.data);
-        trace_info.errnum = errno;
-        trace_info.option = T_OPTION_ACK;
-        pthread_cond_broadcast(&trace_update);
-        
-        while (trace_info.option == T_OPTION_ACK)
+    }
+    if ((n != nfds) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+        int i;
+        for (i = 0; (i < n) && (i < nfds); i++)
         {
-            DBUG("sending trace option: %s", s_trace_opt_name(T_OPTION_ACK));
-            pthread_cond_wait(&trace_update, &global_mutex);
+            close(fds[i]);
         }
-        
-        DBUG("sent trace option: %s", s_trace_opt_name(T_OPTION_ACK));
+        FUNC_RET("%zd", (ssize_t)-1);
     }
-    V(&global_mutex);
     
-    /* Remove sandbox from the pool */
-    P(&global_mutex);
-    assert(item);
-    SLIST_REMOVE(&global_pool, item, __pool_item, entries);
-    free(item);
-    DBUG("removed sandbox %p from the pool", psbox);
-    V(&global_mutex);
+    FUNC_RET("%zd", res);
+}
+
+ssize_t
+feed_memory(int pfd, const void * addr, size_t len)
+{
+    FUNC_BEGIN("%d,%p,%zu", pfd, addr, len);
+    assert(addr);
+    
+    ssize_t res = -1;
+#ifdef HAVE_SPLICE
+    struct iovec iov = {(void *)addr, len};
+    res = vmsplice(pfd, &iov, 1, SPLICE_F_NONBLOCK);
+    if ((res >= 0) || ((errno != EINVAL) && (errno != ENOSYS)))
+    {
+        FUNC_RET("%zd", res);
+    }
+#endif /* HAVE_SPLICE */
+    res = write(pfd, addr, len);
     
-    FUNC_RET("%p", (void *)&psbox->result);
+    FUNC_RET("%zd", res);
 }
 
-/**
- * @brief Send signal to monitor threads of a \c sandbox_t object.
- */
-static void
-sandbox_notify(sandbox_t * const psbox, int signo)
+ssize_t
+feed_file(int pfd, int fd, long long * poff, size_t len)
 {
-    PROC_BEGIN("%p,%d", psbox, signo);
-    assert(psbox && (signo > 0));
+    FUNC_BEGIN("%d,%d,%p,%zu", pfd, fd, poff, len);
+    assert(poff);
+    
+    ssize_t res = -1;
+#ifdef HAVE_SPLICE
+    loff_t off = (loff_t)*poff;
+    res = splice(fd, &off, pfd, NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (res >= 0)
+    {
+        *poff = (long long)off;
+    }
+    if ((res >= 0) || ((errno != EINVAL) && (errno != ENOSYS)))
+    {
+        FUNC_RET("%zd", res);
+    }
+#endif /* HAVE_SPLICE */
     
-    const pthread_t profiler_thread = psbox->ctrl.monitor[0].tid;
-    switch (signo)
+    /* Only the bytes written into the pipe are consumed from the file */
+    char buff[PIPE_BUF];
+    res = pread(fd, buff, (len < sizeof(buff)) ? len : sizeof(buff), 
+        (off_t)*poff);
+    if (res > 0)
     {
-    case SIGEXIT:
-    case SIGSTAT:
-    case SIGPROF:
-        pthread_kill(profiler_thread, signo);
-        break;
-    default:
-        /* Wrap the real signal in the payload of SIGEXIT, because the
-         * profiler thread of a sandbox instance only waits for the
-         * three reserved signals, SIG{EXIT, STAT, PROF}. */
+        res = write(pfd, buff, res);
+    }
+    if (res > 0)
+    {
+        *poff += res;
+    }
+    
+    FUNC_RET("%zd", res);
+}
+
+long
+feed_pending(int pfd)
+{
+    FUNC_BEGIN("%d", pfd);
+    
+    int n = 0;
+    if (ioctl(pfd, FIONREAD, &n) != 0)
+    {
+        FUNC_RET("%ld", -1L);
+    }
+    
+    FUNC_RET("%ld", (long)n);
+}
+
+int
+feed_sealed(const void * addr, int fd, long long off, size_t len)
+{
+    FUNC_BEGIN("%p,%d,%lld,%zu", addr, fd, off, len);
+    
+#ifdef HAVE_MEMFD
+    int mfd = syscall(SYS_memfd_create, "sandbox-input", 
+        MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mfd < 0)
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    /* A region of the file is copied within the kernel, and may turn out to 
+     * be shorter than expected */
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t res;
+        if (addr != NULL)
         {
-            union sigval sv;
-            sv.sival_int = signo;
-            if (pthread_sigqueue(profiler_thread, SIGEXIT, sv) != 0)
-            {
-                WARN("failed pthread_sigqueue()");
-            }
+            res = write(mfd, (const char *)addr + done, len - done);
         }
-        break;
+        else
+        {
+            off_t pos = (off_t)(off + done);
+            res = sendfile(mfd, fd, &pos, len - done);
+        }
+        if ((res < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            break;
+        }
+        done += (size_t)res;
+    }
+    if ((done < len) && (addr != NULL))
+    {
+        close(mfd);
+        FUNC_RET("%d", -1);
     }
     
-    PROC_END();
+    if ((fcntl(mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE |
+        F_SEAL_SEAL) != 0) || (lseek(mfd, 0, SEEK_SET) != 0))
+    {
+        close(mfd);
+        FUNC_RET("%d", -1);
+    }
+    
+    FUNC_RET("%d", mfd);
+#else
+    errno = EOPNOTSUPP;
+    FUNC_RET("%d", -1);
+#endif /* HAVE_MEMFD */
 }
 
 /**
@@ -1063,15 +2744,8 @@ sandbox_manager(sandbox_pool_t * const pool)
     FUNC_BEGIN("%p", pool);
     assert(pool);
     
-    sigset_t sigmask;
-    sigemptyset(&sigmask);
-    sigaddset(&sigmask, SIGEXIT);
-    sigaddset(&sigmask, SIGTERM);
-    sigaddset(&sigmask, SIGQUIT);
-    sigaddset(&sigmask, SIGINT);
-    
-    /* The primary task of the manager thread is to send peroidical SIGPROF and
-     * SIGSTAT signals to all active sandbox instances. We used to trigger the
+    /* The primary task of the manager thread is to send peroidical NOTICE_PROF
+     * and NOTICE_STAT to all active sandbox instances. We used to trigger the
      * signals with recurring timers created by timer_create(), and brodcast
      * the signals to all active sandbox instances. However, memory profiling
      * with Massif (http://valgrind.org/docs/manual/ms-manual.html) showed that 
@@ -1082,7 +2756,9 @@ sandbox_manager(sandbox_pool_t * const pool)
      * the period of a profiling cycle converges to (1 / PROF_FREQ) sec. Sleep
      * time calibration is implemented as a discrete PID-controller, where SP
      * is the planned profiling cycle (cycle), PV is the measured profiling 
-     * cycle (delta), and MV is the calibrated time for sleep (timeout). */
+     * cycle (delta), and MV is the calibrated time for sleep (timeout). Since
+     * 0.3.6, the sleep is performed with ppoll() on an eventfd, such that the
+     * manager thread can be informed to quit without using signals. */
     
     const struct timespec ZERO = {0, 0};
     
@@ -1118,6 +2794,7 @@ sandbox_manager(sandbox_pool_t * const pool)
     
     unsigned long count = 0;
     bool end = false;
+    int nfds = 0;
     
     while (!end)
     {
@@ -1145,49 +2822,40 @@ sandbox_manager(sandbox_pool_t * const pool)
             TS_INPLACE_ADD(integral, delta);
         }
         
-        siginfo_t siginfo;
-        int signo;
-        if ((signo = sigtimedwait(&sigmask, &siginfo, &ZERO)) < 0)
+        unsigned long notice = 0;
+        if (nfds == 0)
         {
-            if (errno == EAGAIN)
+            if (count % (PROF_FREQ / STAT_FREQ) == 0)
             {
-                siginfo.si_code = SI_TIMER;
-                if (count % (PROF_FREQ / STAT_FREQ) == 0)
-                {
-                    signo = SIGSTAT;
-                }
-                else
-                {
-                    signo = SIGPROF;
-                }
+                notice = NOTICE_STAT;
             }
             else
             {
-                WARN("failed to sigtimedwait()");
+                notice = NOTICE_PROF;
             }
         }
+        else if (nfds > 0)
+        {
+            /* The manager thread is informed to quit, and the active sandbox
+             * instances (if any) should be killed */
+            end = true;
+            notice = NOTICE_KILL;
+        }
         
-        if (signo >= 0)
+        if (notice != 0)
         {
-            /* SIGEXIT informs the manager thread to quit, and the actual
-             * signal to be propagated to sandbox instances is SIGKILL */
-            if (signo == SIGEXIT)
-            {
-                end = true;
-                signo = SIGKILL;
-            }
-            /* Propagate the received signal to all active sandbox instances */
+            /* Propagate the notice to all active sandbox instances */
             P(&global_mutex);
             sandbox_mgr_t * item;
             SLIST_FOREACH(item, pool, entries)
             {
-                sandbox_notify(item->psbox, signo);
+                NOTIFY(item->psbox, notice);
             }
             V(&global_mutex);
         }
         
         /* Calibrate sleep time for this profiling cycle.*/
-        if (siginfo.si_code == SI_TIMER)
+        if (nfds == 0)
         {
             ++count;
             TS_INPLACE_SUB(error, cycle);
@@ -1241,47 +2909,54 @@ sandbox_manager(sandbox_pool_t * const pool)
         }
         
         /* Sleep for a while according to calibrated time */
-        if ((errno = clock_nanosleep(CLOCK_MONOTONIC, 0, &timeout, NULL)) > 0)
+        if (!end)
         {
-            WARN("failed in clock_nanosleep()");
+            struct pollfd pfd = {manager_efd, POLLIN, 0};
+            if (((nfds = ppoll(&pfd, 1, &timeout, NULL)) < 0) && 
+                (errno != EINTR))
+            {
+                WARN("failed in ppoll()");
+            }
         }
     }
     
     FUNC_RET("%p", (void *)pool);
 }
 
-static sigset_t global_oldmask;
-static sigset_t global_newmask;
-static pthread_t manager_thread;
-
-static __attribute__((constructor)) void 
+static void 
 global_init(void)
 {
     PROC_BEGIN();
     
-    /* Block signals relevant to libsandbox control, they will be unblocked 
-     * and handled by the the manager thread */
-    
-    sigemptyset(&global_newmask);
-    sigaddset(&global_newmask, SIGEXIT);
-    sigaddset(&global_newmask, SIGSTAT);
-    sigaddset(&global_newmask, SIGPROF);
-    sigaddset(&global_newmask, SIGTERM);
-    sigaddset(&global_newmask, SIGQUIT);
-    sigaddset(&global_newmask, SIGINT);
+    /* Libsandbox used to block the signals relevant to sandbox control for the
+     * entire process upon loading, and start the manager thread right away. 
+     * Since 0.3.6, the manager thread is started upon the first execution of
+     * sandbox instances, and informed to quit through an eventfd. */
     
-    if (pthread_sigmask(SIG_BLOCK, &global_newmask, &global_oldmask) != 0)
+    if ((manager_efd = eventfd(0, EFD_CLOEXEC)) < 0)
     {
-        WARN("pthread_sigmask");
+        WARN("failed to create eventfd for the manager thread");
+        PROC_END();
     }
-    DBUG("blocked reserved signals");
     
+    /* The manager thread inherits the signal mask of the creating thread, so 
+     * block all signals temporarily to keep it from stealing signals directed
+     * to the process running libsandbox */
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
     if (pthread_create(&manager_thread, NULL, (thread_func_t)sandbox_manager, 
         (void *)&global_pool) != 0)
     {
         WARN("failed to create the manager thread at %p", sandbox_manager);
+        close(manager_efd);
+        manager_efd = -1;
     }
-    DBUG("created the manager thread at %p", sandbox_manager);
+    else
+    {
+        DBUG("created the manager thread at %p", sandbox_manager);
+    }
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
     
     PROC_END();
 }
@@ -1291,7 +2966,16 @@ global_fini(void)
 {
     PROC_BEGIN();
     
-    pthread_kill(manager_thread, SIGEXIT);
+    /* Nothing to do if no sandbox instance has ever been executed */
+    if (manager_efd < 0)
+    {
+        PROC_END();
+    }
+    
+    if (eventfd_write(manager_efd, 1) != 0)
+    {
+        WARN("failed to inform the manager thread to quit");
+    }
     if (pthread_join(manager_thread, NULL) != 0)
     {
         WARN("failed to join the manager thread");
@@ -1307,36 +2991,14 @@ global_fini(void)
     while (!SLIST_EMPTY(&global_pool))
     {
         sandbox_mgr_t * const item = SLIST_FIRST(&global_pool);
-        int i;
-        for (i = 0; i < (SBOX_MONITOR_MAX); i++)
-        {
-            pthread_kill(item->psbox->ctrl.monitor[i].tid, SIGEXIT);
-        }
+        NOTIFY(item->psbox, NOTICE_EXIT);
         SLIST_REMOVE_HEAD(&global_pool, entries);
         free(item);
     }
     V(&global_mutex);
     
-    /* All sandbox instances should have been stopped at this point. Any 
-     * pending signal in the reserved set is safe to be ignored. This step is 
-     * necessary for non-pool mode, becuase profiling signals are delivered
-     * to the entire process and may arrive after the profiler thread of the
-     * sandbox instance has been joined. */
-    int signo;
-    siginfo_t siginfo;
-    struct timespec timeout = {0, ms2ns(20)};
-    while ((signo = sigtimedwait(&global_newmask, &siginfo, &timeout)) > 0)
-    {
-        DBUG("flushing signal %d", signo);
-    }
-    DBUG("flushed all pending signals");
-    
-    /* Restore saved sigmask */
-    if (pthread_sigmask(SIG_SETMASK, &global_oldmask, NULL) != 0)
-    {
-        WARN("pthread_sigmask");
-    }
-    DBUG("restored old signal mask");
+    close(manager_efd);
+    manager_efd = -1;
     
     PROC_END();
 }
@@ -40,6 +40,9 @@
 #include <signal.h>             /* siginfo_t, SIGTRAP, ... */
 #include <sys/types.h>          /* pid_t */
 #ifdef __linux__
+#include <linux/seccomp.h>      /* SECCOMP_MODE_FILTER */
+#include <sys/prctl.h>          /* PR_SET_NO_NEW_PRIVS */
+#include <sys/ptrace.h>         /* PTRACE_EVENT_SECCOMP */
 #include <sys/reg.h>            /* EAX, EBX, ... */
 #include <sys/syscall.h>        /* SYS_execve, ... */
 #include <sys/user.h>           /* struct user_regs_struct */
@@ -148,6 +151,12 @@ typedef struct
     ((pproc)->tflags.not_wait_execve++) \
 /* NOT_WAIT_EXECVE */
 
+/* Per-process flag (in the flags field of procfs stat) of a forked process 
+ * that has not yet executed a new program through execve() */
+#ifndef PF_FORKNOEXEC
+#define PF_FORKNOEXEC           0x00000040
+#endif /* PF_FORKNOEXEC */
+
 /**
  * @brief Bind an empty process stat buffer with a sandbox instance.
  * @param[in] psbox pointer to the sandbox instance
@@ -197,6 +206,65 @@ bool proc_dump(const proc_t * const pproc, const void * const addr,
  */
 int proc_abi(proc_t * const);
 
+/* Size of the dedicated stack of a child process spawned by proc_spawn() */
+#ifndef SBOX_SPAWN_STACK
+#define SBOX_SPAWN_STACK        65536
+#endif /* SBOX_SPAWN_STACK */
+
+/**
+ * @brief Spawn a child process that runs \c fn(arg) and then either execve() 
+ * or _exit(). Where possible (since 0.3.6), the child shares the memory of 
+ * the calling process and runs on a small dedicated stack, while the calling 
+ * thread is suspended until the child has either executed a new program or 
+ * exited. Thus the cost of spawning does not grow with the size of the calling
+ * process. The child must not stop itself, nor touch any lock or allocator 
+ * state, before execve(). Signal handlers are reset to default in the child.
+ * @param[in] fn function to run in the child process
+ * @param[in] arg argument to \c fn
+ * @param[in] flags extra flags of clone() from \c ns_clone_flags(), or 0
+ * @return pid of the child process, or -1 on failure
+ */
+pid_t proc_spawn(int (* fn)(void *), void * arg, int flags);
+
+/* Executing a program from an open file (since 0.3.6) requires execveat() 
+ * with AT_EMPTY_PATH (linux 3.19 or later). */
+#if defined(__linux__) && defined(SYS_execveat)
+#define HAVE_EXECVEAT
+#endif /* __linux__ && SYS_execveat */
+
+/**
+ * @brief Execute the program of an open file, e.g. a sealed memfd (since 
+ * 0.3.6). The file is not inherited by the program, which also means a script
+ * (i.e. starting with #!) cannot be executed this way.
+ * @param[in] fd open file descriptor of an executable file
+ * @param[in] argv command line arguments
+ * @param[in] envp environment variables
+ * @return never returns on success, or -1 with errno set on failure, where 
+ * errno is *EOPNOTSUPP* if the facility is not available
+ */
+int proc_execfd(int fd, char * const argv[], char * const envp[]);
+
+/**
+ * @brief Fork a copy of the calling process (since 0.3.6). Unlike fork(), the
+ * copy may be created in fresh namespaces, and no fork handlers are run.
+ * @param[in] flags extra flags of clone() from \c ns_clone_flags(), or 0
+ * @return pid of the copy in the calling process, 0 in the copy, or -1 on 
+ * failure
+ */
+pid_t proc_fork(int flags);
+
+/**
+ * @brief Change the real, effective and saved identities of the calling
+ * process (since 0.3.6). Supplementary groups are dropped if the caller is
+ * privileged. Unlike setuid() and friends of glibc, this issues raw system 
+ * calls, and is thus safe to call in a CLONE_VM child of a multithreaded host,
+ * whose threads must not be signaled to synchronize their credentials.
+ * @param[in] uid targeted user id
+ * @param[in] gid targeted group id
+ * @return true on success, or false with errno set on failure
+ */
+bool proc_setid(uid_t uid, gid_t gid);
+
 #ifdef __linux__
 
 #define THE_SCMODE(pproc) \
@@ -223,6 +291,11 @@ int proc_abi(proc_t * const);
 #define SCMODE_MAX              2
 
 #define SC_EXECVE               MAKE_WORD(SYS_execve, SCMODE_LINUX64)
+#ifdef SYS_execveat
+#define SC_EXECVEAT             MAKE_WORD(SYS_execveat, SCMODE_LINUX64)
+#else
+#define SC_EXECVEAT             MAKE_WORD(322, SCMODE_LINUX64)
+#endif /* SYS_execveat */
 #define SC_FORK                 MAKE_WORD(SYS_fork, SCMODE_LINUX64)
 #define SC_VFORK                MAKE_WORD(SYS_vfork, SCMODE_LINUX64)
 #define SC_CLONE                MAKE_WORD(SYS_clone, SCMODE_LINUX64)
@@ -235,10 +308,29 @@ int proc_abi(proc_t * const);
 #define SC_EXIT                 MAKE_WORD(SYS_exit, SCMODE_LINUX64)
 #define SC_EXIT_GROUP           MAKE_WORD(SYS_exit_group, SCMODE_LINUX64)
 
+/* System calls taking a fd as the first argument, where a fork server parks
+ * its master process if the fd is a standard channel */
+#define SC_READ                 MAKE_WORD(SYS_read, SCMODE_LINUX64)
+#define SC_READV                MAKE_WORD(SYS_readv, SCMODE_LINUX64)
+#define SC_PREAD64              MAKE_WORD(SYS_pread64, SCMODE_LINUX64)
+#define SC_WRITE                MAKE_WORD(SYS_write, SCMODE_LINUX64)
+#define SC_WRITEV               MAKE_WORD(SYS_writev, SCMODE_LINUX64)
+#define SC_PWRITE64             MAKE_WORD(SYS_pwrite64, SCMODE_LINUX64)
+#define SC_LSEEK                MAKE_WORD(SYS_lseek, SCMODE_LINUX64)
+#define SC_FSTAT                MAKE_WORD(SYS_fstat, SCMODE_LINUX64)
+#define SC_NEWFSTATAT           MAKE_WORD(SYS_newfstatat, SCMODE_LINUX64)
+#define SC_IOCTL                MAKE_WORD(SYS_ioctl, SCMODE_LINUX64)
+#define SC_FCNTL                MAKE_WORD(SYS_fcntl, SCMODE_LINUX64)
+#define SC_CLOSE                MAKE_WORD(SYS_close, SCMODE_LINUX64)
+#define SC_DUP                  MAKE_WORD(SYS_dup, SCMODE_LINUX64)
+#define SC_DUP2                 MAKE_WORD(SYS_dup2, SCMODE_LINUX64)
+#define SC_DUP3                 MAKE_WORD(SYS_dup3, SCMODE_LINUX64)
+
 /* Hard coding these numbers is somewhat ugly, but we are in 64bit mode here,
  * and <sys/syscall.h> does not expose 32bit system call numbers. */
 
 #define SC32_EXECVE             MAKE_WORD(11, SCMODE_LINUX32)
+#define SC32_EXECVEAT           MAKE_WORD(358, SCMODE_LINUX32)
 #define SC32_FORK               MAKE_WORD(2, SCMODE_LINUX32)
 #define SC32_VFORK              MAKE_WORD(190, SCMODE_LINUX32)
 #define SC32_CLONE              MAKE_WORD(120, SCMODE_LINUX32)
@@ -332,14 +424,18 @@ int proc_abi(proc_t * const);
 {{{ \
     (pproc)->tflags.is_in_syscall = true; \
     (pproc)->tflags.not_wait_execve = ((THE_SYSCALL(pproc) != SC_EXECVE) && \
-                                       (THE_SYSCALL(pproc) != SC32_EXECVE)); \
+                                       (THE_SYSCALL(pproc) != SC32_EXECVE) && \
+                                       (THE_SYSCALL(pproc) != SC_EXECVEAT) && \
+                                       (THE_SYSCALL(pproc) != SC32_EXECVEAT)); \
 }}} /* SET_IN_SYSCALL */
 
 #define CLR_IN_SYSCALL(pproc) \
 {{{ \
     (pproc)->tflags.is_in_syscall = false; \
     (pproc)->tflags.not_wait_execve = ((THE_SYSCALL(pproc) != SC_EXECVE) && \
-                                       (THE_SYSCALL(pproc) != SC32_EXECVE)); \
+                                       (THE_SYSCALL(pproc) != SC32_EXECVE) && \
+                                       (THE_SYSCALL(pproc) != SC_EXECVEAT) && \
+                                       (THE_SYSCALL(pproc) != SC32_EXECVEAT)); \
 }}} /* CLR_IN_SYSCALL */
 
 #else /* __i386__ */
@@ -348,6 +444,11 @@ int proc_abi(proc_t * const);
 #define SCMODE_MAX              1
 
 #define SC_EXECVE               MAKE_WORD(SYS_execve, SCMODE_LINUX32)
+#ifdef SYS_execveat
+#define SC_EXECVEAT             MAKE_WORD(SYS_execveat, SCMODE_LINUX32)
+#else
+#define SC_EXECVEAT             MAKE_WORD(358, SCMODE_LINUX32)
+#endif /* SYS_execveat */
 #define SC_FORK                 MAKE_WORD(SYS_fork, SCMODE_LINUX32)
 #define SC_VFORK                MAKE_WORD(SYS_vfork, SCMODE_LINUX32)
 #define SC_CLONE                MAKE_WORD(SYS_clone, SCMODE_LINUX32)
@@ -390,13 +491,15 @@ int proc_abi(proc_t * const);
 #define SET_IN_SYSCALL(pproc) \
 {{{ \
     (pproc)->tflags.is_in_syscall = true; \
-    (pproc)->tflags.not_wait_execve = (THE_SYSCALL(pproc) != SC_EXECVE); \
+    (pproc)->tflags.not_wait_execve = ((THE_SYSCALL(pproc) != SC_EXECVE) && \
+                                       (THE_SYSCALL(pproc) != SC_EXECVEAT)); \
 }}} /* SET_IN_SYSCALL */
 
 #define CLR_IN_SYSCALL(pproc) \
 {{{ \
     (pproc)->tflags.is_in_syscall = false; \
-    (pproc)->tflags.not_wait_execve = (THE_SYSCALL(pproc) != SC_EXECVE); \
+    (pproc)->tflags.not_wait_execve = ((THE_SYSCALL(pproc) != SC_EXECVE) && \
+                                       (THE_SYSCALL(pproc) != SC_EXECVEAT)); \
 }}} /* CLR_IN_SYSCALL */
 
 #endif /* __x86_64__ */
@@ -427,6 +530,35 @@ int proc_abi(proc_t * const);
  */
 bool trace_me(void);
 
+/**
+ * @brief Attach to a running child process as its tracer (since 0.3.6). The 
+ * process is resumed once attached, and is then traced in the same way as a
+ * process that called \c trace_me(), i.e. it stops with SIGTRAP after the 
+ * next successful execve().
+ * @param[in] pid id of the process to be traced
+ * @return true on success
+ */
+bool trace_attach(pid_t pid);
+
+/* System call filters (since 0.3.6) are built upon the seccomp facility and the
+ * PTRACE_O_TRACESECCOMP option of linux (since 3.5). Filtered system calls stop 
+ * the traced process with a ptrace event (rather than a syscall-entry-stop). */
+#if defined(SECCOMP_MODE_FILTER) && defined(PR_SET_NO_NEW_PRIVS)
+#define HAVE_SYSCALL_FILTER
+#define TRAP_FILTERED           (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))
+#endif /* SECCOMP_MODE_FILTER && PR_SET_NO_NEW_PRIVS */
+
+/**
+ * @brief Let the current (traced) process install a system call filter. The 
+ * process stops itself with SIGSTOP before installing the filter, such that the
+ * tracer can enable the reporting of filtered system calls with 
+ * \c trace_filter() in advance.
+ * @param[in] prog BPF instructions of the filter
+ * @param[in] len number of BPF instructions
+ * @return true on success
+ */
+bool trace_me_filtered(const void * const prog, unsigned short len);
+
 /**
  * @brief Subprocess trace methods.
  */
@@ -434,16 +566,126 @@ typedef enum
 {
     TRACE_SINGLE_STEP = 0,      /**< enter single-step tracing mode */
     TRACE_SYSTEM_CALL = 1,      /**< enter system call tracing mode */
+    TRACE_FILTERED_CALL = 2,    /**< run until next filtered system call */
 } trace_type_t;
 
 /**
  * @brief Schedule next stop for a traced process.
  * @param[in,out] pproc pointer to a binded process stat buffer
- * @param[in] type \c TRACE_SYSTEM_CALL or \c TRACE_SINGLE_STEP
+ * @param[in] type \c TRACE_SYSTEM_CALL, \c TRACE_SINGLE_STEP or 
+ * \c TRACE_FILTERED_CALL
  * @return true on success
  */
 bool trace_next(proc_t * const pproc, trace_type_t type);
 
+/**
+ * @brief Enable the reporting of filtered system calls of a traced process.
+ * @param[in] pproc pointer to a binded process stat buffer
+ * @return true on success
+ */
+bool trace_filter(const proc_t * const pproc);
+
+/* A pidfd (linux 5.3 or later) detects the termination of an untraced child
+ * process in poll() */
+#if defined(__linux__) && defined(SYS_pidfd_open)
+#define HAVE_PIDFD
+#endif /* __linux__ && SYS_pidfd_open */
+
+/* Seccomp user notifications (since 0.3.6) deliver filtered system calls of an
+ * untraced process to a listener fd, such that the prisoner process can be 
+ * watched without ptrace (linux 5.6 or later). */
+#if defined(HAVE_SYSCALL_FILTER) && defined(SECCOMP_USER_NOTIF_FLAG_CONTINUE) \
+    && defined(SYS_seccomp) && defined(HAVE_PIDFD) && defined(SYS_pidfd_getfd)
+#define HAVE_SYSCALL_NOTIFY
+#endif /* HAVE_SYSCALL_FILTER && SECCOMP_USER_NOTIF_FLAG_CONTINUE && ... */
+
+/**
+ * @brief Structure for a filtered system call delivered to the listener.
+ */
+typedef struct
+{
+    unsigned long long id;      /**< cookie for answering the notification */
+    pid_t pid;                  /**< id of the calling process */
+    unsigned long scinfo;       /**< system call number and mode (MAKE_WORD) */
+    unsigned long args[6];      /**< system call arguments */
+} notif_t;
+
+/**
+ * @brief Let the current (untraced) process install a system call filter that
+ * delivers filtered system calls as user notifications. Returns of 
+ * *SECCOMP_RET_TRACE* in the filter are rewritten into 
+ * *SECCOMP_RET_USER_NOTIF*, and an empty filter delivers all system calls. 
+ * The number of the listener fd is written to \c chan before installing the 
+ * filter, and \c chan is closed.
+ * @param[in] prog BPF instructions of the filter, or NULL
+ * @param[in] len number of BPF instructions
+ * @param[in] chan writable end of a pipe to the watcher
+ * @return true on success
+ */
+bool trace_me_notified(const void * const prog, unsigned short len, int chan);
+
+/**
+ * @brief Obtain the listener fd installed by \c trace_me_notified() in a 
+ * child process.
+ * @param[in] pid id of the child process
+ * @param[in] chan readable end of the pipe from the child process
+ * @return a duplicate of the listener fd, or -1 on failure
+ */
+int trace_listener(pid_t pid, int chan);
+
+/**
+ * @brief Receive a pending user notification from a listener fd.
+ * @param[in] fd listener fd returned by \c trace_listener()
+ * @param[out] pnotif pointer to a notification buffer
+ * @return true on success
+ */
+bool trace_notified(int fd, notif_t * const pnotif);
+
+/**
+ * @brief Answer a user notification, such that the calling process either
+ * continues with the system call, or the system call fails with an error.
+ * @param[in] fd listener fd returned by \c trace_listener()
+ * @param[in] pnotif notification returned by \c trace_notified()
+ * @param[in] errnum 0 to continue, or the errno to fail the system call with
+ * @return true on success
+ */
+bool trace_respond(int fd, const notif_t * const pnotif, int errnum);
+
+/* A fork server (since 0.3.6) parks a traced process upon a system call, and
+ * forks copies of it by injecting system calls, which is only implemented for
+ * x86_64 (and native 64bit system calls). The parked process is watched with 
+ * a pidfd. On other platforms, fork servers fail to start. */
+#if defined(__x86_64__) && defined(HAVE_PIDFD) && defined(PTRACE_GETSIGMASK)
+#define HAVE_TRACE_FORK
+#endif /* __x86_64__ && HAVE_PIDFD && PTRACE_GETSIGMASK */
+
+/**
+ * @brief Park a traced (single-threaded) process stopped upon entering a
+ * native 64bit system call (since 0.3.6). The system call is replaced with 
+ * pause(), and the process is detached from the tracer with all signals 
+ * blocked, such that no signal handler runs untraced, and pause() is only 
+ * ever restarted. \c trace_fork() kills the process if found outside pause().
+ * @param[in] pproc pointer to a binded process stat buffer, with \c regs and
+ * \c op probed at the syscall-entry-stop
+ * @param[out] pmask signal mask of the process before parking
+ * @return true on success
+ */
+bool trace_park(const proc_t * const pproc, unsigned long * pmask);
+
+/**
+ * @brief Fork a copy of a process parked by \c trace_park() (since 0.3.6).
+ * The copy is a sibling of the parked process, runs in a new session with the
+ * signal mask saved by \c trace_park(), and is traced by the calling thread. 
+ * Its standard channels are replaced with the three fd's of a message queued 
+ * by \c fd_send() on the (unix domain socket) fd 0 of the parked process, and
+ * it is left stopped upon re-entering the parked system call. The stop is not
+ * consumed, i.e. is reported to the next waitid() of the tracer.
+ * @param[in] ppoint the same process stat buffer passed to \c trace_park()
+ * @param[in] mask the signal mask returned by \c trace_park()
+ * @return pid of the copy, or -1 on failure
+ */
+pid_t trace_fork(const proc_t * const ppoint, unsigned long mask);
+
 /**
  * @brief Kill a traced process, prevent any overrun.
  * @param[in] pproc pointer to a binded process stat buffer
@@ -466,6 +708,246 @@ bool trace_end(const proc_t * const pproc);
  */
 void * sandbox_tracer(void * const psbox);
 
+/**
+ * @brief Reserve a cpu for running the prisoner process of a sandbox.
+ * @param[in] cpu preferred cpu number, or SBOX_CPU_AUTO for any idle cpu
+ * @return reserved cpu number, or SBOX_CPU_ANY if no cpu is available
+ */
+int cpu_reserve(int cpu);
+
+/**
+ * @brief Reserve the idle sibling (hyperthread) of a reserved cpu.
+ * @param[in] cpu cpu number returned by \c cpu_reserve()
+ * @return reserved cpu number, or SBOX_CPU_ANY if no sibling is available
+ */
+int cpu_sibling(int cpu);
+
+/**
+ * @brief Release a cpu reserved by \c cpu_reserve() or \c cpu_sibling().
+ * @param[in] cpu reserved cpu number, negative numbers are ignored
+ */
+void cpu_release(int cpu);
+
+/**
+ * @brief Check if a cpu is available to this process (since 0.3.6).
+ * @param[in] cpu cpu number
+ * @return true if the cpu is in the affinity of this process
+ */
+bool cpu_allowed(int cpu);
+
+/**
+ * @brief Affinity of a thread saved by \c cpu_bind() (since 0.3.6).
+ */
+typedef struct
+{
+    bool saved;                 /**< whether mask holds the saved affinity */
+    unsigned long mask[16];     /**< opaque storage of a cpu_set_t */
+} cpu_saved_t;
+
+/**
+ * @brief Bind a thread to the specified cpu.
+ * @param[in] tid id of the thread to be bound
+ * @param[in] cpu cpu number, or SBOX_CPU_ANY to restore the default affinity
+ * @param[out] psaved affinity of the thread before binding, or NULL to skip 
+ * saving it (since 0.3.6)
+ * @return true on success
+ */
+bool cpu_bind(pthread_t tid, int cpu, cpu_saved_t * psaved);
+
+/**
+ * @brief Restore the affinity of a thread saved by \c cpu_bind() (since 
+ * 0.3.6). Threads whose affinity was not saved get the default affinity.
+ * @param[in] tid id of the thread to be restored
+ * @param[in] psaved affinity saved by \c cpu_bind()
+ * @return true on success
+ */
+bool cpu_restore(pthread_t tid, const cpu_saved_t * psaved);
+
+/**
+ * @brief Bind a process to the specified cpu (since 0.3.6). Unlike 
+ * \c cpu_bind(), this can be called in a child process from proc_spawn().
+ * @param[in] pid id of the process to be bound, or 0 for the calling process
+ * @param[in] cpu cpu number
+ * @return true on success
+ */
+bool cpu_bind_proc(pid_t pid, int cpu);
+
+/* Landlock (since 0.3.6) lets an unprivileged process restrict its own access
+ * to the filesystem beneath a set of paths (linux 5.13 or later). */
+#if defined(__linux__) && defined(SYS_landlock_create_ruleset) && \
+    defined(SYS_landlock_add_rule) && defined(SYS_landlock_restrict_self)
+#define HAVE_FS_RESTRICT
+#endif /* __linux__ && SYS_landlock_* */
+
+/**
+ * @brief Get the version of the filesystem restriction facility.
+ * @return landlock ABI version, or 0 if not available
+ */
+int fs_abi(void);
+
+/**
+ * @brief Restrict filesystem access of the current process (and its future 
+ * children) to the beneath of the specified paths, irrevocably. Access types
+ * in \c modes[] are values of \c fs_access_t.
+ * @param[in] paths array of paths
+ * @param[in] modes array of access types granted beneath each path
+ * @param[in] n number of paths
+ * @return true on success, or false with errno set to *EOPNOTSUPP* if the 
+ * facility is not available
+ */
+bool fs_restrict(const char * const paths[], const int modes[], int n);
+
+/* Namespaces (since 0.3.6) isolate a process from the network, other 
+ * processes and mount points of the host (linux 3.8 or later). */
+#if defined(__linux__) && defined(SYS_unshare) && defined(SYS_setns)
+#define HAVE_NAMESPACE
+#endif /* __linux__ && SYS_unshare && SYS_setns */
+
+/**
+ * @brief Get the flags of clone() for creating a child process in fresh 
+ * namespaces (since 0.3.6). Only the user and pid namespaces are created by 
+ * clone(), the others are created by \c ns_enter() in the child process.
+ * @param[in] ns bitmask of namespace types, i.e. values of \c ns_type_t
+ * @return flags to be passed to \c proc_spawn() or \c proc_fork()
+ */
+int ns_clone_flags(int ns);
+
+/**
+ * @brief Enter the remaining fresh namespaces in a child process created with
+ * the flags of \c ns_clone_flags() (since 0.3.6). In a fresh user namespace,
+ * the specified identity is mapped to itself. In a fresh mount namespace, all
+ * mount points become private, and if combined with a fresh pid namespace, a 
+ * fresh procfs is mounted onto the \c proc directory beneath \c jail (if 
+ * present).
+ * @param[in] ns bitmask of namespace types, i.e. values of \c ns_type_t
+ * @param[in] uid owner identity of the calling process
+ * @param[in] gid group identity of the calling process
+ * @param[in] jail path of the root directory to be chroot()'ed to later
+ * @return true on success, or false with errno set to *EOPNOTSUPP* if the 
+ * facility is not available
+ */
+bool ns_enter(int ns, uid_t uid, gid_t gid, const char * jail);
+
+/**
+ * @brief Set up a jail image in the fresh mount namespace of the calling 
+ * process (since 0.3.6). The jail is bind-mounted onto itself, then a tmpfs is
+ * mounted onto \c scratch beneath the jail, and \c prog is bind-mounted 
+ * read-only onto \c target (created if missing, right in \c scratch), before
+ * the jail is remounted read-only. Mount flags locked by the host (e.g. 
+ * noexec) are retained.
+ * @param[in] jail path of the jail directory
+ * @param[in] readonly whether to remount the jail read-only
+ * @param[in] scratch path of the tmpfs mount point inside of the jail, or ""
+ * @param[in] size size limit of the tmpfs in bytes, or 0 for the default
+ * @param[in] prog path of the program file outside of the jail, or ""
+ * @param[in] target path of the program file beneath the jail
+ * @return true on success, or false with errno set to *EOPNOTSUPP* if the 
+ * facility is not available
+ */
+bool ns_mount_jail(const char * jail, bool readonly, const char * scratch, 
+                   unsigned long long size, const char * prog, 
+                   const char * target);
+
+/**
+ * @brief Make the jail the root directory of the calling process in its fresh
+ * mount namespace (since 0.3.6). Unlike chroot(), pivot_root() moves the jail
+ * onto the root, and the mount tree of the host is then detached, such that 
+ * it is no longer reachable from the namespace.
+ * @param[in] jail path of the jail directory (other than "/")
+ * @param[in] bound whether the jail is a mount point, e.g. bound by
+ * \c ns_mount_jail(), otherwise it is bind-mounted onto itself first
+ * @return true on success, or false with errno set to *EOPNOTSUPP* if the 
+ * facility is not available
+ */
+bool ns_pivot_jail(const char * jail, bool bound);
+
+/* Maximum number of file descriptors sent along with a message */
+#ifndef SBOX_FD_MAX
+#define SBOX_FD_MAX             4
+#endif /* SBOX_FD_MAX */
+
+/**
+ * @brief Send a message along with open file descriptors over a unix domain 
+ * socket (since 0.3.6).
+ * @param[in] sock connected unix domain socket
+ * @param[in] buff message to be sent
+ * @param[in] len length of the message
+ * @param[in] fds file descriptors to be sent
+ * @param[in] nfds number of file descriptors, at most \c SBOX_FD_MAX
+ * @return true on success
+ */
+bool fd_send(int sock, const void * buff, size_t len, const int fds[], 
+             int nfds);
+
+/**
+ * @brief Receive a message along with file descriptors sent by \c fd_send()
+ * (since 0.3.6). Interrupted receptions are restarted.
+ * @param[in] sock connected unix domain socket
+ * @param[out] buff buffer for the message
+ * @param[in] len size of the buffer
+ * @param[out] fds received file descriptors
+ * @param[in] nfds number of file descriptors expected, at most \c SBOX_FD_MAX
+ * @return length of the message, or -1 on failure (including receiving fewer
+ * file descriptors than expected)
+ */
+ssize_t fd_recv(int sock, void * buff, size_t len, int fds[], int nfds);
+
+/* Zero-copy feeding (since 0.3.6) moves user memory and file pages into pipes
+ * (linux 2.6.17 or later), and seals memory files (linux 3.17 or later). */
+#if defined(__linux__) && defined(SYS_vmsplice) && defined(SYS_splice)
+#define HAVE_SPLICE
+#endif /* __linux__ && SYS_vmsplice && SYS_splice */
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+#define HAVE_MEMFD
+#endif /* __linux__ && SYS_memfd_create */
+
+/**
+ * @brief Move user memory into a pipe without blocking (since 0.3.6). The 
+ * pages of the memory are referenced by the pipe until consumed, and should 
+ * not be modified in the meantime. Memory is copied into the pipe if moving
+ * is not available.
+ * @param[in] pfd writable end of a pipe in non-blocking mode
+ * @param[in] addr start of the memory
+ * @param[in] len length of the memory
+ * @return number of bytes moved, or -1 with errno set to *EAGAIN* if the pipe
+ * is full
+ */
+ssize_t feed_memory(int pfd, const void * addr, size_t len);
+
+/**
+ * @brief Move a region of a file into a pipe without blocking (since 0.3.6),
+ * pages of the file are copied into the pipe if moving is not available.
+ * @param[in] pfd writable end of a pipe in non-blocking mode
+ * @param[in] fd readable file
+ * @param[in,out] poff offset of the region, advanced by the bytes moved
+ * @param[in] len length of the region
+ * @return number of bytes moved, 0 at the end of the file, or -1 with errno 
+ * set to *EAGAIN* if the pipe is full
+ */
+ssize_t feed_file(int pfd, int fd, long long * poff, size_t len);
+
+/**
+ * @brief Count the bytes pending in a pipe (since 0.3.6), i.e. written but not
+ * yet read, from either end of the pipe.
+ * @param[in] pfd either end of a pipe
+ * @return number of bytes, or -1 on failure
+ */
+long feed_pending(int pfd);
+
+/**
+ * @brief Create a sealed memory file holding a copy of user memory, or of a 
+ * region of a file (since 0.3.6). The memory file is close-on-exec, and is 
+ * positioned at its start.
+ * @param[in] addr start of the memory, or NULL to copy from \c fd
+ * @param[in] fd readable file, if \c addr is NULL
+ * @param[in] off offset of the region in the file
+ * @param[in] len length of the memory or the region
+ * @return the memory file, or -1 on failure with errno set to *EOPNOTSUPP* if
+ * the facility is not available
+ */
+int feed_sealed(const void * addr, int fd, long long off, size_t len);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -34,20 +34,32 @@
 #include "internal.h" 
 #include "config.h"
 
-#include <errno.h>              /* ECHILD, EINVAL */
+#include <errno.h>              /* ECHILD, EINVAL, ENOENT */
+#include <fcntl.h>              /* fcntl(), FD_CLOEXEC */
 #include <grp.h>                /* struct group, getgrgid() */
 #include <pwd.h>                /* struct passwd, getpwuid() */
 #include <pthread.h>            /* pthread_{create,join,sigmask,...}() */
+#include <poll.h>               /* poll(), struct pollfd, POLLIN */
 #include <signal.h>             /* kill(), SIG* */
-#include <stdlib.h>             /* EXIT_{SUCCESS,FAILURE} */
-#include <string.h>             /* str{cpy,cmp,str}(), mem{set,cpy}() */
+#include <stddef.h>             /* offsetof() */
+#include <stdlib.h>             /* EXIT_{SUCCESS,FAILURE}, malloc(), free() */
+#include <string.h>             /* str{cpy,cmp,str}(), mem{set,cpy,chr}() */
 #include <sys/stat.h>           /* struct stat, stat(), fstat() */
+#ifdef __linux__
+#include <sys/prctl.h>          /* prctl(), PR_SET_PDEATHSIG */
+#endif /* __linux__ */
+#include <sys/file.h>           /* flock(), LOCK_{SH,EX,UN} */
+#include <sys/mman.h>           /* mmap(), munmap(), madvise() */
 #include <sys/resource.h>       /* getrlimit(), setrlimit() */
+#include <sys/socket.h>         /* socketpair(), AF_UNIX, SOCK_SEQPACKET */
 #include <sys/wait.h>           /* waitid(), P_* */
 #include <time.h>               /* clock_get{cpuclockid,time}(), ... */
 #include <unistd.h>             /* fork(), access(), chroot(), getpid(),
-                                   getpagesize(), {R,X}_OK,
+                                   getpagesize(), pipe(), {R,X}_OK,
                                    STD{IN,OUT,ERR}_FILENO */
+#ifdef __SSE2__
+#include <emmintrin.h>          /* _mm_{loadu,cmpeq,min,movemask}_*() */
+#endif /* __SSE2__ */
 
 #ifdef DELETED
 #include <sys/time.h>           /* setitimer(), ITIMER_PROF */
@@ -62,6 +74,17 @@
 #endif /* HAVE_SCHED_H */
 #endif /* WITH_REALTIME_SCHED */
 
+#if defined(WITH_SOFTWARE_TSC) && defined(HAVE_SYSCALL_FILTER)
+#warning "system call filters are not used along with software tsc"
+#undef HAVE_SYSCALL_FILTER
+#undef HAVE_SYSCALL_NOTIFY
+#endif /* WITH_SOFTWARE_TSC && HAVE_SYSCALL_FILTER */
+
+#if defined(WITH_SOFTWARE_TSC) && defined(HAVE_PIDFD)
+#warning "trusted tasks are not supported along with software tsc"
+#undef HAVE_PIDFD
+#endif /* WITH_SOFTWARE_TSC && HAVE_PIDFD */
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -153,13 +176,179 @@ extern "C"
     UNLOCK(psbox); \
 }}} /* UPDATE_STATUS */
 
+/* Slot of the decision cache (since 0.3.6) */
+
+typedef struct
+{
+    long key[7];                /* scinfo, and selected arguments */
+    int mask;                   /* cache key of the decision, or 0 if vacant */
+    action_t action;            /* cached decision */
+} cache_t;
+
+/* Number of slots probed for each scinfo */
+#define SBOX_CACHE_PROBE        8
+
+/* State of the incremental comparison of captured output (since 0.3.6) */
+
+/* Longest token of the output held for S_COMPARE_FLOAT */
+#define SBOX_TOKEN_MAX          64
+
+typedef struct
+{
+    const char * answer;        /* mapped answer file, or NULL if empty */
+    size_t size;                /* size of the answer file */
+    size_t pos;                 /* offset of the next byte of the answer */
+    compare_t mode;             /* comparison mode */
+    double epsilon;             /* tolerance of S_COMPARE_FLOAT */
+    long long seen;             /* bytes of output fed to the matcher */
+    bool token;                 /* within a token of the captured output */
+    bool hold;                  /* the current token is held for comparison */
+    long long start;            /* output offset of the held token */
+    size_t alen;                /* length of the held token of the answer */
+    size_t hlen;                /* length of the held token of the output */
+    char held[SBOX_TOKEN_MAX];  /* held token of the output */
+} matcher_t;
+
+/* Whitespace separating the tokens of S_COMPARE_{TOKEN,NOCASE,FLOAT} */
+#define __IS_SPACE(c) \
+    (((c) == ' ') || ((c) == '\n') || ((c) == '\t') || ((c) == '\r') || \
+     ((c) == '\v') || ((c) == '\f')) \
+/* __IS_SPACE */
+
+#define __TO_LOWER(c) \
+    ((((c) >= 'A') && ((c) <= 'Z')) ? ((c) | 0x20) : (c)) \
+/* __TO_LOWER */
+
+/* State of the incremental digests (since 0.3.6), i.e. the XXH64 digest of
+ * captured output, and the SHA-256 digest of the keys of the result cache */
+
+typedef struct
+{
+    unsigned long long acc[4];  /* accumulators of the lanes */
+    unsigned long long total;   /* bytes digested */
+    unsigned char buff[32];     /* bytes short of a stripe */
+    size_t len;                 /* number of bytes short of a stripe */
+} digest_t;
+
+typedef struct
+{
+    unsigned int state[8];      /* intermediate hash value */
+    unsigned long long total;   /* bytes digested */
+    unsigned char buff[64];     /* bytes short of a block */
+    size_t len;                 /* number of bytes short of a block */
+} sha256_t;
+
+/* Index file of the result cache (since 0.3.6) */
+
+#define SBOX_MEMO_MAGIC         "SBOXMEMO"
+#define SBOX_MEMO_VERSION       (1)
+
+/* Number of slots probed for each key */
+#define SBOX_MEMO_PROBE         8
+
+typedef struct
+{
+    char magic[8];              /* SBOX_MEMO_MAGIC */
+    unsigned int version;       /* SBOX_MEMO_VERSION */
+    unsigned int layout;        /* size of the slots */
+    unsigned long long slots;   /* number of slots following the header */
+} memo_head_t;
+
+typedef struct
+{
+    unsigned char key[32];      /* SHA-256 of the run, or zeros if vacant */
+    result_t result;            /* result of the run */
+    int exitcode;               /* exit code */
+    signal_t signal;            /* last signal info */
+    long syscall;               /* last syscall info */
+    struct timespec elapsed;    /* elapsed wallclock time */
+    struct timespec clock;      /* cpu clock time usage */
+    struct timespec utime;      /* cpu usage in user mode */
+    struct timespec stime;      /* cpu usage in kernel mode */
+    res_t vsize_peak;           /* virtual memory peak usage */
+    res_t rss_peak;             /* resident set peak size */
+    res_t minflt;               /* minor page faults */
+    res_t majflt;               /* major page faults */
+    res_t bytes;                /* bytes captured from the standard output */
+    long long mismatch;         /* offset of the first mismatch, or -1 */
+    unsigned long long digest;  /* XXH64 of the captured bytes */
+    unsigned char sha256[32];   /* SHA-256 of the captured bytes */
+    res_t fed;                  /* bytes of input fed */
+    res_t consumed;             /* bytes of input consumed */
+} memo_slot_t;
+
+/* Arguments of the prisoner process (since 0.3.6) */
+
+typedef struct
+{
+    task_t * ptask;             /* task to be executed */
+    const filter_t * pfilter;   /* system call filter */
+    char * const * argv;        /* prepared argument array */
+    int chan;                   /* writable end of the listener pipe, or -1 */
+    int cpu;                    /* cpu to bind, or SBOX_CPU_ANY */
+    pid_t parent;               /* parent pid, or 0 in a fresh pid namespace */
+} prisoner_t;
+
+/* Maximum number of BPF instructions handed over to a pooled helper */
+#define SBOX_FILTER_MAX         4096
+
+/* Message handing a sandbox over to a parked helper (since 0.3.6) */
+
+typedef struct
+{
+    res_t quota[QUOTA_TOTAL];   /* quota of the sandbox */
+    unsigned short len;         /* number of BPF instructions, or 0 */
+    unsigned long long prog[SBOX_FILTER_MAX]; /* BPF instructions */
+} handoff_t;
+
+/* Arguments of a helper of a pool, on the stack of the spawning thread */
+
+typedef struct
+{
+    task_t task;                /* copy of the template */
+    char * const * argv;        /* prepared argument array */
+    int sock;                   /* helper end of the hand-off socket */
+    pid_t parent;               /* pid of the process running libsandbox */
+    handoff_t msg;              /* buffer of the hand-off message */
+} helper_t;
+
 /* Local function prototypes */
 
-static void __sandbox_task_init(task_t *, const char * *);
+static bool __sandbox_comm_init(command_t *, const char * *, const char * *);
+static void __sandbox_comm_fini(command_t *);
+
+static bool __sandbox_task_init(task_t *, const char * *, const char * *);
 static bool __sandbox_task_check(const task_t *);
-static int  __sandbox_task_execute(task_t *);
+static bool __sandbox_task_check_spec(const task_t *);
+static bool __sandbox_task_stamp(const task_t *, stamp_t *);
+static bool __sandbox_task_match(const task_t *, const task_t *);
+static char ** __sandbox_task_argv(const task_t *);
+static int  __sandbox_task_spawned(void *);
+static int  __sandbox_task_execute(task_t *, const filter_t *, char * const *,
+                                   int, pid_t);
+static int  __sandbox_task_confine(const task_t *, pid_t);
+static int  __sandbox_task_limit(const task_t *);
+static int  __sandbox_task_launch(const task_t *, const filter_t *, 
+                                  char * const *, int, bool);
 static void __sandbox_task_fini(task_t *);
 
+static void * __sandbox_pool_spawner(void *);
+static int  __sandbox_pool_helper(void *);
+static bool __sandbox_pool_parked(pool_t *, int);
+static pid_t __sandbox_pool_take(pool_t *, const task_t *, const filter_t *, 
+                                 bool, int);
+
+static void * __sandbox_server_runner(void *);
+#ifdef HAVE_TRACE_FORK
+static bool __sandbox_server_point(long, unsigned long);
+static bool __sandbox_server_park(sandbox_t *, const proc_t *);
+static void __sandbox_server_wait(sandbox_t *, pid_t);
+static pid_t __sandbox_server_fork(server_t *, const task_t *, int);
+#endif /* HAVE_TRACE_FORK */
+
+static void * __sandbox_link_runner(void *);
+static void __sandbox_link_finish(sandbox_t *);
+
 static void __sandbox_stat_init(stat_t *);
 static void __sandbox_stat_update(sandbox_t *, const proc_t *);
 static void __sandbox_stat_fini(stat_t *);
@@ -167,9 +356,54 @@ static void __sandbox_stat_fini(stat_t *);
 static void __sandbox_ctrl_init(ctrl_t *, thread_func_t);
 static int  __sandbox_ctrl_add_monitor(ctrl_t *, thread_func_t);
 static void __sandbox_ctrl_fini(ctrl_t *);
+static bool __sandbox_ctrl_dispatch(sandbox_t *, cache_t *, bool *);
+
+static bool __sandbox_cache_lookup(const cache_t *, const event_t *, 
+                                   action_t *);
+static void __sandbox_cache_store(cache_t *, const event_t *, 
+                                  const action_t *);
+
+static bool __sandbox_match_init(matcher_t *, int, compare_t, double);
+static size_t __sandbox_match_span(const char *, size_t, bool);
+static size_t __sandbox_match_diff(const char *, const char *, size_t, bool);
+static bool __sandbox_match_number(const char *, size_t, const char *, size_t,
+    double);
+static bool __sandbox_match_hold(matcher_t *, long long);
+static bool __sandbox_match_close(matcher_t *);
+static long long __sandbox_match_feed(matcher_t *, const char *, size_t);
+static long long __sandbox_match_end(matcher_t *);
+static void __sandbox_match_fini(matcher_t *);
+static void __sandbox_digest_init(digest_t *);
+static void __sandbox_digest_feed(digest_t *, const void *, size_t);
+static unsigned long long __sandbox_digest_end(const digest_t *);
+static void __sandbox_sha256_init(sha256_t *);
+static void __sandbox_sha256_block(unsigned int *, const unsigned char *);
+static void __sandbox_sha256_feed(sha256_t *, const void *, size_t);
+static void __sandbox_sha256_end(sha256_t *, unsigned char *);
+
+static void __sandbox_memo_field(sha256_t *, const void *, size_t);
+static bool __sandbox_memo_file(sha256_t *, int, long long, long long);
+static bool __sandbox_memo_key(const task_t *, const memo_t *, const void *,
+                               size_t, unsigned char *);
+static bool __sandbox_memo_lookup(memo_t *, const unsigned char *, 
+                                  memo_slot_t *);
+static void __sandbox_memo_store(memo_t *, const unsigned char *, 
+                                 const memo_slot_t *);
+static void __sandbox_memo_save(const sandbox_t *, memo_slot_t *);
+static void __sandbox_memo_replay(sandbox_t *, const memo_slot_t *);
+
+static size_t __sandbox_capture_forward(sandbox_t *, int, const char *, 
+                                        size_t, bool);
+static void __sandbox_capture_wait(sandbox_t *);
+
+#ifdef HAVE_PIDFD
+static void __sandbox_watch_untraced(sandbox_t *, proc_t *, cache_t *);
+#endif /* HAVE_PIDFD */
 
 void * sandbox_watcher(sandbox_t *);
 void * sandbox_profiler(sandbox_t *);
+void * sandbox_capturer(sandbox_t *);
+void * sandbox_feeder(sandbox_t *);
 
 int 
 sandbox_init(sandbox_t * psbox, const char * argv[])
@@ -177,6 +411,15 @@ sandbox_init(sandbox_t * psbox, const char * argv[])
     FUNC_BEGIN("%p,%p", psbox, argv);
     assert(psbox);
     
+    FUNC_RET("%d", sandbox_init_env(psbox, argv, NULL));
+}
+
+int 
+sandbox_init_env(sandbox_t * psbox, const char * argv[], const char * envp[])
+{
+    FUNC_BEGIN("%p,%p,%p", psbox, argv, envp);
+    assert(psbox);
+    
     if (psbox == NULL)
     {
         FUNC_RET("%d", -1);
@@ -184,7 +427,11 @@ sandbox_init(sandbox_t * psbox, const char * argv[])
     
     psbox->lock = LOCK_INITIALIZER;
     LOCK(psbox, EX);
-    __sandbox_task_init(&psbox->task, argv);
+    if (!__sandbox_task_init(&psbox->task, argv, envp))
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", -1);
+    }
     __sandbox_stat_init(&psbox->stat);
     __sandbox_ctrl_init(&psbox->ctrl, (thread_func_t)sandbox_tracer);
     __sandbox_ctrl_add_monitor(&psbox->ctrl, (thread_func_t)sandbox_profiler);
@@ -219,234 +466,1585 @@ sandbox_fini(sandbox_t * psbox)
     FUNC_RET("%d", 0);
 }
 
-bool 
-sandbox_check(sandbox_t * psbox)
+int 
+sandbox_command(sandbox_t * psbox, const char * argv[], const char * envp[])
 {
-    FUNC_BEGIN("%p", psbox);
+    FUNC_BEGIN("%p,%p,%p", psbox, argv, envp);
     assert(psbox);
     
     if (psbox == NULL)
     {
-        FUNC_RET("%d", false);
+        FUNC_RET("%d", -1);
     }
     
     LOCK(psbox, EX);
     
-    /* Don't change the state of a running / blocking sandbox */
+    /* Don't change the command of a running / blocking sandbox */
     if (!NOT_STARTED(psbox) && !IS_FINISHED(psbox))
     {
         UNLOCK(psbox);
-        FUNC_RET("%d", false);
+        FUNC_RET("%d", -1);
     }
-    DBUG("passed sandbox status check");
     
-    /* Clear previous statistics and status */
-    if (IS_FINISHED(psbox))
+    command_t * const pcomm = &psbox->task.comm;
+    command_t comm;
+    if (!__sandbox_comm_init(&comm, 
+        (argv != NULL) ? argv : (const char **)pcomm->args, 
+        (envp != NULL) ? envp : (const char **)pcomm->envs))
     {
-        __sandbox_stat_fini(&psbox->stat);
-        __sandbox_stat_init(&psbox->stat);
+        UNLOCK(psbox);
+        FUNC_RET("%d", -1);
     }
+    __sandbox_comm_fini(pcomm);
+    *pcomm = comm;
+    memset(&psbox->task.stamp, 0, sizeof(stamp_t));
     
-    __UPDATE_RESULT(psbox, S_RESULT_PD);
-    __UPDATE_STATUS(psbox, S_STATUS_PRE);
+    UNLOCK(psbox);
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_template_init(task_t * ptmpl, const task_t * ptask)
+{
+    FUNC_BEGIN("%p,%p", ptmpl, ptask);
+    assert(ptmpl && ptask);
     
-    if (!__sandbox_task_check(&psbox->task))
+    if ((ptmpl == NULL) || (ptask == NULL))
     {
-        UNLOCK(psbox);
-        FUNC_RET("%d", false);
+        FUNC_RET("%d", -1);
     }
-    DBUG("passed task spec validation");
     
-    if (psbox->ctrl.tracer.target == NULL)
+    memcpy(ptmpl, ptask, sizeof(task_t));
+    if (!__sandbox_comm_init(&ptmpl->comm, (const char **)ptask->comm.args, 
+        (const char **)ptask->comm.envs))
     {
-        UNLOCK(psbox);
-        FUNC_RET("%d", false);
+        memset(ptmpl, 0, sizeof(task_t));
+        FUNC_RET("%d", -1);
     }
-    DBUG("passed ctrl tracer validation");
     
-    if (psbox->ctrl.monitor[0].target == NULL)
+    /* The stamp is taken before validating static fields, such that changes
+     * to the program file in between would be caught by the instances */
+    if (!__sandbox_task_stamp(ptmpl, &ptmpl->stamp) || 
+        !__sandbox_task_check_spec(ptmpl))
     {
-        UNLOCK(psbox);
-        FUNC_RET("%d", false);
+        __sandbox_task_fini(ptmpl);
+        memset(ptmpl, 0, sizeof(task_t));
+        FUNC_RET("%d", -1);
     }
-    DBUG("passed ctrl monitor validation");
     
-    __UPDATE_STATUS(psbox, S_STATUS_RDY);
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_template_fini(task_t * ptmpl)
+{
+    FUNC_BEGIN("%p", ptmpl);
+    assert(ptmpl);
     
-    UNLOCK(psbox);
-    FUNC_RET("%d", true);
+    if (ptmpl == NULL)
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    __sandbox_task_fini(ptmpl);
+    memset(ptmpl, 0, sizeof(task_t));
+    
+    FUNC_RET("%d", 0);
 }
 
-result_t * 
-sandbox_execute(sandbox_t * psbox)
+int 
+sandbox_instantiate(sandbox_t * psbox, const task_t * ptmpl)
 {
-    FUNC_BEGIN("%p", psbox);
-    assert(psbox);
+    FUNC_BEGIN("%p,%p", psbox, ptmpl);
+    assert(psbox && ptmpl);
     
-    if (psbox == NULL)
+    if ((psbox == NULL) || (ptmpl == NULL) || (ptmpl->stamp.ino == 0))
     {
-        FUNC_RET("%p", (result_t *)NULL);
+        FUNC_RET("%d", -1);
     }
     
-    if (!sandbox_check(psbox))
+    LOCK(psbox, EX);
+    
+    /* Don't change the task of a running / blocking sandbox */
+    if (!NOT_STARTED(psbox) && !IS_FINISHED(psbox))
     {
-        WARN("sandbox pre-execution state check failed");
-        FUNC_RET("%p", &psbox->result);
+        UNLOCK(psbox);
+        FUNC_RET("%d", -1);
     }
     
-#ifdef WITH_REALTIME_SCHED
-    /* Turn on realtime scheduling */
-    struct sched_param param = {1};
-    if (getuid() == (uid_t)0)
+    task_t * const ptask = &psbox->task;
+    command_t comm;
+    if (!__sandbox_comm_init(&comm, (const char **)ptmpl->comm.args, 
+        (const char **)ptmpl->comm.envs))
     {
-        if (sched_setscheduler(0, SCHED_RR, &param) != 0)
-        {
-            WARN("failed to apply realtime scheduling policy");
-            FUNC_RET("%p", &psbox->result);
-        }
-        DBUG("applied realtime scheduling policy");
+        UNLOCK(psbox);
+        FUNC_RET("%d", -1);
     }
-#endif /* WITH_REALTIME_SCHED */
+    __sandbox_comm_fini(&ptask->comm);
+    ptask->comm = comm;
+    strcpy(ptask->jail, ptmpl->jail);
+    ptask->uid = ptmpl->uid;
+    ptask->gid = ptmpl->gid;
+    memcpy(&ptask->fs, &ptmpl->fs, sizeof(filesys_t));
+    ptask->trust = ptmpl->trust;
+    ptask->ns = ptmpl->ns;
+    memcpy(&ptask->image, &ptmpl->image, sizeof(image_t));
+    ptask->xfd = ptmpl->xfd;
+    ptask->stamp = ptmpl->stamp;
     
-    LOCK(psbox, EX);
+    UNLOCK(psbox);
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_pool_init(pool_t * ppool, const task_t * ptmpl, int size, 
+                  bool refill)
+{
+    FUNC_BEGIN("%p,%p,%d,%d", ppool, ptmpl, size, refill);
+    assert(ppool && ptmpl);
+    
+    /* Helpers report their pid's, which are meaningless outside of a fresh
+     * pid namespace */
+    if ((ppool == NULL) || (ptmpl == NULL) || (ptmpl->stamp.ino == 0) || 
+        (ptmpl->ns & S_NS_PID) || (size <= 0) || (size > SBOX_POOL_MAX))
+    {
+        FUNC_RET("%d", -1);
+    }
     
-    /* Fork the prisoner process */
-    psbox->ctrl.pid = fork();
+    memset(ppool, 0, sizeof(pool_t));
+    ppool->lock = LOCK_INITIALIZER;
+    ppool->size = size;
+    ppool->refill = refill;
     
-    /* Execute the targeted program in the prisoner process */
-    if (psbox->ctrl.pid == 0)
+    /* The argument array is prepared once, such that the helpers never 
+     * allocate memory in the shared memory space */
+    if (sandbox_template_init(&ppool->tmpl, ptmpl) != 0)
     {
-        DBUG("entering: the prisoner process");
-        UNLOCK(psbox);
-        /* Start executing the targeted program */
-        _exit(__sandbox_task_execute(&psbox->task));
+        FUNC_RET("%d", -1);
+    }
+    if ((ppool->argv = __sandbox_task_argv(&ppool->tmpl)) == NULL)
+    {
+        sandbox_template_fini(&ppool->tmpl);
+        FUNC_RET("%d", -1);
     }
     
-    /* Create all monitor threads */
-    int all, i;
-    for (i = all = 0; i < (SBOX_MONITOR_MAX); i++)
+    int i;
+    for (i = 0; i < size; i++)
     {
-        if (psbox->ctrl.monitor[i].target == NULL)
-        {
-            continue;
-        }
-        if (pthread_create(&psbox->ctrl.monitor[i].tid, NULL, 
-            psbox->ctrl.monitor[i].target, (void *)psbox) != 0)
+        ppool->slot[i].chan = -1;
+    }
+    
+    /* Create the spawning threads with all signals blocked, which are then
+     * inherited by the helpers until they launch the targeted program */
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+    for (i = 0; i < size; i++)
+    {
+        if (pthread_create(&ppool->slot[i].spawner.tid, NULL, 
+            __sandbox_pool_spawner, (void *)ppool) != 0)
         {
-            WARN("failed to create monitor thread at %p",
-                psbox->ctrl.monitor[i].target);
-            psbox->ctrl.monitor[i].target = NULL;
-            continue; /* continue to create the rest monitor threads */
+            WARN("failed to create spawning thread #%d", i);
+            break;
         }
-        ++all;
-        DBUG("created: monitor thread #%d at %p", all, 
-            psbox->ctrl.monitor[i].target);
+        ppool->slot[i].spawner.target = __sandbox_pool_spawner;
     }
-    DBUG("created: %d monitor threads", all);
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
     
-    /* Save current thread id */
-    psbox->ctrl.tracer.tid = pthread_self();
+    if (i < size)
+    {
+        sandbox_pool_fini(ppool);
+        FUNC_RET("%d", -1);
+    }
     
-    /* Start executing the main tracer thread */
-    if (psbox->ctrl.pid > 0)
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_pool_fini(pool_t * ppool)
+{
+    FUNC_BEGIN("%p", ppool);
+    assert(ppool);
+    
+    if ((ppool == NULL) || (ppool->argv == NULL))
     {
-        DBUG("forked the prisoner process as pid %d", psbox->ctrl.pid);
-        __UPDATE_RESULT(psbox, S_RESULT_PD);
-        __UPDATE_STATUS(psbox, S_STATUS_BLK);
-        UNLOCK(psbox);
-        psbox->ctrl.tracer.target(psbox);
+        FUNC_RET("%d", -1);
     }
-    else
+    
+    /* Parked helpers quit as their hand-off sockets are shut down, and the 
+     * spawning threads then reap them */
+    LOCK(ppool, EX);
+    ppool->closing = true;
+    int i;
+    for (i = 0; i < ppool->size; i++)
     {
-        WARN("error forking the prisoner process");
-        __UPDATE_RESULT(psbox, S_RESULT_IE);
-        __UPDATE_STATUS(psbox, S_STATUS_FIN);
-        UNLOCK(psbox);
+        if (ppool->slot[i].chan >= 0)
+        {
+            shutdown(ppool->slot[i].chan, SHUT_RDWR);
+        }
     }
+    UNLOCK(ppool);
     
-    /* Join all monitor threads */
-    int idx, cnt;
-    for (i = idx = cnt = 0; i < (SBOX_MONITOR_MAX); i++)
+    for (i = 0; i < ppool->size; i++)
     {
-        if (psbox->ctrl.monitor[i].target == NULL)
+        if (ppool->slot[i].spawner.target == NULL)
         {
             continue;
         }
-        ++idx;
-        /* Final notification for the monitor thread to quit */
-        pthread_kill(psbox->ctrl.monitor[i].tid, SIGEXIT);
-        if (pthread_join(psbox->ctrl.monitor[i].tid, NULL) != 0)
+        if (pthread_join(ppool->slot[i].spawner.tid, NULL) != 0)
         {
-            WARN("failed to join monitor thread #%d", idx);
-            if (pthread_cancel(psbox->ctrl.monitor[i].tid) != 0)
-            {
-                WARN("failed to cancel the %dth monitor thread", idx);
-                continue; /* continue to join the rest monitor threads */
-            }
+            WARN("failed to join spawning thread #%d", i);
         }
-        ++cnt;
     }
-    DBUG("joined %d of %d monitor threads", cnt, all);
+    DBUG("joined %d spawning threads", ppool->started);
     
-    FUNC_RET("%p", &psbox->result);
+    free(ppool->argv);
+    sandbox_template_fini(&ppool->tmpl);
+    memset(ppool, 0, sizeof(pool_t));
+    
+    FUNC_RET("%d", 0);
 }
 
-static void 
-__sandbox_task_init(task_t * ptask, const char * argv[])
-{ 
-    PROC_BEGIN("%p,%p", ptask, argv);
-    assert(ptask);              /* argv could be NULL */
+int 
+sandbox_pool_ready(pool_t * ppool)
+{
+    FUNC_BEGIN("%p", ppool);
+    assert(ppool);
     
-    memset(ptask, 0, sizeof(task_t));
+    if ((ppool == NULL) || (ppool->argv == NULL))
+    {
+        FUNC_RET("%d", -1);
+    }
     
-    unsigned int argc = 0;
-    unsigned int offset = 0;
-    if (argv != NULL)
+    LOCK(ppool, EX);
+    int i, cnt;
+    for (i = cnt = 0; i < ppool->size; i++)
     {
-        while (argv[argc] != NULL)
+        if (__sandbox_pool_parked(ppool, i))
         {
-            unsigned int delta  = strlen(argv[argc]) + 1;
-            if (offset + delta >= sizeof(ptask->comm.buff))
-            {
-                break;
-            }
-            strcpy(ptask->comm.buff + offset, argv[argc]);
-            ptask->comm.args[argc++] = offset;
-            offset += delta;
+            ++cnt;
         }
     }
-    ptask->comm.buff[offset] = '\0';
-    ptask->comm.args[argc] = -1;
+    UNLOCK(ppool);
     
-    strcpy(ptask->jail, "/");
-    ptask->uid = getuid();
-    ptask->gid = getgid();
-    ptask->ifd = STDIN_FILENO;
-    ptask->ofd = STDOUT_FILENO;
-    ptask->efd = STDERR_FILENO;
-    ptask->quota[S_QUOTA_WALLCLOCK] = SBOX_QUOTA_INF;
-    ptask->quota[S_QUOTA_CPU] = SBOX_QUOTA_INF;
-    ptask->quota[S_QUOTA_MEMORY] = SBOX_QUOTA_INF;
-    ptask->quota[S_QUOTA_DISK] = SBOX_QUOTA_INF;
-    PROC_END();
+    FUNC_RET("%d", cnt);
 }
 
-static void 
-__sandbox_task_fini(task_t * ptask)
+int 
+sandbox_memo_init(memo_t * pmemo, const char * path, unsigned long slots)
 {
-    PROC_BEGIN("%p", ptask);
-    assert(ptask);
+    FUNC_BEGIN("%p,%p,%lu", pmemo, path, slots);
+    assert(pmemo && path);
     
-    /* TODO */
+    if ((pmemo == NULL) || (path == NULL))
+    {
+        FUNC_RET("%d", -1);
+    }
     
-    PROC_END();
-}
-
-static bool
-__sandbox_task_check(const task_t * ptask)
-{
-    FUNC_BEGIN("%p", ptask);
-    assert(ptask);
+    memset(pmemo, 0, sizeof(memo_t));
+    pmemo->lock = LOCK_INITIALIZER;
+    pmemo->fd = -1;
+    slots = (slots > 0) ? slots : SBOX_MEMO_SLOTS;
+    
+    const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        WARN("failed to open the index file of the result cache");
+        FUNC_RET("%d", -1);
+    }
+    
+    /* A new index file is laid out (or an existing one validated) under an 
+     * exclusive lock, such that concurrent processes see either none or all
+     * of the header. The slots of a new index file are all vacant (zeros). */
+    memo_head_t head;
+    struct stat s;
+    bool valid = (flock(fd, LOCK_EX) == 0) && (fstat(fd, &s) == 0);
+    if (valid && (s.st_size == 0))
+    {
+        memset(&head, 0, sizeof(memo_head_t));
+        memcpy(head.magic, SBOX_MEMO_MAGIC, sizeof(head.magic));
+        head.version = SBOX_MEMO_VERSION;
+        head.layout = sizeof(memo_slot_t);
+        head.slots = slots;
+        valid = (ftruncate(fd, sizeof(memo_head_t) + 
+            head.slots * sizeof(memo_slot_t)) == 0) && 
+            (pwrite(fd, &head, sizeof(memo_head_t), 0) == 
+             sizeof(memo_head_t));
+    }
+    else if (valid)
+    {
+        valid = (pread(fd, &head, sizeof(memo_head_t), 0) == 
+            sizeof(memo_head_t)) && 
+            (memcmp(head.magic, SBOX_MEMO_MAGIC, sizeof(head.magic)) == 0) &&
+            (head.version == SBOX_MEMO_VERSION) && 
+            (head.layout == sizeof(memo_slot_t)) && (head.slots > 0) && 
+            ((unsigned long long)s.st_size == sizeof(memo_head_t) + 
+             head.slots * sizeof(memo_slot_t));
+    }
+    const size_t size = valid ? (sizeof(memo_head_t) + 
+        head.slots * sizeof(memo_slot_t)) : 0;
+    void * base = valid ? mmap(NULL, size, PROT_READ | PROT_WRITE, 
+        MAP_SHARED, fd, 0) : MAP_FAILED;
+    flock(fd, LOCK_UN);
+    if (base == MAP_FAILED)
+    {
+        WARN("invalid or incompatible index file of the result cache");
+        close(fd);
+        FUNC_RET("%d", -1);
+    }
+    
+    pmemo->fd = fd;
+    pmemo->base = base;
+    pmemo->size = size;
+    pmemo->slots = head.slots;
+    
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_memo_fini(memo_t * pmemo)
+{
+    FUNC_BEGIN("%p", pmemo);
+    assert(pmemo);
+    
+    if ((pmemo == NULL) || (pmemo->base == NULL))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    munmap(pmemo->base, pmemo->size);
+    close(pmemo->fd);
+    memset(pmemo, 0, sizeof(memo_t));
+    pmemo->fd = -1;
+    
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_server_init(server_t * pserver, const task_t * ptmpl, 
+                    const policy_t * ppolicy)
+{
+    FUNC_BEGIN("%p,%p,%p", pserver, ptmpl, ppolicy);
+    assert(pserver && ptmpl && ppolicy);
+    
+    /* Copies of the master process are traced, which is not the case with 
+     * trusted tasks, and are siblings of the master process, which is not 
+     * possible for the init process of a fresh pid namespace */
+    if ((pserver == NULL) || (ptmpl == NULL) || (ppolicy == NULL) || 
+        (ptmpl->stamp.ino == 0) || (ptmpl->trust != S_TRUST_NONE) || 
+        (ptmpl->ns & S_NS_PID))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+#ifdef HAVE_TRACE_FORK
+    memset(pserver, 0, sizeof(server_t));
+    pserver->lock = LOCK_INITIALIZER;
+    pserver->chan[0] = pserver->chan[1] = -1;
+    
+    if ((socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, 
+        pserver->chan) != 0) || 
+        ((pserver->point = malloc(sizeof(proc_t))) == NULL))
+    {
+        WARN("failed to create hand-off socket");
+        close(pserver->chan[0]);
+        close(pserver->chan[1]);
+        memset(pserver, 0, sizeof(server_t));
+        FUNC_RET("%d", -1);
+    }
+    
+    /* All standard channels of the master process are connected to the 
+     * hand-off socket, and the master sandbox has no wallclock quota, as the
+     * master process is parked for as long as the server lives */
+    sandbox_t * const psbox = &pserver->sbox;
+    if ((sandbox_init_env(psbox, (const char **)ptmpl->comm.args, 
+        (const char **)ptmpl->comm.envs) != 0) || 
+        (sandbox_instantiate(psbox, ptmpl) != 0))
+    {
+        WARN("failed to initialize the master sandbox");
+        sandbox_fini(psbox);
+        free(pserver->point);
+        close(pserver->chan[0]);
+        close(pserver->chan[1]);
+        memset(pserver, 0, sizeof(server_t));
+        FUNC_RET("%d", -1);
+    }
+    psbox->task.ifd = psbox->task.ofd = psbox->task.efd = pserver->chan[1];
+    memcpy(psbox->task.quota, ptmpl->quota, sizeof(psbox->task.quota));
+    psbox->task.quota[S_QUOTA_WALLCLOCK] = SBOX_QUOTA_INF;
+    psbox->ctrl.policy = *ppolicy;
+    psbox->ctrl.server = pserver;
+    
+    /* The master sandbox is checked here, such that it is known to start 
+     * (and to finish) once the runner thread is created */
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+    const bool res = sandbox_check(psbox) && 
+        (pthread_create(&pserver->runner.tid, NULL, __sandbox_server_runner, 
+                        (void *)pserver) == 0);
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+    if (!res)
+    {
+        WARN("failed to start the master sandbox");
+        sandbox_fini(psbox);
+        free(pserver->point);
+        close(pserver->chan[0]);
+        close(pserver->chan[1]);
+        memset(pserver, 0, sizeof(server_t));
+        FUNC_RET("%d", -1);
+    }
+    pserver->runner.target = __sandbox_server_runner;
+    
+    FUNC_RET("%d", 0);
+#else
+#warning "sandbox_server_init() is not implemented for this platform"
+    FUNC_RET("%d", -1);
+#endif /* HAVE_TRACE_FORK */
+}
+
+int 
+sandbox_server_fini(server_t * pserver)
+{
+    FUNC_BEGIN("%p", pserver);
+    assert(pserver);
+    
+    if ((pserver == NULL) || (pserver->runner.target == NULL))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    /* No copy is being forked once the server is closing */
+    LOCK(pserver, EX);
+    pserver->closing = true;
+    pserver->parked = false;
+    UNLOCK(pserver);
+    
+    /* Kill the master process (parked or not) as soon as it is spawned, and
+     * the runner thread then finishes the master sandbox */
+    sandbox_t * const psbox = &pserver->sbox;
+    LOCK_ON_COND(psbox, SH, !NOT_STARTED(psbox));
+    if (!IS_FINISHED(psbox) && (psbox->ctrl.pid > 0))
+    {
+        kill(-psbox->ctrl.pid, SIGKILL);
+    }
+    UNLOCK(psbox);
+    
+    if (pthread_join(pserver->runner.tid, NULL) != 0)
+    {
+        WARN("failed to join the runner thread");
+    }
+    
+    sandbox_fini(psbox);
+    free(pserver->point);
+    close(pserver->chan[0]);
+    close(pserver->chan[1]);
+    memset(pserver, 0, sizeof(server_t));
+    
+    FUNC_RET("%d", 0);
+}
+
+int 
+sandbox_server_ready(server_t * pserver)
+{
+    FUNC_BEGIN("%p", pserver);
+    assert(pserver);
+    
+    if ((pserver == NULL) || (pserver->runner.target == NULL))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    LOCK(pserver, SH);
+    const int res = (pserver->parked) ? 1 : 0;
+    UNLOCK(pserver);
+    
+    FUNC_RET("%d", res);
+}
+
+bool 
+sandbox_check(sandbox_t * psbox)
+{
+    FUNC_BEGIN("%p", psbox);
+    assert(psbox);
+    
+    if (psbox == NULL)
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    LOCK(psbox, EX);
+    
+    /* Don't change the state of a running / blocking sandbox */
+    if (!NOT_STARTED(psbox) && !IS_FINISHED(psbox))
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed sandbox status check");
+    
+    /* Clear previous statistics and status */
+    if (IS_FINISHED(psbox))
+    {
+        __sandbox_stat_fini(&psbox->stat);
+        __sandbox_stat_init(&psbox->stat);
+    }
+    
+    __UPDATE_RESULT(psbox, S_RESULT_PD);
+    __UPDATE_STATUS(psbox, S_STATUS_PRE);
+    
+    if (!__sandbox_task_check(&psbox->task))
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed task spec validation");
+    
+    if (psbox->ctrl.tracer.target == NULL)
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed ctrl tracer validation");
+    
+    if (psbox->ctrl.monitor[0].target == NULL)
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed ctrl monitor validation");
+    
+    if ((psbox->ctrl.filter.len > 0) && (psbox->ctrl.filter.prog == NULL))
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed ctrl filter validation");
+    
+#ifdef HAVE_SYSCALL_NOTIFY
+    if ((psbox->ctrl.backend != S_BACKEND_PTRACE) && 
+        (psbox->ctrl.backend != S_BACKEND_NOTIFY))
+#else
+    if (psbox->ctrl.backend != S_BACKEND_PTRACE)
+#endif /* HAVE_SYSCALL_NOTIFY */
+    {
+        UNLOCK(psbox);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed ctrl backend validation");
+    
+    __UPDATE_STATUS(psbox, S_STATUS_RDY);
+    
+    UNLOCK(psbox);
+    FUNC_RET("%d", true);
+}
+
+result_t * 
+sandbox_execute(sandbox_t * psbox)
+{
+    FUNC_BEGIN("%p", psbox);
+    assert(psbox);
+    
+    if (psbox == NULL)
+    {
+        FUNC_RET("%p", (result_t *)NULL);
+    }
+    
+    if (!sandbox_check(psbox))
+    {
+        WARN("sandbox pre-execution state check failed");
+        FUNC_RET("%p", &psbox->result);
+    }
+    
+#ifdef WITH_REALTIME_SCHED
+    /* Turn on realtime scheduling */
+    struct sched_param param = {1};
+    if (getuid() == (uid_t)0)
+    {
+        if (sched_setscheduler(0, SCHED_RR, &param) != 0)
+        {
+            WARN("failed to apply realtime scheduling policy");
+            FUNC_RET("%p", &psbox->result);
+        }
+        DBUG("applied realtime scheduling policy");
+    }
+#endif /* WITH_REALTIME_SCHED */
+    
+    /* Replay the run from the result cache (if any) without executing the 
+     * targeted program, otherwise the run is stored into the cache once it 
+     * is finished. The key is computed on a snapshot of the task, such that
+     * the lock is not held while hashing the program file and the input. */
+    unsigned char key[32];
+    memo_slot_t slot;
+    task_t snapshot;
+    LOCK(psbox, SH);
+    memcpy(&snapshot, &psbox->task, sizeof(task_t));
+    const bool cacheable = (psbox->ctrl.link.peer == NULL) && 
+        ((psbox->ctrl.server == NULL) || 
+         (psbox != &psbox->ctrl.server->sbox));
+    const memo_t * const pmemo = cacheable ? psbox->ctrl.memo : NULL;
+    const void * const profile = psbox->ctrl.profile.data;
+    const size_t size = psbox->ctrl.profile.size;
+    UNLOCK(psbox);
+    bool memo = __sandbox_memo_key(&snapshot, pmemo, profile, size, key);
+    
+    LOCK(psbox, EX);
+    
+    if (memo && __sandbox_memo_lookup(psbox->ctrl.memo, key, &slot))
+    {
+        DBUG("replayed the run from the result cache");
+        __sandbox_memo_replay(psbox, &slot);
+        __UPDATE_RESULT(psbox, slot.result);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+        FUNC_RET("%p", &psbox->result);
+    }
+    
+    /* Prepare the argument array of the targeted program in advance, such 
+     * that the prisoner process runs on a small stack */
+    char ** argv = __sandbox_task_argv(&psbox->task);
+    if (argv == NULL)
+    {
+        WARN("failed to allocate argument array");
+        __UPDATE_RESULT(psbox, S_RESULT_IE);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+        FUNC_RET("%p", &psbox->result);
+    }
+    
+    /* Create the eventfd for notifying the profiler thread */
+    psbox->ctrl.notice.pending = 0;
+    if ((psbox->ctrl.notice.fd = eventfd(0, EFD_CLOEXEC)) < 0)
+    {
+        WARN("failed to create eventfd for notices");
+        free(argv);
+        __UPDATE_RESULT(psbox, S_RESULT_IE);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+        FUNC_RET("%p", &psbox->result);
+    }
+    
+    /* Create the pipe for collecting the seccomp listener of the prisoner */
+    int chan[2] = {-1, -1};
+#ifdef HAVE_SYSCALL_NOTIFY
+    const bool listened = ((psbox->ctrl.backend == S_BACKEND_NOTIFY) && 
+                           (psbox->task.trust != S_TRUST_FULL));
+    if (listened && ((pipe(chan) != 0) || 
+        (fcntl(chan[0], F_SETFD, FD_CLOEXEC) != 0) || 
+        (fcntl(chan[1], F_SETFD, FD_CLOEXEC) != 0)))
+    {
+        WARN("failed to create pipe for the seccomp listener");
+        free(argv);
+        close(chan[0]);
+        close(chan[1]);
+        close(psbox->ctrl.notice.fd);
+        psbox->ctrl.notice.fd = -1;
+        __UPDATE_RESULT(psbox, S_RESULT_IE);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+        FUNC_RET("%p", &psbox->result);
+    }
+#endif /* HAVE_SYSCALL_NOTIFY */
+    
+    /* Create the pipes for capturing the output of the prisoner process, 
+     * whose writable ends stand in for the output channels of the task until
+     * the prisoner process is spawned. Output channels other than regular 
+     * files are captured for enforcing the disk quota, and the error channel 
+     * shares the capture pipe of the output channel if they are one and the 
+     * same, and the output is not compared. The master process of a fork 
+     * server keeps its channels on the hand-off socket. The output to a 
+     * linked sandbox is always captured, and relayed by the capture thread. 
+     * The output of a run to be cached, or to be fingerprinted with SHA-256,
+     * is captured for its digests. */
+    int capture[2] = {-1, -1};
+    int ecapture[2] = {-1, -1};
+    const int ofd = psbox->task.ofd;
+    const int efd = psbox->task.efd;
+    bool ocap = psbox->task.capture.enabled || psbox->task.capture.sha256 ||
+        (psbox->ctrl.link.peer != NULL) || memo;
+    bool ecap = false;
+    bool shared = false;
+    if ((psbox->task.quota[S_QUOTA_DISK] != SBOX_QUOTA_INF) && 
+        ((psbox->ctrl.server == NULL) || 
+         (psbox != &psbox->ctrl.server->sbox)))
+    {
+        struct stat os, es;
+        const bool ook = (fstat(ofd, &os) == 0);
+        const bool eok = (fstat(efd, &es) == 0);
+        ocap = ocap || (ook && !S_ISREG(os.st_mode));
+        ecap = eok && !S_ISREG(es.st_mode);
+        shared = ecap && ocap && ook && (os.st_dev == es.st_dev) && 
+            (os.st_ino == es.st_ino) && 
+            (!psbox->task.capture.enabled || 
+             (psbox->task.capture.compare == S_COMPARE_NONE));
+    }
+    if ((ocap && ((pipe(capture) != 0) || 
+         (fcntl(capture[0], F_SETFD, FD_CLOEXEC) != 0) || 
+         (fcntl(capture[1], F_SETFD, FD_CLOEXEC) != 0))) || 
+        (ecap && !shared && ((pipe(ecapture) != 0) || 
+         (fcntl(ecapture[0], F_SETFD, FD_CLOEXEC) != 0) || 
+         (fcntl(ecapture[1], F_SETFD, FD_CLOEXEC) != 0))))
+    {
+        WARN("failed to create pipe for capturing output");
+        free(argv);
+        close(capture[0]);
+        close(capture[1]);
+        close(ecapture[0]);
+        close(ecapture[1]);
+        close(chan[0]);
+        close(chan[1]);
+        close(psbox->ctrl.notice.fd);
+        psbox->ctrl.notice.fd = -1;
+        __UPDATE_RESULT(psbox, S_RESULT_IE);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+        FUNC_RET("%p", &psbox->result);
+    }
+    if (ocap)
+    {
+        psbox->task.ofd = capture[1];
+    }
+    if (ecap)
+    {
+        psbox->task.efd = shared ? capture[1] : ecapture[1];
+    }
+    
+    /* Stand in for the input channel of the task with the input to be fed, 
+     * i.e. either the readable end of a feeding pipe, or a seekable file. A
+     * seekable file is the file of the task itself (re-opened for a private 
+     * offset) if the input covers the entire file, or otherwise a sealed copy
+     * of the input in memory. */
+    int feed[2] = {-1, -1};
+    const int ifd = psbox->task.ifd;
+    const bool fed = (psbox->task.feed.data != NULL) || 
+        (psbox->task.feed.fd >= 0);
+    if (fed)
+    {
+        const feed_t * const pfeed = &psbox->task.feed;
+        struct stat fs;
+        long long size = pfeed->size;
+        bool whole = false;
+        if ((pfeed->fd >= 0) && (fstat(pfeed->fd, &fs) == 0))
+        {
+            const long long rest = (fs.st_size > pfeed->offset) ? 
+                (fs.st_size - pfeed->offset) : 0;
+            size = ((size < 0) || (size > rest)) ? rest : size;
+            whole = (pfeed->offset == 0) && (size == fs.st_size);
+        }
+        size = (size < 0) ? 0 : size;
+        psbox->ctrl.feed.size = size;
+        if (pfeed->seekable && whole)
+        {
+            char path[32];
+            snprintf(path, sizeof(path), "/proc/self/fd/%d", pfeed->fd);
+            feed[0] = open(path, O_RDONLY | O_CLOEXEC);
+        }
+        if (pfeed->seekable && (feed[0] < 0))
+        {
+            feed[0] = feed_sealed(pfeed->data, pfeed->fd, pfeed->offset, 
+                (size_t)size);
+        }
+        if (!pfeed->seekable && (pipe(feed) == 0) && 
+            ((fcntl(feed[0], F_SETFD, FD_CLOEXEC) != 0) || 
+             (fcntl(feed[1], F_SETFD, FD_CLOEXEC) != 0) || 
+             (fcntl(feed[1], F_SETFL, O_NONBLOCK) != 0)))
+        {
+            close(feed[0]);
+            close(feed[1]);
+            feed[0] = feed[1] = -1;
+        }
+    }
+    if (fed && (feed[0] < 0))
+    {
+        WARN("failed to create pipe or file for feeding input");
+        free(argv);
+        if (ocap)
+        {
+            psbox->task.ofd = ofd;
+            close(capture[0]);
+            close(capture[1]);
+        }
+        if (ecap)
+        {
+            psbox->task.efd = efd;
+            close(ecapture[0]);
+            close(ecapture[1]);
+        }
+        close(chan[0]);
+        close(chan[1]);
+        close(psbox->ctrl.notice.fd);
+        psbox->ctrl.notice.fd = -1;
+        __UPDATE_RESULT(psbox, S_RESULT_IE);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+        FUNC_RET("%p", &psbox->result);
+    }
+    if (fed)
+    {
+        psbox->task.ifd = feed[0];
+    }
+    
+    /* Place the prisoner process and the tracer threads on cpu's */
+    placement_t * const pplace = &psbox->stat.placement;
+    pplace->prisoner = SBOX_CPU_ANY;
+    pplace->tracer = SBOX_CPU_ANY;
+    if (psbox->task.cpu.prisoner != SBOX_CPU_ANY)
+    {
+        pplace->prisoner = cpu_reserve(psbox->task.cpu.prisoner);
+    }
+    if (psbox->task.cpu.tracer == SBOX_CPU_AUTO)
+    {
+        pplace->tracer = cpu_sibling(pplace->prisoner);
+    }
+    else
+    {
+        pplace->tracer = psbox->task.cpu.tracer;
+    }
+    DBUG("placement: prisoner on cpu %d, tracer on cpu %d", pplace->prisoner,
+        pplace->tracer);
+    
+    /* Spawn the prisoner process to execute the targeted program. A prisoner
+     * process that waits for the watcher before its execve() (i.e. stops 
+     * itself to have filtered system calls traced, or has the execve() sent
+     * to the listener) must be a forked copy of this process, because the 
+     * calling thread is suspended by proc_spawn() until the execve(). */
+    prisoner_t prisoner = {&psbox->task, &psbox->ctrl.filter, argv, chan[1], 
+        pplace->prisoner, (psbox->task.ns & S_NS_PID) ? 0 : getpid()};
+    psbox->ctrl.pid = -1;
+    if ((psbox->ctrl.pool != NULL) && ((psbox->task.trust == S_TRUST_FULL) || 
+        (psbox->ctrl.backend == S_BACKEND_PTRACE)))
+    {
+        psbox->ctrl.pid = __sandbox_pool_take(psbox->ctrl.pool, &psbox->task,
+            &psbox->ctrl.filter, (psbox->task.trust != S_TRUST_FULL), 
+            pplace->prisoner);
+    }
+#ifdef HAVE_TRACE_FORK
+    /* Copies of the master process of a fork server are traced without system
+     * call filter, as is the master process */
+    if ((psbox->ctrl.pid <= 0) && (psbox->ctrl.server != NULL) && 
+        (psbox != &psbox->ctrl.server->sbox) && 
+        (psbox->task.trust == S_TRUST_NONE) && 
+        (psbox->ctrl.backend == S_BACKEND_PTRACE))
+    {
+        psbox->ctrl.pid = __sandbox_server_fork(psbox->ctrl.server, 
+            &psbox->task, pplace->prisoner);
+        if (psbox->ctrl.pid > 0)
+        {
+            psbox->ctrl.filter = (filter_t){0, NULL};
+        }
+    }
+#endif /* HAVE_TRACE_FORK */
+    if (psbox->ctrl.pid > 0)
+    {
+        DBUG("handed the task over to process %d", psbox->ctrl.pid);
+    }
+#ifdef HAVE_SYSCALL_FILTER
+    else if ((psbox->task.trust != S_TRUST_FULL) && 
+        ((psbox->ctrl.backend != S_BACKEND_PTRACE) || 
+         (psbox->ctrl.filter.len > 0)))
+    {
+        psbox->ctrl.pid = proc_fork(ns_clone_flags(psbox->task.ns));
+        if (psbox->ctrl.pid == 0)
+        {
+            _exit(__sandbox_task_spawned(&prisoner));
+        }
+    }
+#endif /* HAVE_SYSCALL_FILTER */
+    else
+    {
+        psbox->ctrl.pid = proc_spawn(__sandbox_task_spawned, &prisoner, 
+            ns_clone_flags(psbox->task.ns));
+    }
+    free(argv);
+    
+    /* Have the capture pipes drained by a capture thread along with the other
+     * monitor threads */
+    int capturer = SBOX_MONITOR_MAX;
+    if (ocap || ecap)
+    {
+        psbox->task.ofd = ofd;
+        psbox->task.efd = efd;
+        close(capture[1]);
+        close(ecapture[1]);
+        psbox->ctrl.capture.fd = capture[0];
+        psbox->ctrl.capture.efd = ecapture[0];
+        psbox->ctrl.capture.exited = false;
+        capturer = __sandbox_ctrl_add_monitor(&psbox->ctrl, 
+            (thread_func_t)sandbox_capturer);
+    }
+    
+    /* Have the input fed through the feeding pipe by a feed thread, or else
+     * handed over to the prisoner process all at once in a seekable file */
+    int feeder = SBOX_MONITOR_MAX;
+    if (fed)
+    {
+        psbox->task.ifd = ifd;
+        psbox->ctrl.feed.rfd = feed[0];
+        psbox->ctrl.feed.fd = feed[1];
+        if (feed[1] >= 0)
+        {
+            feeder = __sandbox_ctrl_add_monitor(&psbox->ctrl, 
+                (thread_func_t)sandbox_feeder);
+        }
+        else
+        {
+            psbox->stat.input.bytes = psbox->ctrl.feed.size;
+        }
+    }
+    
+#ifdef HAVE_SYSCALL_NOTIFY
+    /* Collect the seccomp listener of the prisoner process */
+    if (listened)
+    {
+        close(chan[1]);
+        if (psbox->ctrl.pid > 0)
+        {
+            psbox->ctrl.listener = trace_listener(psbox->ctrl.pid, chan[0]);
+        }
+        close(chan[0]);
+    }
+#endif /* HAVE_SYSCALL_NOTIFY */
+    
+    /* Create all monitor threads with all signals blocked, such that they do
+     * not steal signals directed to the process running libsandbox */
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+    int all, i;
+    for (i = all = 0; i < (SBOX_MONITOR_MAX); i++)
+    {
+        if (psbox->ctrl.monitor[i].target == NULL)
+        {
+            continue;
+        }
+        if (pthread_create(&psbox->ctrl.monitor[i].tid, NULL, 
+            psbox->ctrl.monitor[i].target, (void *)psbox) != 0)
+        {
+            WARN("failed to create monitor thread at %p",
+                psbox->ctrl.monitor[i].target);
+            psbox->ctrl.monitor[i].target = NULL;
+            continue; /* continue to create the rest monitor threads */
+        }
+        ++all;
+        DBUG("created: monitor thread #%d at %p", all, 
+            psbox->ctrl.monitor[i].target);
+        if (pplace->tracer >= 0)
+        {
+            cpu_bind(psbox->ctrl.monitor[i].tid, pplace->tracer, NULL);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+    DBUG("created: %d monitor threads", all);
+    
+    /* Without a capture thread, the exit of the prisoner process should not
+     * wait for its output to be compared */
+    if (((psbox->ctrl.capture.fd >= 0) || (psbox->ctrl.capture.efd >= 0)) && 
+        ((capturer >= SBOX_MONITOR_MAX) || 
+         (psbox->ctrl.monitor[capturer].target == NULL)))
+    {
+        WARN("failed to start the capture thread");
+        memo = false;
+        close(psbox->ctrl.capture.fd);
+        close(psbox->ctrl.capture.efd);
+        psbox->ctrl.capture.fd = -1;
+        psbox->ctrl.capture.efd = -1;
+    }
+    
+    /* Without a feed thread, the prisoner process should see the end of its
+     * input rather than wait for it */
+    if ((psbox->ctrl.feed.fd >= 0) && ((feeder >= SBOX_MONITOR_MAX) || 
+        (psbox->ctrl.monitor[feeder].target == NULL)))
+    {
+        WARN("failed to start the feed thread");
+        close(psbox->ctrl.feed.fd);
+        psbox->ctrl.feed.fd = -1;
+    }
+    
+    /* Save current thread id */
+    psbox->ctrl.tracer.tid = pthread_self();
+    cpu_saved_t affinity;
+    const bool bound = (pplace->tracer >= 0) && 
+        cpu_bind(psbox->ctrl.tracer.tid, pplace->tracer, &affinity);
+    
+    /* Start executing the main tracer thread */
+    if (psbox->ctrl.pid > 0)
+    {
+        DBUG("forked the prisoner process as pid %d", psbox->ctrl.pid);
+        __UPDATE_RESULT(psbox, S_RESULT_PD);
+        __UPDATE_STATUS(psbox, S_STATUS_BLK);
+        UNLOCK(psbox);
+        psbox->ctrl.tracer.target(psbox);
+    }
+    else
+    {
+        WARN("error forking the prisoner process");
+        __UPDATE_RESULT(psbox, S_RESULT_IE);
+        __UPDATE_STATUS(psbox, S_STATUS_FIN);
+        UNLOCK(psbox);
+    }
+    
+    /* Final notification for the monitor threads to quit */
+    NOTIFY(psbox, NOTICE_EXIT);
+    
+    /* Join all monitor threads */
+    int idx, cnt;
+    for (i = idx = cnt = 0; i < (SBOX_MONITOR_MAX); i++)
+    {
+        if (psbox->ctrl.monitor[i].target == NULL)
+        {
+            continue;
+        }
+        ++idx;
+        if (pthread_join(psbox->ctrl.monitor[i].tid, NULL) != 0)
+        {
+            WARN("failed to join monitor thread #%d", idx);
+            if (pthread_cancel(psbox->ctrl.monitor[i].tid) != 0)
+            {
+                WARN("failed to cancel the %dth monitor thread", idx);
+                continue; /* continue to join the rest monitor threads */
+            }
+        }
+        ++cnt;
+    }
+    DBUG("joined %d of %d monitor threads", cnt, all);
+    
+    close(psbox->ctrl.notice.fd);
+    psbox->ctrl.notice.fd = -1;
+    
+    /* The capture thread is only started for sandboxes capturing output, and
+     * it may have quit before draining the capture pipe */
+    if (capturer < SBOX_MONITOR_MAX)
+    {
+        psbox->ctrl.monitor[capturer].target = NULL;
+    }
+    if (psbox->ctrl.capture.fd >= 0)
+    {
+        close(psbox->ctrl.capture.fd);
+        psbox->ctrl.capture.fd = -1;
+    }
+    if (psbox->ctrl.capture.efd >= 0)
+    {
+        close(psbox->ctrl.capture.efd);
+        psbox->ctrl.capture.efd = -1;
+    }
+    
+    /* Input left in the feeding pipe, or after the offset of the seekable 
+     * file, is not consumed by the prisoner process */
+    if (feeder < SBOX_MONITOR_MAX)
+    {
+        psbox->ctrl.monitor[feeder].target = NULL;
+    }
+    if (psbox->ctrl.feed.fd >= 0)
+    {
+        close(psbox->ctrl.feed.fd);
+        psbox->ctrl.feed.fd = -1;
+    }
+    if (psbox->ctrl.feed.rfd >= 0)
+    {
+        long long consumed = 0;
+        if (feed[1] >= 0)
+        {
+            const long pending = feed_pending(psbox->ctrl.feed.rfd);
+            consumed = (pending < 0) ? 0 : 
+                (psbox->stat.input.bytes - pending);
+        }
+        else
+        {
+            consumed = (long long)lseek(psbox->ctrl.feed.rfd, 0, SEEK_CUR);
+        }
+        consumed = (consumed < 0) ? 0 : consumed;
+        consumed = (consumed > psbox->stat.input.bytes) ? 
+            psbox->stat.input.bytes : consumed;
+        psbox->stat.input.consumed = consumed;
+        close(psbox->ctrl.feed.rfd);
+        psbox->ctrl.feed.rfd = -1;
+    }
+    
+    if (psbox->ctrl.listener >= 0)
+    {
+        close(psbox->ctrl.listener);
+        psbox->ctrl.listener = -1;
+    }
+    
+    /* Restore the affinity of current thread and release reserved cpu's */
+    if (bound)
+    {
+        cpu_restore(psbox->ctrl.tracer.tid, &affinity);
+    }
+    if (psbox->task.cpu.prisoner != SBOX_CPU_ANY)
+    {
+        cpu_release(pplace->prisoner);
+    }
+    if (psbox->task.cpu.tracer == SBOX_CPU_AUTO)
+    {
+        cpu_release(pplace->tracer);
+    }
+    
+    /* Store the finished run into the result cache, unless it failed for 
+     * reasons other than the targeted program, or it exceeded a time or 
+     * memory quota, which depends on the load of the host as well */
+    LOCK(psbox, SH);
+    if (memo && IS_FINISHED(psbox) && (psbox->result != S_RESULT_IE) && 
+        (psbox->result != S_RESULT_BP) && (psbox->result != S_RESULT_TL) && 
+        (psbox->result != S_RESULT_ML))
+    {
+        __sandbox_memo_save(psbox, &slot);
+        __sandbox_memo_store(psbox->ctrl.memo, key, &slot);
+    }
+    UNLOCK(psbox);
+    
+    FUNC_RET("%p", &psbox->result);
+}
+
+int
+sandbox_execute_linked(sandbox_t * psbox, sandbox_t * ppeer, res_t grace)
+{
+    FUNC_BEGIN("%p,%p,%llu", psbox, ppeer, (unsigned long long)grace);
+    assert(psbox && ppeer);
+    
+    if ((psbox == NULL) || (ppeer == NULL) || (psbox == ppeer))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    /* Input fed by the library would stand in for the pipe from the peer */
+    LOCK(psbox, SH);
+    bool fed = (psbox->task.feed.data != NULL) || (psbox->task.feed.fd >= 0);
+    UNLOCK(psbox);
+    LOCK(ppeer, SH);
+    fed = fed || (ppeer->task.feed.data != NULL) || (ppeer->task.feed.fd >= 0);
+    UNLOCK(ppeer);
+    if (fed)
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    /* Create the pipes cross-connecting the pair of sandboxes, i.e. from the
+     * first to the second (fd[0]), and the other way round (fd[1]) */
+    int fd[2][2] = {{-1, -1}, {-1, -1}};
+    int k;
+    for (k = 0; k < 2; k++)
+    {
+        if ((pipe(fd[k]) != 0) || 
+            (fcntl(fd[k][0], F_SETFD, FD_CLOEXEC) != 0) || 
+            (fcntl(fd[k][1], F_SETFD, FD_CLOEXEC) != 0))
+        {
+            WARN("failed to create pipe for linking sandboxes");
+            close(fd[0][0]);
+            close(fd[0][1]);
+            close(fd[1][0]);
+            close(fd[1][1]);
+            FUNC_RET("%d", -1);
+        }
+    }
+    
+    /* The pipes stand in for the input and output channels of the tasks */
+    sandbox_t * const pair[2] = {psbox, ppeer};
+    int chan[2][2];
+    for (k = 0; k < 2; k++)
+    {
+        LOCK(pair[k], EX);
+        chan[k][0] = pair[k]->task.ifd;
+        chan[k][1] = pair[k]->task.ofd;
+        pair[k]->task.ifd = fd[1 - k][0];
+        pair[k]->task.ofd = fd[k][1];
+        pair[k]->ctrl.link.peer = pair[1 - k];
+        pair[k]->ctrl.link.fd = fd[1 - k][0];
+        pair[k]->ctrl.link.ofd = fd[k][1];
+        pair[k]->ctrl.link.pending = 0;
+        pair[k]->ctrl.link.grace = grace;
+        pair[k]->ctrl.link.deadline = SBOX_QUOTA_INF;
+        UNLOCK(pair[k]);
+    }
+    
+    /* Both sandboxes are checked here, such that neither is left waiting for
+     * the other to start. The peer runs on a runner thread (with all signals 
+     * blocked), while the calling thread runs the first sandbox. */
+    pthread_t runner;
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+    const bool res = sandbox_check(psbox) && sandbox_check(ppeer) && 
+        (pthread_create(&runner, NULL, __sandbox_link_runner, 
+                        (void *)ppeer) == 0);
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+    if (res)
+    {
+        sandbox_execute(psbox);
+        __sandbox_link_finish(psbox);
+        if (pthread_join(runner, NULL) != 0)
+        {
+            WARN("failed to join the runner thread");
+        }
+    }
+    else
+    {
+        WARN("failed to start the linked sandboxes");
+    }
+    
+    /* Bytes received are those sent by the peer, less those left unread */
+    for (k = 0; k < 2; k++)
+    {
+        LOCK(pair[k], EX);
+        close(pair[k]->ctrl.link.fd);
+        close(pair[k]->ctrl.link.ofd);
+        pair[k]->task.ifd = chan[k][0];
+        pair[k]->task.ofd = chan[k][1];
+        const res_t sent = pair[1 - k]->stat.link.sent;
+        const res_t unread = (res_t)pair[k]->ctrl.link.pending;
+        pair[k]->stat.link.received = (sent > unread) ? (sent - unread) : 0;
+        pair[k]->ctrl.link.peer = NULL;
+        pair[k]->ctrl.link.fd = -1;
+        pair[k]->ctrl.link.ofd = -1;
+        pair[k]->ctrl.link.pending = 0;
+        pair[k]->ctrl.link.grace = SBOX_QUOTA_INF;
+        pair[k]->ctrl.link.deadline = SBOX_QUOTA_INF;
+        UNLOCK(pair[k]);
+    }
+    
+    FUNC_RET("%d", res ? 0 : -1);
+}
+
+bool
+sandbox_fs_enforced(void)
+{
+    FUNC_BEGIN();
+    FUNC_RET("%d", (fs_abi() > 0));
+}
+
+/* Count the leading strings of a NULL-terminated array that fit into 
+ * SBOX_ARG_MAX bytes, and sum up their sizes */
+static size_t
+__sandbox_comm_count(const char * strv[], size_t * psize)
+{
+    size_t cnt = 0;
+    *psize = 0;
+    if (strv != NULL)
+    {
+        while (strv[cnt] != NULL)
+        {
+            size_t delta = strlen(strv[cnt]) + 1;
+            if (*psize + delta >= SBOX_ARG_MAX)
+            {
+                break;
+            }
+            *psize += delta;
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+static bool
+__sandbox_comm_init(command_t * pcomm, const char * argv[], 
+                    const char * envp[])
+{
+    FUNC_BEGIN("%p,%p,%p", pcomm, argv, envp);
+    assert(pcomm);              /* argv, envp could be NULL */
+    
+    /* Layout of the arena: args[argc + 1], envs[envc + 1], then the strings
+     * pointed to by both arrays */
+    size_t argsz, envsz;
+    const size_t argc = __sandbox_comm_count(argv, &argsz);
+    const size_t envc = __sandbox_comm_count(envp, &envsz);
+    const size_t ptrsz = sizeof(char *) * (argc + envc + 2);
+    
+    char ** arena = (char **)malloc(ptrsz + argsz + envsz);
+    if (arena == NULL)
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    char * buff = (char *)arena + ptrsz;
+    size_t i;
+    pcomm->args = arena;
+    for (i = 0; i < argc; i++)
+    {
+        pcomm->args[i] = strcpy(buff, argv[i]);
+        buff += strlen(buff) + 1;
+    }
+    pcomm->args[argc] = NULL;
+    pcomm->envs = arena + argc + 1;
+    for (i = 0; i < envc; i++)
+    {
+        pcomm->envs[i] = strcpy(buff, envp[i]);
+        buff += strlen(buff) + 1;
+    }
+    pcomm->envs[envc] = NULL;
+    
+    FUNC_RET("%d", true);
+}
+
+static void
+__sandbox_comm_fini(command_t * pcomm)
+{
+    PROC_BEGIN("%p", pcomm);
+    assert(pcomm);
+    
+    free(pcomm->args);
+    pcomm->args = NULL;
+    pcomm->envs = NULL;
+    
+    PROC_END();
+}
+
+static bool 
+__sandbox_task_init(task_t * ptask, const char * argv[], const char * envp[])
+{
+    FUNC_BEGIN("%p,%p,%p", ptask, argv, envp);
+    assert(ptask);              /* argv, envp could be NULL */
+    
+    memset(ptask, 0, sizeof(task_t));
+    
+    if (!__sandbox_comm_init(&ptask->comm, argv, envp))
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    strcpy(ptask->jail, "/");
+    ptask->uid = getuid();
+    ptask->gid = getgid();
+    ptask->ifd = STDIN_FILENO;
+    ptask->ofd = STDOUT_FILENO;
+    ptask->efd = STDERR_FILENO;
+    ptask->quota[S_QUOTA_WALLCLOCK] = SBOX_QUOTA_INF;
+    ptask->quota[S_QUOTA_CPU] = SBOX_QUOTA_INF;
+    ptask->quota[S_QUOTA_MEMORY] = SBOX_QUOTA_INF;
+    ptask->quota[S_QUOTA_DISK] = SBOX_QUOTA_INF;
+    ptask->cpu.prisoner = SBOX_CPU_ANY;
+    ptask->cpu.tracer = SBOX_CPU_ANY;
+    int i;
+    for (i = 0; i < SBOX_FS_MAX; i++)
+    {
+        ptask->fs.path[i] = -1;
+        ptask->fs.access[i] = S_FS_NONE;
+    }
+    ptask->fs.buff[0] = '\0';
+    ptask->trust = S_TRUST_NONE;
+    ptask->ns = S_NS_NONE;
+    ptask->image.readonly = false;
+    ptask->image.prog[0] = '\0';
+    ptask->image.scratch[0] = '\0';
+    ptask->image.size = 0;
+    ptask->xfd = -1;
+    ptask->capture.enabled = false;
+    ptask->capture.compare = S_COMPARE_NONE;
+    ptask->capture.answer = -1;
+    ptask->capture.epsilon = 1e-6;
+    ptask->capture.sha256 = false;
+    ptask->feed.data = NULL;
+    ptask->feed.fd = -1;
+    ptask->feed.offset = 0;
+    ptask->feed.size = -1;
+    ptask->feed.seekable = false;
+    FUNC_RET("%d", true);
+}
+
+static char **
+__sandbox_task_argv(const task_t * ptask)
+{
+    FUNC_BEGIN("%p", ptask);
+    assert(ptask);
+    
+    int argc = 0;
+    while (ptask->comm.args[argc] != NULL)
+    {
+        argc++;
+    }
+    
+    char ** argv = (char **)malloc(sizeof(char *) * (argc + 1));
+    if (argv == NULL)
+    {
+        FUNC_RET("%p", (char **)NULL);
+    }
+    
+    memcpy(argv, ptask->comm.args, sizeof(char *) * argc);
+    if ((argc > 0) && (strcmp(ptask->jail, "/") != 0))
+    {
+        argv[0] += strlen(ptask->jail);
+    }
+    argv[argc] = NULL;
+    
+    FUNC_RET("%p", argv);
+}
+
+static void 
+__sandbox_task_fini(task_t * ptask)
+{
+    PROC_BEGIN("%p", ptask);
+    assert(ptask);
+    
+    __sandbox_comm_fini(&ptask->comm);
+    
+    PROC_END();
+}
+
+static bool
+__sandbox_task_check(const task_t * ptask)
+{
+    FUNC_BEGIN("%p", ptask);
+    assert(ptask);
+    
+    /* 1. check static fields, unless the task is instantiated from a template
+     * and the program file is unchanged since the template was validated
+     */
+    stamp_t stamp;
+    if ((ptask->stamp.ino == 0) || !__sandbox_task_stamp(ptask, &stamp) || 
+        (memcmp(&stamp, &ptask->stamp, sizeof(stamp_t)) != 0))
+    {
+        if (!__sandbox_task_check_spec(ptask))
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    DBUG("passed static specification test");
+    
+    struct stat s;
+    
+    /* 2. check ifd, ofd, efd are existing file descriptors
+     *   a) if ifd is readable by current user
+     *   b) if ofd and efd are writable by current user
+     */
+    if ((fstat(ptask->ifd, &s) < 0) || !(S_ISCHR(s.st_mode) || 
+         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode) || S_ISSOCK(s.st_mode)))
+    {
+        FUNC_RET("%d", false);
+    }
+    if (!((S_IRUSR & s.st_mode) && (s.st_uid == getuid())) && 
+        !((S_IRGRP & s.st_mode) && (s.st_gid == getgid())) && 
+        !(S_IROTH & s.st_mode) && !(getuid() == (uid_t)0))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed input channel validity test");
+    
+    if ((fstat(ptask->ofd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
+         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode) || S_ISSOCK(s.st_mode)))
+    {
+        FUNC_RET("%d", false);
+    }
+    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) && 
+        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) && 
+        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed output channel validity test");
+    
+    if ((fstat(ptask->efd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
+         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode) || S_ISSOCK(s.st_mode)))
+    {
+        FUNC_RET("%d", false);
+    }
+    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) && 
+        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) && 
+        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed error channel validity test");
+    
+    /* 3. check cpu field
+     *   a) if the prisoner cpu is an allowed cpu or SBOX_CPU_{ANY,AUTO}
+     *   b) if the tracer cpu is an allowed cpu or SBOX_CPU_{ANY,AUTO}
+     */
+    if ((ptask->cpu.prisoner < SBOX_CPU_AUTO) || 
+        (ptask->cpu.tracer < SBOX_CPU_AUTO) || 
+        ((ptask->cpu.prisoner >= 0) && !cpu_allowed(ptask->cpu.prisoner)) ||
+        ((ptask->cpu.tracer >= 0) && !cpu_allowed(ptask->cpu.tracer)))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed cpu placement test");
+    
+    /* 4. check capture field
+     *   a) if the comparison mode is one of S_COMPARE_*
+     *   b) if output is compared, the answer file is a readable regular file
+     *   c) if the float tolerance is non-negative (and not a nan)
+     */
+    if (ptask->capture.enabled)
+    {
+        if ((ptask->capture.compare != S_COMPARE_NONE) && 
+            (ptask->capture.compare != S_COMPARE_BYTE) && 
+            (ptask->capture.compare != S_COMPARE_TOKEN) && 
+            (ptask->capture.compare != S_COMPARE_NOCASE) && 
+            (ptask->capture.compare != S_COMPARE_FLOAT))
+        {
+            FUNC_RET("%d", false);
+        }
+        if ((ptask->capture.compare != S_COMPARE_NONE) && 
+            ((ptask->capture.answer < 0) || 
+             (fstat(ptask->capture.answer, &s) < 0) || !S_ISREG(s.st_mode) ||
+             ((fcntl(ptask->capture.answer, F_GETFL) & O_ACCMODE) == 
+              O_WRONLY)))
+        {
+            FUNC_RET("%d", false);
+        }
+        if (!(ptask->capture.epsilon >= 0))
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    DBUG("passed output capture test");
+    
+    /* 5. check feed field
+     *   a) if at most one of the memory buffer and the file is specified
+     *   b) if the memory buffer has a non-negative size
+     *   c) if the file is a readable regular file, with a non-negative offset
+     */
+    if ((ptask->feed.data != NULL) && (ptask->feed.fd >= 0))
+    {
+        FUNC_RET("%d", false);
+    }
+    if ((ptask->feed.data != NULL) && (ptask->feed.size < 0))
+    {
+        FUNC_RET("%d", false);
+    }
+    if ((ptask->feed.fd >= 0) && 
+        ((fstat(ptask->feed.fd, &s) < 0) || !S_ISREG(s.st_mode) || 
+         ((fcntl(ptask->feed.fd, F_GETFL) & O_ACCMODE) == O_WRONLY) || 
+         (ptask->feed.offset < 0) || (ptask->feed.size < -1)))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed input feeding test");
+    
+    FUNC_RET("%d", true);
+}
+
+static bool
+__sandbox_task_stamp(const task_t * ptask, stamp_t * pstamp)
+{
+    FUNC_BEGIN("%p,%p", ptask, pstamp);
+    assert(ptask && pstamp);
+    
+    /* Stamps are compared with memcmp(), zero the padding bytes (if any) */
+    memset(pstamp, 0, sizeof(stamp_t));
+    
+    /* The executable file, or the program file bound into the jail image (if
+     * any) is stamped instead of the program path */
+    const char * prog = (ptask->image.prog[0] != '\0') ? 
+        (ptask->image.prog) : (ptask->comm.args[0]);
+    struct stat s;
+    if ((ptask->xfd >= 0) ? (fstat(ptask->xfd, &s) < 0) : 
+        ((prog == NULL) || (stat(prog, &s) < 0)))
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    pstamp->dev = s.st_dev;
+    pstamp->ino = s.st_ino;
+    pstamp->mtime = s.st_mtim;
+    pstamp->ctime = s.st_ctim;
+    
+    FUNC_RET("%d", true);
+}
+
+static bool
+__sandbox_task_check_spec(const task_t * ptask)
+{
+    FUNC_BEGIN("%p", ptask);
+    assert(ptask);
     
     /* 1. check uid, gid fields
      *   a) if user exists
@@ -456,491 +2054,2631 @@ __sandbox_task_check(const task_t * ptask)
     struct passwd * pw = NULL;
     if ((pw = getpwuid(ptask->uid)) == NULL)
     {
-        FUNC_RET("%d", false);
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed user identity test");
+    
+    struct group * gr = NULL;
+    if ((gr = getgrgid(ptask->gid)) == NULL)
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed group identity test");
+    
+    if ((getuid() != (uid_t)0) && ((getuid() != ptask->uid) || 
+                                   (getgid() != ptask->gid)))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed set{uid,gid} privilege test");
+    
+    struct stat s;
+    
+    /* 2. check comm field (or the executable file, or the program file bound 
+     * into the jail image)
+     *   a) if program file is an existing regular file
+     *   b) if program file is executable by the specified user
+     *   c) if the executable file is neither a standard channel, nor combined
+     *      with a program file bound into the jail image
+     */
+#ifdef HAVE_EXECVEAT
+    if ((ptask->xfd >= 0) && ((ptask->xfd <= STDERR_FILENO) || 
+        (ptask->image.prog[0] != '\0')))
+#else
+    if (ptask->xfd >= 0)
+#endif /* HAVE_EXECVEAT */
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    const char * prog = (ptask->image.prog[0] != '\0') ? 
+        (ptask->image.prog) : (ptask->comm.args[0]);
+    if ((ptask->comm.args[0] == NULL) || ((ptask->xfd >= 0) ? 
+        (fstat(ptask->xfd, &s) < 0) : (stat(prog, &s) < 0)) || 
+        !S_ISREG(s.st_mode))
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    if (!((S_IXUSR & s.st_mode) && (s.st_uid == ptask->uid)) && 
+        !((S_IXGRP & s.st_mode) && (s.st_gid == ptask->gid)) && 
+        !(S_IXOTH & s.st_mode) && !(ptask->uid == (uid_t)0))
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    DBUG("passed permission test of the targeted program");
+    
+    /* 3. check jail field (if jail is not "/")
+     *   a) only super user can chroot!
+     *   b) if jail path is accessible and readable
+     *   c) if jail is a prefix to the targeted program command line
+     */
+    if (strcmp(ptask->jail, "/") != 0)
+    {
+        if (getuid() != (uid_t)0)
+        {
+            FUNC_RET("%d", false);
+        }
+        if (access(ptask->jail, X_OK | R_OK) < 0)
+        {
+            FUNC_RET("%d", false);
+        }
+        if ((stat(ptask->jail, &s) < 0) || !S_ISDIR(s.st_mode))
+        {
+            FUNC_RET("%d", false);
+        }
+        if (strstr(ptask->comm.args[0], ptask->jail) != ptask->comm.args[0])
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    DBUG("passed jail validity test");
+    
+    /* 4. check fs field
+     *   a) if each path is an absolute path within the buffer
+     *   b) if each access type is a valid fs_access_t
+     *   c) if no S_FS_NONE path lies beneath a granted path
+     *   d) if a non-empty allow-list can be enforced by the running kernel
+     */
+    int i, j;
+    for (i = 0; (i < SBOX_FS_MAX) && (ptask->fs.path[i] >= 0); i++)
+    {
+        if ((ptask->fs.path[i] >= SBOX_PATH_MAX) || 
+            (ptask->fs.buff[ptask->fs.path[i]] != '/') || 
+            (memchr(ptask->fs.buff + ptask->fs.path[i], '\0', 
+                SBOX_PATH_MAX - ptask->fs.path[i]) == NULL))
+        {
+            FUNC_RET("%d", false);
+        }
+        if ((ptask->fs.access[i] != S_FS_NONE) && 
+            (ptask->fs.access[i] != S_FS_READ) && 
+            (ptask->fs.access[i] != S_FS_WRITE))
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    for (i = 0; (i < SBOX_FS_MAX) && (ptask->fs.path[i] >= 0); i++)
+    {
+        if (ptask->fs.access[i] != S_FS_NONE)
+        {
+            continue;
+        }
+        const char * path = ptask->fs.buff + ptask->fs.path[i];
+        for (j = 0; (j < SBOX_FS_MAX) && (ptask->fs.path[j] >= 0); j++)
+        {
+            const char * base = ptask->fs.buff + ptask->fs.path[j];
+            size_t len = strlen(base);
+            if ((ptask->fs.access[j] != S_FS_NONE) && 
+                (strncmp(path, base, len) == 0) && ((base[len - 1] == '/') || 
+                 (path[len] == '\0') || (path[len] == '/')))
+            {
+                FUNC_RET("%d", false);
+            }
+        }
+    }
+    if ((ptask->fs.path[0] >= 0) && !sandbox_fs_enforced())
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed filesystem allow-list test");
+    
+    /* 5. check trust field
+     *   a) if the trust level is a valid trust_t
+     *   b) if trusted tasks can be watched without ptrace on this platform
+     */
+#ifdef HAVE_PIDFD
+    if ((ptask->trust != S_TRUST_NONE) && (ptask->trust != S_TRUST_FULL))
+#else
+    if (ptask->trust != S_TRUST_NONE)
+#endif /* HAVE_PIDFD */
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed trust level test");
+    
+    /* 6. check ns field
+     *   a) if the bitmask is made of valid ns_type_t
+     *   b) if namespaces are available on this platform
+     *   c) only super user can create namespaces without a user namespace
+     */
+#ifdef HAVE_NAMESPACE
+    if ((ptask->ns & ~S_NS_ALL) != 0)
+#else
+    if (ptask->ns != S_NS_NONE)
+#endif /* HAVE_NAMESPACE */
+    {
+        FUNC_RET("%d", false);
+    }
+    if ((ptask->ns != S_NS_NONE) && !(ptask->ns & S_NS_USER) && 
+        (getuid() != (uid_t)0))
+    {
+        FUNC_RET("%d", false);
+    }
+    DBUG("passed namespace test");
+    
+    /* 7. check image field (if any)
+     *   a) if the jail image is set up in a fresh mount namespace
+     *   b) if the scratch path is an absolute path to a directory in the jail
+     *   c) if the program mount point is an existing file in the jail image, 
+     *      or a missing file right in the scratch path, where it is created
+     */
+    if (ptask->image.readonly || (ptask->image.prog[0] != '\0') || 
+        (ptask->image.scratch[0] != '\0'))
+    {
+        if (!(ptask->ns & S_NS_MOUNT) || (strcmp(ptask->jail, "/") == 0))
+        {
+            FUNC_RET("%d", false);
+        }
+        if (ptask->image.scratch[0] != '\0')
+        {
+            char path[SBOX_PATH_MAX * 2];
+            snprintf(path, sizeof(path), "%s%s", ptask->jail, 
+                ptask->image.scratch);
+            if ((ptask->image.scratch[0] != '/') || (stat(path, &s) < 0) || 
+                !S_ISDIR(s.st_mode))
+            {
+                FUNC_RET("%d", false);
+            }
+        }
+        if ((ptask->image.prog[0] != '\0') && 
+            (lstat(ptask->comm.args[0], &s) < 0))
+        {
+            /* The parent of a missing mount point must be the scratch path
+             * itself, i.e. the same directory regardless of dots and links */
+            char path[SBOX_PATH_MAX * 2];
+            char * sep = NULL;
+            struct stat t;
+            snprintf(path, sizeof(path), "%s%s", ptask->jail, 
+                ptask->image.scratch);
+            if ((errno != ENOENT) || (ptask->image.scratch[0] == '\0') || 
+                (stat(path, &t) < 0))
+            {
+                FUNC_RET("%d", false);
+            }
+            snprintf(path, sizeof(path), "%s", ptask->comm.args[0]);
+            if (((sep = strrchr(path, '/')) == NULL) || (sep[1] == '\0'))
+            {
+                FUNC_RET("%d", false);
+            }
+            *sep = '\0';
+            if ((stat(path, &s) < 0) || (s.st_dev != t.st_dev) || 
+                (s.st_ino != t.st_ino))
+            {
+                FUNC_RET("%d", false);
+            }
+        }
+        else if ((ptask->image.prog[0] != '\0') && !S_ISREG(s.st_mode))
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    DBUG("passed jail image test");
+    
+    FUNC_RET("%d", true);
+}
+
+static int
+__sandbox_task_spawned(void * arg)
+{
+    FUNC_BEGIN("%p", arg);
+    assert(arg);
+    
+    /* The prisoner process may share the memory of the process running 
+     * libsandbox, so the lock of the sandbox must be left untouched */
+    DBUG("entering: the prisoner process");
+    const prisoner_t * const pprisoner = (const prisoner_t *)arg;
+    if ((pprisoner->cpu >= 0) && !cpu_bind_proc(0, pprisoner->cpu))
+    {
+        FUNC_RET("%d", EXIT_FAILURE);
+    }
+    
+    /* Start executing the targeted program */
+    FUNC_RET("%d", __sandbox_task_execute(pprisoner->ptask, pprisoner->pfilter,
+        pprisoner->argv, pprisoner->chan, pprisoner->parent));
+}
+
+static int
+__sandbox_task_execute(task_t * ptask, const filter_t * pfilter, 
+                       char * const argv[], int chan, pid_t parent)
+{
+    FUNC_BEGIN("%p,%p,%p,%d,%d", ptask, pfilter, argv, chan, parent);
+    assert(ptask && pfilter && argv);
+    
+    /* Run the prisoner process in a separate process group */
+    if (setsid() < 0)
+    {
+        WARN("failed to set session id");
+        return EXIT_FAILURE;
+    }
+    
+    /* Close fd's not used by the targeted program */
+    int fd;
+    for (fd = 0; fd < FILENO_MAX; fd++)
+    {
+        if ((fd == ptask->ifd) || (fd == ptask->ofd) || (fd == ptask->efd) || 
+            (fd == ptask->xfd) || (fd == chan))
+        {
+            continue;
+        }
+        close(fd);
+    }
+    
+    /* Redirect I/O channel */
+    
+    if (dup2(ptask->efd, STDERR_FILENO) < 0)
+    {
+        WARN("failed to redirect error channel");
+        return EXIT_FAILURE;
+    }
+    DBUG("dup2: %d->%d", ptask->efd, STDERR_FILENO);
+    
+    if (dup2(ptask->ofd, STDOUT_FILENO) < 0)
+    {
+        WARN("failed to redirect output channel(s)");
+        return EXIT_FAILURE;
+    }
+    DBUG("dup2: %d->%d", ptask->ofd, STDOUT_FILENO);
+    
+    if (dup2(ptask->ifd, STDIN_FILENO) < 0)
+    {
+        WARN("failed to redirect input channel(s)");
+        return EXIT_FAILURE;
+    }
+    DBUG("dup2: %d->%d", ptask->ifd, STDIN_FILENO);
+    
+    /* Apply security restrictions and resource limits */
+    int res = __sandbox_task_confine(ptask, parent);
+    if (res != EXIT_SUCCESS)
+    {
+        return res;
+    }
+    
+    FUNC_RET("%d", __sandbox_task_launch(ptask, pfilter, argv, chan, false));
+}
+
+static int
+__sandbox_task_confine(const task_t * ptask, pid_t parent)
+{
+    FUNC_BEGIN("%p,%d", ptask, parent);
+    assert(ptask);
+    
+    /* Apply security restrictions */
+    
+    if ((ptask->ns != S_NS_NONE) && 
+        !ns_enter(ptask->ns, ptask->uid, ptask->gid, ptask->jail))
+    {
+        WARN("failed to enter namespaces");
+        return EXIT_FAILURE;
+    }
+    
+    const bool imaged = ptask->image.readonly || 
+        (ptask->image.prog[0] != '\0') || (ptask->image.scratch[0] != '\0');
+    if (imaged && !ns_mount_jail(ptask->jail, ptask->image.readonly, 
+        ptask->image.scratch, ptask->image.size, ptask->image.prog, 
+        ptask->comm.args[0]))
+    {
+        WARN("failed to set up jail image");
+        return EXIT_FAILURE;
+    }
+    
+    /* In a fresh mount namespace, the mount tree of the host is detached, as
+     * opposed to being hidden by chroot() */
+    if ((strcmp(ptask->jail, "/") != 0) && (ptask->ns & S_NS_MOUNT))
+    {
+        if (!ns_pivot_jail(ptask->jail, imaged))
+        {
+            WARN("failed to pivot to jail directory");
+            return EXIT_FAILURE;
+        }
+        DBUG("jail: \"%s\"", ptask->jail);
+    }
+    else if (strcmp(ptask->jail, "/") != 0)
+    {
+        if (chdir(ptask->jail) < 0)
+        {
+            WARN("failed to chdir() to jail directory");
+            return EXIT_FAILURE;
+        }
+        if (chroot(".") < 0)
+        {
+            WARN("failed to chroot() to jail directory");
+            return EXIT_FAILURE;
+        }
+        DBUG("jail: \"%s\"", ptask->jail);
+    }
+    
+    /* Restrict filesystem access to the allow-list, the targeted program is
+     * never executed with an allow-list the kernel cannot enforce */
+    if (ptask->fs.path[0] >= 0)
+    {
+        const char * paths[SBOX_FS_MAX];
+        int modes[SBOX_FS_MAX];
+        int n = 0;
+        while ((n < SBOX_FS_MAX) && (ptask->fs.path[n] >= 0))
+        {
+            paths[n] = ptask->fs.buff + ptask->fs.path[n];
+            modes[n] = ptask->fs.access[n];
+            n++;
+        }
+        if (!fs_restrict(paths, modes, n))
+        {
+            WARN("failed to restrict filesystem access");
+            return EXIT_FAILURE;
+        }
+        DBUG("restricted filesystem access beneath %d path(s)", n);
+    }
+    
+    /* Change identity before executing the targeted program. The calling
+     * process may share memory with a multithreaded host, so the setxid
+     * wrappers of glibc, which signal all threads of the host, are avoided */
+    
+    if (!proc_setid(ptask->uid, ptask->gid))
+    {
+        WARN("failed to change identity");
+        return EXIT_FAILURE;
+    }
+    DBUG("setid: %lu,%lu", (unsigned long)ptask->uid, 
+        (unsigned long)ptask->gid);
+    
+#ifdef PR_SET_PDEATHSIG
+    /* Termination signals are not intercepted by libsandbox, so the prisoner
+     * process should not outlive the tracer in case the process running 
+     * libsandbox is killed. The death signal must be set after changing 
+     * identity, because setuid() clears it. */
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) != 0)
+    {
+        WARN("failed to set parent death signal");
+        return EXIT_FAILURE;
+    }
+    DBUG("PR_SET_PDEATHSIG: %d", SIGKILL);
+    
+    /* The parent may have died before the death signal was set, in which case
+     * the prisoner process has been reparented, and would never get it */
+    if (getppid() != parent)
+    {
+        WARN("parent died before setting the death signal");
+        return EXIT_FAILURE;
+    }
+#endif /* PR_SET_PDEATHSIG */
+    
+    FUNC_RET("%d", __sandbox_task_limit(ptask));
+}
+
+static int
+__sandbox_task_limit(const task_t * ptask)
+{
+    FUNC_BEGIN("%p", ptask);
+    assert(ptask);
+    
+    /* Output quota is applied through the *setrlimit*. Because we might have 
+     * already changed identity by this time, the hard limits should remain as 
+     * they were. Thus we must invoke a *getrlimit* ahead of time to load 
+     * original hard resource limit. */
+    struct rlimit rlimval;
+    
+    /* Do NOT produce core dump files at all. */
+    if (getrlimit(RLIMIT_CORE, &rlimval) != 0)
+    {
+        WARN("failed to getrlimit(RLIMIT_CORE)");
+        return EXIT_FAILURE;
+    }
+    rlimval.rlim_cur = 0;
+    if (setrlimit(RLIMIT_CORE, &rlimval) != 0)
+    {
+        WARN("failed to setrlimit(RLIMIT_CORE)");
+        return EXIT_FAILURE;
+    }
+    DBUG("RLIMIT_CORE: %ld", rlimval.rlim_cur);
+     
+    /* Disk quota (bytes) */
+    if (getrlimit(RLIMIT_FSIZE, &rlimval) != 0)
+    {
+        WARN("failed to getrlimit(RLIMIT_FSIZE)");
+        return EXIT_FAILURE;
+    }
+    rlimval.rlim_cur = ptask->quota[S_QUOTA_DISK];
+    if (setrlimit(RLIMIT_FSIZE, &rlimval) != 0)
+    {
+        WARN("failed to setrlimit(RLIMIT_FSIZE)");
+        return EXIT_FAILURE;
+    }
+    DBUG("RLIMIT_FSIZE: %ld", rlimval.rlim_cur);
+    
+#ifdef DELETED
+    /* Memory quota (bytes) */
+    if (getrlimit(RLIMIT_AS, &rlimval) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    rlimval.rlim_cur = ptask->quota[S_QUOTA_MEMORY];
+    if (setrlimit(RLIMIT_AS, &rlimval) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    DBUG("RLIMIT_AS: %ld", rlimval.rlim_cur);
+#endif /* DELETED */
+    
+#ifdef DELETED
+    /* CPU quota */
+    struct itimerval itv;
+    itv.it_interval.tv_sec = 0;
+    itv.it_interval.tv_usec = 0;
+    itv.it_value.tv_sec = ptask->quota[S_QUOTA_CPU] / 1000;
+    itv.it_value.tv_usec = (ptask->quota[S_QUOTA_CPU] % 1000) * 1000;
+    if (setitimer(ITIMER_PROF, &itv, NULL) < 0)
+    {
+        WARN("failed to setitimer(ITIMER_PROF)");
+        return EXIT_FAILURE;
+    }
+#endif /* DELETED */
+    
+#ifdef HAVE_PIDFD
+    /* Trusted programs are neither traced nor filtered. Besides the sampling 
+     * of the profiler thread, the cpu quota is backed by RLIMIT_CPU, rounded
+     * up to the next second after the quota, such that the profiler usually 
+     * reports it first. */
+    if ((ptask->trust == S_TRUST_FULL) && 
+        (ptask->quota[S_QUOTA_CPU] != SBOX_QUOTA_INF))
+    {
+        if (getrlimit(RLIMIT_CPU, &rlimval) != 0)
+        {
+            WARN("failed to getrlimit(RLIMIT_CPU)");
+            return EXIT_FAILURE;
+        }
+        const rlim_t sec = (ptask->quota[S_QUOTA_CPU] + 999) / 1000 + 1;
+        if ((rlimval.rlim_max == RLIM_INFINITY) || (sec < rlimval.rlim_max))
+        {
+            rlimval.rlim_cur = sec;
+        }
+        if (setrlimit(RLIMIT_CPU, &rlimval) != 0)
+        {
+            WARN("failed to setrlimit(RLIMIT_CPU)");
+            return EXIT_FAILURE;
+        }
+        DBUG("RLIMIT_CPU: %ld", rlimval.rlim_cur);
+    }
+#endif /* HAVE_PIDFD */
+    
+    FUNC_RET("%d", EXIT_SUCCESS);
+}
+
+static int
+__sandbox_task_launch(const task_t * ptask, const filter_t * pfilter, 
+                      char * const argv[], int chan, bool attached)
+{
+    FUNC_BEGIN("%p,%p,%p,%d,%d", ptask, pfilter, argv, chan, attached);
+    assert(ptask && pfilter && argv);
+    
+#ifndef NDEBUG
+    int argc = 0;
+    while (argv[argc] != NULL)
+    {
+        DBUG("argv[%d]: \"%s\"", argc, argv[argc]);
+        argc++;
+    }
+#endif /* NDEBUG */
+    
+    /* Unblock all signals for the prisoner process. */
+    sigset_t sigmask;
+    sigfillset(&sigmask);
+    if (pthread_sigmask(SIG_UNBLOCK, &sigmask, NULL) != 0)
+    {
+        WARN("pthread_sigmask");
+        return EXIT_FAILURE;
+    }
+    DBUG("unblocked all signals");
+    
+#ifdef HAVE_PIDFD
+    /* Without a tracer to intercept them, SIGXFSZ and SIGXCPU should terminate
+     * the prisoner process, even if ignored by the process running libsandbox
+     * (as is the case with python) */
+    if ((chan >= 0) || (ptask->trust == S_TRUST_FULL))
+    {
+        if ((signal(SIGXFSZ, SIG_DFL) == SIG_ERR) || 
+            (signal(SIGXCPU, SIG_DFL) == SIG_ERR))
+        {
+            WARN("failed to reset SIGXFSZ and SIGXCPU");
+            return EXIT_FAILURE;
+        }
+    }
+    
+    /* Trusted programs are neither traced nor filtered */
+    if (ptask->trust == S_TRUST_FULL)
+    {
+        goto execute;
+    }
+#endif /* HAVE_PIDFD */
+    
+#ifdef HAVE_SYSCALL_NOTIFY
+    /* Without ptrace, install the system call filter that delivers filtered
+     * system calls (or all, with an empty filter) to the watcher thread */
+    if (chan >= 0)
+    {
+        if (!trace_me_notified(pfilter->prog, pfilter->len, chan))
+        {
+            WARN("trace_me_notified");
+            return EXIT_FAILURE;
+        }
+        goto execute;
+    }
+#endif /* HAVE_SYSCALL_NOTIFY */
+    
+    /* Mark current process as traced, unless attached by the tracer */
+    if (!attached && !trace_me())
+    {
+        WARN("trace_me");
+        return EXIT_FAILURE;
+    }
+    
+#ifdef HAVE_SYSCALL_FILTER
+    /* Install the system call filter, if any */
+    if ((pfilter->len > 0) && !trace_me_filtered(pfilter->prog, pfilter->len))
+    {
+        WARN("trace_me_filtered");
+        return EXIT_FAILURE;
+    }
+#endif /* HAVE_SYSCALL_FILTER */
+    
+#ifdef HAVE_PIDFD
+execute:
+#endif /* HAVE_PIDFD */
+    
+    /* Execute the targeted program */
+    if (ptask->xfd >= 0)
+    {
+        proc_execfd(ptask->xfd, argv, ptask->comm.envs);
+        WARN("execveat() failed unexpectedly");
+        return errno;
+    }
+    if (execve(argv[0], argv, ptask->comm.envs) != 0)
+    {
+        WARN("execve() failed unexpectedly");
+        return errno;
+    }
+    
+    /* According to Linux manual, the execve() function will NEVER return on
+     * success, thus we should not be able to reach to this line of code! */
+    return EXIT_FAILURE;
+}
+
+static void *
+__sandbox_pool_spawner(void * arg)
+{
+    FUNC_BEGIN("%p", arg);
+    assert(arg);
+    
+    pool_t * const ppool = (pool_t *)arg;
+    
+    LOCK(ppool, EX);
+    const int i = ppool->started++;
+    UNLOCK(ppool);
+    
+    helper_t helper;            /* shared with the helper via proc_spawn() */
+    unsigned long spawned = 0;
+    
+    while (true)
+    {
+        /* Wait until the pool is closing, or the slot is vacant */
+        LOCK_ON_COND(ppool, EX, ppool->closing || ((ppool->slot[i].chan < 0) 
+            && (ppool->refill || (spawned == 0))));
+        if (ppool->closing)
+        {
+            UNLOCK(ppool);
+            break;
+        }
+        int sv[2] = {-1, -1};
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0)
+        {
+            UNLOCK(ppool);
+            WARN("failed to create hand-off socket");
+            struct timespec delay = {0, 100000000}; /* back off for 100ms */
+            nanosleep(&delay, NULL);
+            continue;
+        }
+        ppool->slot[i].pid = 0;
+        ppool->slot[i].chan = sv[0];
+        ppool->stat.spawned++;
+        UNLOCK(ppool);
+        
+        /* The calling thread is suspended by proc_spawn() until the helper 
+         * executes the targeted program, or exits */
+        memcpy(&helper.task, &ppool->tmpl, sizeof(task_t));
+        helper.argv = ppool->argv;
+        helper.sock = sv[1];
+        helper.parent = getpid();
+        const pid_t pid = proc_spawn(__sandbox_pool_helper, &helper, 
+            ns_clone_flags(helper.task.ns));
+        close(sv[1]);
+        ++spawned;
+        
+        LOCK(ppool, EX);
+        const bool taken = (ppool->slot[i].pid < 0);
+        if (!taken)
+        {
+            close(ppool->slot[i].chan);
+        }
+        ppool->slot[i].pid = 0;
+        ppool->slot[i].chan = -1;
+        const bool closing = ppool->closing;
+        UNLOCK(ppool);
+        
+        /* A helper not taken by any sandbox has either failed to park, or 
+         * is still parked where proc_spawn() does not suspend the caller */
+        if (!taken && (pid > 0))
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+            DBUG("dismissed helper %d", pid);
+            if (!closing)
+            {
+                struct timespec delay = {0, 100000000}; /* back off for 100ms */
+                nanosleep(&delay, NULL);
+            }
+        }
+    }
+    
+    FUNC_RET("%p", (void *)NULL);
+}
+
+static int
+__sandbox_pool_helper(void * arg)
+{
+    FUNC_BEGIN("%p", arg);
+    assert(arg);
+    
+    /* The helper may share the memory of the process running libsandbox, so
+     * it only touches its own arguments before execve() */
+    helper_t * const phelper = (helper_t *)arg;
+    task_t * const ptask = &phelper->task;
+    const int sock = phelper->sock;
+    
+    /* Run the helper process in a separate process group */
+    if (setsid() < 0)
+    {
+        WARN("failed to set session id");
+        return EXIT_FAILURE;
+    }
+    
+    /* Close fd's other than the hand-off socket and the executable file */
+    int fd;
+    for (fd = 0; fd < FILENO_MAX; fd++)
+    {
+        if ((fd != sock) && (fd != ptask->xfd))
+        {
+            close(fd);
+        }
+    }
+    
+    /* Apply security restrictions and resource limits of the template */
+    int res = __sandbox_task_confine(ptask, phelper->parent);
+    if (res != EXIT_SUCCESS)
+    {
+        return res;
+    }
+    
+    /* Report readiness, and park until handed over a sandbox, or dismissed */
+    const pid_t pid = getpid();
+    if (send(sock, &pid, sizeof(pid_t), MSG_NOSIGNAL) != sizeof(pid_t))
+    {
+        return EXIT_FAILURE;
+    }
+    handoff_t * const pmsg = &phelper->msg;
+    int fds[3] = {-1, -1, -1};
+    ssize_t len = fd_recv(sock, pmsg, sizeof(handoff_t), fds, 3);
+    if ((len < (ssize_t)offsetof(handoff_t, prog)) || 
+        (pmsg->len > SBOX_FILTER_MAX) || ((size_t)len != 
+        offsetof(handoff_t, prog) + pmsg->len * sizeof(pmsg->prog[0])))
+    {
+        DBUG("helper dismissed");
+        return EXIT_FAILURE;
+    }
+    
+    /* Redirect I/O channels, moving the received fd's out of the way of the
+     * standard ones first */
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        fd = fcntl(fds[i], F_DUPFD, STDERR_FILENO + 1);
+        close(fds[i]);
+        if ((fds[i] = fd) < 0)
+        {
+            WARN("failed to duplicate received channel");
+            return EXIT_FAILURE;
+        }
+    }
+    if ((dup2(fds[2], STDERR_FILENO) < 0) || 
+        (dup2(fds[1], STDOUT_FILENO) < 0) || 
+        (dup2(fds[0], STDIN_FILENO) < 0))
+    {
+        WARN("failed to redirect I/O channels");
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < 3; i++)
+    {
+        close(fds[i]);
+    }
+    
+    /* Apply the quota of the sandbox, if different from the template */
+    if (memcmp(ptask->quota, pmsg->quota, sizeof(pmsg->quota)) != 0)
+    {
+        memcpy(ptask->quota, pmsg->quota, sizeof(pmsg->quota));
+        if ((res = __sandbox_task_limit(ptask)) != EXIT_SUCCESS)
+        {
+            return res;
+        }
+    }
+    
+    /* The tracer has attached to the helper before the hand-off */
+    const filter_t filter = {pmsg->len, pmsg->prog};
+    FUNC_RET("%d", __sandbox_task_launch(ptask, &filter, phelper->argv, -1, 
+        true));
+}
+
+static bool
+__sandbox_pool_parked(pool_t * ppool, int i)
+{
+    FUNC_BEGIN("%p,%d", ppool, i);
+    assert(ppool && (i >= 0) && (i < SBOX_POOL_MAX));
+    
+    /* Collect the pid reported by the helper, the caller holds the lock */
+    if ((ppool->slot[i].chan >= 0) && (ppool->slot[i].pid == 0))
+    {
+        pid_t pid = 0;
+        if ((recv(ppool->slot[i].chan, &pid, sizeof(pid_t), MSG_DONTWAIT) == 
+            sizeof(pid_t)) && (pid > 0))
+        {
+            ppool->slot[i].pid = pid;
+        }
+    }
+    
+    FUNC_RET("%d", (ppool->slot[i].chan >= 0) && (ppool->slot[i].pid > 0));
+}
+
+static bool
+__sandbox_task_match(const task_t * ptmpl, const task_t * ptask)
+{
+    FUNC_BEGIN("%p,%p", ptmpl, ptask);
+    assert(ptmpl && ptask);
+    
+    if ((ptask->stamp.ino == 0) || 
+        (memcmp(&ptask->stamp, &ptmpl->stamp, sizeof(stamp_t)) != 0) || 
+        (ptask->uid != ptmpl->uid) || (ptask->gid != ptmpl->gid) || 
+        (ptask->trust != ptmpl->trust) || (ptask->ns != ptmpl->ns) || 
+        (ptask->xfd != ptmpl->xfd) || 
+        (strcmp(ptask->jail, ptmpl->jail) != 0) || 
+        (memcmp(&ptask->fs, &ptmpl->fs, sizeof(filesys_t)) != 0) || 
+        (memcmp(&ptask->image, &ptmpl->image, sizeof(image_t)) != 0))
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    int i;
+    for (i = 0; (ptask->comm.args[i] != NULL) && 
+                (ptmpl->comm.args[i] != NULL); i++)
+    {
+        if (strcmp(ptask->comm.args[i], ptmpl->comm.args[i]) != 0)
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    if (ptask->comm.args[i] != ptmpl->comm.args[i])
+    {
+        FUNC_RET("%d", false);
+    }
+    for (i = 0; (ptask->comm.envs[i] != NULL) && 
+                (ptmpl->comm.envs[i] != NULL); i++)
+    {
+        if (strcmp(ptask->comm.envs[i], ptmpl->comm.envs[i]) != 0)
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    
+    FUNC_RET("%d", (ptask->comm.envs[i] == ptmpl->comm.envs[i]));
+}
+
+static pid_t
+__sandbox_pool_take(pool_t * ppool, const task_t * ptask, 
+                    const filter_t * pfilter, bool traced, int cpu)
+{
+    FUNC_BEGIN("%p,%p,%p,%d,%d", ppool, ptask, pfilter, traced, cpu);
+    assert(ppool && ptask && pfilter);
+    
+    /* Only tasks with the same static fields as the template of the pool are
+     * handed over to its helpers */
+    if (!__sandbox_task_match(&ppool->tmpl, ptask) || 
+        (traced && (pfilter->len > SBOX_FILTER_MAX)))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    LOCK(ppool, EX);
+    pid_t pid = -1;
+    int chan = -1;
+    int i;
+    for (i = 0; !ppool->closing && (i < ppool->size); i++)
+    {
+        if (__sandbox_pool_parked(ppool, i))
+        {
+            pid = ppool->slot[i].pid;
+            chan = ppool->slot[i].chan;
+            ppool->slot[i].pid = -1;
+            ppool->slot[i].chan = -1;
+            break;
+        }
+    }
+    if (pid < 0)
+    {
+        ppool->stat.miss++;
+        UNLOCK(ppool);
+        FUNC_RET("%d", -1);
+    }
+    UNLOCK(ppool);
+    
+    /* Only the used part of the filter is sent */
+    const unsigned short n = (traced) ? (pfilter->len) : (0);
+    const size_t len = offsetof(handoff_t, prog) + 
+        n * sizeof(((handoff_t *)NULL)->prog[0]);
+    handoff_t * const pmsg = (handoff_t *)malloc(len);
+    const int fds[3] = {ptask->ifd, ptask->ofd, ptask->efd};
+    if (pmsg != NULL)
+    {
+        memcpy(pmsg->quota, ptask->quota, sizeof(pmsg->quota));
+        pmsg->len = n;
+        memcpy(pmsg->prog, pfilter->prog, n * sizeof(pmsg->prog[0]));
+    }
+    
+    /* Attach to the helper before releasing it, such that the tracer takes 
+     * over from the execve() of the targeted program on */
+    const bool res = (pmsg != NULL) && (!traced || trace_attach(pid)) && 
+        ((cpu < 0) || cpu_bind_proc(pid, cpu)) && 
+        fd_send(chan, pmsg, len, fds, 3);
+    free(pmsg);
+    
+    /* As with proc_spawn(), wait until the helper has executed the targeted 
+     * program, which closes its end of the hand-off socket, unless it stops
+     * itself for the watcher to install the filter */
+    if (res && (n == 0))
+    {
+        char c;
+        while ((recv(chan, &c, sizeof(c), 0) < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+    }
+    close(chan);
+    if (!res)
+    {
+        WARN("failed to hand over to helper %d", pid);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        pid = -1;
+    }
+    
+    LOCK(ppool, EX);
+    if (res)
+    {
+        ppool->stat.hit++;
+    }
+    else
+    {
+        ppool->stat.miss++;
+    }
+    UNLOCK(ppool);
+    
+    FUNC_RET("%d", pid);
+}
+
+static void *
+__sandbox_server_runner(void * arg)
+{
+    FUNC_BEGIN("%p", arg);
+    assert(arg);
+    
+    server_t * const pserver = (server_t *)arg;
+    
+    /* The master sandbox finishes as the master process exits, or is killed
+     * by sandbox_server_fini() */
+    sandbox_execute(&pserver->sbox);
+    
+    LOCK(pserver, EX);
+    pserver->parked = false;
+    UNLOCK(pserver);
+    
+    FUNC_RET("%p", (void *)NULL);
+}
+
+static void *
+__sandbox_link_runner(void * arg)
+{
+    FUNC_BEGIN("%p", arg);
+    assert(arg);
+    
+    sandbox_t * const psbox = (sandbox_t *)arg;
+    
+    sandbox_execute(psbox);
+    __sandbox_link_finish(psbox);
+    
+    FUNC_RET("%p", (void *)NULL);
+}
+
+static void
+__sandbox_link_finish(sandbox_t * psbox)
+{
+    PROC_BEGIN("%p", psbox);
+    assert(psbox);
+    
+    /* The peer sees the end of its input, once the capture thread relaying
+     * the output to the peer is joined */
+    LOCK(psbox, EX);
+    sandbox_t * const ppeer = (sandbox_t *)psbox->ctrl.link.peer;
+    const int fd = psbox->ctrl.link.fd;
+    const res_t grace = psbox->ctrl.link.grace;
+    close(psbox->ctrl.link.ofd);
+    psbox->ctrl.link.ofd = -1;
+    UNLOCK(psbox);
+    
+    /* Input left in the pipe from the peer is not received. It is counted 
+     * after the readable end is closed (such that the peer can no longer 
+     * write), if the writable end is still held by the peer. */
+    LOCK(ppeer, EX);
+    long pending;
+    if (ppeer->ctrl.link.ofd >= 0)
+    {
+        close(fd);
+        pending = feed_pending(ppeer->ctrl.link.ofd);
+    }
+    else
+    {
+        pending = feed_pending(fd);
+        close(fd);
+    }
+    
+    /* The peer is killed as exceeding its wallclock quota, unless finished 
+     * within the grace time */
+    if ((grace != SBOX_QUOTA_INF) && !IS_FINISHED(ppeer))
+    {
+        const res_t deadline = (res_t)ts2ms(ppeer->stat.elapsed) + grace;
+        if (deadline < ppeer->ctrl.link.deadline)
+        {
+            ppeer->ctrl.link.deadline = deadline;
+        }
+    }
+    UNLOCK(ppeer);
+    
+    LOCK(psbox, EX);
+    psbox->ctrl.link.fd = -1;
+    psbox->ctrl.link.pending = (pending > 0) ? pending : 0;
+    UNLOCK(psbox);
+    
+    PROC_END();
+}
+
+#ifdef HAVE_TRACE_FORK
+static bool
+__sandbox_server_point(long sc, unsigned long fd)
+{
+    FUNC_BEGIN("%ld,%lu", sc, fd);
+    
+    /* Parking on a standard channel, the copies re-enter the system call on
+     * their own I/O channels */
+    if (fd > STDERR_FILENO)
+    {
+        FUNC_RET("%d", false);
+    }
+    
+    switch (sc)
+    {
+    case SC_READ:
+    case SC_READV:
+    case SC_PREAD64:
+    case SC_WRITE:
+    case SC_WRITEV:
+    case SC_PWRITE64:
+    case SC_LSEEK:
+    case SC_FSTAT:
+    case SC_NEWFSTATAT:
+    case SC_IOCTL:
+    case SC_FCNTL:
+    case SC_CLOSE:
+    case SC_DUP:
+    case SC_DUP2:
+    case SC_DUP3:
+        FUNC_RET("%d", true);
+    default:
+        break;
+    }
+    
+    FUNC_RET("%d", false);
+}
+
+static bool
+__sandbox_server_park(sandbox_t * psbox, const proc_t * pproc)
+{
+    FUNC_BEGIN("%p,%p", psbox, pproc);
+    assert(psbox && pproc);
+    
+    server_t * const pserver = psbox->ctrl.server;
+    
+    LOCK(pserver, EX);
+    bool res = !pserver->closing;
+    if (res)
+    {
+        memcpy(pserver->point, pproc, sizeof(proc_t));
+        res = trace_park(pproc, &pserver->sigmask);
+    }
+    pserver->parked = res;
+    UNLOCK(pserver);
+    
+    if (!res)
+    {
+        WARN("failed to park the master process: %d", pproc->pid);
+    }
+    
+    FUNC_RET("%d", res);
+}
+
+static void
+__sandbox_server_wait(sandbox_t * psbox, pid_t pid)
+{
+    PROC_BEGIN("%p,%d", psbox, pid);
+    assert(psbox && (pid > 0));
+    
+    server_t * const pserver = psbox->ctrl.server;
+    
+    /* The parked master process is attached by the tracers of copies from
+     * time to time, so it is watched with a pidfd rather than waitid(), which
+     * would steal the ptrace stops reported to those tracers */
+    const int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd >= 0)
+    {
+        struct pollfd pfd = {pidfd, POLLIN, 0};
+        while ((poll(&pfd, 1, -1) < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        close(pidfd);
+    }
+    else
+    {
+        WARN("failed to open pidfd of process: %d", pid);
+    }
+    
+    LOCK(pserver, EX);
+    pserver->parked = false;
+    UNLOCK(pserver);
+    
+    if (pidfd < 0)
+    {
+        kill(-pid, SIGKILL);
+    }
+    
+    /* Having served its purpose, the master sandbox finishes without passing
+     * the exit of the master process to the policy */
+    siginfo_t info;
+    while ((waitid(P_PID, pid, &info, WEXITED) != 0) && (errno == EINTR))
+    {
+        continue;
+    }
+    LOCK(psbox, EX);
+    if (info.si_code == CLD_EXITED)
+    {
+        psbox->stat.exitcode = info.si_status;
+    }
+    else
+    {
+        psbox->stat.signal.signo = info.si_status;
+        psbox->stat.signal.code = info.si_code;
+    }
+    __UPDATE_RESULT(psbox, S_RESULT_OK);
+    UNLOCK(psbox);
+    
+    PROC_END();
+}
+
+static pid_t
+__sandbox_server_fork(server_t * pserver, const task_t * ptask, int cpu)
+{
+    FUNC_BEGIN("%p,%p,%d", pserver, ptask, cpu);
+    assert(pserver && ptask);
+    
+    /* Only tasks with the same static fields as the template of the server 
+     * are served by copies of the master process */
+    if (!__sandbox_task_match(&pserver->sbox.task, ptask))
+    {
+        FUNC_RET("%d", -1);
+    }
+    
+    LOCK(pserver, EX);
+    if (!pserver->parked)
+    {
+        pserver->stat.miss++;
+        UNLOCK(pserver);
+        FUNC_RET("%d", -1);
+    }
+    
+    /* The I/O channels of the sandbox are queued on the hand-off socket, and
+     * then received by the copy in place of those of the master process */
+    const char c = 0;
+    const int fds[3] = {ptask->ifd, ptask->ofd, ptask->efd};
+    pid_t pid = -1;
+    if (fd_send(pserver->chan[0], &c, sizeof(c), fds, 3))
+    {
+        pid = trace_fork((const proc_t *)pserver->point, pserver->sigmask);
+    }
+    if (pid < 0)
+    {
+        /* Drop the message if still queued, and stop serving, as the master
+         * process may have been left in an unknown state */
+        WARN("failed to fork the master process");
+        char buf;
+        while (recv(pserver->chan[1], &buf, sizeof(buf), MSG_DONTWAIT) >= 0)
+        {
+            continue;
+        }
+        pserver->parked = false;
+        pserver->stat.miss++;
+        UNLOCK(pserver);
+        FUNC_RET("%d", -1);
+    }
+    pserver->stat.hit++;
+    UNLOCK(pserver);
+    
+    /* The copy inherits the resource limits of the master process, except 
+     * the disk quota which is specific to the sandbox */
+    struct rlimit rlimval;
+    bool res = (syscall(SYS_prlimit64, pid, RLIMIT_FSIZE, NULL, 
+                        &rlimval) == 0);
+    rlimval.rlim_cur = ptask->quota[S_QUOTA_DISK];
+    res = res && (syscall(SYS_prlimit64, pid, RLIMIT_FSIZE, &rlimval, 
+                          NULL) == 0) && 
+        ((cpu < 0) || cpu_bind_proc(pid, cpu));
+    if (!res)
+    {
+        WARN("failed to apply limits to process: %d", pid);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        pid = -1;
+    }
+    
+    FUNC_RET("%d", pid);
+}
+#endif /* HAVE_TRACE_FORK */
+
+static void 
+__sandbox_stat_init(stat_t * pstat)
+{
+    PROC_BEGIN("%p", pstat);
+    assert(pstat);
+    
+    memset(pstat, 0, sizeof(stat_t));
+    pstat->placement.prisoner = SBOX_CPU_ANY;
+    pstat->placement.tracer = SBOX_CPU_ANY;
+    pstat->output.mismatch = -1;
+    
+    PROC_END();
+}
+
+static void 
+__sandbox_stat_update(sandbox_t * psbox, const proc_t * pproc)
+{
+    PROC_BEGIN("%p,%p", psbox, pproc);
+    assert(psbox && pproc);
+    
+    const struct timespec ZERO = {0, 0};
+    struct timespec ts = ZERO;
+    bool exceeded = false;
+    
+    LOCK(psbox, EX);
+    
+    /* mem_info */
+    #define MEM_UPDATE(a,b) \
+    {{{ \
+        (a) = (b); \
+        (a ## _peak) = (((a ## _peak) > (a)) ? (a ## _peak) : (a)); \
+    }}} /* MEM_UPDATE */
+    
+    MEM_UPDATE(psbox->stat.mem_info.vsize, pproc->vsize);
+    MEM_UPDATE(psbox->stat.mem_info.rss, pproc->rss * getpagesize());
+    psbox->stat.mem_info.minflt = pproc->minflt;
+    psbox->stat.mem_info.majflt = pproc->majflt;
+    
+    /* cpu_info */
+    ts = ZERO;
+    TS_INPLACE_ADD(ts, pproc->utime);
+    TS_INPLACE_ADD(ts, pproc->stime);
+    TS_UPDATE(psbox->stat.cpu_info.clock, ts);
+    TS_UPDATE(psbox->stat.cpu_info.utime, pproc->utime);
+    TS_UPDATE(psbox->stat.cpu_info.stime, pproc->stime);
+    
+    /* wallclock */
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    {
+        UNLOCK(psbox);
+        MONITOR_ERROR(psbox, "failed to get wallclock time");
+        PROC_END();
     }
-    DBUG("passed user identity test");
     
-    struct group * gr = NULL;
-    if ((gr = getgrgid(ptask->gid)) == NULL)
+    /* Update the elapsed time stat of sandbox, also update the walllock
+     * started time if it is not set already. */
+    if (!TS_LESS(ZERO, psbox->stat.started))
     {
-        FUNC_RET("%d", false);
+        psbox->stat.started = ts;
+        psbox->stat.elapsed = ZERO;
+    }
+    else
+    {
+        TS_INPLACE_SUB(ts, psbox->stat.started);
+        TS_UPDATE(psbox->stat.elapsed, ts);
     }
-    DBUG("passed group identity test");
     
-    if ((getuid() != (uid_t)0) && ((getuid() != ptask->uid) || 
-                                   (getgid() != ptask->gid)))
+    UNLOCK(psbox);
+    
+    /* Compare peak memory usage against memory quota limit */
+    LOCK(psbox, SH);
+    if (psbox->stat.mem_info.vsize_peak > \
+        psbox->task.quota[S_QUOTA_MEMORY])
     {
-        FUNC_RET("%d", false);
+        DBUG("memory quota exceeded");
+        UNLOCK(psbox);
+        POST_EVENT(psbox, _QUOTA, S_QUOTA_MEMORY);
+        exceeded = true;
+    }
+    else
+    {
+        UNLOCK(psbox);
     }
-    DBUG("passed set{uid,gid} privilege test");
     
-    struct stat s;
+    /* Compare cpu clock time against cpu quota limit */
+    LOCK(psbox, SH);
+    if ((res_t)ts2ms(psbox->stat.cpu_info.clock) > \
+        psbox->task.quota[S_QUOTA_CPU])
+    {
+        DBUG("cpu quota exceeded");
+        UNLOCK(psbox);
+        POST_EVENT(psbox, _QUOTA, S_QUOTA_CPU);
+        exceeded = true;
+    }
+    else
+    {
+        UNLOCK(psbox);
+    }
     
-    /* 2. check comm field
-     *   a) if program file is an existing regular file
-     *   b) if program file is executable by the specified user
-     */
-    if ((stat(ptask->comm.buff, &s) < 0) || !S_ISREG(s.st_mode))
+    /* Compare elapsed time against wallclock quota limit, and the deadline 
+     * after the linked sandbox has finished */
+    LOCK(psbox, SH);
+    if (((res_t)ts2ms(psbox->stat.elapsed) > 
+         psbox->task.quota[S_QUOTA_WALLCLOCK]) || 
+        ((res_t)ts2ms(psbox->stat.elapsed) > psbox->ctrl.link.deadline))
     {
-        FUNC_RET("%d", false);
+        DBUG("wallclock quota exceeded");
+        UNLOCK(psbox);
+        POST_EVENT(psbox, _QUOTA, S_QUOTA_WALLCLOCK);
+        exceeded = true;
+    }
+    else
+    {
+        UNLOCK(psbox);
     }
     
-    if (!((S_IXUSR & s.st_mode) && (s.st_uid == ptask->uid)) && 
-        !((S_IXGRP & s.st_mode) && (s.st_gid == ptask->gid)) && 
-        !(S_IXOTH & s.st_mode) && !(ptask->uid == (uid_t)0))
+    /* Stop targeted program to force event handling */
+    if (exceeded)
+    {
+        trace_kill(pproc, SIGSTOP);
+        trace_kill(pproc, SIGCONT);
+    }
+    
+    PROC_END();
+}
+
+static void 
+__sandbox_stat_fini(stat_t * pstat)
+{
+    PROC_BEGIN("%p", pstat);
+    assert(pstat);
+    
+    /* TODO */
+    
+    PROC_END();
+}
+
+static void 
+__sandbox_ctrl_init(ctrl_t * pctrl, thread_func_t tft)
+{
+    PROC_BEGIN("%p,%p", pctrl, tft);
+    assert(pctrl && tft);
+    
+    memset(pctrl, 0, sizeof(ctrl_t));
+    
+    pctrl->policy.entry = (void *)sandbox_default_policy;
+    pctrl->policy.data = 0L;
+    pctrl->filter.len = 0;
+    pctrl->filter.prog = NULL;
+    pctrl->backend = S_BACKEND_PTRACE;
+    pctrl->listener = -1;
+    pctrl->capture.fd = -1;
+    pctrl->capture.efd = -1;
+    pctrl->capture.exited = false;
+    pctrl->feed.fd = -1;
+    pctrl->feed.rfd = -1;
+    pctrl->feed.size = 0;
+    pctrl->link.peer = NULL;
+    pctrl->link.fd = -1;
+    pctrl->link.ofd = -1;
+    pctrl->link.pending = 0;
+    pctrl->link.grace = SBOX_QUOTA_INF;
+    pctrl->link.deadline = SBOX_QUOTA_INF;
+    pctrl->memo = NULL;
+    pctrl->profile.data = NULL;
+    pctrl->profile.size = 0;
+    memset(pctrl->monitor, 0, (SBOX_MONITOR_MAX) * sizeof(worker_t));
+    memset(&pctrl->tracer, 0, sizeof(worker_t));
+    pctrl->tracer.target = tft;
+    pctrl->notice.fd = -1;
+    __QUEUE_CLEAR(pctrl);
+    
+    PROC_END();
+}
+
+static void 
+__sandbox_ctrl_fini(ctrl_t * pctrl)
+{
+    PROC_BEGIN("%p", pctrl);
+    assert(pctrl);
+    
+    __QUEUE_CLEAR(pctrl);
+    pctrl->tracer.target = NULL;
+    memset(&pctrl->tracer, 0, sizeof(worker_t));
+    memset(pctrl->monitor, 0, (SBOX_MONITOR_MAX) * sizeof(worker_t));
+    
+    PROC_END();
+}
+
+static int
+__sandbox_ctrl_add_monitor(ctrl_t * pctrl, thread_func_t tfm)
+{
+    FUNC_BEGIN("%p,%p", pctrl, tfm);
+    assert(pctrl && tfm);
+    
+    int i;
+    for (i = 0; i < (SBOX_MONITOR_MAX); i++)
+    {
+        if (pctrl->monitor[i].target == NULL)
+        {
+            pctrl->monitor[i].target = tfm;
+            break;
+        }
+    }
+    
+    FUNC_RET("%d", i);
+}
+
+/* Slots for the same scinfo are probed linearly from its hash */
+#define __CACHE_HASH(scinfo) \
+    ((int)((((unsigned long)(scinfo)) * 2654435761UL) >> 7) & \
+        ((SBOX_CACHE_MAX) - 1)) \
+/* __CACHE_HASH */
+
+static bool
+__sandbox_cache_lookup(const cache_t * cache, const event_t * pevent, 
+                       action_t * paction)
+{
+    FUNC_BEGIN("%p,%p,%p", cache, pevent, paction);
+    assert(cache && pevent && paction);
+    
+    if (pevent->type != S_EVENT_SYSCALL)
     {
         FUNC_RET("%d", false);
     }
     
-    DBUG("passed permission test of the targeted program");
+    const long * args = &pevent->data._SYSCALL.a;
+    const long scinfo = pevent->data._SYSCALL.scinfo;
+    const int h = __CACHE_HASH(scinfo);
     
-    /* 3. check jail field (if jail is not "/")
-     *   a) only super user can chroot!
-     *   b) if jail path is accessible and readable
-     *   c) if jail is a prefix to the targeted program command line
-     */
-    if (strcmp(ptask->jail, "/") != 0)
+    int i, j;
+    for (i = 0; i < SBOX_CACHE_PROBE; i++)
     {
-        if (getuid() != (uid_t)0)
+        const cache_t * pslot = &cache[(h + i) & ((SBOX_CACHE_MAX) - 1)];
+        if (pslot->mask == 0)
         {
-            FUNC_RET("%d", false);
+            break;
         }
-        if (access(ptask->jail, X_OK | R_OK) < 0)
+        if (pslot->key[0] != scinfo)
         {
-            FUNC_RET("%d", false);
+            continue;
         }
-        if ((stat(ptask->jail, &s) < 0) || !S_ISDIR(s.st_mode))
+        for (j = 0; j < 6; j++)
         {
-            FUNC_RET("%d", false);
+            if ((pslot->mask & (1 << j)) && (pslot->key[j + 1] != args[j]))
+            {
+                break;
+            }
         }
-        if (strstr(ptask->comm.buff, ptask->jail) != ptask->comm.buff)
+        if (j == 6)
         {
-            FUNC_RET("%d", false);
+            *paction = pslot->action;
+            FUNC_RET("%d", true);
         }
     }
-    DBUG("passed jail validity test");
     
-    /* 4. check ifd, ofd, efd are existing file descriptors
-     *   a) if ifd is readable by current user
-     *   b) if ofd and efd are writable by current user
-     */
-    if ((fstat(ptask->ifd, &s) < 0) || !(S_ISCHR(s.st_mode) || 
-         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    FUNC_RET("%d", false);
+}
+
+static void
+__sandbox_cache_store(cache_t * cache, const event_t * pevent, 
+                      const action_t * paction)
+{
+    PROC_BEGIN("%p,%p,%p", cache, pevent, paction);
+    assert(cache && pevent && paction);
+    
+    /* Only continuations of system calls are cacheable */
+    if ((pevent->type != S_EVENT_SYSCALL) || 
+        ((paction->type != S_ACTION_CONT) && 
+         (paction->type != S_ACTION_CONT_NORET)) || 
+        !(paction->data._CONT.cache & S_CACHE_SCINFO))
     {
-        FUNC_RET("%d", false);
+        PROC_END();
     }
-    if (!((S_IRUSR & s.st_mode) && (s.st_uid == getuid())) && 
-        !((S_IRGRP & s.st_mode) && (s.st_gid == getgid())) && 
-        !(S_IROTH & s.st_mode) && !(getuid() == (uid_t)0))
+    
+    const long * args = &pevent->data._SYSCALL.a;
+    const long scinfo = pevent->data._SYSCALL.scinfo;
+    const int h = __CACHE_HASH(scinfo);
+    
+    /* Decisions are dropped if all slots for the scinfo are occupied */
+    int i, j;
+    for (i = 0; i < SBOX_CACHE_PROBE; i++)
+    {
+        cache_t * pslot = &cache[(h + i) & ((SBOX_CACHE_MAX) - 1)];
+        if (pslot->mask != 0)
+        {
+            continue;
+        }
+        pslot->mask = paction->data._CONT.cache;
+        pslot->key[0] = scinfo;
+        for (j = 0; j < 6; j++)
+        {
+            pslot->key[j + 1] = (pslot->mask & (1 << j)) ? args[j] : 0;
+        }
+        pslot->action = *paction;
+        DBUG("cached decision for scinfo %ld in slot %d", scinfo, 
+            (h + i) & ((SBOX_CACHE_MAX) - 1));
+        break;
+    }
+    
+    PROC_END();
+}
+
+static bool
+__sandbox_match_init(matcher_t * pm, int answer, compare_t mode, 
+    double epsilon)
+{
+    FUNC_BEGIN("%p,%d,%d,%g", pm, answer, mode, epsilon);
+    assert(pm);
+    
+    memset(pm, 0, sizeof(matcher_t));
+    pm->mode = mode;
+    pm->epsilon = epsilon;
+    if (mode == S_COMPARE_NONE)
+    {
+        FUNC_RET("%d", true);
+    }
+    
+    /* An empty answer file cannot be mapped, nor does it need to be */
+    struct stat s;
+    if (fstat(answer, &s) < 0)
     {
         FUNC_RET("%d", false);
     }
-    DBUG("passed input channel validity test");
+    pm->size = (size_t)s.st_size;
+    if (pm->size == 0)
+    {
+        FUNC_RET("%d", true);
+    }
     
-    if ((fstat(ptask->ofd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
-         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    void * addr = mmap(NULL, pm->size, PROT_READ, MAP_PRIVATE, answer, 0);
+    if (addr == MAP_FAILED)
     {
         FUNC_RET("%d", false);
     }
-    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) && 
-        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) && 
-        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    madvise(addr, pm->size, MADV_SEQUENTIAL);
+    pm->answer = (const char *)addr;
+    
+    FUNC_RET("%d", true);
+}
+
+static size_t
+__sandbox_match_span(const char * p, size_t n, bool space)
+{
+    /* Length of the leading run of whitespace (or non-whitespace) bytes, the
+     * bytes are classified 16 at a time where sse2 is available */
+    size_t i = 0;
+    
+#ifdef __SSE2__
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i ht = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8('\r' - '\t');
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+        /* '\t' to '\r' are consecutive, which is an unsigned range check */
+        const __m128i t = _mm_sub_epi8(c, ht);
+        const __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(c, sp), 
+            _mm_cmpeq_epi8(_mm_min_epu8(t, range), t));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(ws);
+        if (space)
+        {
+            mask = ~mask & 0xffff;
+        }
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif /* __SSE2__ */
+    
+    while ((i < n) && ((bool)__IS_SPACE(p[i]) == space))
+    {
+        i++;
+    }
+    return i;
+}
+
+static size_t
+__sandbox_match_diff(const char * a, const char * b, size_t n, bool nocase)
+{
+    /* Length of the common prefix of two buffers, optionally ignoring ascii
+     * case, a matching run is confirmed by memcmp() at memory bandwidth */
+    size_t i = 0;
+    
+    if ((n == 0) || (!nocase && (memcmp(a, b, n) == 0)))
+    {
+        return n;
+    }
+    
+#ifdef __SSE2__
+    const __m128i upper = _mm_set1_epi8('A');
+    const __m128i range = _mm_set1_epi8('Z' - 'A');
+    const __m128i bit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        if (nocase)
+        {
+            __m128i t = _mm_sub_epi8(x, upper);
+            x = _mm_or_si128(x, _mm_and_si128(bit, 
+                _mm_cmpeq_epi8(_mm_min_epu8(t, range), t)));
+            t = _mm_sub_epi8(y, upper);
+            y = _mm_or_si128(y, _mm_and_si128(bit, 
+                _mm_cmpeq_epi8(_mm_min_epu8(t, range), t)));
+        }
+        const unsigned int mask = 
+            ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xffff;
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif /* __SSE2__ */
+    
+    if (nocase)
+    {
+        while ((i < n) && (__TO_LOWER(a[i]) == __TO_LOWER(b[i])))
+        {
+            i++;
+        }
+        return i;
+    }
+    while ((i < n) && (a[i] == b[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+static bool
+__sandbox_match_number(const char * out, size_t olen, const char * ans, 
+    size_t alen, double epsilon)
+{
+    FUNC_BEGIN("%p,%zu,%p,%zu,%g", out, olen, ans, alen, epsilon);
+    assert(out && ans);
+    
+    if ((olen == alen) && (memcmp(out, ans, olen) == 0))
+    {
+        FUNC_RET("%d", true);
+    }
+    if ((olen == 0) || (alen == 0) || (olen >= SBOX_TOKEN_MAX) || 
+        (alen >= SBOX_TOKEN_MAX))
     {
         FUNC_RET("%d", false);
     }
-    DBUG("passed output channel validity test");
     
-    if ((fstat(ptask->efd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
-         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    /* Only decimal notations count as numbers, i.e. no nan, inf or hex */
+    char token[2][SBOX_TOKEN_MAX];
+    double value[2];
+    int k;
+    for (k = 0; k < 2; k++)
+    {
+        const char * src = (k == 0) ? out : ans;
+        const size_t len = (k == 0) ? olen : alen;
+        size_t i;
+        for (i = 0; i < len; i++)
+        {
+            const char c = src[i];
+            if (!(((c >= '0') && (c <= '9')) || (c == '.') || (c == 'e') || 
+                  (c == 'E') || (c == '+') || (c == '-')))
+            {
+                FUNC_RET("%d", false);
+            }
+            token[k][i] = c;
+        }
+        token[k][len] = '\0';
+        char * end = NULL;
+        value[k] = strtod(token[k], &end);
+        if (end != token[k] + len)
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    
+    /* Absolute or relative error within the tolerance, which rules out nan's
+     * resulting from overflown values */
+    const double error = (value[0] > value[1]) ? (value[0] - value[1]) : 
+        (value[1] - value[0]);
+    const double scale = (value[1] < 0) ? -value[1] : value[1];
+    
+    FUNC_RET("%d", (error <= epsilon) || (error <= epsilon * scale));
+}
+
+static bool
+__sandbox_match_hold(matcher_t * pm, long long offset)
+{
+    FUNC_BEGIN("%p,%lld", pm, offset);
+    assert(pm);
+    
+    /* Rewind to the start of the current token, whose prefix is common to 
+     * the output and the answer, and hold it for numeric comparison */
+    size_t h = 0;
+    if (pm->token)
     {
-        FUNC_RET("%d", false);
+        while ((h < pm->pos) && !__IS_SPACE(pm->answer[pm->pos - h - 1]))
+        {
+            h++;
+        }
     }
-    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) && 
-        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) && 
-        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    pm->pos -= h;
+    pm->start = offset - (long long)h;
+    pm->alen = __sandbox_match_span(pm->answer + pm->pos, 
+        pm->size - pm->pos, false);
+    pm->token = true;
+    pm->hold = true;
+    
+    /* Missing tokens and overlong ones are no numbers at all */
+    if ((pm->alen == 0) || (pm->alen >= SBOX_TOKEN_MAX))
     {
         FUNC_RET("%d", false);
     }
-    DBUG("passed error channel validity test");
+    memcpy(pm->held, pm->answer + pm->pos, h);
+    pm->hlen = h;
     
     FUNC_RET("%d", true);
 }
 
-static int
-__sandbox_task_execute(task_t * ptask)
+static bool
+__sandbox_match_close(matcher_t * pm)
 {
-    FUNC_BEGIN("%p", ptask);
-    assert(ptask);
+    FUNC_BEGIN("%p", pm);
+    assert(pm && pm->hold);
     
-    /* Run the prisoner process in a separate process group */
-    if (setsid() < 0)
+    const bool res = __sandbox_match_number(pm->held, pm->hlen, 
+        pm->answer + pm->pos, pm->alen, pm->epsilon);
+    pm->pos += pm->alen;
+    pm->token = false;
+    pm->hold = false;
+    
+    FUNC_RET("%d", res);
+}
+
+static long long
+__sandbox_match_feed(matcher_t * pm, const char * buff, size_t len)
+{
+    FUNC_BEGIN("%p,%p,%zu", pm, buff, len);
+    assert(pm && buff);
+    
+    /* Returns the offset of the first mismatch in the captured output, or -1
+     * if the buffer matches the answer so far */
+    const bool nocase = (pm->mode == S_COMPARE_NOCASE);
+    const long long seen = pm->seen;
+    size_t i = 0;
+    
+    pm->seen += len;
+    
+    if (pm->mode == S_COMPARE_NONE)
     {
-        WARN("failed to set session id");
-        return EXIT_FAILURE;
+        FUNC_RET("%lld", -1LL);
     }
     
-    /* Close fd's not used by the targeted program */
-    int fd;
-    for (fd = 0; fd < FILENO_MAX; fd++)
+    if (pm->mode == S_COMPARE_BYTE)
+    {
+        const size_t n = (len < pm->size - pm->pos) ? len : 
+            (pm->size - pm->pos);
+        i = __sandbox_match_diff(buff, pm->answer + pm->pos, n, false);
+        pm->pos += i;
+        /* Output beyond the end of the answer is a mismatch by itself */
+        FUNC_RET("%lld", (i < len) ? (seen + (long long)i) : -1LL);
+    }
+    
+    while (i < len)
     {
-        if ((fd == ptask->ifd) || (fd == ptask->ofd) || (fd == ptask->efd))
+        size_t n;
+        
+        /* A held token of S_COMPARE_FLOAT is compared as it ends */
+        if (pm->hold)
         {
+            n = __sandbox_match_span(buff + i, len - i, false);
+            if (pm->hlen + n >= SBOX_TOKEN_MAX)
+            {
+                FUNC_RET("%lld", pm->start);
+            }
+            memcpy(pm->held + pm->hlen, buff + i, n);
+            pm->hlen += n;
+            i += n;
+            if ((i < len) && !__sandbox_match_close(pm))
+            {
+                FUNC_RET("%lld", pm->start);
+            }
             continue;
         }
-        close(fd);
+        
+        /* Runs of output identical to the answer need no tokenization */
+        n = (len - i < pm->size - pm->pos) ? (len - i) : 
+            (pm->size - pm->pos);
+        n = __sandbox_match_diff(buff + i, pm->answer + pm->pos, n, nocase);
+        if (n > 0)
+        {
+            pm->token = !__IS_SPACE(buff[i + n - 1]);
+            pm->pos += n;
+            i += n;
+        }
+        if (i == len)
+        {
+            break;
+        }
+        
+        /* Where the output diverges from the answer, whitespace on either 
+         * side is skipped unless it cuts a token short */
+        const bool space = __IS_SPACE(buff[i]);
+        const bool aspace = (pm->pos < pm->size) && 
+            __IS_SPACE(pm->answer[pm->pos]);
+        if (space && !(pm->token && (pm->pos < pm->size) && !aspace))
+        {
+            i += __sandbox_match_span(buff + i, len - i, true);
+            pm->pos += __sandbox_match_span(pm->answer + pm->pos, 
+                pm->size - pm->pos, true);
+            pm->token = false;
+            continue;
+        }
+        if (!space && !pm->token && aspace)
+        {
+            pm->pos += __sandbox_match_span(pm->answer + pm->pos, 
+                pm->size - pm->pos, true);
+            continue;
+        }
+        
+        /* Mismatching tokens, unless they are numerically close */
+        if ((pm->mode != S_COMPARE_FLOAT) || 
+            !__sandbox_match_hold(pm, seen + (long long)i))
+        {
+            FUNC_RET("%lld", (pm->mode == S_COMPARE_FLOAT) ? pm->start : 
+                (seen + (long long)i));
+        }
     }
     
-    /* Redirect I/O channel */
+    FUNC_RET("%lld", -1LL);
+}
+
+static long long
+__sandbox_match_end(matcher_t * pm)
+{
+    FUNC_BEGIN("%p", pm);
+    assert(pm);
     
-    if (dup2(ptask->efd, STDERR_FILENO) < 0)
+    /* Returns the offset of the mismatch at the end of the output, or -1 if 
+     * the answer is exhausted as well */
+    if (pm->mode == S_COMPARE_NONE)
     {
-        WARN("failed to redirect error channel");
-        return EXIT_FAILURE;
+        FUNC_RET("%lld", -1LL);
     }
-    DBUG("dup2: %d->%d", ptask->efd, STDERR_FILENO);
     
-    if (dup2(ptask->ofd, STDOUT_FILENO) < 0)
+    if (pm->mode != S_COMPARE_BYTE)
     {
-        WARN("failed to redirect output channel(s)");
-        return EXIT_FAILURE;
+        /* The last token of the output may be cut short */
+        if (!pm->hold && pm->token && (pm->pos < pm->size) && 
+            !__IS_SPACE(pm->answer[pm->pos]))
+        {
+            if ((pm->mode != S_COMPARE_FLOAT) || 
+                !__sandbox_match_hold(pm, pm->seen))
+            {
+                FUNC_RET("%lld", (pm->mode == S_COMPARE_FLOAT) ? pm->start :
+                    pm->seen);
+            }
+        }
+        if (pm->hold && !__sandbox_match_close(pm))
+        {
+            FUNC_RET("%lld", pm->start);
+        }
+        pm->pos += __sandbox_match_span(pm->answer + pm->pos, 
+            pm->size - pm->pos, true);
     }
-    DBUG("dup2: %d->%d", ptask->ofd, STDOUT_FILENO);
     
-    if (dup2(ptask->ifd, STDIN_FILENO) < 0)
+    FUNC_RET("%lld", (pm->pos == pm->size) ? -1LL : pm->seen);
+}
+
+static void
+__sandbox_match_fini(matcher_t * pm)
+{
+    PROC_BEGIN("%p", pm);
+    assert(pm);
+    
+    if (pm->answer != NULL)
     {
-        WARN("failed to redirect input channel(s)");
-        return EXIT_FAILURE;
+        munmap((void *)pm->answer, pm->size);
     }
-    DBUG("dup2: %d->%d", ptask->ifd, STDIN_FILENO);
+    memset(pm, 0, sizeof(matcher_t));
     
-    /* Apply security restrictions */
+    PROC_END();
+}
+
+/* Primes and lane round of XXH64 */
+#define XXH_P1                  0x9E3779B185EBCA87ULL
+#define XXH_P2                  0xC2B2AE3D27D4EB4FULL
+#define XXH_P3                  0x165667B19E3779F9ULL
+#define XXH_P4                  0x85EBCA77C2B2AE63ULL
+#define XXH_P5                  0x27D4EB2F165667C5ULL
+
+#define __ROTL64(x,r) \
+    (((x) << (r)) | ((x) >> (64 - (r)))) \
+/* __ROTL64 */
+
+#define __XXH_ROUND(acc,in) \
+    (__ROTL64((acc) + (in) * XXH_P2, 31) * XXH_P1) \
+/* __XXH_ROUND */
+
+static void
+__sandbox_digest_init(digest_t * pd)
+{
+    /* XXH64 with seed 0, whose digests can be reproduced with any xxhash 
+     * implementation (e.g. `xxhsum -H64`) */
+    memset(pd, 0, sizeof(digest_t));
+    pd->acc[0] = XXH_P1 + XXH_P2;
+    pd->acc[1] = XXH_P2;
+    pd->acc[2] = 0;
+    pd->acc[3] = -XXH_P1;
+}
+
+static void
+__sandbox_digest_feed(digest_t * pd, const void * data, size_t len)
+{
+    /* Stripes of 32 bytes are consumed by four independent lanes, with bytes
+     * short of a stripe kept for the next call, such that the digest does not
+     * depend on how the output is split into reads. Words are little-endian
+     * loads, as is the case with the x86 targets of libsandbox. */
+    const unsigned char * p = (const unsigned char *)data;
+    pd->total += len;
     
-    if (strcmp(ptask->jail, "/") != 0)
+    if (pd->len > 0)
     {
-        if (chdir(ptask->jail) < 0)
+        const size_t n = (len < 32 - pd->len) ? len : (32 - pd->len);
+        memcpy(pd->buff + pd->len, p, n);
+        pd->len += n;
+        p += n;
+        len -= n;
+        if (pd->len < 32)
         {
-            WARN("failed to chdir() to jail directory");
-            return EXIT_FAILURE;
+            return;
         }
-        if (chroot(".") < 0)
+        unsigned long long w[4];
+        memcpy(w, pd->buff, sizeof(w));
+        int k;
+        for (k = 0; k < 4; k++)
         {
-            WARN("failed to chroot() to jail directory");
-            return EXIT_FAILURE;
+            pd->acc[k] = __XXH_ROUND(pd->acc[k], w[k]);
         }
-        DBUG("jail: \"%s\"", ptask->jail);
+        pd->len = 0;
     }
     
-    /* Change identity before executing the targeted program */
-    
-    if (setgid(ptask->gid) < 0)
+    unsigned long long a0 = pd->acc[0], a1 = pd->acc[1];
+    unsigned long long a2 = pd->acc[2], a3 = pd->acc[3];
+    for (; len >= 32; p += 32, len -= 32)
     {
-        WARN("failed to change group identity");
-        return EXIT_FAILURE;
+        unsigned long long w[4];
+        memcpy(w, p, sizeof(w));
+        a0 = __XXH_ROUND(a0, w[0]);
+        a1 = __XXH_ROUND(a1, w[1]);
+        a2 = __XXH_ROUND(a2, w[2]);
+        a3 = __XXH_ROUND(a3, w[3]);
     }
-    DBUG("setgid: %lu", (unsigned long)ptask->gid);
+    pd->acc[0] = a0;
+    pd->acc[1] = a1;
+    pd->acc[2] = a2;
+    pd->acc[3] = a3;
     
-    if (setuid(ptask->uid) < 0)
+    memcpy(pd->buff, p, len);
+    pd->len = len;
+}
+
+static unsigned long long
+__sandbox_digest_end(const digest_t * pd)
+{
+    unsigned long long h = XXH_P5;
+    if (pd->total >= 32)
     {
-        WARN("failed to change owner identity");
-        return EXIT_FAILURE;
+        h = __ROTL64(pd->acc[0], 1) + __ROTL64(pd->acc[1], 7) + 
+            __ROTL64(pd->acc[2], 12) + __ROTL64(pd->acc[3], 18);
+        int k;
+        for (k = 0; k < 4; k++)
+        {
+            h = (h ^ __XXH_ROUND(0, pd->acc[k])) * XXH_P1 + XXH_P4;
+        }
     }
-    DBUG("setuid: %lu", (unsigned long)ptask->uid);
+    h += pd->total;
     
-    /* Prepare argument array to be passed to execve() */
-    char * argv[SBOX_ARG_MAX] = {NULL};
-    int argc = 0;
-    while ((argc + 1 < (SBOX_ARG_MAX)) && (ptask->comm.args[argc] >= 0))
-    {
-        argv[argc] = ptask->comm.buff + ptask->comm.args[argc];
-        argc++;
-    }
-    if (strcmp(ptask->jail, "/") != 0)
+    const unsigned char * p = pd->buff;
+    size_t len = pd->len;
+    for (; len >= 8; p += 8, len -= 8)
     {
-        argv[0] += strlen(ptask->jail);
+        unsigned long long w;
+        memcpy(&w, p, sizeof(w));
+        h = __ROTL64(h ^ __XXH_ROUND(0, w), 27) * XXH_P1 + XXH_P4;
     }
-    argv[argc] = NULL;
-    
-#ifndef NDEBUG
-    argc = 0;
-    while (argv[argc] != NULL)
+    if (len >= 4)
     {
-        DBUG("argv[%d]: \"%s\"", argc, argv[argc]);
-        argc++;
+        unsigned int w;
+        memcpy(&w, p, sizeof(w));
+        h = __ROTL64(h ^ (w * XXH_P1), 23) * XXH_P2 + XXH_P3;
+        p += 4;
+        len -= 4;
     }
-#endif /* NDEBUG */
-    
-    /* Unblock all signals for the prisoner process. */
-    sigset_t sigmask;
-    sigfillset(&sigmask);
-    if (pthread_sigmask(SIG_UNBLOCK, &sigmask, NULL) != 0)
+    for (; len > 0; p++, len--)
     {
-        WARN("pthread_sigmask");
-        return EXIT_FAILURE;
+        h = __ROTL64(h ^ (*p * XXH_P5), 11) * XXH_P1;
     }
-    DBUG("unblocked all signals");
     
-    /* Output quota is applied through the *setrlimit*. Because we might have 
-     * already changed identity by this time, the hard limits should remain as 
-     * they were. Thus we must invoke a *getrlimit* ahead of time to load 
-     * original hard resource limit. */
-    struct rlimit rlimval;
-    
-    /* Do NOT produce core dump files at all. */
-    if (getrlimit(RLIMIT_CORE, &rlimval) != 0)
-    {
-        WARN("failed to getrlimit(RLIMIT_CORE)");
-        return EXIT_FAILURE;
-    }
-    rlimval.rlim_cur = 0;
-    if (setrlimit(RLIMIT_CORE, &rlimval) != 0)
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Round constants of SHA-256 (FIPS 180-4) */
+static const unsigned int SHA256_K[64] = 
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define __ROTR32(x,r) \
+    (((x) >> (r)) | ((x) << (32 - (r)))) \
+/* __ROTR32 */
+
+static void
+__sandbox_sha256_init(sha256_t * ps)
+{
+    static const unsigned int iv[8] = 
     {
-        WARN("failed to setrlimit(RLIMIT_CORE)");
-        return EXIT_FAILURE;
-    }
-    DBUG("RLIMIT_CORE: %ld", rlimval.rlim_cur);
-     
-    /* Disk quota (bytes) */
-    if (getrlimit(RLIMIT_FSIZE, &rlimval) != 0)
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 
+        0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memset(ps, 0, sizeof(sha256_t));
+    memcpy(ps->state, iv, sizeof(iv));
+}
+
+static void
+__sandbox_sha256_block(unsigned int * h, const unsigned char * p)
+{
+    unsigned int w[64];
+    int i;
+    for (i = 0; i < 16; i++)
     {
-        WARN("failed to getrlimit(RLIMIT_FSIZE)");
-        return EXIT_FAILURE;
+        w[i] = ((unsigned int)p[4 * i] << 24) | 
+            ((unsigned int)p[4 * i + 1] << 16) | 
+            ((unsigned int)p[4 * i + 2] << 8) | (unsigned int)p[4 * i + 3];
     }
-    rlimval.rlim_cur = ptask->quota[S_QUOTA_DISK];
-    if (setrlimit(RLIMIT_FSIZE, &rlimval) != 0)
+    for (i = 16; i < 64; i++)
     {
-        WARN("failed to setrlimit(RLIMIT_FSIZE)");
-        return EXIT_FAILURE;
+        const unsigned int s0 = __ROTR32(w[i - 15], 7) ^ 
+            __ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const unsigned int s1 = __ROTR32(w[i - 2], 17) ^ 
+            __ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
     }
-    DBUG("RLIMIT_FSIZE: %ld", rlimval.rlim_cur);
     
-#ifdef DELETED
-    /* Memory quota (bytes) */
-    if (getrlimit(RLIMIT_AS, &rlimval) != 0)
+    unsigned int a = h[0], b = h[1], c = h[2], d = h[3];
+    unsigned int e = h[4], f = h[5], g = h[6], k = h[7];
+    for (i = 0; i < 64; i++)
     {
-        return EXIT_FAILURE;
+        const unsigned int t1 = k + (__ROTR32(e, 6) ^ __ROTR32(e, 11) ^ 
+            __ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        const unsigned int t2 = (__ROTR32(a, 2) ^ __ROTR32(a, 13) ^ 
+            __ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
     }
-    rlimval.rlim_cur = ptask->quota[S_QUOTA_MEMORY];
-    if (setrlimit(RLIMIT_AS, &rlimval) != 0)
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+}
+
+static void
+__sandbox_sha256_feed(sha256_t * ps, const void * data, size_t len)
+{
+    const unsigned char * p = (const unsigned char *)data;
+    ps->total += len;
+    
+    if (ps->len > 0)
     {
-        return EXIT_FAILURE;
+        const size_t n = (len < 64 - ps->len) ? len : (64 - ps->len);
+        memcpy(ps->buff + ps->len, p, n);
+        ps->len += n;
+        p += n;
+        len -= n;
+        if (ps->len < 64)
+        {
+            return;
+        }
+        __sandbox_sha256_block(ps->state, ps->buff);
+        ps->len = 0;
     }
-    DBUG("RLIMIT_AS: %ld", rlimval.rlim_cur);
-#endif /* DELETED */
-    
-#ifdef DELETED
-    /* CPU quota */
-    struct itimerval itv;
-    itv.it_interval.tv_sec = 0;
-    itv.it_interval.tv_usec = 0;
-    itv.it_value.tv_sec = ptask->quota[S_QUOTA_CPU] / 1000;
-    itv.it_value.tv_usec = (ptask->quota[S_QUOTA_CPU] % 1000) * 1000;
-    if (setitimer(ITIMER_PROF, &itv, NULL) < 0)
+    for (; len >= 64; p += 64, len -= 64)
     {
-        WARN("failed to setitimer(ITIMER_PROF)");
-        return EXIT_FAILURE;
+        __sandbox_sha256_block(ps->state, p);
     }
-#endif /* DELETED */
-    
-    /* Mark current process as traced */
-    if (!trace_me())
+    memcpy(ps->buff, p, len);
+    ps->len = len;
+}
+
+static void
+__sandbox_sha256_end(sha256_t * ps, unsigned char * md)
+{
+    /* Pad with a one bit, zeros, and the big-endian bit length */
+    const unsigned long long bits = ps->total << 3;
+    unsigned char pad[72] = {0x80};
+    const size_t n = (ps->len < 56) ? (56 - ps->len) : (120 - ps->len);
+    int i;
+    for (i = 0; i < 8; i++)
     {
-        WARN("trace_me");
-        return EXIT_FAILURE;
+        pad[n + i] = (unsigned char)(bits >> (56 - 8 * i));
     }
-    
-    /* Execute the targeted program */
-    if (execve(argv[0], argv, NULL) != 0)
+    __sandbox_sha256_feed(ps, pad, n + 8);
+    for (i = 0; i < 8; i++)
     {
-        WARN("execve() failed unexpectedly");
-        return errno;
+        md[4 * i] = (unsigned char)(ps->state[i] >> 24);
+        md[4 * i + 1] = (unsigned char)(ps->state[i] >> 16);
+        md[4 * i + 2] = (unsigned char)(ps->state[i] >> 8);
+        md[4 * i + 3] = (unsigned char)(ps->state[i]);
     }
-    
-    /* According to Linux manual, the execve() function will NEVER return on
-     * success, thus we should not be able to reach to this line of code! */
-    return EXIT_FAILURE;
 }
 
-static void 
-__sandbox_stat_init(stat_t * pstat)
+static void
+__sandbox_memo_field(sha256_t * ps, const void * data, size_t len)
 {
-    PROC_BEGIN("%p", pstat);
-    assert(pstat);
+    PROC_BEGIN("%p,%p,%zu", ps, data, len);
+    assert(ps && (data || (len == 0)));
     
-    memset(pstat, 0, sizeof(stat_t));
+    /* Fields of a key are prefixed with their lengths, such that adjacent 
+     * fields cannot be told apart by shifting bytes from one to the other */
+    const unsigned long long n = len;
+    __sandbox_sha256_feed(ps, &n, sizeof(n));
+    __sandbox_sha256_feed(ps, data, len);
     
     PROC_END();
 }
 
-static void 
-__sandbox_stat_update(sandbox_t * psbox, const proc_t * pproc)
+static bool
+__sandbox_memo_file(sha256_t * ps, int fd, long long offset, long long size)
 {
-    PROC_BEGIN("%p,%p", psbox, pproc);
-    assert(psbox && pproc);
-    
-    const struct timespec ZERO = {0, 0};
-    struct timespec ts = ZERO;
-    bool exceeded = false;
+    FUNC_BEGIN("%p,%d,%lld,%lld", ps, fd, offset, size);
+    assert(ps);
     
-    LOCK(psbox, EX);
+    /* Digest a region of a regular file (up to its end if size is negative)
+     * without moving its offset */
+    struct stat s;
+    if ((fd < 0) || (fstat(fd, &s) < 0) || !S_ISREG(s.st_mode))
+    {
+        FUNC_RET("%d", false);
+    }
+    const long long rest = (s.st_size > offset) ? (s.st_size - offset) : 0;
+    size = ((size < 0) || (size > rest)) ? rest : size;
     
-    /* mem_info */
-    #define MEM_UPDATE(a,b) \
-    {{{ \
-        (a) = (b); \
-        (a ## _peak) = (((a ## _peak) > (a)) ? (a ## _peak) : (a)); \
-    }}} /* MEM_UPDATE */
+    const unsigned long long n = size;
+    __sandbox_sha256_feed(ps, &n, sizeof(n));
+    char buff[SBOX_CAPTURE_MAX];
+    while (size > 0)
+    {
+        const size_t len = (size < (long long)sizeof(buff)) ? (size_t)size : 
+            sizeof(buff);
+        const ssize_t res = pread(fd, buff, len, offset);
+        if ((res < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            FUNC_RET("%d", false);
+        }
+        __sandbox_sha256_feed(ps, buff, res);
+        offset += res;
+        size -= res;
+    }
     
-    MEM_UPDATE(psbox->stat.mem_info.vsize, pproc->vsize);
-    MEM_UPDATE(psbox->stat.mem_info.rss, pproc->rss * getpagesize());
-    psbox->stat.mem_info.minflt = pproc->minflt;
-    psbox->stat.mem_info.majflt = pproc->majflt;
+    FUNC_RET("%d", true);
+}
+
+static bool
+__sandbox_memo_key(const task_t * ptask, const memo_t * pmemo, 
+                   const void * profile, size_t size, unsigned char * key)
+{
+    FUNC_BEGIN("%p,%p,%p,%zu,%p", ptask, pmemo, profile, size, key);
+    assert(ptask && key);
     
-    /* cpu_info */
-    ts = ZERO;
-    TS_INPLACE_ADD(ts, pproc->utime);
-    TS_INPLACE_ADD(ts, pproc->stime);
-    TS_UPDATE(psbox->stat.cpu_info.clock, ts);
-    TS_UPDATE(psbox->stat.cpu_info.utime, pproc->utime);
-    TS_UPDATE(psbox->stat.cpu_info.stime, pproc->stime);
+    /* Only runs under a deterministic policy, with all of their input known
+     * in advance, are cached */
+    if ((pmemo == NULL) || (pmemo->base == NULL) || (profile == NULL))
+    {
+        FUNC_RET("%d", false);
+    }
     
-    /* wallclock */
-    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    /* Nothing is written to the output channels on a hit, so the output of
+     * cached runs must go nowhere but the comparator and the digests, i.e. 
+     * both output channels are the null device */
+    struct stat null, os, es;
+    if ((stat("/dev/null", &null) != 0) || !S_ISCHR(null.st_mode) || 
+        (fstat(ptask->ofd, &os) != 0) || !S_ISCHR(os.st_mode) || 
+        (os.st_rdev != null.st_rdev) || (fstat(ptask->efd, &es) != 0) || 
+        !S_ISCHR(es.st_mode) || (es.st_rdev != null.st_rdev))
     {
-        UNLOCK(psbox);
-        MONITOR_ERROR(psbox, "failed to get wallclock time");
-        PROC_END();
+        FUNC_RET("%d", false);
     }
     
-    /* Update the elapsed time stat of sandbox, also update the walllock
-     * started time if it is not set already. */
-    if (!TS_LESS(ZERO, psbox->stat.started))
+    sha256_t sha;
+    __sandbox_sha256_init(&sha);
+    __sandbox_memo_field(&sha, SBOX_MEMO_MAGIC, 8);
+    
+    /* Content of the executable file, or the program file bound into the 
+     * jail image (if any), as is the case with the stamp of the task */
+    const char * prog = (ptask->image.prog[0] != '\0') ? 
+        (ptask->image.prog) : (ptask->comm.args[0]);
+    const int xfd = (ptask->xfd >= 0) ? ptask->xfd : 
+        open(prog, O_RDONLY | O_CLOEXEC);
+    const bool exe = __sandbox_memo_file(&sha, xfd, 0, -1);
+    if ((ptask->xfd < 0) && (xfd >= 0))
     {
-        psbox->stat.started = ts;
-        psbox->stat.elapsed = ZERO;
+        close(xfd);
     }
-    else
+    if (!exe)
     {
-        TS_INPLACE_SUB(ts, psbox->stat.started);
-        TS_UPDATE(psbox->stat.elapsed, ts);
+        FUNC_RET("%d", false);
     }
     
-    UNLOCK(psbox);
-    
-    /* Compare peak memory usage against memory quota limit */
-    LOCK(psbox, SH);
-    if (psbox->stat.mem_info.vsize_peak > \
-        psbox->task.quota[S_QUOTA_MEMORY])
+    /* Content of the input to be fed, or the rest of the input file */
+    const feed_t * const pfeed = &ptask->feed;
+    bool input = true;
+    if (pfeed->data != NULL)
     {
-        DBUG("memory quota exceeded");
-        UNLOCK(psbox);
-        POST_EVENT(psbox, _QUOTA, S_QUOTA_MEMORY);
-        exceeded = true;
+        __sandbox_memo_field(&sha, pfeed->data, 
+            (pfeed->size > 0) ? (size_t)pfeed->size : 0);
+    }
+    else if (pfeed->fd >= 0)
+    {
+        input = __sandbox_memo_file(&sha, pfeed->fd, pfeed->offset, 
+            pfeed->size);
     }
     else
     {
-        UNLOCK(psbox);
+        const off_t offset = lseek(ptask->ifd, 0, SEEK_CUR);
+        input = (offset >= 0) && 
+            __sandbox_memo_file(&sha, ptask->ifd, offset, -1);
+    }
+    if (!input)
+    {
+        FUNC_RET("%d", false);
     }
     
-    /* Compare cpu clock time against cpu quota limit */
-    LOCK(psbox, SH);
-    if ((res_t)ts2ms(psbox->stat.cpu_info.clock) > \
-        psbox->task.quota[S_QUOTA_CPU])
+    /* Content of the answer file, which decides the result along with the 
+     * output */
+    const capture_t * const pcap = &ptask->capture;
+    const compare_t compare = pcap->enabled ? pcap->compare : S_COMPARE_NONE;
+    __sandbox_memo_field(&sha, &compare, sizeof(compare));
+    __sandbox_memo_field(&sha, &pcap->sha256, sizeof(pcap->sha256));
+    if (compare != S_COMPARE_NONE)
     {
-        DBUG("cpu quota exceeded");
-        UNLOCK(psbox);
-        POST_EVENT(psbox, _QUOTA, S_QUOTA_CPU);
-        exceeded = true;
+        __sandbox_memo_field(&sha, &pcap->epsilon, sizeof(pcap->epsilon));
+        if ((pcap->answer >= 0) && 
+            !__sandbox_memo_file(&sha, pcap->answer, 0, -1))
+        {
+            FUNC_RET("%d", false);
+        }
     }
-    else
+    
+    /* Command line and environment */
+    char * const * strv[2] = {ptask->comm.args, ptask->comm.envs};
+    int k;
+    for (k = 0; k < 2; k++)
     {
-        UNLOCK(psbox);
+        int i;
+        for (i = 0; (strv[k] != NULL) && (strv[k][i] != NULL); i++)
+        {
+            __sandbox_memo_field(&sha, strv[k][i], strlen(strv[k][i]) + 1);
+        }
+        __sandbox_memo_field(&sha, NULL, 0);
     }
     
-    /* Compare elapsed time against wallclock quota limit */
-    LOCK(psbox, SH);
-    if ((res_t)ts2ms(psbox->stat.elapsed) > 
-        psbox->task.quota[S_QUOTA_WALLCLOCK])
+    /* Static fields of the task, other than the program file, and quota */
+    __sandbox_memo_field(&sha, ptask->jail, strlen(ptask->jail));
+    __sandbox_memo_field(&sha, &ptask->uid, sizeof(ptask->uid));
+    __sandbox_memo_field(&sha, &ptask->gid, sizeof(ptask->gid));
+    __sandbox_memo_field(&sha, &ptask->trust, sizeof(ptask->trust));
+    __sandbox_memo_field(&sha, &ptask->ns, sizeof(ptask->ns));
+    int i;
+    for (i = 0; (i < SBOX_FS_MAX) && (ptask->fs.path[i] >= 0); i++)
     {
-        DBUG("wallclock quota exceeded");
-        UNLOCK(psbox);
-        POST_EVENT(psbox, _QUOTA, S_QUOTA_WALLCLOCK);
-        exceeded = true;
+        const char * path = ptask->fs.buff + ptask->fs.path[i];
+        __sandbox_memo_field(&sha, path, strlen(path));
+        __sandbox_memo_field(&sha, &ptask->fs.access[i], 
+            sizeof(fs_access_t));
+    }
+    __sandbox_memo_field(&sha, &ptask->image.readonly, sizeof(bool));
+    __sandbox_memo_field(&sha, ptask->image.scratch, 
+        strlen(ptask->image.scratch));
+    __sandbox_memo_field(&sha, &ptask->image.size, sizeof(res_t));
+    __sandbox_memo_field(&sha, &pfeed->seekable, sizeof(bool));
+    __sandbox_memo_field(&sha, ptask->quota, sizeof(ptask->quota));
+    
+    /* Identity of the deterministic policy */
+    __sandbox_memo_field(&sha, profile, size);
+    
+    __sandbox_sha256_end(&sha, key);
+    
+    FUNC_RET("%d", true);
+}
+
+static bool
+__sandbox_memo_lookup(memo_t * pmemo, const unsigned char * key, 
+                      memo_slot_t * pslot)
+{
+    FUNC_BEGIN("%p,%p,%p", pmemo, key, pslot);
+    assert(pmemo && key && pslot);
+    
+    /* Keys are uniformly distributed, so the home slot of a key is indexed 
+     * by its leading bytes, and up to SBOX_MEMO_PROBE slots are probed from
+     * there. Threads of this process are excluded by the lock of the cache,
+     * and other processes by flock() on the index file. */
+    const memo_slot_t * const slot = (const memo_slot_t *)
+        ((const char *)pmemo->base + sizeof(memo_head_t));
+    unsigned long long home;
+    memcpy(&home, key, sizeof(home));
+    
+    LOCK(pmemo, EX);
+    flock(pmemo->fd, LOCK_SH);
+    bool found = false;
+    int i;
+    for (i = 0; (i < SBOX_MEMO_PROBE) && !found; i++)
+    {
+        const unsigned long j = (home + i) % pmemo->slots;
+        if (memcmp(slot[j].key, key, sizeof(slot[j].key)) == 0)
+        {
+            *pslot = slot[j];
+            found = true;
+        }
+    }
+    flock(pmemo->fd, LOCK_UN);
+    if (found)
+    {
+        ++pmemo->stat.hit;
     }
     else
     {
-        UNLOCK(psbox);
+        ++pmemo->stat.miss;
     }
+    UNLOCK(pmemo);
     
-    /* Stop targeted program to force event handling */
-    if (exceeded)
+    FUNC_RET("%d", found);
+}
+
+static void
+__sandbox_memo_store(memo_t * pmemo, const unsigned char * key, 
+                     const memo_slot_t * pslot)
+{
+    PROC_BEGIN("%p,%p,%p", pmemo, key, pslot);
+    assert(pmemo && key && pslot);
+    
+    /* The run takes the slot of the same key, or the first vacant slot, or 
+     * else evicts the run in its home slot */
+    static const unsigned char vacant[32] = {0};
+    memo_slot_t * const slot = (memo_slot_t *)
+        ((char *)pmemo->base + sizeof(memo_head_t));
+    unsigned long long home;
+    memcpy(&home, key, sizeof(home));
+    
+    LOCK(pmemo, EX);
+    flock(pmemo->fd, LOCK_EX);
+    unsigned long j = home % pmemo->slots;
+    int i;
+    for (i = 0; i < SBOX_MEMO_PROBE; i++)
     {
-        trace_kill(pproc, SIGSTOP);
-        trace_kill(pproc, SIGCONT);
+        const unsigned long t = (home + i) % pmemo->slots;
+        if ((memcmp(slot[t].key, key, sizeof(slot[t].key)) == 0) || 
+            (memcmp(slot[t].key, vacant, sizeof(vacant)) == 0))
+        {
+            j = t;
+            break;
+        }
     }
+    slot[j] = *pslot;
+    memcpy(slot[j].key, key, sizeof(slot[j].key));
+    flock(pmemo->fd, LOCK_UN);
+    ++pmemo->stat.stored;
+    UNLOCK(pmemo);
     
     PROC_END();
 }
 
-static void 
-__sandbox_stat_fini(stat_t * pstat)
+static void
+__sandbox_memo_save(const sandbox_t * psbox, memo_slot_t * pslot)
 {
-    PROC_BEGIN("%p", pstat);
-    assert(pstat);
+    PROC_BEGIN("%p,%p", psbox, pslot);
+    assert(psbox && pslot);
     
-    /* TODO */
+    const stat_t * const pstat = &psbox->stat;
+    memset(pslot, 0, sizeof(memo_slot_t));
+    pslot->result = psbox->result;
+    pslot->exitcode = pstat->exitcode;
+    pslot->signal = pstat->signal;
+    pslot->syscall = pstat->syscall;
+    pslot->elapsed = pstat->elapsed;
+    pslot->clock = pstat->cpu_info.clock;
+    pslot->utime = pstat->cpu_info.utime;
+    pslot->stime = pstat->cpu_info.stime;
+    pslot->vsize_peak = pstat->mem_info.vsize_peak;
+    pslot->rss_peak = pstat->mem_info.rss_peak;
+    pslot->minflt = pstat->mem_info.minflt;
+    pslot->majflt = pstat->mem_info.majflt;
+    pslot->bytes = pstat->output.bytes;
+    pslot->mismatch = pstat->output.mismatch;
+    pslot->digest = pstat->output.digest;
+    memcpy(pslot->sha256, pstat->output.sha256, sizeof(pslot->sha256));
+    pslot->fed = pstat->input.bytes;
+    pslot->consumed = pstat->input.consumed;
     
     PROC_END();
 }
 
-static void 
-__sandbox_ctrl_init(ctrl_t * pctrl, thread_func_t tft)
+static void
+__sandbox_memo_replay(sandbox_t * psbox, const memo_slot_t * pslot)
 {
-    PROC_BEGIN("%p,%p", pctrl, tft);
-    assert(pctrl && tft);
-    
-    memset(pctrl, 0, sizeof(ctrl_t));
+    PROC_BEGIN("%p,%p", psbox, pslot);
+    assert(psbox && pslot);
     
-    pctrl->policy.entry = (void *)sandbox_default_policy;
-    pctrl->policy.data = 0L;
-    memset(pctrl->monitor, 0, (SBOX_MONITOR_MAX) * sizeof(worker_t));
-    memset(&pctrl->tracer, 0, sizeof(worker_t));
-    pctrl->tracer.target = tft;
-    __QUEUE_CLEAR(pctrl);
+    stat_t * const pstat = &psbox->stat;
+    clock_gettime(CLOCK_MONOTONIC, &pstat->started);
+    pstat->exitcode = pslot->exitcode;
+    pstat->signal = pslot->signal;
+    pstat->syscall = pslot->syscall;
+    pstat->elapsed = pslot->elapsed;
+    pstat->cpu_info.clock = pslot->clock;
+    pstat->cpu_info.utime = pslot->utime;
+    pstat->cpu_info.stime = pslot->stime;
+    pstat->mem_info.vsize_peak = pslot->vsize_peak;
+    pstat->mem_info.rss_peak = pslot->rss_peak;
+    pstat->mem_info.minflt = pslot->minflt;
+    pstat->mem_info.majflt = pslot->majflt;
+    pstat->output.bytes = pslot->bytes;
+    pstat->output.mismatch = pslot->mismatch;
+    pstat->output.digest = pslot->digest;
+    memcpy(pstat->output.sha256, pslot->sha256, sizeof(pslot->sha256));
+    pstat->input.bytes = pslot->fed;
+    pstat->input.consumed = pslot->consumed;
+    pstat->memoized = true;
     
     PROC_END();
 }
 
-static void 
-__sandbox_ctrl_fini(ctrl_t * pctrl)
+static size_t
+__sandbox_capture_forward(sandbox_t * psbox, int ofd, const char * buff, 
+                          size_t len, bool stream)
 {
-    PROC_BEGIN("%p", pctrl);
-    assert(pctrl);
+    FUNC_BEGIN("%p,%d,%p,%zu,%d", psbox, ofd, buff, len, stream);
+    assert(psbox && buff);
     
-    __QUEUE_CLEAR(pctrl);
-    pctrl->tracer.target = NULL;
-    memset(&pctrl->tracer, 0, sizeof(worker_t));
-    memset(pctrl->monitor, 0, (SBOX_MONITOR_MAX) * sizeof(worker_t));
+    /* Writes to pipes and sockets may block for as long as the reader likes.
+     * They are made PIPE_BUF bytes at a time once the output channel is known
+     * to be writable, such that the capture thread is not held up beyond the
+     * prisoner process. Bytes forwarded ahead of a failure are reported. */
+    size_t done = 0;
+    while (done < len)
+    {
+        size_t n = len - done;
+        if (stream)
+        {
+            struct pollfd pfd = {ofd, POLLOUT, 0};
+            const int res = poll(&pfd, 1, 1000 / PROF_FREQ);
+            if ((res < 0) && (errno != EINTR))
+            {
+                FUNC_RET("%zu", done);
+            }
+            if (res <= 0)
+            {
+                LOCK(psbox, SH);
+                const bool gone = psbox->ctrl.capture.exited || 
+                    IS_FINISHED(psbox);
+                UNLOCK(psbox);
+                if (gone)
+                {
+                    FUNC_RET("%zu", done);
+                }
+                continue;
+            }
+            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                FUNC_RET("%zu", done);
+            }
+            n = (n < PIPE_BUF) ? n : PIPE_BUF;
+        }
+        const ssize_t res = write(ofd, buff + done, n);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            FUNC_RET("%zu", done);
+        }
+        done += (size_t)res;
+    }
+    
+    FUNC_RET("%zu", done);
+}
+
+static void
+__sandbox_capture_wait(sandbox_t * psbox)
+{
+    PROC_BEGIN("%p", psbox);
+    assert(psbox);
+    
+    /* The output of the prisoner process may still be buffered in the capture
+     * pipe upon its exit. Wait for the capture thread to compare the residue,
+     * such that a mismatch is reported to the policy ahead of the exit. */
+    LOCK(psbox, EX);
+    psbox->ctrl.capture.exited = true;
+    UNLOCK(psbox);
+    LOCK_ON_COND(psbox, SH, ((psbox->ctrl.capture.fd < 0) && 
+        (psbox->ctrl.capture.efd < 0)) || HAS_RESULT(psbox));
+    UNLOCK(psbox);
     
     PROC_END();
 }
 
-static int
-__sandbox_ctrl_add_monitor(ctrl_t * pctrl, thread_func_t tfm)
+static bool
+__sandbox_ctrl_dispatch(sandbox_t * psbox, cache_t * cache, bool * pnoret)
 {
-    FUNC_BEGIN("%p,%p", pctrl, tfm);
-    assert(pctrl && tfm);
+    FUNC_BEGIN("%p,%p,%p", psbox, cache, pnoret);
+    assert(psbox && cache && pnoret);
     
-    int i;
-    for (i = 0; i < (SBOX_MONITOR_MAX); i++)
+    ctrl_t * const pctrl = &psbox->ctrl;
+    bool killed = false;
+    
+    LOCK(psbox, SH);
+    while (!__QUEUE_EMPTY(pctrl))
     {
-        if (pctrl->monitor[i].target == NULL)
+        /* Start investigating the event */
+        DBUG("detected: event %s {%lu %lu %lu %lu %lu %lu %lu}",
+            s_event_type_name(__QUEUE_HEAD(pctrl).type),
+            __QUEUE_HEAD(pctrl).data.__bitmap__.A,
+            __QUEUE_HEAD(pctrl).data.__bitmap__.B,
+            __QUEUE_HEAD(pctrl).data.__bitmap__.C,
+            __QUEUE_HEAD(pctrl).data.__bitmap__.D,
+            __QUEUE_HEAD(pctrl).data.__bitmap__.E,
+            __QUEUE_HEAD(pctrl).data.__bitmap__.F,
+            __QUEUE_HEAD(pctrl).data.__bitmap__.G);
+    
+        /* Consult the decision cache, or the sandbox policy to determine
+         * next action */
+        const bool cached = __sandbox_cache_lookup(cache, 
+            &(__QUEUE_HEAD(pctrl)), &pctrl->action);
+        if (!cached)
         {
-            pctrl->monitor[i].target = tfm;
+            ((policy_entry_t)pctrl->policy.entry)(&pctrl->policy, \
+                &(__QUEUE_HEAD(pctrl)), &pctrl->action);
+            __sandbox_cache_store(cache, &(__QUEUE_HEAD(pctrl)), 
+                &pctrl->action);
+        }
+    
+        DBUG("policy decided action: %s {%lu %lu}",
+            s_action_type_name(pctrl->action.type),
+            pctrl->action.data.__bitmap__.A,
+            pctrl->action.data.__bitmap__.B);
+        
+        /* Perform the desired action */
+        RELOCK(psbox, EX);
+        if (__QUEUE_HEAD(pctrl).type == S_EVENT_SYSCALL)
+        {
+            (cached) ? psbox->stat.cache.hit++ : psbox->stat.cache.miss++;
+        }
+        switch (pctrl->action.type)
+        {
+        case S_ACTION_CONT:
+            /* Drop the obsoleted event */
+            __QUEUE_POP(pctrl);
+            break;
+        case S_ACTION_CONT_NORET:
+            /* Do not report the return of the current system call */
+            if (__QUEUE_HEAD(pctrl).type == S_EVENT_SYSCALL)
+            {
+                *pnoret = true;
+            }
+            __QUEUE_POP(pctrl);
+            break;
+        case S_ACTION_FINI:
+            /* Terminate the prisoner process */
+            __UPDATE_RESULT(psbox, pctrl->action.data._FINI.result);
+            __QUEUE_CLEAR(pctrl);
+            killed = true;
+            break;
+        default:
+        case S_ACTION_KILL:
+            __UPDATE_RESULT(psbox, pctrl->action.data._KILL.result);
+            __QUEUE_CLEAR(pctrl);
+            killed = true;
             break;
         }
+        RELOCK(psbox, SH);
     }
+    UNLOCK(psbox);
     
-    FUNC_RET("%d", i);
+    FUNC_RET("%d", killed);
 }
 
 void *
@@ -950,18 +4688,49 @@ sandbox_watcher(sandbox_t * psbox)
     
     /* Temporary variables. */
     LOCK(psbox, SH);
-    const pthread_t profiler_thread = psbox->ctrl.monitor[0].tid;
     const pid_t pid = psbox->ctrl.pid;
-    ctrl_t * const pctrl = &psbox->ctrl;
     proc_t proc = {0};
     proc_bind(psbox, &proc);
+#ifdef HAVE_SYSCALL_FILTER
+    const bool filtered = (psbox->ctrl.filter.len > 0);
+#else
+    const bool filtered = false;
+#endif /* HAVE_SYSCALL_FILTER */
+    const bool untraced = ((psbox->ctrl.backend == S_BACKEND_NOTIFY) || 
+                           (psbox->task.trust == S_TRUST_FULL));
+#ifdef HAVE_TRACE_FORK
+    /* The master process of a fork server is parked (at most once) */
+    bool served = (psbox->ctrl.server != NULL) && 
+                  (psbox == &psbox->ctrl.server->sbox);
+#endif /* HAVE_TRACE_FORK */
     UNLOCK(psbox);
     
     siginfo_t w_info;
     int w_opt = WEXITED | WSTOPPED;
     int w_res = 0;
     long sc_stack[8] = {0};
+    bool sc_noret[8] = {false};
     int sc_top = 0;
+    cache_t cache[SBOX_CACHE_MAX];
+    memset(cache, 0, sizeof(cache));
+    
+#ifdef HAVE_PIDFD
+    /* The prisoner process is not traced with S_BACKEND_NOTIFY, or if it is
+     * fully trusted */
+    if (untraced)
+    {
+        __sandbox_watch_untraced(psbox, &proc, cache);
+        goto watch_end;
+    }
+#endif /* HAVE_PIDFD */
+    
+#ifdef HAVE_SYSCALL_FILTER
+    /* With a system call filter, the prisoner process stops itself to have the
+     * reporting of filtered system calls enabled, and then the execve() of the
+     * targeted program stops as a filtered system call. Neither is reported to
+     * the policy, as is the case without filter. */
+    int setup = filtered ? 2 : 0;
+#endif /* HAVE_SYSCALL_FILTER */
     
     /* Entering the watching loop */
     while ((w_res = waitid(P_PID, pid, &w_info, w_opt)) >= 0)
@@ -988,6 +4757,27 @@ sandbox_watcher(sandbox_t * psbox)
             }
         }
         
+#ifdef HAVE_SYSCALL_FILTER
+        if ((setup == 2) && (w_info.si_code == CLD_TRAPPED) && 
+            (w_info.si_status == SIGSTOP))
+        {
+            DBUG("detected: pre-filter SIGSTOP");
+            if (!trace_filter(&proc))
+            {
+                MONITOR_ERROR(psbox, "failed to enable filter: %d", pid);
+            }
+            setup = 1;
+            goto schedule_next;
+        }
+        if ((setup == 1) && (w_info.si_code == CLD_TRAPPED) && 
+            (w_info.si_status == TRAP_FILTERED))
+        {
+            DBUG("detected: filtered execve");
+            setup = 0;
+            goto schedule_next;
+        }
+#endif /* HAVE_SYSCALL_FILTER */
+        
         /* Raise appropriate events judging each wait status */
         if (w_info.si_code == CLD_TRAPPED)
         {
@@ -1015,6 +4805,9 @@ sandbox_watcher(sandbox_t * psbox)
                 POST_EVENT(psbox, _QUOTA, S_QUOTA_DISK);
                 goto update_signal;
                 break;
+#ifdef HAVE_SYSCALL_FILTER
+            case TRAP_FILTERED: /* Filtered system call */
+#endif /* HAVE_SYSCALL_FILTER */
             case SIGTRAP:
                 /* Collect additional info of the prisoner process */
                 if (!proc_probe(pid, PROBE_REGS | PROBE_OP, &proc))
@@ -1033,8 +4826,27 @@ sandbox_watcher(sandbox_t * psbox)
                     psbox->stat.syscall = sc;
                     UNLOCK(psbox);
                     
-                    if (sc != sc_stack[sc_top])
+                    /* The bottom of the stack is not a pending system call,
+                     * and system call 0 (i.e. read on x86_64) should not be
+                     * mistaken for its return */
+                    if ((sc_top == 0) || (sc != sc_stack[sc_top]))
                     {
+#ifdef HAVE_TRACE_FORK
+                        /* The master process of a fork server is parked upon
+                         * its first system call on a standard channel, which
+                         * is re-entered (and reported) by each of its copies 
+                         * instead */
+                        if (served && __sandbox_server_point(sc, 
+                            SYSCALL_ARG1(&proc)))
+                        {
+                            served = false;
+                            if (__sandbox_server_park(psbox, &proc))
+                            {
+                                __sandbox_server_wait(psbox, pid);
+                                goto watch_end;
+                            }
+                        }
+#endif /* HAVE_TRACE_FORK */
                         SET_IN_SYSCALL(&proc);
                         sc_stack[++sc_top] = sc;
                         POST_EVENT(psbox, _SYSCALL, sc, SYSCALL_ARG1(&proc),
@@ -1046,7 +4858,12 @@ sandbox_watcher(sandbox_t * psbox)
                     }
                     else
                     {
-                        POST_EVENT(psbox, _SYSRET,  sc, SYSRET_RETVAL(&proc));
+                        if (!sc_noret[sc_top])
+                        {
+                            POST_EVENT(psbox, _SYSRET, sc, 
+                                SYSRET_RETVAL(&proc));
+                        }
+                        sc_noret[sc_top] = false;
                         sc_stack[sc_top--] = 0;
                         CLR_IN_SYSCALL(&proc);
                     }
@@ -1094,105 +4911,305 @@ sandbox_watcher(sandbox_t * psbox)
             LOCK(psbox, EX);
             psbox->stat.exitcode = w_info.si_status;
             UNLOCK(psbox);
+            __sandbox_capture_wait(psbox);
             POST_EVENT(psbox, _EXIT, w_info.si_status);
         }
         else
         {
-            DBUG("wait: unknown (si_code = %d)", w_info.si_code);
-            /* unknown event, should not reach here! */
+            DBUG("wait: unknown (si_code = %d)", w_info.si_code);
+            /* unknown event, should not reach here! */
+        }
+        
+        /* Update resource usage statistics. */
+        __sandbox_stat_update(psbox, &proc);
+        NOTIFY(psbox, NOTICE_PROF);
+        
+        /* Deliver pending events to the policy module for investigation */
+        if (__sandbox_ctrl_dispatch(psbox, cache, &sc_noret[sc_top]))
+        {
+            trace_kill(&proc, SIGKILL);
+        }
+        
+#ifdef HAVE_SYSCALL_FILTER
+        /* With a system call filter, the prisoner process needs not stop on
+         * the return of a system call, if the policy is not interested */
+        if (filtered && proc.tflags.is_in_syscall && sc_noret[sc_top])
+        {
+            sc_noret[sc_top] = false;
+            sc_stack[sc_top--] = 0;
+            CLR_IN_SYSCALL(&proc);
+        }
+#endif /* HAVE_SYSCALL_FILTER */
+        
+        /* Schedule for next trace, with a system call filter, the prisoner 
+         * process only stops on filtered system calls, and on the returns of
+         * those reported to the policy. */
+#ifdef HAVE_SYSCALL_FILTER
+    schedule_next:
+#endif /* HAVE_SYSCALL_FILTER */
+#ifdef WITH_SOFTWARE_TSC
+        if (!trace_next(&proc, TRACE_SINGLE_STEP))
+#else /* WITHOUT_SOFTWARE_TSC */
+        if (!trace_next(&proc, (filtered && !proc.tflags.is_in_syscall) ? 
+            TRACE_FILTERED_CALL : TRACE_SYSTEM_CALL))
+#endif /* WITH_SOFTWARE_TSC */
+        {
+            MONITOR_ERROR(psbox, "failed to schedule next watch");
+            LOCK(psbox, SH);
+            if (HAS_RESULT(psbox))
+            {
+                DBUG("exiting the watching loop");
+                UNLOCK(psbox);
+                break;
+            }
+            else
+            {
+                UNLOCK(psbox);
+            }
+        }
+        
+        UPDATE_STATUS(psbox, S_STATUS_EXE);
+    }
+    
+#ifdef HAVE_PIDFD
+watch_end:
+#endif /* HAVE_PIDFD */
+    UPDATE_STATUS(psbox, S_STATUS_FIN);
+    
+    LOCK(psbox, EX);
+    if (!HAS_RESULT(psbox))
+    {
+        __UPDATE_RESULT(psbox, S_RESULT_BP);
+    }
+    UNLOCK(psbox);
+    
+    /* Notify the main tracer thread to return */
+    trace_end(&proc);
+    
+    MONITOR_END(psbox);
+}
+
+#ifdef HAVE_PIDFD
+static void
+__sandbox_watch_untraced(sandbox_t * psbox, proc_t * pproc, cache_t * cache)
+{
+    PROC_BEGIN("%p,%p,%p", psbox, pproc, cache);
+    assert(psbox && pproc && cache);
+    
+    LOCK(psbox, SH);
+    const pid_t pid = psbox->ctrl.pid;
+    const int listener = psbox->ctrl.listener;
+    const bool trusted = (psbox->task.trust == S_TRUST_FULL);
+    UNLOCK(psbox);
+    
+    /* Without ptrace, filtered system calls are received from the listener fd
+     * (while the calling thread is held by the kernel), and the termination of
+     * the prisoner process is detected by polling a pidfd. Events posted by 
+     * other monitor threads are dispatched upon periodic wakeups. A trusted 
+     * prisoner process has no listener fd at all. */
+    
+    const int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd < 0)
+    {
+        MONITOR_ERROR(psbox, "failed to open pidfd of process: %d", pid);
+        PROC_END();
+    }
+    if ((listener < 0) && !trusted)
+    {
+        MONITOR_ERROR(psbox, "failed to obtain listener of process: %d", pid);
+    }
+    
+    struct pollfd pfd[2] = {{listener, POLLIN, 0}, {pidfd, POLLIN, 0}};
+    siginfo_t w_info;
+    notif_t notif;
+    bool exited = false;
+    
+    /* Before the prisoner process has replaced itself with the targeted program
+     * through (the reported) execve(), neither its system calls, nor its memory
+     * usage should be inspected. The latter is detected with PF_FORKNOEXEC. */
+    int setup = trusted ? 1 : 2;
+    
+    #define SETUP_DONE(pproc) \
+        (proc_probe(pid, PROBE_STAT, (pproc)) && \
+         !((pproc)->flags & PF_FORKNOEXEC)) \
+    /* SETUP_DONE */
+    
+    /* Entering the watching loop */
+    while (!exited)
+    {
+        const int w_res = poll(pfd, 2, (setup == 1) ? 1 : (1000 / PROF_FREQ));
+        if ((w_res < 0) && (errno != EINTR))
+        {
+            MONITOR_ERROR(psbox, "failed to poll process: %d", pid);
+            break;
         }
         
-        /* Update resource usage statistics. */
-        __sandbox_stat_update(psbox, &proc);
-        pthread_kill(profiler_thread, SIGPROF);
-        
-        /* Deliver pending events to the policy module for investigation */
-        LOCK(psbox, SH);
-        while (!__QUEUE_EMPTY(pctrl))
-        {
-            /* Start investigating the event */
-            DBUG("detected: event %s {%lu %lu %lu %lu %lu %lu %lu}",
-                s_event_type_name(__QUEUE_HEAD(pctrl).type),
-                __QUEUE_HEAD(pctrl).data.__bitmap__.A,
-                __QUEUE_HEAD(pctrl).data.__bitmap__.B,
-                __QUEUE_HEAD(pctrl).data.__bitmap__.C,
-                __QUEUE_HEAD(pctrl).data.__bitmap__.D,
-                __QUEUE_HEAD(pctrl).data.__bitmap__.E,
-                __QUEUE_HEAD(pctrl).data.__bitmap__.F,
-                __QUEUE_HEAD(pctrl).data.__bitmap__.G);
-        
-            /* Consult the sandbox policy to determine next action */
-            ((policy_entry_t)pctrl->policy.entry)(&pctrl->policy, \
-                &(__QUEUE_HEAD(pctrl)), &pctrl->action);
+        bool pending = false;
+        bool killed = false;
+        bool noret = false;
         
-            DBUG("policy decided action: %s {%lu %lu}",
-                s_action_type_name(pctrl->action.type),
-                pctrl->action.data.__bitmap__.A,
-                pctrl->action.data.__bitmap__.B);
-            
-            /* Perform the desired action */
-            RELOCK(psbox, EX);
-            switch (pctrl->action.type)
+        if (pfd[0].revents & (POLLHUP | POLLERR | POLLNVAL))
+        {
+            /* No more filtered system calls from the prisoner process */
+            pfd[0].fd = -1;
+        }
+        else if (pfd[0].revents & POLLIN)
+        {
+            if (!trace_notified(listener, &notif))
             {
-            case S_ACTION_CONT:
-                /* Drop the obsoleted event */
-                __QUEUE_POP(pctrl);
-                break;
-            case S_ACTION_FINI:
-                /* Terminate the prisoner process */
-                __UPDATE_RESULT(psbox, pctrl->action.data._FINI.result);
-                __QUEUE_CLEAR(pctrl);
-                trace_kill(&proc, SIGKILL);
-                break;
-            default:
-            case S_ACTION_KILL:
-                __UPDATE_RESULT(psbox, pctrl->action.data._KILL.result);
-                __QUEUE_CLEAR(pctrl);
-                trace_kill(&proc, SIGKILL);
-                break;
+                /* The notification is gone when the calling thread is killed,
+                 * and another thread may have received it first */
+                if ((errno != ENOENT) && (errno != EINTR))
+                {
+                    MONITOR_ERROR(psbox, "failed to receive notification: %d", 
+                        pid);
+                }
+            }
+            else if (notif.pid != pid)
+            {
+                /* System calls of other threads or children of the prisoner 
+                 * process should not be attributed to it, and fail as they do
+                 * for untraced tasks under ptrace */
+                DBUG("denied notification from task: %d", notif.pid);
+                if (!trace_respond(listener, &notif, ENOSYS))
+                {
+                    WARN("failed to answer notification: %llu", notif.id);
+                }
+            }
+            else if ((setup == 0) || ((setup == 1) && SETUP_DONE(pproc)))
+            {
+                if (setup == 1)
+                {
+                    DBUG("detected: post-execve system call");
+                    setup = 0;
+                }
+                UPDATE_STATUS(psbox, S_STATUS_BLK);
+                LOCK(psbox, EX);
+                psbox->stat.syscall = notif.scinfo;
+                UNLOCK(psbox);
+                POST_EVENT(psbox, _SYSCALL, notif.scinfo, notif.args[0], 
+                                                          notif.args[1], 
+                                                          notif.args[2], 
+                                                          notif.args[3], 
+                                                          notif.args[4], 
+                                                          notif.args[5]);
+                pending = true;
+            }
+            else
+            {
+                if ((setup == 2) && ((notif.scinfo == SC_EXECVE) || 
+                                     (notif.scinfo == SC32_EXECVE) || 
+                                     (notif.scinfo == SC_EXECVEAT) || 
+                                     (notif.scinfo == SC32_EXECVEAT)))
+                {
+                    DBUG("detected: notified execve");
+                    setup = 1;
+                }
+                if (!trace_respond(listener, &notif, 0))
+                {
+                    WARN("failed to answer notification: %llu", notif.id);
+                }
             }
-            RELOCK(psbox, SH);
         }
-        UNLOCK(psbox);
         
-        /* Schedule for next trace */
-#ifdef WITH_SOFTWARE_TSC
-        if (!trace_next(&proc, TRACE_SINGLE_STEP))
-#else /* WITHOUT_SOFTWARE_TSC */
-        if (!trace_next(&proc, TRACE_SYSTEM_CALL))
-#endif /* WITH_SOFTWARE_TSC */
+        if (pfd[1].revents & POLLIN)
         {
-            MONITOR_ERROR(psbox, "failed to schedule next watch");
+            /* Leave the prisoner process as zombie, such that its final stat
+             * can be probed. It is then discarded by trace_end(). */
+            if (waitid(P_PID, pid, &w_info, WEXITED | WNOWAIT) != 0)
+            {
+                MONITOR_ERROR(psbox, "failed to wait process: %d", pid);
+                break;
+            }
+            proc_probe(pid, PROBE_STAT, pproc);
             LOCK(psbox, SH);
-            if (HAS_RESULT(psbox))
+            const bool decided = HAS_RESULT(psbox);
+            UNLOCK(psbox);
+            if (decided)
             {
-                DBUG("exiting the watching loop");
+                /* The prisoner process was terminated by the policy */
+                DBUG("wait: terminated (%d)", w_info.si_status);
+            }
+            else if (w_info.si_code == CLD_EXITED)
+            {
+                DBUG("wait: exited (%d)", w_info.si_status);
+                LOCK(psbox, EX);
+                psbox->stat.exitcode = w_info.si_status;
                 UNLOCK(psbox);
-                break;
+                __sandbox_capture_wait(psbox);
+                POST_EVENT(psbox, _EXIT, w_info.si_status);
             }
             else
             {
+                /* Signal info of the prisoner process is not available without
+                 * ptrace, so the si_code is reported as 0 */
+                DBUG("wait: signaled (%d)", w_info.si_status);
+                if (w_info.si_status == SIGXFSZ)
+                {
+                    POST_EVENT(psbox, _QUOTA, S_QUOTA_DISK);
+                }
+                else if (w_info.si_status == SIGXCPU)
+                {
+                    POST_EVENT(psbox, _QUOTA, S_QUOTA_CPU);
+                }
+                else
+                {
+                    POST_EVENT(psbox, _SIGNAL, w_info.si_status, 0);
+                }
+                LOCK(psbox, EX);
+                psbox->stat.signal.signo = w_info.si_status;
+                psbox->stat.signal.code = 0;
                 UNLOCK(psbox);
             }
+            pending = exited = true;
         }
         
-        UPDATE_STATUS(psbox, S_STATUS_EXE);
-    }
-    
-    UPDATE_STATUS(psbox, S_STATUS_FIN);
-    
-    LOCK(psbox, EX);
-    if (!HAS_RESULT(psbox))
-    {
-        __UPDATE_RESULT(psbox, S_RESULT_BP);
+        if ((setup == 1) && SETUP_DONE(pproc))
+        {
+            DBUG("detected: post-execve process");
+            setup = 0;
+            UPDATE_STATUS(psbox, S_STATUS_EXE);
+        }
+        
+        if (pending)
+        {
+            /* Update resource usage statistics. */
+            __sandbox_stat_update(psbox, pproc);
+            NOTIFY(psbox, NOTICE_PROF);
+        }
+        
+        /* Deliver pending events (including those posted by other monitor 
+         * threads) to the policy module for investigation */
+        if ((setup == 0) || exited)
+        {
+            killed = __sandbox_ctrl_dispatch(psbox, cache, &noret);
+        }
+        
+        /* Either terminate the prisoner process, or let the notified system
+         * call proceed */
+        if (killed)
+        {
+            kill(-pid, SIGKILL);
+        }
+        else if (pending && !exited)
+        {
+            if (!trace_respond(listener, &notif, 0))
+            {
+                WARN("failed to answer notification: %llu", notif.id);
+            }
+        }
+        
+        if (pending && (setup == 0))
+        {
+            UPDATE_STATUS(psbox, S_STATUS_EXE);
+        }
     }
-    UNLOCK(psbox);
     
-    /* Notify the main tracer thread to return */
-    trace_end(&proc);
+    close(pidfd);
     
-    MONITOR_END(psbox);
+    PROC_END();
 }
+#endif /* HAVE_PIDFD */
 
 void 
 sandbox_default_policy(const policy_t * ppolicy, const event_t * pevent, 
@@ -1285,6 +5302,9 @@ sandbox_default_policy(const policy_t * ppolicy, const event_t * pevent,
             break;
         }
         break;
+    case S_EVENT_OUTPUT:
+        *paction = (action_t){S_ACTION_KILL, {{S_RESULT_WA}}};
+        break;
     default:
         *paction = (action_t){S_ACTION_KILL, {{S_RESULT_IE}}};
         break;
@@ -1301,6 +5321,7 @@ sandbox_profiler(sandbox_t * psbox)
     /* Temporary variables */
     LOCK(psbox, SH);
     const pid_t pid = psbox->ctrl.pid;
+    const int link = psbox->ctrl.link.fd;
     proc_t proc = {0};
     proc_bind(psbox, &proc);
     UNLOCK(psbox);
@@ -1308,7 +5329,7 @@ sandbox_profiler(sandbox_t * psbox)
     /* Profiling is by means of sampling the resource usage of the prisoner 
      * process at a relatively high frequency, and raise out-of-quota events
      * as soon as they happen. Other monitor threads may trigger profiling
-     * by sending SIGSTAT signals to the profiler thread. */
+     * by sending NOTICE_STAT notices to the profiler thread. */
     
     clockid_t clockid;
     struct timespec ts;
@@ -1327,11 +5348,7 @@ sandbox_profiler(sandbox_t * psbox)
      * the process running libsandbox, whose size does not represent the memory
      * usage of the prisoner process, and may exceed the (mem) quota! */
     
-    sigset_t sigmask;
-    sigemptyset(&sigmask);
-    sigaddset(&sigmask, SIGEXIT);
-    sigaddset(&sigmask, SIGSTAT);
-    sigaddset(&sigmask, SIGPROF);
+    unsigned long mask = NOTICE_EXIT | NOTICE_KILL | NOTICE_STAT | NOTICE_PROF;
     
     LOCK_ON_COND(psbox, SH, !IS_BLOCKED(psbox));
     
@@ -1339,39 +5356,45 @@ sandbox_profiler(sandbox_t * psbox)
     {
         UNLOCK(psbox);
         
-        int signo;
-        siginfo_t siginfo;
-        if ((signo = sigwaitinfo(&sigmask, &siginfo)) < 0)
+        eventfd_t count;
+        if (eventfd_read(psbox->ctrl.notice.fd, &count) != 0)
         {
-            WARN("failed to sigwaitinfo()");
+            WARN("failed to read notices");
             goto check_status;
         }
         
-        switch (signo)
+        const unsigned long notice = mask & 
+            __sync_fetch_and_and(&psbox->ctrl.notice.pending, 0);
+        bool sample = (notice & (NOTICE_STAT | NOTICE_PROF));
+        
+        if (notice & NOTICE_STAT)
         {
-        case SIGSTAT:
             /* Collect stat of the prisoner process */
             if (!proc_probe(pid, PROBE_STAT, &proc))
             {
                 WARN("failed to probe process: %d", pid);
                 /* Do NOT raise monitor error here because the prisoner process
                  * may have gone making proc_probe() to fail. */
-                break;
+                sample = false;
             }
-            
-            /* Update resource usage statistics. */
-            __sandbox_stat_update(psbox, &proc);
-            
-            /* NOTE: do NOT break here, proceed to cpu clock profiling */
-        case SIGPROF:
-            /* Sample the cpu clock time of the prisoner process */
-            if (clock_gettime(clockid, &ts) != 0)
+            else
             {
-                WARN("failed to get the prisoner's cpu clock time");
-                /* Do NOT raise monitor error here because the prisoner process
-                 * may have gone making the clock invalid. */
-                break;
+                /* Update resource usage statistics. */
+                __sandbox_stat_update(psbox, &proc);
             }
+        }
+        
+        /* Sample the cpu clock time of the prisoner process */
+        if (sample && (clock_gettime(clockid, &ts) != 0))
+        {
+            WARN("failed to get the prisoner's cpu clock time");
+            /* Do NOT raise monitor error here because the prisoner process
+             * may have gone making the clock invalid. */
+            sample = false;
+        }
+        
+        if (sample)
+        {
             /* Update sandbox stat with the sampled data */
             LOCK(psbox, EX);
             TS_UPDATE(psbox->stat.cpu_info.clock, ts);
@@ -1384,52 +5407,343 @@ sandbox_profiler(sandbox_t * psbox)
                 POST_EVENT(psbox, _QUOTA, S_QUOTA_CPU);
                 trace_kill(&proc, SIGSTOP);
                 trace_kill(&proc, SIGCONT);
-                /* Block the profiling signal upon the first out-of-quota (cpu)
+                /* Mask the profiling notice upon the first out-of-quota (cpu)
                  * event. This avoids jamming the event queue in case the user-
                  * specified policy module ignores out-of-quota events. */
-                sigdelset(&sigmask, SIGPROF);
+                mask &= ~NOTICE_PROF;
             }
             else
             {
                 UNLOCK(psbox);
             }
+        }
+        
+        /* Sample the prisoner process asleep with no input pending from the
+         * linked sandbox, i.e. waiting on the peer */
+        if (sample && (link >= 0) && (feed_pending(link) == 0) && 
+            proc_probe(pid, PROBE_STAT, &proc) && (proc.state == 'S'))
+        {
+            LOCK(psbox, EX);
+            psbox->stat.link.wait += 1000 / PROF_FREQ;
+            UNLOCK(psbox);
+        }
+        
+        if (notice & NOTICE_KILL)
+        {
+            /* When the process running libsandbox is about to quit, try to
+             * terminate the prisoner process. Since this is not the fault of
+             * the prisoner process, it is reported as a monitor error. */
+            errno = EINTR;
+            MONITOR_ERROR(psbox, "process running libsandbox is quitting");
+        }
+        
+        /* Do NOT exit the profiling loop immediately upon NOTICE_EXIT. Instead,
+         * go back to the front to verify if the watcher thread is finished. */
+
+check_status:
+        LOCK(psbox, SH);
+    }
+    UNLOCK(psbox);
+    
+    MONITOR_END(psbox);
+}
+
+void *
+sandbox_capturer(sandbox_t * psbox)
+{
+    MONITOR_BEGIN(psbox);
+    
+    /* Temporary variables */
+    LOCK(psbox, SH);
+    const int fd[2] = {psbox->ctrl.capture.fd, psbox->ctrl.capture.efd};
+    const int answer = psbox->task.capture.answer;
+    const compare_t compare = psbox->task.capture.enabled ? 
+        psbox->task.capture.compare : S_COMPARE_NONE;
+    const double epsilon = psbox->task.capture.epsilon;
+    const res_t quota = psbox->task.quota[S_QUOTA_DISK];
+    int dst[2] = {psbox->task.ofd, psbox->task.efd};
+    const bool linked = (psbox->ctrl.link.peer != NULL);
+    proc_t proc = {0};
+    proc_bind(psbox, &proc);
+    UNLOCK(psbox);
+    
+    /* The capture thread drains the standard output (and maybe the standard 
+     * error) of the prisoner process from the capture pipes, forwards it to 
+     * the output channels of the task, and compares the standard output with
+     * the answer as it comes. Output beyond the disk quota is posted as an 
+     * S_EVENT_QUOTA event and no longer forwarded, and the first mismatch is
+     * posted as an S_EVENT_OUTPUT event. Either way, the prisoner process is
+     * stopped and continued (as is the case with cpu quota) to have the event
+     * dispatched by the watcher thread without waiting for the next system 
+     * call. The pipes are drained to the end, event or not. */
+    
+    bool stream[2] = {false, false};
+    int k;
+    for (k = 0; k < 2; k++)
+    {
+        struct stat s;
+        stream[k] = (fstat(dst[k], &s) == 0) && 
+            (S_ISFIFO(s.st_mode) || S_ISSOCK(s.st_mode));
+    }
+    
+    digest_t digest;
+    __sandbox_digest_init(&digest);
+    sha256_t sha;
+    const bool sha256 = psbox->task.capture.sha256;
+    if (sha256)
+    {
+        __sandbox_sha256_init(&sha);
+    }
+    
+    matcher_t matcher;
+    if (!__sandbox_match_init(&matcher, answer, compare, epsilon))
+    {
+        MONITOR_ERROR(psbox, "failed to map the answer file");
+        matcher.mode = S_COMPARE_NONE;
+    }
+    
+    /* Once the prisoner process is gone, only the residue of the pipes (up to
+     * the default pipe-max-size of linux) is drained, regardless of other 
+     * writers, e.g. descendants of a trusted prisoner process */
+    size_t residue = 16 * (SBOX_CAPTURE_MAX);
+    char buff[SBOX_CAPTURE_MAX];
+    struct pollfd pfd[2] = {{fd[0], POLLIN, 0}, {fd[1], POLLIN, 0}};
+    res_t bytes = 0;
+    res_t total = 0;
+    long long mismatch = -1;
+    bool eof = false;
+    bool exceeded = false;
+    int last = 1;
+    
+    while ((pfd[0].fd >= 0) || (pfd[1].fd >= 0))
+    {
+        LOCK(psbox, SH);
+        const bool gone = psbox->ctrl.capture.exited || IS_FINISHED(psbox);
+        UNLOCK(psbox);
+        
+        const int res = poll(pfd, 2, gone ? 0 : (1000 / PROF_FREQ));
+        if (res < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            WARN("failed to poll the capture pipes");
             break;
-        case SIGEXIT:
-            if (siginfo.si_code != SI_QUEUE)
+        }
+        if (res == 0)
+        {
+            if (gone)
             {
-                DBUG("termination signal %d", signo);
                 break;
             }
-            /* Extract the real signal from siginfo */
-            switch (siginfo.si_int)
+            continue;
+        }
+        
+        /* Drain the pipes with pending output in turn */
+        k = ((pfd[0].revents != 0) && ((pfd[1].revents == 0) || 
+            (last == 1))) ? 0 : 1;
+        last = k;
+        const ssize_t len = read(fd[k], buff, sizeof(buff));
+        if (len < 0)
+        {
+            if ((errno == EINTR) || (errno == EAGAIN))
             {
-            case SIGTERM:
-            case SIGQUIT:
-            case SIGINT:
-                /* These signals are forwarded to the prisoner process. This
-                 * allows shell programs running libsandbox to respond to user 
-                 * emitted signals such as <Ctrl> + C (i.e. SIGINT). */
-                errno = EINTR;
-                WARN("termination signal %d", siginfo.si_int);
-                trace_kill(&proc, signo);
-                break;
-            default:
-                /* When the process running libsandbox is interrupted by an
-                 * unexpected signal, try to terminate the prisoner process.
-                 * Since this is not the fault of the prisoner process, the 
-                 * signal is reported as a monitor error. */
-                errno = EINTR;
-                MONITOR_ERROR(psbox, "unexpected signal %d", siginfo.si_int);
-                break;
+                continue;
+            }
+            WARN("failed to read capture pipe %d", fd[k]);
+            break;
+        }
+        if (len == 0)
+        {
+            eof = eof || (k == 0);
+            pfd[k].fd = -1;
+            continue;
+        }
+        
+        bool found = false;
+        if ((k == 0) && (mismatch < 0))
+        {
+            mismatch = __sandbox_match_feed(&matcher, buff, len);
+            found = (mismatch >= 0);
+        }
+        if (k == 0)
+        {
+            __sandbox_digest_feed(&digest, buff, len);
+            if (sha256)
+            {
+                __sandbox_sha256_feed(&sha, buff, len);
             }
-            /* Do NOT exit the profiling loop immediately. Instead, go back to
-             * the front to verify if the watcher thread is already finished. */
+            bytes += len;
+        }
+        
+        /* Forward no more than the disk quota */
+        size_t n = (size_t)len;
+        if (total + len > quota)
+        {
+            n = (total < quota) ? (size_t)(quota - total) : 0;
+        }
+        total += len;
+        
+        LOCK(psbox, EX);
+        psbox->stat.output.bytes = bytes;
+        psbox->stat.output.mismatch = mismatch;
+        UNLOCK(psbox);
+        
+        if (!exceeded && (n < (size_t)len))
+        {
+            DBUG("output exceeded the disk quota at %llu bytes", 
+                (unsigned long long)quota);
+            exceeded = found = true;
+            POST_EVENT(psbox, _QUOTA, S_QUOTA_DISK);
+        }
+        else if (found)
+        {
+            DBUG("output mismatch at offset %lld", mismatch);
+            POST_EVENT(psbox, _OUTPUT, mismatch);
+        }
+        if (found && !gone)
+        {
+            trace_kill(&proc, SIGSTOP);
+            trace_kill(&proc, SIGCONT);
+        }
+        
+        const size_t sent = ((dst[k] >= 0) && (n > 0)) ? 
+            __sandbox_capture_forward(psbox, dst[k], buff, n, stream[k]) : 0;
+        if (linked && (k == 0))
+        {
+            LOCK(psbox, EX);
+            psbox->stat.link.sent += sent;
+            UNLOCK(psbox);
+        }
+        if ((dst[k] >= 0) && (sent < n))
+        {
+            WARN("failed to forward captured output to fd %d", dst[k]);
+            dst[k] = -1;
+        }
+        
+        if (gone && ((residue -= (residue < (size_t)len) ? residue : 
+            (size_t)len) == 0))
+        {
+            WARN("abandoned output beyond the residue of the capture pipes");
             break;
         }
+    }
+    
+    /* Output ending ahead of the answer, or amid a mismatching token, is a 
+     * mismatch at its end (or at the start of the token) */
+    if (eof && (mismatch < 0) && 
+        ((mismatch = __sandbox_match_end(&matcher)) >= 0))
+    {
+        DBUG("output mismatch at offset %lld", mismatch);
+        LOCK(psbox, EX);
+        psbox->stat.output.mismatch = mismatch;
+        UNLOCK(psbox);
+        POST_EVENT(psbox, _OUTPUT, mismatch);
+    }
+    __sandbox_match_fini(&matcher);
+    
+    /* Release the capture pipes, the watcher thread may be waiting for them 
+     * to report the exit of the prisoner process */
+    LOCK(psbox, EX);
+    psbox->stat.output.digest = __sandbox_digest_end(&digest);
+    if (sha256)
+    {
+        __sandbox_sha256_end(&sha, psbox->stat.output.sha256);
+    }
+    close(fd[0]);
+    close(fd[1]);
+    psbox->ctrl.capture.fd = -1;
+    psbox->ctrl.capture.efd = -1;
+    UNLOCK(psbox);
+    
+    MONITOR_END(psbox);
+}
 
-check_status:
+void *
+sandbox_feeder(sandbox_t * psbox)
+{
+    MONITOR_BEGIN(psbox);
+    
+    /* Temporary variables */
+    LOCK(psbox, SH);
+    const int fd = psbox->ctrl.feed.fd;
+    const void * const data = psbox->task.feed.data;
+    const int src = psbox->task.feed.fd;
+    long long offset = psbox->task.feed.offset;
+    const long long size = psbox->ctrl.feed.size;
+    UNLOCK(psbox);
+    
+    /* The feed thread moves the input into the feeding pipe as fast as the 
+     * prisoner process drains it, and closes the pipe at the end of the input
+     * (or once the prisoner process is gone), such that the prisoner process
+     * sees the end of its standard input. */
+    
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    long long bytes = 0;
+    
+    while (bytes < size)
+    {
         LOCK(psbox, SH);
+        const bool gone = psbox->ctrl.capture.exited || IS_FINISHED(psbox);
+        UNLOCK(psbox);
+        if (gone)
+        {
+            break;
+        }
+        
+        const int res = poll(&pfd, 1, 1000 / PROF_FREQ);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            WARN("failed to poll the feeding pipe");
+            break;
+        }
+        if (res == 0)
+        {
+            continue;
+        }
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            DBUG("prisoner process closed its standard input");
+            break;
+        }
+        
+        const size_t len = (size_t)(size - bytes);
+        const ssize_t n = (data != NULL) ? 
+            feed_memory(fd, (const char *)data + bytes, len) : 
+            feed_file(fd, src, &offset, len);
+        if (n < 0)
+        {
+            if ((errno == EINTR) || (errno == EAGAIN))
+            {
+                continue;
+            }
+            if (errno != EPIPE)
+            {
+                WARN("failed to feed input to pipe %d", fd);
+            }
+            break;
+        }
+        if (n == 0)
+        {
+            WARN("input file ended ahead of its size");
+            break;
+        }
+        bytes += n;
+        
+        LOCK(psbox, EX);
+        psbox->stat.input.bytes = bytes;
+        UNLOCK(psbox);
     }
+    
+    /* Close the feeding pipe to mark the end of the input */
+    LOCK(psbox, EX);
+    close(fd);
+    psbox->ctrl.feed.fd = -1;
     UNLOCK(psbox);
     
     MONITOR_END(psbox);
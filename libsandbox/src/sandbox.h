@@ -77,6 +77,21 @@ extern "C"
 #define RES_INFINITY SBOX_QUOTA_INF
 #endif /* RES_INFINITY */
 
+#ifndef SBOX_CPU_ANY
+#define SBOX_CPU_ANY            (-1)    /* float on all allowed cpu's */
+#endif /* SBOX_CPU_ANY */
+
+#ifndef SBOX_CPU_AUTO
+#define SBOX_CPU_AUTO           (-2)    /* let libsandbox pick a cpu */
+#endif /* SBOX_CPU_AUTO */
+
+/* Maximum number of paths in the filesystem allow-list of a task */
+#ifndef SBOX_FS_MAX
+#define SBOX_FS_MAX             16
+#else
+#warning "overriding default filesystem allow-list size"
+#endif /* SBOX_FS_MAX */
+
 /* Maximum number of monitor threads */
 #ifndef SBOX_MONITOR_MAX
 #define SBOX_MONITOR_MAX        8
@@ -91,13 +106,32 @@ extern "C"
 #warning "overriding default event queue size"
 #endif /* SBOX_EVENT_MAX */
 
+/* Number of slots in the decision cache, must be a power of 2 */
+#ifndef SBOX_CACHE_MAX
+#define SBOX_CACHE_MAX          128
+#else
+#warning "overriding default decision cache size"
+#endif /* SBOX_CACHE_MAX */
+    
+/* Size of the buffer for draining captured output (since 0.3.6) */
+#ifndef SBOX_CAPTURE_MAX
+#define SBOX_CAPTURE_MAX        65536
+#else
+#warning "overriding default capture buffer size"
+#endif /* SBOX_CAPTURE_MAX */
+
 /**
- * @brief Serialized representation of a command and its arguments.
+ * @brief Command line arguments and environment of the targeted program.
+ *
+ * Both NULL-terminated arrays, and the strings they point to, are stored in a
+ * single right-sized arena on the heap (since 0.3.6). The arena is owned by 
+ * the sandbox, and replaced with \c sandbox_command(). Strings beyond the 
+ * first SBOX_ARG_MAX bytes of either array are discarded.
  */
 typedef struct
 {
-    char buff[SBOX_ARG_MAX];    /**< command line buffer */
-    int args[SBOX_ARG_MAX];     /**< arguments offset */
+    char ** args;               /**< arguments, at the beginning of the arena */
+    char ** envs;               /**< environment, within the arena */
 } command_t;
 
 /**
@@ -118,8 +152,225 @@ typedef enum
  */
 typedef rlim_t res_t;
 
+/**
+ * @brief CPU placement of the prisoner process and its tracer threads.
+ *
+ * Each field is either a cpu number, or one of SBOX_CPU_ANY and SBOX_CPU_AUTO.
+ * An automatic prisoner is placed on an idle cpu that is not used by other
+ * active sandboxes, and an automatic tracer is placed on the sibling (hyper-
+ * thread) of the prisoner's cpu. Set the tracer to a fixed cpu number to run
+ * the tracer threads of all sandboxes on a shared housekeeping cpu instead.
+ */
+typedef struct
+{
+    int prisoner;               /**< cpu to run the targeted program on */
+    int tracer;                 /**< cpu to run the tracer threads on */
+} placement_t;
+
+/**
+ * @brief Types of filesystem access granted beneath a path (since 0.3.6).
+ */
+typedef enum
+{
+    S_FS_NONE          = 0,     /*!< No access */
+    S_FS_READ          = 1,     /*!< Read and execute */
+    S_FS_WRITE         = 2,     /*!< Read, execute, write, create and remove */
+} fs_access_t;
+
+/**
+ * @brief Filesystem allow-list of a task (since 0.3.6).
+ *
+ * Paths are absolute (inside the jail), and serialized into \c buff in the 
+ * same way as the arguments of \c command_t. A non-empty allow-list is 
+ * enforced by *landlock* (linux 5.13 or later) in the prisoner process right
+ * before executing the targeted program: files beneath a path are accessible
+ * as granted, and the rest of the filesystem is not accessible at all. This 
+ * frees the policy object from inspecting the paths of file system calls. The
+ * targeted program (and its shared libraries, if any) must be readable. 
+ * Landlock can only grant access, so an *S_FS_NONE* entry beneath another 
+ * path is rejected. Without landlock, the allow-list cannot be enforced, and 
+ * tasks with a non-empty allow-list are rejected, see 
+ * \c sandbox_fs_enforced().
+ */
+typedef struct
+{
+    char buff[SBOX_PATH_MAX];   /**< serialized paths */
+    int path[SBOX_FS_MAX];      /**< offsets of paths, terminated with -1 */
+    fs_access_t access[SBOX_FS_MAX]; /**< access granted beneath each path */
+} filesys_t;
+
+/**
+ * @brief Jail image of a task (since 0.3.6).
+ *
+ * A jail image is a prepared jail directory shared by many tasks (e.g. the 
+ * runtime of a language), which is set up in the fresh mount namespace of the
+ * prisoner process (see \c S_NS_MOUNT) rather than being copied per task. 
+ * The jail is bind-mounted onto itself, read-only if \c readonly is set. A 
+ * size-limited tmpfs for scratch writes is mounted onto the \c scratch 
+ * directory beneath the jail, if specified. The per-task program file at 
+ * \c prog (outside of the jail), if specified, is bind-mounted read-only onto
+ * the program path of the command line (inside of the jail), which is either
+ * an existing file in the image, or created in the scratch tmpfs. None of the
+ * mounts are visible outside of the prisoner process.
+ */
+typedef struct
+{
+    bool readonly;              /**< mount the jail read-only */
+    char prog[SBOX_PATH_MAX];   /**< program file to be bound, or "" */
+    char scratch[SBOX_PATH_MAX]; /**< tmpfs mount point in the jail, or "" */
+    res_t size;                 /**< size limit of the tmpfs, 0 for default */
+} image_t;
+
+/**
+ * @brief Trust levels of the targeted program (since 0.3.6).
+ *
+ * A fully trusted program (e.g. a reference solution) is neither traced nor
+ * filtered, its system calls are never reported to the policy object. Quotas
+ * are still enforced by the profiler and by resource limits of the prisoner 
+ * process, and the results are reported in the same way. Note that memory 
+ * usage is only sampled by the profiler, a trusted program may allocate well
+ * beyond its memory quota before being terminated.
+ */
+typedef enum
+{
+    S_TRUST_NONE       = 0,     /*!< Untrusted, watched by ctrl_t backend */
+    S_TRUST_FULL       = 1,     /*!< Trusted, watched with quotas only */
+} trust_t;
+
+/**
+ * @brief Namespaces to start the prisoner process in (since 0.3.6).
+ *
+ * Values are bits to be combined into the \c ns field of \c task_t. Inside 
+ * fresh namespaces, system calls such as socket(), kill() or getpid() cannot 
+ * reach the network, other processes or mount points of the host, and may be
+ * allowed by the policy without further inspection. Except for \c S_NS_USER,
+ * namespaces can only be created by a privileged process, or together with 
+ * \c S_NS_USER. The latter has no effect for a privileged process, which 
+ * drops its privileges by changing identity (i.e. uid, gid) anyway. 
+ *
+ * In a fresh pid namespace, the prisoner process is the init process and 
+ * ignores signals of default action sent by itself. In a fresh mount 
+ * namespace, all mount points are private to the prisoner process, and a 
+ * fresh procfs is mounted onto the \c proc directory beneath the jail (if 
+ * present) when combined with \c S_NS_PID. The jail then becomes the root 
+ * with pivot_root(), and the mount tree of the host is detached. Note that 
+ * with the jail being "/", the mount tree of the host is kept (though private
+ * to the prisoner process); no minimal tree is built in its place. 
+ */
+typedef enum
+{
+    S_NS_NONE          = 0,     /*!< Namespaces of the calling process */
+    S_NS_USER          = 1,     /*!< Fresh user namespace */
+    S_NS_PID           = 2,     /*!< Fresh pid namespace */
+    S_NS_MOUNT         = 4,     /*!< Fresh mount namespace */
+    S_NS_NET           = 8,     /*!< Fresh network namespace */
+    S_NS_IPC           = 16,    /*!< Fresh ipc namespace */
+    S_NS_UTS           = 32,    /*!< Fresh uts namespace */
+    S_NS_ALL           = 63,    /*!< All of the above */
+} ns_type_t;
+
+/**
+ * @brief Identity of the targeted program as of the validation of a task 
+ * template (since 0.3.6). 
+ *
+ * Tasks instantiated from a validated template carry its stamp, and skip the
+ * validation of static fields (i.e. comm, jail, uid, gid, fs, trust, ns, 
+ * image, xfd) as long as the program file is neither replaced nor modified. 
+ * An all-zero stamp means the task is validated from scratch.
+ */
+typedef struct
+{
+    dev_t dev;                  /**< device of the program file */
+    ino_t ino;                  /**< inode of the program file */
+    struct timespec mtime;      /**< last modification of file content */
+    struct timespec ctime;      /**< last change of file status */
+} stamp_t;
+
+/**
+ * @brief Comparison of captured output with the expected output (since 
+ * 0.3.6).
+ */
+typedef enum
+{
+    S_COMPARE_NONE     = 0,     /*!< capture only, without comparison */
+    S_COMPARE_BYTE     = 1,     /*!< byte-by-byte comparison */
+    S_COMPARE_TOKEN    = 2,     /*!< whitespace-separated token comparison */
+    S_COMPARE_NOCASE   = 3,     /*!< token comparison ignoring ascii case */
+    S_COMPARE_FLOAT    = 4,     /*!< token comparison with float tolerance */
+} compare_t;
+
+/**
+ * @brief Capture of the standard output of the targeted program (since 
+ * 0.3.6).
+ *
+ * When enabled, the standard output of the prisoner process is a pipe owned 
+ * by the sandbox. A capture thread drains the pipe through a bounded buffer, 
+ * forwards the captured bytes to \c ofd of the task, and compares them 
+ * incrementally with the memory-mapped \c answer file. The first mismatch 
+ * (including missing or excess output) raises an *S_EVENT_OUTPUT* event with
+ * the offset of the mismatch in the captured output. Captured bytes, their 
+ * XXH64 digest, and the offset of the mismatch are reported in field output
+ * of \c stat_t. The exit of the prisoner process is reported after all of
+ * its output is compared.
+ *
+ * The digests are computed on the fly as the pipe is drained, such that the
+ * output is fingerprinted without a second pass over the data. The SHA-256 
+ * digest is computed if \c sha256 is set, which captures the standard output
+ * even if \c enabled is not set (since 0.3.6).
+ *
+ * Regardless of \c enabled, output channels other than regular files (e.g. 
+ * pipes and sockets) are captured and forwarded by the capture thread if the
+ * task has a finite *S_QUOTA_DISK*, which is otherwise enforced on regular 
+ * files only. Bytes written to \c ofd and \c efd count towards the quota, 
+ * and output beyond the quota raises an *S_EVENT_QUOTA* event instead of 
+ * being forwarded (since 0.3.6).
+ *
+ * With *S_COMPARE_FLOAT* (since 0.3.6), a pair of numeric tokens matches if 
+ * they differ by no more than \c epsilon, either absolutely or relatively 
+ * to the token of the answer; other tokens are compared as is. The offset of
+ * a mismatching token is that of its first byte.
+ */
+typedef struct
+{
+    bool enabled;               /**< capture the standard output */
+    compare_t compare;          /**< comparison with the answer file */
+    int answer;                 /**< file of the expected output, or -1 */
+    double epsilon;             /**< tolerance of *S_COMPARE_FLOAT* */
+    bool sha256;                /**< also compute the SHA-256 digest */
+} capture_t;
+
+/**
+ * @brief Input fed to the standard input of the targeted program (since 
+ * 0.3.6).
+ *
+ * A task with either a memory buffer \c data, or a region of a regular file 
+ * \c fd, feeds it to the standard input of the prisoner process in place of 
+ * \c ifd. Unless \c seekable, the input is fed through a pipe by a feeder 
+ * thread, which moves (rather than copies) the pages of the memory or the 
+ * file into the pipe, so the memory should not be modified until the task is
+ * finished. A \c seekable input is handed to the prisoner process as a file,
+ * i.e. \c fd itself if the region covers the entire file, or otherwise a 
+ * sealed memfd holding a copy of the input. Bytes of the input fed to and 
+ * consumed by the prisoner process are reported in field input of \c stat_t.
+ */
+typedef struct
+{
+    const void * data;          /**< memory buffer to be fed, or NULL */
+    int fd;                     /**< file with the region to be fed, or -1 */
+    long long offset;           /**< offset of the region in the file */
+    long long size;             /**< size of the buffer or the region, or -1 
+                                     for the rest of the file */
+    bool seekable;              /**< feed a file rather than a pipe */
+} feed_t;
+
 /**
  * @brief Static specification of a task.
+ *
+ * With a valid \c xfd (since 0.3.6), the targeted program is executed from 
+ * the open file (e.g. a sealed memfd) rather than from the program path of 
+ * \c comm, which is only the name of the program (and still has to be beneath
+ * the jail). The file is validated with fstat() and not inherited by the 
+ * targeted program, so a check-to-execute race on the path is ruled out.
  */
 typedef struct
 {
@@ -131,6 +382,15 @@ typedef struct
     int ofd;                    /**< file descriptor for task output */
     int efd;                    /**< file descriptor for task error log */
     res_t quota[QUOTA_TOTAL];   /**< block the task program if quota exceeds */
+    placement_t cpu;            /**< requested cpu placement (since 0.3.6) */
+    filesys_t fs;               /**< filesystem allow-list (since 0.3.6) */
+    trust_t trust;              /**< trust level of program (since 0.3.6) */
+    int ns;                     /**< bitmask of ns_type_t (since 0.3.6) */
+    image_t image;              /**< jail image (since 0.3.6) */
+    int xfd;                    /**< executable file, or -1 (since 0.3.6) */
+    capture_t capture;          /**< output capture (since 0.3.6) */
+    feed_t feed;                /**< input feeding (since 0.3.6) */
+    stamp_t stamp;              /**< stamp of template (since 0.3.6) */
 } task_t;
 
 #ifndef HAVE_SYSCALL_T
@@ -179,6 +439,32 @@ typedef struct
     long syscall;               /**< last / current syscall info */
     signal_t signal;            /**< last / current signal info */
     int exitcode;               /**< exit code */
+    placement_t placement;      /**< effective cpu placement (since 0.3.6) */
+    struct
+    {
+        unsigned long hit;      /**< decisions answered by the cache */
+        unsigned long miss;     /**< decisions made by the policy */
+    } cache;                    /**< decision cache stat (since 0.3.6) */
+    struct
+    {
+        res_t bytes;            /**< bytes captured from the standard output */
+        long long mismatch;     /**< offset of the first mismatch, or -1 */
+        unsigned long long digest; /**< XXH64 of the captured bytes */
+        unsigned char sha256[32]; /**< SHA-256 of the captured bytes */
+    } output;                   /**< output capture stat (since 0.3.6) */
+    struct
+    {
+        res_t bytes;            /**< bytes fed to the standard input */
+        res_t consumed;         /**< bytes consumed by the prisoner process */
+    } input;                    /**< input feeding stat (since 0.3.6) */
+    struct
+    {
+        res_t sent;             /**< bytes sent to the linked sandbox */
+        res_t received;         /**< bytes received from the linked sandbox */
+        res_t wait;             /**< msec spent waiting on the linked peer */
+    } link;                     /**< linked execution stat (since 0.3.6) */
+    bool memoized;              /**< replayed from the result cache (since 
+                                     0.3.6) */
 } stat_t;
 
 /**
@@ -214,6 +500,7 @@ typedef enum
     S_RESULT_R3        = 13,    /*!< Reserved result type 3 (since 0.3.2) */
     S_RESULT_R4        = 14,    /*!< Reserved result type 4 (since 0.3.2) */
     S_RESULT_R5        = 15,    /*!< Reserved result type 5 (since 0.3.2) */
+    S_RESULT_WA        = 16,    /*!< Wrong Answer (since 0.3.6) */
 } result_t;
 
 /**
@@ -227,6 +514,7 @@ typedef enum
     S_EVENT_SYSCALL    = 3,     /*!< target program issued a system call */
     S_EVENT_SYSRET     = 4,     /*!< target program returned from system call */
     S_EVENT_QUOTA      = 5,     /*!< target program exceeds resource quota */
+    S_EVENT_OUTPUT     = 6,     /*!< target program output mismatches answer */
 } event_type_t;
 
 /**
@@ -270,6 +558,10 @@ typedef union
     {
         long type;
     } _QUOTA;
+    struct
+    {
+        long offset;            /* offset of the mismatch (since 0.3.6) */
+    } _OUTPUT;
 } event_data_t;
 
 /**
@@ -289,9 +581,31 @@ typedef enum
     S_ACTION_CONT      = 0,     /*!< Continute */
     S_ACTION_FINI      = 1,     /*!< Finish (safe exit) */
     S_ACTION_KILL      = 2,     /*!< Kill (instant exit) */
+    S_ACTION_CONT_NORET = 3,    /*!< Continue, skip return (since 0.3.6) */
     /* TODO identify other action types */
 } action_type_t;
 
+/**
+ * @brief Keys of cacheable decisions (since 0.3.6).
+ *
+ * A policy may mark its *S_ACTION_CONT* or *S_ACTION_CONT_NORET* decision on
+ * an *S_EVENT_SYSCALL* event as cacheable, by setting the *cache* field of the
+ * action data to *S_CACHE_SCINFO*, optionally OR'ed with some of 
+ * *S_CACHE_ARG1* - *S_CACHE_ARG6*. Later system calls with the same scinfo and
+ * values of the selected arguments are then answered from a small decision 
+ * cache of the watcher, without consulting the policy.
+ */
+typedef enum
+{
+    S_CACHE_ARG1       = (1 << 0),      /*!< Key includes argument 1 */
+    S_CACHE_ARG2       = (1 << 1),      /*!< Key includes argument 2 */
+    S_CACHE_ARG3       = (1 << 2),      /*!< Key includes argument 3 */
+    S_CACHE_ARG4       = (1 << 3),      /*!< Key includes argument 4 */
+    S_CACHE_ARG5       = (1 << 4),      /*!< Key includes argument 5 */
+    S_CACHE_ARG6       = (1 << 5),      /*!< Key includes argument 6 */
+    S_CACHE_SCINFO     = (1 << 7),      /*!< Key includes scinfo (required) */
+} cache_key_t;
+
 /**
  * @brief Action specific data bindings.
  */
@@ -303,7 +617,7 @@ typedef union
     } __bitmap__;
     struct
     {
-        int reserved;
+        int cache;              /* cache key (S_CACHE_*) or 0 (since 0.3.6) */
     } _CONT;
     struct
     {
@@ -353,6 +667,52 @@ typedef struct
  */
 typedef void (* policy_entry_t)(const policy_t *, const event_t *, action_t *);
 
+/**
+ * @brief Structure for an optional system call filter (since 0.3.6).
+ *
+ * Policy objects may translate part of their rules into a classic BPF program
+ * for the *seccomp* facility of linux. The filter is installed in the prisoner
+ * process right before executing the targeted program. System calls for which
+ * the filter returns *SECCOMP_RET_ALLOW* proceed without stopping the prisoner
+ * process (and the policy object will NOT see the corresponding *SYSCALL* and 
+ * *SYSRET* events), whereas those for which the filter returns 
+ * *SECCOMP_RET_TRACE* are reported to the policy object as usual. The filter
+ * should NOT return other values. An empty filter (\c len == 0) disables this
+ * feature, and all system calls are reported to the policy object.
+ */
+typedef struct
+{
+    unsigned short len;         /**< number of BPF instructions */
+    void * prog;                /**< BPF instructions (struct sock_filter) */
+} filter_t;
+
+/**
+ * @brief Backends for watching the prisoner process (since 0.3.6).
+ *
+ * With *S_BACKEND_NOTIFY*, the prisoner process is not traced at all. System 
+ * calls for which the filter returns *SECCOMP_RET_TRACE* (or all system calls,
+ * with an empty filter) are delivered to the watcher thread as seccomp user 
+ * notifications, and are held by the kernel until the watcher answers them. 
+ * The policy object sees the same *SYSCALL* events as with *S_BACKEND_PTRACE*,
+ * but *SYSRET* events are never reported, and the si_code of *SIGNAL* events
+ * is always 0. This backend requires linux 5.6 or later.
+ *
+ * Allowed system calls are continued by the kernel with the arguments as seen
+ * by the policy object. Values in registers cannot change, but memory they 
+ * point to (e.g. paths) can still be rewritten by other threads sharing the 
+ * memory of the prisoner process before the kernel reads it. Policies that 
+ * decide on memory pointed to by arguments are only sound with 
+ * *S_BACKEND_PTRACE* and single-threaded programs, or with threads denied in
+ * the first place. System calls of other threads or children of the prisoner
+ * process are not reported, and fail with *ENOSYS*, as they do when they are
+ * untraced under *S_BACKEND_PTRACE*.
+ */
+typedef enum
+{
+    S_BACKEND_PTRACE   = 0,     /*!< trace the prisoner process with ptrace */
+    S_BACKEND_NOTIFY   = 1,     /*!< seccomp user notification, no ptrace */
+} backend_t;
+
 #ifndef thread_func_t
 /**
  * @brief Entry function signature of sandbox monitor object.
@@ -369,6 +729,110 @@ typedef struct
     pthread_t tid;              /**< thread id of the worker when started */
 } worker_t;
 
+/**
+ * @brief Read-write lock of a sandbox object.
+ */
+typedef struct
+{
+    pthread_mutex_t mutex;      /**< POSIX mutex */
+    pthread_cond_t rdc;         /**< eligible for read condition */
+    pthread_cond_t wrc;         /**< eligible for write condition */
+    int rdcount;                /**< number of concurrent readers */
+    bool wrlock;                /**< write locked */
+} lock_t;
+
+/* Maximum number of idle helpers in a pool (since 0.3.6) */
+#ifndef SBOX_POOL_MAX
+#define SBOX_POOL_MAX           16
+#endif /* SBOX_POOL_MAX */
+
+/**
+ * @brief Pool of pre-spawned prisoner processes (since 0.3.6).
+ *
+ * Each slot of a pool has a thread spawning helpers from a validated task 
+ * template with proc_spawn(). A helper applies session, jail, filesystem 
+ * allow-list, identity and resource limits of the template, and then parks 
+ * on its hand-off socket, while the spawning thread remains suspended until 
+ * the helper executes a program or exits. A sandbox with field pool of ctrl_t
+ * pointing to the pool, and with the same static fields as the template, 
+ * hands its I/O channels, quota and system call filter over to a parked 
+ * helper, which is attached by the tracer (unless trusted), and executes the
+ * targeted program. Sandboxes watched with S_BACKEND_NOTIFY, or finding no 
+ * parked helper, spawn their prisoner processes as usual. Helpers are 
+ * children of the spawning threads, so the pool must outlive the sandboxes 
+ * executed with it.
+ */
+typedef struct
+{
+    task_t tmpl;                /**< validated template of the helpers */
+    char ** argv;               /**< prepared argument array of the helpers */
+    int size;                   /**< number of slots in use */
+    bool refill;                /**< replace helpers taken by sandboxes */
+    bool closing;               /**< the spawning threads should quit */
+    int started;                /**< number of spawning threads started */
+    struct
+    {
+        pid_t pid;              /**< parked helper, 0 if unknown, -1 if taken */
+        int chan;               /**< hand-off socket of the helper, or -1 */
+        worker_t spawner;       /**< thread spawning helpers for the slot */
+    } slot[SBOX_POOL_MAX];      /**< slots of helpers */
+    struct
+    {
+        unsigned long spawned;  /**< number of helpers spawned */
+        unsigned long hit;      /**< number of sandboxes served by helpers */
+        unsigned long miss;     /**< number of sandboxes finding no helper */
+    } stat;                     /**< statistics of the pool */
+    lock_t lock;                /**< rwlock for concurrency control */
+} pool_t;
+
+/* Number of slots of a result cache by default (since 0.3.6) */
+#ifndef SBOX_MEMO_SLOTS
+#define SBOX_MEMO_SLOTS         65536
+#endif /* SBOX_MEMO_SLOTS */
+
+/**
+ * @brief Content-addressed cache of the results of deterministic runs (since
+ * 0.3.6).
+ *
+ * The cache is a fixed-size hash table in an index file, which is mapped into
+ * memory and shared by all processes opening the same file. A sandbox with 
+ * field memo of ctrl_t pointing to the cache, and with a deterministic policy
+ * identified by field profile of ctrl_t, looks up its run by the SHA-256 of 
+ * the content of the program file, the content of the input (i.e. the rest of
+ * a regular input file, or the input to be fed), the content of the answer 
+ * file (if compared), the command line, the environment, the static fields,
+ * the quota and the profile. On a hit, the result and the key fields of 
+ * \c stat_t (i.e. elapsed time, cpu and memory usage, exit code, signal, 
+ * captured output with its digest) are replayed without executing the 
+ * targeted program, nothing is written to the output channels, and field 
+ * memoized of \c stat_t is set. Otherwise, the output is captured for its 
+ * digest, and the finished run is stored into the cache unless it failed 
+ * for internal or external reasons (i.e. *S_RESULT_IE*, *S_RESULT_BP*), or 
+ * exceeded a quota subject to the load of the host (i.e. *S_RESULT_TL*, 
+ * *S_RESULT_ML*). 
+ * Shared libraries and other files beneath the jail are identified by path 
+ * only. Runs with a non-regular input channel, runs with \c ofd or \c efd 
+ * other than the null device (i.e. whose output would be lost on a hit), 
+ * linked runs, and master sandboxes of fork servers are never cached.
+ */
+typedef struct
+{
+    int fd;                     /**< index file, or -1 */
+    void * base;                /**< mapped index file */
+    size_t size;                /**< size of the mapped index file */
+    unsigned long slots;        /**< number of slots of the index */
+    struct
+    {
+        unsigned long hit;      /**< number of runs replayed */
+        unsigned long miss;     /**< number of runs not found */
+        unsigned long stored;   /**< number of runs stored */
+    } stat;                     /**< statistics of the cache */
+    lock_t lock;                /**< rwlock for concurrency control */
+} memo_t;
+
+/* Fork server of prisoner processes (since 0.3.6), defined below */
+typedef struct __sandbox_server server_t;
+
 /**
  * @brief Configurable controller of a sandbox object.
  */
@@ -377,6 +841,40 @@ typedef struct
     pid_t pid;                  /**< id of the process being traced */
     action_t action;            /**< the action to be suggested by the policy */
     policy_t policy;            /**< the policy to consult for actions */
+    filter_t filter;            /**< system call filter (since 0.3.6) */
+    backend_t backend;          /**< watching backend (since 0.3.6) */
+    int listener;               /**< seccomp user notification fd */
+    struct
+    {
+        int fd;                 /**< read end of the capture pipe, or -1 */
+        int efd;                /**< ditto, for the error channel, or -1 */
+        bool exited;            /**< the prisoner process has exited */
+    } capture;                  /**< output capture (since 0.3.6) */
+    struct
+    {
+        int fd;                 /**< writable end of the feeding pipe, or -1 */
+        int rfd;                /**< readable end, or the seekable file */
+        long long size;         /**< bytes to be fed */
+    } feed;                     /**< input feeding (since 0.3.6) */
+    struct
+    {
+        void * peer;            /**< the linked sandbox_t object, or NULL */
+        int fd;                 /**< readable end of the pipe from the peer */
+        int ofd;                /**< writable end of the pipe to the peer */
+        long pending;           /**< bytes left unread from the peer */
+        res_t grace;            /**< time the peer may outlive this sandbox */
+        res_t deadline;         /**< elapsed time to finish by, as the peer 
+                                     has finished (msec) */
+    } link;                     /**< linked execution (since 0.3.6) */
+    memo_t * memo;              /**< result cache (since 0.3.6), or NULL */
+    struct
+    {
+        const void * data;      /**< identity of a deterministic policy, or 
+                                     NULL if the policy is not deterministic */
+        size_t size;            /**< size of the identity */
+    } profile;                  /**< policy profile (since 0.3.6) */
+    pool_t * pool;              /**< pool of helpers (since 0.3.6), or NULL */
+    server_t * server;          /**< fork server (since 0.3.6), or NULL */
     worker_t tracer;            /**< the main tracer thread */
     worker_t monitor[SBOX_MONITOR_MAX]; /**< the pool of monitor threads */
     struct
@@ -385,20 +883,13 @@ typedef struct
         int size;
         event_t list[SBOX_EVENT_MAX];
     } event;                    /**< the queue of pending events */
+    struct
+    {
+        int fd;                 /**< eventfd for waking up the profiler */
+        unsigned long pending;  /**< bitmask of pending notices */
+    } notice;                   /**< notices to the profiler (since 0.3.6) */
 } ctrl_t;
 
-/**
- * @brief Read-write lock of a sandbox object.
- */
-typedef struct
-{
-    pthread_mutex_t mutex;      /**< POSIX mutex */
-    pthread_cond_t rdc;         /**< eligible for read condition */
-    pthread_cond_t wrc;         /**< eligible for write condition */
-    int rdcount;                /**< number of concurrent readers */
-    bool wrlock;                /**< write locked */
-} lock_t;
-
 /**
  * @brief Structure for collecting everything needed to run a sandbox.
  */
@@ -412,6 +903,40 @@ typedef struct
     lock_t lock;                /**< rwlock for concurrency control */
 } sandbox_t;
 
+/**
+ * @brief Fork server of prisoner processes (since 0.3.6).
+ *
+ * The server executes the program of a validated task template in a master
+ * sandbox, with all standard channels of the master process connected to the
+ * hand-off socket of the server. Once done with loading and initializing the
+ * program, the (single-threaded) master process is parked upon its first 
+ * system call on a standard channel, and detached by the tracer. A sandbox 
+ * with field server of ctrl_t pointing to the server, and with the same 
+ * static fields as the template, has a copy of the parked master process 
+ * forked by its tracer, with I/O channels handed over through the socket. The
+ * copy re-enters the parked system call under the tracer, without system 
+ * call filter, and without replaying any system call made by the master 
+ * process before parking. Fork servers are only implemented for x86_64, and
+ * copies are children of the thread running the master sandbox, so the 
+ * server must outlive the sandboxes executed with it.
+ */
+struct __sandbox_server
+{
+    sandbox_t sbox;             /**< master sandbox */
+    void * point;               /**< process stat buffer of the fork point */
+    unsigned long sigmask;      /**< signal mask of the master process */
+    int chan[2];                /**< hand-off socket of the master process */
+    bool parked;                /**< the master process is parked */
+    bool closing;               /**< the master process should be killed */
+    worker_t runner;            /**< thread running the master sandbox */
+    struct
+    {
+        unsigned long hit;      /**< number of sandboxes served by copies */
+        unsigned long miss;     /**< number of sandboxes finding no copy */
+    } stat;                     /**< statistics of the server */
+    lock_t lock;                /**< rwlock for concurrency control */
+};
+
 /**
  * @brief Initialize a \c sandbox_t object.
  * @param[in,out] psbox pointer to the \c sandbox_t object to be initialized
@@ -420,6 +945,139 @@ typedef struct
  */
 int sandbox_init(sandbox_t * psbox, const char * argv[]);
 
+/**
+ * @brief Initialize a \c sandbox_t object with the environment of the targeted
+ * program (since 0.3.6). \c sandbox_init() is the same as this function with
+ * an empty environment.
+ * @param[in,out] psbox pointer to the \c sandbox_t object to be initialized
+ * @param[in] argv command line argument array of the targeted program
+ * @param[in] envp environment array of the targeted program, or NULL
+ * @return 0 on success
+ */
+int sandbox_init_env(sandbox_t * psbox, const char * argv[], 
+                     const char * envp[]);
+
+/**
+ * @brief Replace the command line arguments and / or the environment of the 
+ * targeted program of an initialized sandbox that is not running (since 
+ * 0.3.6).
+ * @param[in,out] psbox pointer to an initialized \c sandbox_t object
+ * @param[in] argv command line argument array, or NULL to keep the current
+ * @param[in] envp environment array, or NULL to keep the current
+ * @return 0 on success
+ */
+int sandbox_command(sandbox_t * psbox, const char * argv[], 
+                    const char * envp[]);
+
+/**
+ * @brief Validate the static fields of a task once as a template (since 
+ * 0.3.6). The template is a deep copy of \c ptask, and should be destroyed 
+ * with \c sandbox_template_fini().
+ * @param[out] ptmpl pointer to the \c task_t object to hold the template
+ * @param[in] ptask pointer to the \c task_t object to be validated
+ * @return 0 on success, or -1 if the task is invalid
+ */
+int sandbox_template_init(task_t * ptmpl, const task_t * ptask);
+
+/**
+ * @brief Destroy a task template (since 0.3.6).
+ * @param[in,out] ptmpl pointer to the template to be destroyed
+ * @return 0 on success
+ */
+int sandbox_template_fini(task_t * ptmpl);
+
+/**
+ * @brief Instantiate the task of an initialized sandbox that is not running 
+ * from a validated template (since 0.3.6). Static fields and the stamp are 
+ * copied from the template, whereas I/O channels, quota and cpu placement of
+ * the sandbox are kept as is. Static fields of the instance should not be 
+ * modified other than through \c sandbox_command(), which drops the stamp.
+ * @param[in,out] psbox pointer to an initialized \c sandbox_t object
+ * @param[in] ptmpl pointer to a template from \c sandbox_template_init()
+ * @return 0 on success
+ */
+int sandbox_instantiate(sandbox_t * psbox, const task_t * ptmpl);
+
+/**
+ * @brief Initialize a pool of pre-spawned prisoner processes, and start the 
+ * threads spawning helpers in the background (since 0.3.6).
+ * @param[out] ppool pointer to the \c pool_t object to be initialized
+ * @param[in] ptmpl pointer to a template from \c sandbox_template_init(), which
+ * should not start in a fresh pid namespace
+ * @param[in] size number of helpers to keep parked, at most \c SBOX_POOL_MAX
+ * @param[in] refill whether to replace helpers taken by sandboxes, otherwise
+ * the pool is drained after serving \c size sandboxes
+ * @return 0 on success
+ */
+int sandbox_pool_init(pool_t * ppool, const task_t * ptmpl, int size, 
+                      bool refill);
+
+/**
+ * @brief Dismiss the parked helpers of a pool, and stop its spawning threads
+ * (since 0.3.6). Prisoner processes handed over by the pool are killed as 
+ * well, as their parent threads are gone.
+ * @param[in,out] ppool pointer to an initialized \c pool_t object
+ * @return 0 on success
+ */
+int sandbox_pool_fini(pool_t * ppool);
+
+/**
+ * @brief Count the helpers of a pool parked for taking over sandboxes 
+ * (since 0.3.6).
+ * @param[in,out] ppool pointer to an initialized \c pool_t object
+ * @return number of parked helpers, or -1 on failure
+ */
+int sandbox_pool_ready(pool_t * ppool);
+
+/**
+ * @brief Open (or create) the index file of a result cache, and map it into
+ * memory (since 0.3.6). 
+ * @param[out] pmemo pointer to the \c memo_t object to be initialized
+ * @param[in] path path of the index file
+ * @param[in] slots number of slots of a new index file, or 0 for 
+ * \c SBOX_MEMO_SLOTS, an existing index file keeps its own
+ * @return 0 on success, or -1 if the index file is invalid
+ */
+int sandbox_memo_init(memo_t * pmemo, const char * path, unsigned long slots);
+
+/**
+ * @brief Unmap and close the index file of a result cache (since 0.3.6).
+ * Sandboxes should no longer point to the cache.
+ * @param[in,out] pmemo pointer to an initialized \c memo_t object
+ * @return 0 on success
+ */
+int sandbox_memo_fini(memo_t * pmemo);
+
+/**
+ * @brief Initialize a fork server, and start running its master sandbox in the
+ * background (since 0.3.6).
+ * @param[out] pserver pointer to the \c server_t object to be initialized
+ * @param[in] ptmpl pointer to a template from \c sandbox_template_init(), which
+ * should neither be trusted, nor start in a fresh pid namespace
+ * @param[in] ppolicy pointer to the policy of the master sandbox, which sees
+ * the system calls of the master process before parking
+ * @return 0 on success
+ */
+int sandbox_server_init(server_t * pserver, const task_t * ptmpl, 
+                        const policy_t * ppolicy);
+
+/**
+ * @brief Kill the master process of a fork server, and stop the thread 
+ * running the master sandbox (since 0.3.6). Copies forked by the server are 
+ * killed as well, as their parent thread is gone.
+ * @param[in,out] pserver pointer to an initialized \c server_t object
+ * @return 0 on success
+ */
+int sandbox_server_fini(server_t * pserver);
+
+/**
+ * @brief Check if the master process of a fork server is parked for forking 
+ * copies (since 0.3.6).
+ * @param[in,out] pserver pointer to an initialized \c server_t object
+ * @return 1 if parked, 0 if not (yet), or -1 on failure
+ */
+int sandbox_server_ready(server_t * pserver);
+
 /**
  * @brief Destroy a \c sandbox_t object.
  * @param[in,out] psbox pointer to the \c sandbox_t object to be destroied
@@ -444,6 +1102,35 @@ bool sandbox_check(sandbox_t * psbox);
  */
 result_t * sandbox_execute(sandbox_t * psbox);
 
+/**
+ * @brief Execute the tasks of two sandboxes linked with each other, for 
+ * interactive tasks (since 0.3.6).
+ *
+ * The standard output of either sandbox is cross-connected to the standard 
+ * input of the other through pipes created by the library, in place of the 
+ * input and output channels of the tasks for the duration of the execution. 
+ * The output is relayed by the capture thread of the sending sandbox, and is
+ * subject to its disk quota. \c psbox is executed on the calling thread, and
+ * \c ppeer on a runner thread. Once either sandbox is finished, the other sees
+ * the end of its input and a broken output, and is killed as exceeding its 
+ * wallclock quota unless finished within \c grace. Bytes sent and received, 
+ * and time spent asleep with no input from the peer (sampled by the profiler
+ * thread), are in field link of \c stat_t.
+ * @param[in,out] psbox pointer to the first \c sandbox_t object
+ * @param[in,out] ppeer pointer to the second \c sandbox_t object
+ * @param[in] grace time either sandbox may outlive the other (msec), or 
+ * SBOX_QUOTA_INF
+ * @return 0 on success, or -1 if either sandbox failed to start
+ */
+int sandbox_execute_linked(sandbox_t * psbox, sandbox_t * ppeer, res_t grace);
+
+/**
+ * @brief Check if the filesystem allow-list of tasks is enforced by the 
+ * running kernel (since 0.3.6).
+ * @return true if landlock is available
+ */
+bool sandbox_fs_enforced(void);
+
 /**
  * @brief Default policy with a baseline (black) list of system calls.
  * @param[in] ppolicy pointer to the \c policy_t object of the sandbox, or NULL
@@ -82,6 +82,17 @@ program until the sandboxed program is finished (or terminated).
 """
         return super(Sandbox, self).run()
 
+    def interact(self, peer, grace=1000):
+        """Execute the sandboxed program along with that of another sandbox
+*peer*, for interactive tasks. The standard output of either program
+is piped to the standard input of the other, in place of their own
+stdin and stdout. Once either program is finished, the other sees
+the end of its input, and is killed (as exceeding its wallclock
+quota) unless finished within *grace* msec, or None to wait. This
+method blocks the calling program until both are finished.
+"""
+        return super(Sandbox, self).interact(peer, grace)
+
     def dump(self, typeid, address):
         """Copy the memory block starting from the specificed address of
 the sandboxed program's memory space. On success, return an object
@@ -126,6 +137,26 @@ program. By default, the result contains the following entries,
       1 (int): last / current system call mode
   - elapsed (int): elapsed wallclock time since started (msec)
   - exitcode (int): exit status of the sandboxed program
+  - placement (2-tuple):
+      0 (int): cpu hosting the sandboxed program, or S_CPU_ANY
+      1 (int): cpu hosting the tracer threads, or S_CPU_ANY
+  - output_info (2-tuple):
+      0 (long): bytes captured from the standard output
+      1 (long): offset of the first mismatch with the answer, or -1
+  - output_digest (2-tuple):
+      0 (long): XXH64 digest of the bytes captured from the standard output
+      1 (str): SHA-256 digest (in hex) of the same bytes with sha256=True of
+          the sandbox, or None
+  - input_info (2-tuple):
+      0 (long): bytes fed to the standard input
+      1 (long): bytes consumed by the sandboxed program
+  - link_info (3-tuple):
+      0 (long): bytes sent to the peer of interact()
+      1 (long): bytes received from the peer of interact()
+      2 (long): time spent waiting on the peer (msec)
+  - memoized (bool): the result is replayed from the cache=path of the
+      sandbox, as the policy has a true *deterministic* attribute, and
+      the output only goes to the answer comparator and the digests
 
 When the optional argument *compatible* is True, the result
 additionally contains the following entries,
@@ -172,11 +203,37 @@ S_EVENT_SIGNAL = SandboxEvent.S_EVENT_SIGNAL
 S_EVENT_SYSCALL = SandboxEvent.S_EVENT_SYSCALL
 S_EVENT_SYSRET = SandboxEvent.S_EVENT_SYSRET
 S_EVENT_QUOTA = SandboxEvent.S_EVENT_QUOTA
+S_EVENT_OUTPUT = SandboxEvent.S_EVENT_OUTPUT
 
 # sandbox action types
 S_ACTION_CONT = SandboxAction.S_ACTION_CONT
 S_ACTION_KILL = SandboxAction.S_ACTION_KILL
 S_ACTION_FINI = SandboxAction.S_ACTION_FINI
+S_ACTION_CONT_NORET = SandboxAction.S_ACTION_CONT_NORET
+
+# decision cache keys
+S_CACHE_SCINFO = SandboxAction.S_CACHE_SCINFO
+S_CACHE_ARG1 = SandboxAction.S_CACHE_ARG1
+S_CACHE_ARG2 = SandboxAction.S_CACHE_ARG2
+S_CACHE_ARG3 = SandboxAction.S_CACHE_ARG3
+S_CACHE_ARG4 = SandboxAction.S_CACHE_ARG4
+S_CACHE_ARG5 = SandboxAction.S_CACHE_ARG5
+S_CACHE_ARG6 = SandboxAction.S_CACHE_ARG6
+
+# native policy rules
+S_RULE_DELEGATE = SandboxPolicy.S_RULE_DELEGATE
+S_PRED_EQ = SandboxPolicy.S_PRED_EQ
+S_PRED_NE = SandboxPolicy.S_PRED_NE
+S_PRED_LT = SandboxPolicy.S_PRED_LT
+S_PRED_LE = SandboxPolicy.S_PRED_LE
+S_PRED_GT = SandboxPolicy.S_PRED_GT
+S_PRED_GE = SandboxPolicy.S_PRED_GE
+S_PRED_ALL = SandboxPolicy.S_PRED_ALL
+S_PRED_NONE = SandboxPolicy.S_PRED_NONE
+S_PRED_IN = SandboxPolicy.S_PRED_IN
+S_PRED_NOT = SandboxPolicy.S_PRED_NOT
+S_PRED_AND = SandboxPolicy.S_PRED_AND
+S_PRED_OR = SandboxPolicy.S_PRED_OR
 
 # sandbox quota types
 S_QUOTA_WALLCLOCK = Sandbox.S_QUOTA_WALLCLOCK
@@ -184,6 +241,41 @@ S_QUOTA_CPU = Sandbox.S_QUOTA_CPU
 S_QUOTA_MEMORY = Sandbox.S_QUOTA_MEMORY
 S_QUOTA_DISK = Sandbox.S_QUOTA_DISK
 
+# sandbox watching backends
+S_BACKEND_PTRACE = Sandbox.S_BACKEND_PTRACE
+S_BACKEND_NOTIFY = Sandbox.S_BACKEND_NOTIFY
+
+# sandbox filesystem access types
+S_FS_NONE = Sandbox.S_FS_NONE
+S_FS_READ = Sandbox.S_FS_READ
+S_FS_WRITE = Sandbox.S_FS_WRITE
+S_FS_ENFORCED = Sandbox.S_FS_ENFORCED
+
+# sandbox trust levels
+S_TRUST_NONE = Sandbox.S_TRUST_NONE
+S_TRUST_FULL = Sandbox.S_TRUST_FULL
+
+# sandbox namespace types
+S_NS_NONE = Sandbox.S_NS_NONE
+S_NS_USER = Sandbox.S_NS_USER
+S_NS_PID = Sandbox.S_NS_PID
+S_NS_MOUNT = Sandbox.S_NS_MOUNT
+S_NS_NET = Sandbox.S_NS_NET
+S_NS_IPC = Sandbox.S_NS_IPC
+S_NS_UTS = Sandbox.S_NS_UTS
+S_NS_ALL = Sandbox.S_NS_ALL
+
+# sandbox output comparison modes
+S_COMPARE_NONE = Sandbox.S_COMPARE_NONE
+S_COMPARE_BYTE = Sandbox.S_COMPARE_BYTE
+S_COMPARE_TOKEN = Sandbox.S_COMPARE_TOKEN
+S_COMPARE_NOCASE = Sandbox.S_COMPARE_NOCASE
+S_COMPARE_FLOAT = Sandbox.S_COMPARE_FLOAT
+
+# sandbox special cpu numbers
+S_CPU_ANY = Sandbox.S_CPU_ANY
+S_CPU_AUTO = Sandbox.S_CPU_AUTO
+
 # sandbox status
 S_STATUS_PRE = Sandbox.S_STATUS_PRE
 S_STATUS_RDY = Sandbox.S_STATUS_RDY
@@ -208,6 +300,7 @@ S_RESULT_R2 = Sandbox.S_RESULT_R2
 S_RESULT_R3 = Sandbox.S_RESULT_R3
 S_RESULT_R4 = Sandbox.S_RESULT_R4
 S_RESULT_R5 = Sandbox.S_RESULT_R5
+S_RESULT_WA = Sandbox.S_RESULT_WA
 
 # datatype indicators
 T_BYTE = Sandbox.T_BYTE
@@ -34,6 +34,18 @@
 #include <sandbox-dev.h>       /* libsandbox internals */
 #include <pwd.h>               /* struct passwd, getpwnam(), getpwuid() */
 #include <grp.h>               /* struct group, getgrnam(), getgrgid() */
+#include <fcntl.h>             /* open(), O_* */
+#include <sys/mman.h>          /* mmap(), munmap(), PROT_READ, MAP_SHARED */
+#include <sys/stat.h>          /* struct stat, fstat(), fchmod() */
+#include <unistd.h>            /* close(), write(), fsync(), unlink() */
+
+#ifdef __linux__
+#include <stddef.h>            /* offsetof() */
+#include <sys/syscall.h>       /* SYS_execve */
+#include <linux/audit.h>       /* AUDIT_ARCH_* */
+#include <linux/filter.h>      /* struct sock_filter, BPF_* */
+#include <linux/seccomp.h>     /* struct seccomp_data, SECCOMP_RET_* */
+#endif /* __linux__ */
 
 #ifdef __cplusplus
 extern "C"
@@ -375,9 +387,50 @@ SandboxAction_FromAction(const action_t * paction)
 
 PyDoc_STRVAR(DOC_TP_POLICY,     "");
 
+PyDoc_STRVAR(DOC_POLICY_RULE, 
+"rule(sc, action, result=S_RESULT_RF, pred=None)\n\n"
+"Add a native rule for system call sc, which is a number, a pair of\n"
+"(number, mode), or None for all system calls without explicit rules.\n"
+"Events of ruled system calls are handled without calling the policy\n"
+"object. Use action S_RULE_DELEGATE to pass the events to __call__()\n"
+"again. The optional pred (arg, op, value) tests argument arg (1-6)\n"
+"with operator S_PRED_*, and the events are delegated if it fails.\n"
+"Predicates can be combined with (S_PRED_NOT, p), (S_PRED_AND, p, q,\n"
+"...) and (S_PRED_OR, p, q, ...), and (arg, S_PRED_IN, (v1, v2, ...))\n"
+"is short for testing arg against each of the values with S_PRED_EQ.\n"
+"Rules cannot be changed while the policy is used by running sandboxes\n"
+"or fork servers.");
+
+PyDoc_STRVAR(DOC_POLICY_DUMP, 
+"dump(filename)\n\n"
+"Save the native rules, along with the seccomp filter translated from\n"
+"them, into a compiled policy profile, which is only compatible with\n"
+"the same version of the module on the same type of host.");
+
+PyDoc_STRVAR(DOC_POLICY_LOAD, 
+"load(filename)\n\n"
+"Replace the native rules with those in a compiled policy profile. The\n"
+"profile is mapped read-only, and shared by all policies and processes\n"
+"loading the same file. Profiles should be replaced (i.e. by renaming)\n"
+"rather than overwritten while in use. The rules of a policy cannot be\n"
+"replaced while it is used by running sandboxes or fork servers.");
+
 static int SandboxPolicy_init(SandboxPolicy *, PyObject *, PyObject *);
 static void SandboxPolicy_free(SandboxPolicy *);
 static PyObject * SandboxPolicy_call(SandboxPolicy *, PyObject *, PyObject *);
+static PyObject * SandboxPolicy_rule(SandboxPolicy *, PyObject *, PyObject *);
+static PyObject * SandboxPolicy_dump(SandboxPolicy *, PyObject *);
+static PyObject * SandboxPolicy_load(SandboxPolicy *, PyObject *);
+static void SandboxPolicy_reset(SandboxPolicy *, rule_table_t *, void *, size_t);
+
+static PyMethodDef policyMethods[] = 
+{
+    {"rule", (PyCFunction)SandboxPolicy_rule, METH_VARARGS | METH_KEYWORDS, 
+     DOC_POLICY_RULE},
+    {"dump", (PyCFunction)SandboxPolicy_dump, METH_VARARGS, DOC_POLICY_DUMP},
+    {"load", (PyCFunction)SandboxPolicy_load, METH_VARARGS, DOC_POLICY_LOAD},
+    {NULL, NULL, 0, NULL}       /* Sentinel */
+};
 
 static PyTypeObject policyType = 
 {
@@ -408,7 +461,7 @@ static PyTypeObject policyType =
     0,                                          /* tp_weaklistoffset */
     0,                                          /* tp_iter */
     0,                                          /* tp_iternext */
-    0,                                          /* tp_methods */
+    policyMethods,                              /* tp_methods */
     0,                                          /* tp_members */
     0,                                          /* tp_getset */
     0,                                          /* tp_base */
@@ -440,6 +493,7 @@ SandboxPolicy_free(SandboxPolicy * self)
     SandboxPolicy_GET_STATE(self).e = NULL;
     Py_XDECREF(SandboxPolicy_GET_STATE(self).a);
     SandboxPolicy_GET_STATE(self).a = NULL;
+    SandboxPolicy_reset(self, NULL, NULL, 0);
     Py_TYPE(self)->tp_free((PyObject *)self);
     PROC_END();
 }
@@ -486,80 +540,1066 @@ SandboxPolicy_call(SandboxPolicy * self, PyObject * args, PyObject * kwds)
     FUNC_RET("%p", a);
 }
 
+/* Replace the rule table of a policy, the previous table is either unmapped
+ * from its policy profile, or freed, so the policy must not be in use */
+static void
+SandboxPolicy_reset(SandboxPolicy * self, rule_table_t * table, void * image, 
+                    size_t size)
+{
+    PROC_BEGIN("%p,%p,%p,%zu", self, table, image, size);
+    assert(self);
+    
+    if (SandboxPolicy_GET_STATE(self).image != NULL)
+    {
+        munmap(SandboxPolicy_GET_STATE(self).image, 
+            SandboxPolicy_GET_STATE(self).size);
+    }
+    else
+    {
+        PyMem_Free(SandboxPolicy_GET_STATE(self).rules);
+    }
+    
+    SandboxPolicy_GET_STATE(self).rules = table;
+    SandboxPolicy_GET_STATE(self).image = image;
+    SandboxPolicy_GET_STATE(self).size = size;
+    
+    PROC_END();
+}
+
+/* Check that predicate code is well-formed, and its evaluation fits in the 
+ * stack of SandboxPolicy_test() */
+static bool
+SandboxPolicy_verify(const pred_t * code, int len)
+{
+    FUNC_BEGIN("%p,%d", code, len);
+    assert(code);
+    
+    int i, sp = 0;
+    for (i = 0; i < len; i++)
+    {
+        switch (code[i].op)
+        {
+        case S_PRED_NOT:
+            if (sp < 1)
+            {
+                FUNC_RET("%d", false);
+            }
+            break;
+        case S_PRED_AND:
+        case S_PRED_OR:
+            if (sp < 2)
+            {
+                FUNC_RET("%d", false);
+            }
+            sp--;
+            break;
+        case S_PRED_IN:
+            FUNC_RET("%d", false);
+        default:
+            if ((code[i].op > S_PRED_OR) || (code[i].arg < 1) || 
+                (code[i].arg > 6) || (++sp > PRED_STACK_MAX))
+            {
+                FUNC_RET("%d", false);
+            }
+            break;
+        }
+    }
+    
+    FUNC_RET("%d", (len == 0) || (sp == 1));
+}
+
+/* Parse a long value, accepting unsigned values that do not fit in a long */
 static int
-SandboxPolicy_Check(PyObject * o)
+SandboxPolicy_value(PyObject * o, long * pvalue)
 {
-    FUNC_BEGIN("%p", o);
-    if (o == NULL)
+    FUNC_BEGIN("%p,%p", o, pvalue);
+    assert(o && pvalue);
+    
+    *pvalue = PyLong_AsLong(o);
+    if (PyErr_Occurred() && PyErr_ExceptionMatches(PyExc_OverflowError))
     {
-        FUNC_RET("%d", 0);
+        PyErr_Clear();
+        *pvalue = (long)PyLong_AsUnsignedLong(o);
     }
-    FUNC_RET("%d", PyObject_TypeCheck(o, &policyType));
+    if (PyErr_Occurred())
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    FUNC_RET("%d", 0);
 }
 
-static PyObject *
-SandboxPolicy_New(void)
+/* Compile a (nested) predicate into postfix code, return 0 on success, or -1
+ * with an exception set if the predicate is malformed or too complex. */
+static int
+SandboxPolicy_compile(PyObject * pred, pred_t * code, int * plen)
 {
-    FUNC_BEGIN();
-    PyObject * args = Py_BuildValue("()");
-    PyObject * o = policyType.tp_new(&policyType, args, NULL);
-    Py_DECREF(args);
-    FUNC_RET("%p", o);
+    FUNC_BEGIN("%p,%p,%p", pred, code, plen);
+    assert(pred && code && plen);
+    
+    #define EMIT(o, a, v) \
+    {{{ \
+        if (*plen >= PRED_CODE_MAX) \
+        { \
+            PyErr_SetString(PyExc_ValueError, MSG_RULE_PRED_TOO_LONG); \
+            FUNC_RET("%d", -1); \
+        } \
+        code[(*plen)++] = (pred_t){(unsigned char)(o), (unsigned char)(a), \
+            (long)(v)}; \
+    }}} /* EMIT */
+    
+    if (!PyTuple_Check(pred) || (PyTuple_GET_SIZE(pred) < 2))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    const Py_ssize_t size = PyTuple_GET_SIZE(pred);
+    const long head = PyLong_AsLong(PyTuple_GET_ITEM(pred, 0));
+    if (PyErr_Occurred())
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    /* Connectives, (S_PRED_NOT, p), (S_PRED_AND / S_PRED_OR, p, q, ...) */
+    if ((head == S_PRED_NOT) || (head == S_PRED_AND) || (head == S_PRED_OR))
+    {
+        if (((head == S_PRED_NOT) && (size != 2)) || 
+            ((head != S_PRED_NOT) && (size < 3)))
+        {
+            PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+            FUNC_RET("%d", -1);
+        }
+        Py_ssize_t i;
+        for (i = 1; i < size; i++)
+        {
+            if (SandboxPolicy_compile(PyTuple_GET_ITEM(pred, i), code, 
+                plen) != 0)
+            {
+                FUNC_RET("%d", -1);
+            }
+            if ((head == S_PRED_NOT) || (i > 1))
+            {
+                EMIT(head, 0, 0);
+            }
+        }
+        FUNC_RET("%d", 0);
+    }
+    
+    /* Comparisons, (arg, op, value) or (arg, S_PRED_IN, (value, ...)) */
+    if (size != 3)
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    const long op = PyLong_AsLong(PyTuple_GET_ITEM(pred, 1));
+    if (PyErr_Occurred())
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    if ((head < 1) || (head > 6) || (op < S_PRED_EQ) || (op > S_PRED_IN))
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_RULE_PRED_VAL_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    PyObject * operand = PyTuple_GET_ITEM(pred, 2);
+    long value = 0;
+    
+    if (op != S_PRED_IN)
+    {
+        if (SandboxPolicy_value(operand, &value) != 0)
+        {
+            FUNC_RET("%d", -1);
+        }
+        EMIT(op, head, value);
+        FUNC_RET("%d", 0);
+    }
+    
+    if (!PyTuple_Check(operand) || (PyTuple_GET_SIZE(operand) < 1))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_RULE_PRED_TYPE_ERR);
+        FUNC_RET("%d", -1);
+    }
+    
+    Py_ssize_t i;
+    for (i = 0; i < PyTuple_GET_SIZE(operand); i++)
+    {
+        if (SandboxPolicy_value(PyTuple_GET_ITEM(operand, i), &value) != 0)
+        {
+            FUNC_RET("%d", -1);
+        }
+        EMIT(S_PRED_EQ, head, value);
+        if (i > 0)
+        {
+            EMIT(S_PRED_OR, 0, 0);
+        }
+    }
+    
+    #undef EMIT
+    
+    FUNC_RET("%d", 0);
 }
 
-static void 
-SandboxPolicy_entry(const policy_t * ppolicy, const event_t * pevent, 
-                     action_t * paction)
+static PyObject *
+SandboxPolicy_rule(SandboxPolicy * self, PyObject * args, PyObject * kwds)
 {
-    PROC_BEGIN("%p,%p,%p", ppolicy, pevent, paction);
+    FUNC_BEGIN("%p,%p,%p", self, args, kwds);
+    assert(self && args);
     
-    assert(ppolicy && pevent && paction);
+    static char * keywords[] = {"sc", "action", "result", "pred", NULL};
     
-    PyGILState_STATE gstate;
-    gstate = PyGILState_Ensure();
+    PyObject * sc = NULL;
+    PyObject * pred = Py_None;
+    int action = S_ACTION_CONT;
+    int result = S_RESULT_RF;
     
-    SandboxPolicy * p = (SandboxPolicy *)ppolicy->data;
-    if (!SandboxPolicy_Check((PyObject *)p))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi|iO:rule", keywords, 
+        &sc, &action, &result, &pred))
     {
-        *paction = (action_t){S_ACTION_KILL, {{S_RESULT_BP}}};
-        PyGILState_Release(gstate);
-        PROC_END();
+        FUNC_RET("%p", Py_NULL);
     }
     
-    (SandboxPolicy_GET_STATE(p).e) ? 
-        SandboxEvent_SET_EVENT(SandboxPolicy_GET_STATE(p).e, pevent) :
-        (SandboxPolicy_GET_STATE(p).e = SandboxEvent_FromEvent(pevent));
+    /* The rule table is read by running sandboxes without the GIL */
+    if (SandboxPolicy_GET_STATE(self).users > 0)
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_RULE_SET_FORBID);
+        FUNC_RET("%p", Py_NULL);
+    }
     
-    (SandboxPolicy_GET_STATE(p).a) ? 
-        SandboxAction_SET_ACTION(SandboxPolicy_GET_STATE(p).a, NULL) :
-        (SandboxPolicy_GET_STATE(p).a = SandboxAction_FromAction(NULL));
+    /* Locate the system call, (-1, 0) stands for the fallback rule */
+    long scno = -1;
+    int mode = 0;
+    if (PyTuple_Check(sc))
+    {
+        if (!PyArg_ParseTuple(sc, "li", &scno, &mode))
+        {
+            PyErr_SetString(PyExc_TypeError, MSG_RULE_SC_TYPE_ERR);
+            FUNC_RET("%p", Py_NULL);
+        }
+    }
+    else if (sc != Py_None)
+    {
+        scno = PyLong_AsLong(sc);
+        if (PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_TypeError, MSG_RULE_SC_TYPE_ERR);
+            FUNC_RET("%p", Py_NULL);
+        }
+    }
     
-    PyObject * o = PyObject_CallFunctionObjArgs((PyObject *)p, 
-        SandboxPolicy_GET_STATE(p).e, SandboxPolicy_GET_STATE(p).a, NULL);
+    if ((sc != Py_None) && ((scno < 0) || (scno >= RULE_SCNO_MAX) || 
+        (mode < 0) || (mode >= RULE_MODE_MAX)))
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_RULE_SC_VAL_ERR);
+        FUNC_RET("%p", Py_NULL);
+    }
     
-    if ((o == NULL) || PyErr_Occurred() || ((o != SandboxPolicy_GET_STATE(p).a) 
-        && !SandboxAction_Check(o)))
+    rule_t rule = {RULE_NATIVE, (unsigned char)action, (unsigned char)result, 
+        0, 0};
+    
+    if (action == S_RULE_DELEGATE)
     {
-        *paction = (action_t){S_ACTION_KILL, {{S_RESULT_BP}}};
+        rule.type = RULE_DELEGATE;
+        rule.action = S_ACTION_CONT;
+    }
+    else if (action == S_ACTION_CONT_NORET)
+    {
+        rule.action = S_ACTION_CONT;
+    }
+    else if ((action != S_ACTION_CONT) && (action != S_ACTION_FINI) && 
+        (action != S_ACTION_KILL))
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_RULE_ACTION_ERR);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    if ((result < S_RESULT_PD) || (result > S_RESULT_WA))
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_RULE_RESULT_ERR);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* Compile the optional argument predicate, and make sure its evaluation
+     * fits in the stack of SandboxPolicy_test() */
+    pred_t code[PRED_CODE_MAX];
+    int len = 0;
+    if (pred != Py_None)
+    {
+        if (SandboxPolicy_compile(pred, code, &len) != 0)
+        {
+            FUNC_RET("%p", Py_NULL);
+        }
+        if (!SandboxPolicy_verify(code, len))
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_RULE_PRED_TOO_LONG);
+            FUNC_RET("%p", Py_NULL);
+        }
+        rule.len = (unsigned char)len;
+    }
+    
+    /* The rule table is allocated on demand. All entries of a new table refer
+     * to the fallback rule, which in turn delegates to the policy object. A 
+     * table mapped from a policy profile is copied before modification. */
+    rule_table_t * table = SandboxPolicy_GET_STATE(self).rules;
+    if ((table == NULL) || (SandboxPolicy_GET_STATE(self).image != NULL) || 
+        (table->used + len > table->size))
+    {
+        unsigned int size = (table == NULL) ? 0 : table->used;
+        if (len > 0)
+        {
+            size = 2 * size + PRED_CODE_MAX;
+        }
+        rule_table_t * copy = (rule_table_t *)PyMem_Malloc(
+            sizeof(rule_table_t) + size * sizeof(pred_t));
+        if (copy == NULL)
+        {
+            FUNC_RET("%p", PyErr_NoMemory());
+        }
+        memset(copy, 0, sizeof(rule_table_t));
+        if (table != NULL)
+        {
+            memcpy(copy, table, sizeof(rule_table_t) + 
+                table->used * sizeof(pred_t));
+        }
+        copy->size = size;
+        SandboxPolicy_reset(self, copy, NULL, 0);
+        table = copy;
+    }
+    
+    /* Predicate code is appended to the pool of the table, replaced rules 
+     * leave their code behind, which is reclaimed with the table */
+    if (len > 0)
+    {
+        memcpy(table->code + table->used, code, len * sizeof(pred_t));
+        rule.pc = table->used;
+        table->used += len;
+    }
+    
+    if (sc == Py_None)
+    {
+        table->fallback = rule;
     }
     else
     {
-        *paction = SandboxAction_GET_ACTION(o);
+        table->rule[mode][scno] = rule;
     }
     
-    Py_XDECREF(o);
+    Py_INCREF(Py_None);
     
-    PyGILState_Release(gstate);
+    FUNC_RET("%p", Py_None);
+}
+
+/* Evaluate the postfix code of a predicate against the arguments of a system 
+ * call event, the depth of the stack has been checked by SandboxPolicy_rule() */
+static bool
+SandboxPolicy_test(const pred_t * code, int len, const event_t * pevent)
+{
+    FUNC_BEGIN("%p,%d,%p", code, len, pevent);
+    assert(code && pevent);
     
-    PROC_END();
+    const long argv[] = {
+        pevent->data._SYSCALL.a, pevent->data._SYSCALL.b, 
+        pevent->data._SYSCALL.c, pevent->data._SYSCALL.d, 
+        pevent->data._SYSCALL.e, pevent->data._SYSCALL.f};
+    
+    bool stack[PRED_STACK_MAX];
+    int i, sp = 0;
+    
+    for (i = 0; i < len; i++)
+    {
+        const long x = (code[i].arg > 0) ? argv[code[i].arg - 1] : 0;
+        const long y = code[i].value;
+        switch (code[i].op)
+        {
+        case S_PRED_NOT:
+            stack[sp - 1] = !stack[sp - 1];
+            break;
+        case S_PRED_AND:
+            sp--;
+            stack[sp - 1] = stack[sp - 1] && stack[sp];
+            break;
+        case S_PRED_OR:
+            sp--;
+            stack[sp - 1] = stack[sp - 1] || stack[sp];
+            break;
+        case S_PRED_EQ:
+            stack[sp++] = (x == y);
+            break;
+        case S_PRED_NE:
+            stack[sp++] = (x != y);
+            break;
+        case S_PRED_LT:
+            stack[sp++] = (x < y);
+            break;
+        case S_PRED_LE:
+            stack[sp++] = (x <= y);
+            break;
+        case S_PRED_GT:
+            stack[sp++] = (x > y);
+            break;
+        case S_PRED_GE:
+            stack[sp++] = (x >= y);
+            break;
+        case S_PRED_ALL:
+            stack[sp++] = ((x & y) == y);
+            break;
+        case S_PRED_NONE:
+            stack[sp++] = ((x & y) == 0);
+            break;
+        default:
+            FUNC_RET("%d", false);
+        }
+    }
+    
+    FUNC_RET("%d", (sp == 1) && stack[0]);
 }
 
-#ifndef SandboxPolicy_AS_POLICY
-#define SandboxPolicy_AS_POLICY(o) \
-    ((policy_t){(void *)SandboxPolicy_entry, (long)(o)})
-#endif /* SandboxPolicy_AS_POLICY */
+/* Look up the action of an event in a native rule table, return 1 if the action
+ * is determined, or 0 if the event should be delegated to the policy object.
+ * NOTE: this function is invoked by the watcher WITHOUT holding the GIL. */
+static int
+SandboxPolicy_lookup(const rule_table_t * table, const event_t * pevent, 
+                     action_t * paction)
+{
+    FUNC_BEGIN("%p,%p,%p", table, pevent, paction);
+    assert(pevent && paction);
+    
+    if ((table == NULL) || ((pevent->type != S_EVENT_SYSCALL) && 
+        (pevent->type != S_EVENT_SYSRET)))
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+#ifdef __x86_64__
+    syscall_t sc;
+    memcpy(&sc, &pevent->data._SYSCALL.scinfo, sizeof(syscall_t));
+    const long scno = sc.scno;
+    const int mode = sc.mode;
+#else
+    const long scno = pevent->data._SYSCALL.scinfo;
+    const int mode = 0;
+#endif /* __x86_64__ */
+    
+    const rule_t * prule = &table->fallback;
+    if ((scno >= 0) && (scno < RULE_SCNO_MAX) && (mode >= 0) && 
+        (mode < RULE_MODE_MAX) && 
+        (table->rule[mode][scno].type != RULE_DEFAULT))
+    {
+        prule = &table->rule[mode][scno];
+    }
+    
+    if (prule->type != RULE_NATIVE)
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    /* Entries allowed by the rule itself are continued with *NORET* below, so 
+     * the return of a ruled system call is only reported if its entry failed
+     * the predicate, and was delegated to the policy object, which should see
+     * the return of the system call it allowed as well. */
+    if (pevent->type == S_EVENT_SYSRET)
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    if ((prule->len > 0) && !SandboxPolicy_test(table->code + prule->pc, 
+        prule->len, pevent))
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    /* Nobody is interested in the return of a natively allowed system call,
+     * and the decision only depends on the arguments tested by the predicate,
+     * thus can be cached by the watcher */
+    if (prule->action == S_ACTION_CONT)
+    {
+        int i, cache = S_CACHE_SCINFO;
+        for (i = 0; i < prule->len; i++)
+        {
+            const pred_t * p = table->code + prule->pc + i;
+            cache |= (p->arg > 0) ? (1 << (p->arg - 1)) : 0;
+        }
+        *paction = (action_t){S_ACTION_CONT_NORET, {{cache}}};
+        FUNC_RET("%d", 1);
+    }
+    
+    *paction = (action_t){(action_type_t)prule->action, {{prule->result}}};
+    
+    FUNC_RET("%d", 1);
+}
 
-/* sandboxType */
+#ifdef SECCOMP_RET_TRACE
+
+/* Only comparisons for (in)equality and bit masks can be translated into the 
+ * classic bpf, which has no signed 64-bit arithmetic */
+static bool
+SandboxPolicy_translatable(const pred_t * code, int len)
+{
+    FUNC_BEGIN("%p,%d", code, len);
+    assert(code);
+    
+    int i;
+    for (i = 0; i < len; i++)
+    {
+        if ((code[i].op >= S_PRED_LT) && (code[i].op <= S_PRED_GE))
+        {
+            FUNC_RET("%d", false);
+        }
+    }
+    
+    FUNC_RET("%d", true);
+}
+
+/* Translate the native rule table of a policy into a seccomp filter program,
+ * such that system calls allowed by their rules (including the predicates) do
+ * not stop the prisoner process at all, while the rest are reported to the 
+ * watcher as usual. Return the length of the program stored in *pprog, or 0 
+ * if the table is not worth translating. The caller frees *pprog. */
+static int
+SandboxPolicy_filter(const rule_table_t * table, struct sock_filter ** pprog)
+{
+    FUNC_BEGIN("%p,%p", table, pprog);
+    assert(pprog);
+    
+    *pprog = NULL;
+    if (table == NULL)
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    struct sock_filter * prog = (struct sock_filter *)PyMem_Malloc(
+        BPF_MAXINSNS * sizeof(struct sock_filter));
+    if (prog == NULL)
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    int len = 0;
+    bool allowed = false;
+    
+    #define EMIT(code, k, jt, jf) \
+    {{{ \
+        if (len >= BPF_MAXINSNS) \
+        { \
+            goto overflow; \
+        } \
+        prog[len++] = (struct sock_filter)BPF_JUMP((code), (k), (jt), (jf)); \
+    }}} /* EMIT */
+    
+    #define ALLOW ((long)SECCOMP_RET_ALLOW)
+    #define TRACE ((long)SECCOMP_RET_TRACE)
+    #define ARG_LO(i) (offsetof(struct seccomp_data, args[(i) - 1]))
+    #define ARG_HI(i) (offsetof(struct seccomp_data, args[(i) - 1]) + 4)
+    
+    /* Outcome of a rule, which is ALLOW, TRACE, or -1 for native continuation
+     * subject to a translatable predicate */
+    #define OUTCOME(prule) \
+        ((((prule)->type != RULE_NATIVE) || \
+          ((prule)->action != S_ACTION_CONT)) ? (TRACE) : \
+         (((prule)->len == 0) ? (ALLOW) : \
+          (SandboxPolicy_translatable(table->code + (prule)->pc, \
+           (prule)->len) ? (-1) : (TRACE)))) \
+    /* OUTCOME */
+    
+    const long default_outcome = (table->fallback.type == RULE_DEFAULT) ? 
+        TRACE : OUTCOME(&table->fallback);
+    const long outcome = (default_outcome == ALLOW) ? ALLOW : TRACE;
+    allowed = (outcome == ALLOW);
+    
+    /* Dispatch by the audit arch of the system call, unknown arch's are always
+     * reported to the watcher */
+    int entry[RULE_MODE_MAX] = {0};
+    int mode;
+    
+    EMIT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch), 0, 0);
+#ifdef __x86_64__
+    EMIT(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 1);
+    entry[0] = len;
+    EMIT(BPF_JMP | BPF_JA, 0, 0, 0);
+    EMIT(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_I386, 0, 1);
+    entry[1] = len;
+    EMIT(BPF_JMP | BPF_JA, 0, 0, 0);
+    EMIT(BPF_RET | BPF_K, TRACE, 0, 0);
+#else /* __i386__ */
+    EMIT(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_I386, 1, 0);
+    EMIT(BPF_RET | BPF_K, TRACE, 0, 0);
+    entry[0] = -1;
+#endif /* __x86_64__ */
+    
+    for (mode = 0; mode < RULE_MODE_MAX; mode++)
+    {
+        /* Resolve the jump from the dispatcher to this block */
+        if (entry[mode] >= 0)
+        {
+            prog[entry[mode]].k = len - (entry[mode] + 1);
+        }
+        
+        EMIT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr), 0, 0);
+        EMIT(BPF_JMP | BPF_JGE | BPF_K, RULE_SCNO_MAX, 0, 1);
+        EMIT(BPF_RET | BPF_K, TRACE, 0, 0);
+        
+        const long execve = (mode == 0) ? SYS_execve : 11;
+#ifdef SYS_execveat
+        const long execveat = (mode == 0) ? SYS_execveat : 358;
+#else
+        const long execveat = -1;
+#endif /* SYS_execveat */
+        long scno;
+        for (scno = 0; scno < RULE_SCNO_MAX; scno++)
+        {
+            const rule_t * prule = &table->rule[mode][scno];
+            /* The watcher relies on reported execve() (and execveat()) to 
+             * follow the prisoner process, it is never filtered out */
+            const long result = ((scno == execve) || (scno == execveat)) ? 
+                TRACE : 
+                (prule->type == RULE_DEFAULT) ? outcome : OUTCOME(prule);
+            if (result == outcome)
+            {
+                continue;
+            }
+            if (result != -1)
+            {
+                EMIT(BPF_JMP | BPF_JEQ | BPF_K, scno, 0, 1);
+                EMIT(BPF_RET | BPF_K, result, 0, 0);
+                allowed = allowed || (result == ALLOW);
+                continue;
+            }
+            
+            /* Evaluate the predicate on scratch memory M[sp], and allow the 
+             * system call if M[0] holds in the end */
+            EMIT(BPF_JMP | BPF_JEQ | BPF_K, scno, 1, 0);
+            const int skip = len;
+            EMIT(BPF_JMP | BPF_JA, 0, 0, 0);
+            const pred_t * code = table->code + prule->pc;
+            int i, sp = 0;
+            for (i = 0; i < prule->len; i++)
+            {
+                const unsigned int lo = (unsigned int)code[i].value;
+                const unsigned int hi = 
+                    (unsigned int)((unsigned long)code[i].value >> 32);
+                const int arg = code[i].arg;
+                switch (code[i].op)
+                {
+                case S_PRED_NOT:
+                    EMIT(BPF_LDX | BPF_W | BPF_MEM, sp - 1, 0, 0);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 1, 0, 0);
+                    EMIT(BPF_ALU | BPF_SUB | BPF_X, 0, 0, 0);
+                    EMIT(BPF_ST, sp - 1, 0, 0);
+                    break;
+                case S_PRED_AND:
+                case S_PRED_OR:
+                    sp--;
+                    EMIT(BPF_LD | BPF_W | BPF_MEM, sp - 1, 0, 0);
+                    EMIT(BPF_LDX | BPF_W | BPF_MEM, sp, 0, 0);
+                    EMIT(BPF_ALU | BPF_X | ((code[i].op == S_PRED_AND) ? 
+                        BPF_AND : BPF_OR), 0, 0, 0);
+                    EMIT(BPF_ST, sp - 1, 0, 0);
+                    break;
+                case S_PRED_EQ:
+                case S_PRED_NE:
+                    EMIT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(arg), 0, 0);
+                    EMIT(BPF_JMP | BPF_JEQ | BPF_K, lo, 0, 4);
+                    EMIT(BPF_LD | BPF_W | BPF_ABS, ARG_HI(arg), 0, 0);
+                    EMIT(BPF_JMP | BPF_JEQ | BPF_K, hi, 0, 2);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 
+                        (code[i].op == S_PRED_EQ) ? 1 : 0, 0, 0);
+                    EMIT(BPF_JMP | BPF_JA, 1, 0, 0);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 
+                        (code[i].op == S_PRED_EQ) ? 0 : 1, 0, 0);
+                    EMIT(BPF_ST, sp++, 0, 0);
+                    break;
+                case S_PRED_ALL:
+                    EMIT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(arg), 0, 0);
+                    EMIT(BPF_ALU | BPF_AND | BPF_K, lo, 0, 0);
+                    EMIT(BPF_JMP | BPF_JEQ | BPF_K, lo, 0, 5);
+                    EMIT(BPF_LD | BPF_W | BPF_ABS, ARG_HI(arg), 0, 0);
+                    EMIT(BPF_ALU | BPF_AND | BPF_K, hi, 0, 0);
+                    EMIT(BPF_JMP | BPF_JEQ | BPF_K, hi, 0, 2);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 1, 0, 0);
+                    EMIT(BPF_JMP | BPF_JA, 1, 0, 0);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 0, 0, 0);
+                    EMIT(BPF_ST, sp++, 0, 0);
+                    break;
+                case S_PRED_NONE:
+                    EMIT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(arg), 0, 0);
+                    EMIT(BPF_JMP | BPF_JSET | BPF_K, lo, 4, 0);
+                    EMIT(BPF_LD | BPF_W | BPF_ABS, ARG_HI(arg), 0, 0);
+                    EMIT(BPF_JMP | BPF_JSET | BPF_K, hi, 2, 0);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 1, 0, 0);
+                    EMIT(BPF_JMP | BPF_JA, 1, 0, 0);
+                    EMIT(BPF_LD | BPF_W | BPF_IMM, 0, 0, 0);
+                    EMIT(BPF_ST, sp++, 0, 0);
+                    break;
+                default:
+                    break;
+                }
+            }
+            EMIT(BPF_LD | BPF_W | BPF_MEM, 0, 0, 0);
+            EMIT(BPF_JMP | BPF_JEQ | BPF_K, 1, 0, 1);
+            EMIT(BPF_RET | BPF_K, ALLOW, 0, 0);
+            EMIT(BPF_RET | BPF_K, TRACE, 0, 0);
+            prog[skip].k = len - (skip + 1);
+            allowed = true;
+        }
+        
+        EMIT(BPF_RET | BPF_K, outcome, 0, 0);
+    }
+    
+    #undef OUTCOME
+    #undef ARG_HI
+    #undef ARG_LO
+    #undef TRACE
+    #undef ALLOW
+    #undef EMIT
+    
+    /* Nothing to gain if all system calls are reported anyway */
+    if (!allowed)
+    {
+        PyMem_Free(prog);
+        FUNC_RET("%d", 0);
+    }
+    
+    *pprog = prog;
+    FUNC_RET("%d", len);
+    
+overflow:
+    WARN("rule table exceeds the size of seccomp filter program");
+    PyMem_Free(prog);
+    FUNC_RET("%d", 0);
+}
+
+#endif /* SECCOMP_RET_TRACE */
+
+/* Check the consistency of a (mapped) policy profile, return its rule table,
+ * or NULL if the profile is invalid, or incompatible with the host */
+static rule_table_t *
+SandboxPolicy_profile(void * image, size_t size)
+{
+    FUNC_BEGIN("%p,%zu", image, size);
+    assert(image);
+    
+    const profile_t * header = (const profile_t *)image;
+    if ((size < sizeof(profile_t)) || 
+        (memcmp(header->magic, PROFILE_MAGIC, sizeof(header->magic)) != 0) || 
+        (header->version != PROFILE_VERSION) || 
+        (header->layout != PROFILE_LAYOUT) || (header->size != size))
+    {
+        FUNC_RET("%p", NULL);
+    }
+    
+    if ((header->table % PROFILE_ALIGN) || (header->table > size) || 
+        (size - header->table < sizeof(rule_table_t)))
+    {
+        FUNC_RET("%p", NULL);
+    }
+    
+    rule_table_t * table = (rule_table_t *)((char *)image + header->table);
+    if ((table->used > table->size) || ((size - header->table - 
+        sizeof(rule_table_t)) / sizeof(pred_t) < table->used))
+    {
+        FUNC_RET("%p", NULL);
+    }
+    
+    if ((header->filter % PROFILE_ALIGN) || (header->filter > size))
+    {
+        FUNC_RET("%p", NULL);
+    }
+#ifdef SECCOMP_RET_TRACE
+    if ((header->nfilter > BPF_MAXINSNS) || ((size - header->filter) / 
+        sizeof(struct sock_filter) < header->nfilter))
+    {
+        FUNC_RET("%p", NULL);
+    }
+#else
+    if (header->nfilter > 0)
+    {
+        FUNC_RET("%p", NULL);
+    }
+#endif /* SECCOMP_RET_TRACE */
+    
+    /* Rules are trusted by SandboxPolicy_lookup(), which runs in the watcher
+     * without further checking */
+    long i;
+    for (i = -1; i < RULE_MODE_MAX * RULE_SCNO_MAX; i++)
+    {
+        const rule_t * prule = (i < 0) ? &table->fallback : 
+            (&table->rule[0][0] + i);
+        if (prule->type > RULE_NATIVE)
+        {
+            FUNC_RET("%p", NULL);
+        }
+        if ((prule->type == RULE_NATIVE) && 
+            (((prule->action != S_ACTION_CONT) && 
+              (prule->action != S_ACTION_FINI) && 
+              (prule->action != S_ACTION_KILL)) || 
+             (prule->result > S_RESULT_WA) || 
+             (prule->pc > table->used) || 
+             (prule->len > table->used - prule->pc) || 
+             !SandboxPolicy_verify(table->code + prule->pc, prule->len)))
+        {
+            FUNC_RET("%p", NULL);
+        }
+    }
+    
+    FUNC_RET("%p", table);
+}
+
+static PyObject *
+SandboxPolicy_dump(SandboxPolicy * self, PyObject * args)
+{
+    FUNC_BEGIN("%p,%p", self, args);
+    assert(self && args);
+    
+    const char * filename = NULL;
+    if (!PyArg_ParseTuple(args, "s:dump", &filename))
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    const rule_table_t * table = SandboxPolicy_GET_STATE(self).rules;
+    if (table == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_PROFILE_NO_RULES);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    void * prog = NULL;
+    int nfilter = 0;
+    size_t nprog = 0;
+#ifdef SECCOMP_RET_TRACE
+    nfilter = SandboxPolicy_filter(table, (struct sock_filter * *)&prog);
+    nprog = nfilter * sizeof(struct sock_filter);
+#endif /* SECCOMP_RET_TRACE */
+    
+    /* The image consists of a header, the rule table with its pool of 
+     * predicate code, and the seccomp filter program, each aligned */
+    #define ALIGNED(x) \
+        (((x) + PROFILE_ALIGN - 1) / PROFILE_ALIGN * PROFILE_ALIGN) \
+    /* ALIGNED */
+    
+    const size_t ntable = sizeof(rule_table_t) + table->used * sizeof(pred_t);
+    profile_t header = {{0}, PROFILE_VERSION, PROFILE_LAYOUT, 0, 0, 0, 
+        (unsigned int)nfilter};
+    memcpy(header.magic, PROFILE_MAGIC, sizeof(header.magic));
+    header.table = ALIGNED(sizeof(profile_t));
+    header.filter = ALIGNED(header.table + ntable);
+    header.size = header.filter + nprog;
+    
+    #undef ALIGNED
+    
+    char * image = (char *)PyMem_Malloc(header.size);
+    if (image == NULL)
+    {
+        PyMem_Free(prog);
+        FUNC_RET("%p", PyErr_NoMemory());
+    }
+    memset(image, 0, header.size);
+    memcpy(image, &header, sizeof(profile_t));
+    memcpy(image + header.table, table, ntable);
+    ((rule_table_t *)(image + header.table))->size = table->used;
+    memcpy(image + header.filter, prog, nprog);
+    PyMem_Free(prog);
+    
+    /* Profiles may be mapped by other processes, so the image is written to
+     * a temporary file in the same directory, and renamed over the profile,
+     * rather than rewriting the mapped file in place */
+    const size_t len = strlen(filename);
+    char * temp = (char *)PyMem_Malloc(len + sizeof(".XXXXXX"));
+    if (temp == NULL)
+    {
+        PyMem_Free(image);
+        FUNC_RET("%p", PyErr_NoMemory());
+    }
+    memcpy(temp, filename, len);
+    memcpy(temp + len, ".XXXXXX", sizeof(".XXXXXX"));
+    
+    int fd = mkstemp(temp);
+    size_t done = 0;
+    while ((fd >= 0) && (done < header.size))
+    {
+        ssize_t res = write(fd, image + done, header.size - done);
+        if ((res < 0) && (errno != EINTR))
+        {
+            break;
+        }
+        done += (res > 0) ? res : 0;
+    }
+    PyMem_Free(image);
+    
+    bool ok = (fd >= 0) && (done == header.size) && 
+        (fchmod(fd, 0644) == 0) && (fsync(fd) == 0);
+    ok = (fd >= 0) && (close(fd) == 0) && ok;
+    ok = ok && (rename(temp, filename) == 0);
+    if (!ok)
+    {
+        const int err = errno;
+        if (fd >= 0)
+        {
+            unlink(temp);
+        }
+        PyMem_Free(temp);
+        errno = err;
+        FUNC_RET("%p", PyErr_SetFromErrnoWithFilename(PyExc_IOError, 
+            filename));
+    }
+    PyMem_Free(temp);
+    
+    Py_INCREF(Py_None);
+    FUNC_RET("%p", Py_None);
+}
+
+static PyObject *
+SandboxPolicy_load(SandboxPolicy * self, PyObject * args)
+{
+    FUNC_BEGIN("%p,%p", self, args);
+    assert(self && args);
+    
+    const char * filename = NULL;
+    if (!PyArg_ParseTuple(args, "s:load", &filename))
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* The replaced rule table is unmapped or freed, see rule() */
+    if (SandboxPolicy_GET_STATE(self).users > 0)
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_RULE_SET_FORBID);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* Profiles are mapped read-only and shared, such that the same rules are 
+     * paid once per host, regardless of the number of policies using them */
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if ((fd < 0) || (fstat(fd, &st) != 0))
+    {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    const size_t size = (size_t)st.st_size;
+    void * image = (size >= sizeof(profile_t)) ? 
+        mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        FUNC_RET("%p", PyErr_SetFromErrnoWithFilename(PyExc_IOError, 
+            filename));
+    }
+    
+    rule_table_t * table = (image != NULL) ? 
+        SandboxPolicy_profile(image, size) : NULL;
+    if (table == NULL)
+    {
+        if (image != NULL)
+        {
+            munmap(image, size);
+        }
+        PyErr_SetString(PyExc_ValueError, MSG_PROFILE_INVALID);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    SandboxPolicy_reset(self, table, image, size);
+    
+    Py_INCREF(Py_None);
+    FUNC_RET("%p", Py_None);
+}
+
+static int
+SandboxPolicy_Check(PyObject * o)
+{
+    FUNC_BEGIN("%p", o);
+    if (o == NULL)
+    {
+        FUNC_RET("%d", 0);
+    }
+    FUNC_RET("%d", PyObject_TypeCheck(o, &policyType));
+}
+
+static PyObject *
+SandboxPolicy_New(void)
+{
+    FUNC_BEGIN();
+    PyObject * args = Py_BuildValue("()");
+    PyObject * o = policyType.tp_new(&policyType, args, NULL);
+    Py_DECREF(args);
+    FUNC_RET("%p", o);
+}
+
+static void 
+SandboxPolicy_entry(const policy_t * ppolicy, const event_t * pevent, 
+                     action_t * paction)
+{
+    PROC_BEGIN("%p,%p,%p", ppolicy, pevent, paction);
+    
+    assert(ppolicy && pevent && paction);
+    
+    SandboxPolicy * p = (SandboxPolicy *)ppolicy->data;
+    
+    /* Since 0.3.6, events covered by the native rule table of the policy are 
+     * handled without acquiring the GIL. The policy object is referenced by 
+     * the running sandbox, and its rule table is neither replaced nor changed
+     * until the run is over, see Sandbox_attach(). */
+    if ((p != NULL) && SandboxPolicy_lookup(SandboxPolicy_GET_STATE(p).rules, 
+        pevent, paction))
+    {
+        PROC_END();
+    }
+    
+    PyGILState_STATE gstate;
+    gstate = PyGILState_Ensure();
+    
+    if (!SandboxPolicy_Check((PyObject *)p))
+    {
+        *paction = (action_t){S_ACTION_KILL, {{S_RESULT_BP}}};
+        PyGILState_Release(gstate);
+        PROC_END();
+    }
+    
+    (SandboxPolicy_GET_STATE(p).e) ? 
+        SandboxEvent_SET_EVENT(SandboxPolicy_GET_STATE(p).e, pevent) :
+        (SandboxPolicy_GET_STATE(p).e = SandboxEvent_FromEvent(pevent));
+    
+    (SandboxPolicy_GET_STATE(p).a) ? 
+        SandboxAction_SET_ACTION(SandboxPolicy_GET_STATE(p).a, NULL) :
+        (SandboxPolicy_GET_STATE(p).a = SandboxAction_FromAction(NULL));
+    
+    PyObject * o = PyObject_CallFunctionObjArgs((PyObject *)p, 
+        SandboxPolicy_GET_STATE(p).e, SandboxPolicy_GET_STATE(p).a, NULL);
+    
+    if ((o == NULL) || PyErr_Occurred() || ((o != SandboxPolicy_GET_STATE(p).a) 
+        && !SandboxAction_Check(o)))
+    {
+        *paction = (action_t){S_ACTION_KILL, {{S_RESULT_BP}}};
+    }
+    else
+    {
+        *paction = SandboxAction_GET_ACTION(o);
+    }
+    
+    Py_XDECREF(o);
+    
+    PyGILState_Release(gstate);
+    
+    PROC_END();
+}
+
+#ifndef SandboxPolicy_AS_POLICY
+#define SandboxPolicy_AS_POLICY(o) \
+    ((policy_t){(void *)SandboxPolicy_entry, (long)(o)})
+#endif /* SandboxPolicy_AS_POLICY */
+
+/* sandboxType */
 
 PyDoc_STRVAR(DOC_TP_SANDBOX,    "");
 
@@ -596,6 +1636,36 @@ PyDoc_STRVAR(DOC_SANDBOX_PROBE, "");
 
 PyDoc_STRVAR(DOC_SANDBOX_RUN,   "");
 
+PyDoc_STRVAR(DOC_SANDBOX_INTERACT, 
+"interact(peer, grace=1000) runs the sandbox along with sandbox peer, the \n"
+"stdout of either is piped to the stdin of the other; once either finishes, \n"
+"the other is killed unless finished within grace (msec, or None to wait)");
+
+PyDoc_STRVAR(DOC_SANDBOX_PREFORK, 
+"prefork(size, refill=True) keeps size prisoner processes pre-spawned from \n"
+"the template of the sandbox, to be handed over to instances created with \n"
+"template=sandbox; the sandbox must outlive its running instances, and the \n"
+"pool is not replaced while in use");
+
+PyDoc_STRVAR(DOC_SANDBOX_POOL, 
+"statistics (dict) of the pool started with prefork(), or None");
+
+PyDoc_STRVAR(DOC_SANDBOX_CACHE, 
+"statistics (dict) of the result cache opened with cache=path, or None; runs\n"
+"under a policy with a true deterministic attribute are cached if both of\n"
+"stdout and stderr are os.devnull, as nothing is written to them on a hit,\n"
+"and the policy is identified by its cache_key attribute (bytes or str), or\n"
+"else the qualified name of its class, along with its native rules");
+
+PyDoc_STRVAR(DOC_SANDBOX_FORKSERVER, 
+"forkserver() runs the template of the sandbox as a master process under the \n"
+"current policy, parks it upon its first system call on a standard channel, \n"
+"and forks (traced) copies of it for instances created with template=sandbox;\n"
+"the sandbox must outlive its running instances (x86_64 only)");
+
+PyDoc_STRVAR(DOC_SANDBOX_SERVER, 
+"statistics (dict) of the fork server started with forkserver(), or None");
+
 static PyMemberDef sandboxMembers[] = 
 {
     {"owner", T_INT, offsetof(Sandbox, sbox.task.uid), READONLY, 
@@ -606,6 +1676,9 @@ static PyMemberDef sandboxMembers[] =
 };
 
 static PyObject * Sandbox_get_pid(Sandbox *, void *);
+static PyObject * Sandbox_get_pool(Sandbox *, void *);
+static PyObject * Sandbox_get_server(Sandbox *, void *);
+static PyObject * Sandbox_get_cache(Sandbox *, void *);
 static PyObject * Sandbox_get_task(Sandbox *, void *);
 static PyObject * Sandbox_get_jail(Sandbox *, void *);
 static PyObject * Sandbox_get_quota(Sandbox *, void *);
@@ -624,18 +1697,30 @@ static PyGetSetDef sandboxGetSetters[] =
     {"status", (getter)Sandbox_get_status, 0, DOC_SANDBOX_STATUS, NULL}, 
     {"result", (getter)Sandbox_get_result, 0, DOC_SANDBOX_RESULT, NULL}, 
     {"pid", (getter)Sandbox_get_pid, 0, DOC_SANDBOX_PID, NULL}, 
+    {"pool", (getter)Sandbox_get_pool, 0, DOC_SANDBOX_POOL, NULL}, 
+    {"server", (getter)Sandbox_get_server, 0, DOC_SANDBOX_SERVER, NULL}, 
+    {"cache", (getter)Sandbox_get_cache, 0, DOC_SANDBOX_CACHE, NULL}, 
     {NULL, 0, 0, 0, NULL}       /* Sentinel */
 };
 
 static PyObject * Sandbox_run(Sandbox *);
+static PyObject * Sandbox_interact(Sandbox *, PyObject *, PyObject *);
 static PyObject * Sandbox_probe(Sandbox *);
 static PyObject * Sandbox_dump(Sandbox *, PyObject *);
+static PyObject * Sandbox_prefork(Sandbox *, PyObject *, PyObject *);
+static PyObject * Sandbox_forkserver(Sandbox *);
 
 static PyMethodDef sandboxMethods[] = 
 {
     {"dump", (PyCFunction)Sandbox_dump, METH_VARARGS, DOC_SANDBOX_DUMP},
     {"probe", (PyCFunction)Sandbox_probe, METH_NOARGS, DOC_SANDBOX_PROBE},
     {"run", (PyCFunction)Sandbox_run, METH_NOARGS, DOC_SANDBOX_RUN},
+    {"interact", (PyCFunction)Sandbox_interact, METH_VARARGS | METH_KEYWORDS,
+     DOC_SANDBOX_INTERACT},
+    {"prefork", (PyCFunction)Sandbox_prefork, METH_VARARGS | METH_KEYWORDS, 
+     DOC_SANDBOX_PREFORK},
+    {"forkserver", (PyCFunction)Sandbox_forkserver, METH_NOARGS, 
+     DOC_SANDBOX_FORKSERVER},
     {NULL, NULL, 0, NULL}       /* Sentinel */
 };
 
@@ -643,6 +1728,7 @@ static PyObject * Sandbox_new(PyTypeObject *, PyObject *, PyObject *);
 static void Sandbox_free(Sandbox *);
 static int Sandbox_traverse(Sandbox *, visitproc, void *);
 static int Sandbox_clear(Sandbox *);
+static void Sandbox_stop_server(Sandbox *);
 
 static PyTypeObject sandboxType = 
 {
@@ -687,7 +1773,20 @@ static PyTypeObject sandboxType =
     Sandbox_new,                                /* tp_new */
 };
 
+static int
+Sandbox_Check(PyObject * o)
+{
+    FUNC_BEGIN("%p", o);
+    if (o == NULL)
+    {
+        FUNC_RET("%d", 0);
+    }
+    FUNC_RET("%d", PyObject_TypeCheck(o, &sandboxType));
+}
+
 static int Sandbox_load_comm(PyObject *, Sandbox *);
+static int Sandbox_load_env(PyObject *, Sandbox *);
+static int Sandbox_load_template(PyObject *, Sandbox *);
 static int Sandbox_load_jail(PyObject *, Sandbox *);
 static int Sandbox_load_uid(PyObject *, Sandbox *);
 static int Sandbox_load_gid(PyObject *, Sandbox *);
@@ -696,6 +1795,20 @@ static int Sandbox_load_ofd(PyObject *, Sandbox *);
 static int Sandbox_load_efd(PyObject *, Sandbox *);
 static int Sandbox_load_quota(PyObject *, Sandbox *);
 static int Sandbox_load_policy(PyObject *, Sandbox *);
+static int Sandbox_load_placement(PyObject *, Sandbox *);
+static int Sandbox_load_backend(PyObject *, Sandbox *);
+static int Sandbox_load_fs(PyObject *, Sandbox *);
+static int Sandbox_load_trust(PyObject *, Sandbox *);
+static int Sandbox_load_ns(PyObject *, Sandbox *);
+static int Sandbox_load_image(PyObject *, Sandbox *);
+static int Sandbox_load_xfd(PyObject *, Sandbox *);
+static int Sandbox_load_answer(PyObject *, Sandbox *);
+static int Sandbox_load_compare(PyObject *, Sandbox *);
+static int Sandbox_load_epsilon(PyObject *, Sandbox *);
+static int Sandbox_load_input(PyObject *, Sandbox *);
+static int Sandbox_load_seekable(PyObject *, Sandbox *);
+static int Sandbox_load_cache(PyObject *, Sandbox *);
+static int Sandbox_load_sha256(PyObject *, Sandbox *);
 
 static PyObject *
 Sandbox_new(PyTypeObject * type, PyObject * args, PyObject * kwds)
@@ -753,22 +1866,101 @@ Sandbox_new(PyTypeObject * type, PyObject * args, PyObject * kwds)
         "stderr",               /* Error channel */
         "quota",                /* Resource quota */
         "policy",               /* Sandbox control policy */
+        "placement",            /* CPU placement */
+        "backend",              /* Watching backend */
+        "fs",                   /* Filesystem allow-list */
+        "trust",                /* Trust level */
+        "env",                  /* Environment variables */
+        "template",             /* Validated sandbox to instantiate from */
+        "ns",                   /* Namespaces */
+        "image",                /* Jail image */
+        "executable",           /* Open program file */
+        "answer",               /* Expected output */
+        "compare",              /* Comparison with the expected output */
+        "epsilon",              /* Tolerance of float comparison */
+        "input",                /* Input fed to stdin */
+        "seekable",             /* Feed the input as a seekable file */
+        "cache",                /* Index file of the result cache */
+        "sha256",               /* Compute the SHA-256 digest of the output */
         NULL                    /* Sentinel */
     };
     
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, 
-        "O&|O&O&O&O&O&O&O&O&", keywords, 
-        Sandbox_load_comm, self, 
-        Sandbox_load_jail, self, 
-        Sandbox_load_uid, self, 
-        Sandbox_load_gid, self, 
-        Sandbox_load_ifd, self, 
-        Sandbox_load_ofd, self, 
+    /* Static fields of the task come from either the template, or the other 
+     * keyword arguments, but not both */
+    if ((kwds != NULL) && (PyDict_GetItemString(kwds, "template") != NULL))
+    {
+        static const char * statics[] = {
+            "args", "jail", "owner", "group", "env", "fs", "trust", "ns", 
+            "image", "executable", NULL
+        };
+        const char ** key = statics;
+        while ((*key != NULL) && (PyDict_GetItemString(kwds, *key) == NULL))
+        {
+            key++;
+        }
+        if ((*key != NULL) || (PyTuple_GET_SIZE(args) > 0))
+        {
+            Py_DECREF((PyObject *)self);
+            PyErr_SetString(PyExc_TypeError, MSG_TEMPLATE_CONFLICT);
+            FUNC_RET("%p", Py_NULL);
+        }
+    }
+    
+    /* The program file bound into the jail image, or the open executable 
+     * file, stands in for the program of the command line, which need not 
+     * exist outside of the prisoner process, so both are loaded ahead of the 
+     * command line */
+    PyObject * image = (kwds != NULL) ? PyDict_GetItemString(kwds, "image") :
+        NULL;
+    if ((image != NULL) && !Sandbox_load_image(image, self))
+    {
+        Py_DECREF((PyObject *)self);
+        FUNC_RET("%p", Py_NULL);
+    }
+    PyObject * exe = (kwds != NULL) ? PyDict_GetItemString(kwds, 
+        "executable") : NULL;
+    if ((exe != NULL) && !Sandbox_load_xfd(exe, self))
+    {
+        Py_DECREF((PyObject *)self);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, 
+        "|O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&O&", keywords, 
+        Sandbox_load_comm, self, 
+        Sandbox_load_jail, self, 
+        Sandbox_load_uid, self, 
+        Sandbox_load_gid, self, 
+        Sandbox_load_ifd, self, 
+        Sandbox_load_ofd, self, 
         Sandbox_load_efd, self, 
         Sandbox_load_quota, self,
-        Sandbox_load_policy, self))
+        Sandbox_load_policy, self,
+        Sandbox_load_placement, self,
+        Sandbox_load_backend, self,
+        Sandbox_load_fs, self,
+        Sandbox_load_trust, self,
+        Sandbox_load_env, self,
+        Sandbox_load_template, self,
+        Sandbox_load_ns, self,
+        Sandbox_load_image, self,
+        Sandbox_load_xfd, self,
+        Sandbox_load_answer, self,
+        Sandbox_load_compare, self,
+        Sandbox_load_epsilon, self,
+        Sandbox_load_input, self,
+        Sandbox_load_seekable, self,
+        Sandbox_load_cache, self,
+        Sandbox_load_sha256, self))
+    {
+        Py_DECREF((PyObject *)self);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    if (Sandbox_GET_SBOX(self).task.comm.args[0] == NULL)
     {
         Py_DECREF((PyObject *)self);
+        PyErr_SetString(PyExc_TypeError, MSG_ARGS_MISSING);
         FUNC_RET("%p", Py_NULL);
     }
     
@@ -787,8 +1979,36 @@ Sandbox_free(Sandbox * self)
 {
     PROC_BEGIN("%p", self);
     assert(self);
+    /* Releasing the references below may run arbitrary code, including the
+     * garbage collector, which should no longer see this object */
+    PyObject_GC_UnTrack((PyObject *)self);
     Sandbox_clear(self);
     sandbox_fini(&Sandbox_GET_SBOX(self));
+    if (self->pool != NULL)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        sandbox_pool_fini(self->pool);
+        Py_END_ALLOW_THREADS
+        free(self->pool);
+        self->pool = NULL;
+    }
+    if (self->memo != NULL)
+    {
+        sandbox_memo_fini(self->memo);
+        free(self->memo);
+        self->memo = NULL;
+    }
+    if (self->tmpl != NULL)
+    {
+        sandbox_template_fini(self->tmpl);
+        free(self->tmpl);
+        self->tmpl = NULL;
+    }
+    /* Release native rules of polymorphic sandbox-and-policy objects */
+    if (SandboxPolicy_Check((PyObject *)self))
+    {
+        SandboxPolicy_reset((SandboxPolicy *)self, NULL, NULL, 0);
+    }
     Py_TYPE(self)->tp_free((PyObject *)self);
     PROC_END();
 }
@@ -801,6 +2021,10 @@ Sandbox_traverse(Sandbox * self, visitproc visit, void * arg)
     Py_VISIT(Sandbox_GET_IO(self).i);
     Py_VISIT(Sandbox_GET_IO(self).o);
     Py_VISIT(Sandbox_GET_IO(self).e);
+    Py_VISIT(Sandbox_GET_IO(self).x);
+    Py_VISIT(Sandbox_GET_IO(self).a);
+    Py_VISIT(Sandbox_GET_IO(self).f);
+    Py_VISIT(self->base);
     
     int res = 0;
     
@@ -816,6 +2040,13 @@ Sandbox_traverse(Sandbox * self, visitproc visit, void * arg)
     }
     UNLOCK(&Sandbox_GET_SBOX(self));
     
+    /* The fork server holds the policy of its master sandbox */
+    if ((res == 0) && (self->server != NULL) && 
+        SandboxPolicy_Check((PyObject *)self->server->sbox.ctrl.policy.data))
+    {
+        res = visit((PyObject *)self->server->sbox.ctrl.policy.data, arg);
+    }
+    
     FUNC_RET("%d", res);
 }
 
@@ -846,6 +2077,8 @@ Sandbox_clear(Sandbox * self)
     FUNC_BEGIN("%p", self);
     assert(self);
     
+    Sandbox_stop_server(self);
+    
     LOCK(&Sandbox_GET_SBOX(self), EX);
     Sandbox_CLEAR_POLICY(self);
     UNLOCK(&Sandbox_GET_SBOX(self));
@@ -853,10 +2086,48 @@ Sandbox_clear(Sandbox * self)
     Py_CLEAR(Sandbox_GET_IO(self).i);
     Py_CLEAR(Sandbox_GET_IO(self).o);
     Py_CLEAR(Sandbox_GET_IO(self).e);
+    Py_CLEAR(Sandbox_GET_IO(self).x);
+    Py_CLEAR(Sandbox_GET_IO(self).a);
+    Py_CLEAR(Sandbox_GET_IO(self).f);
+    if (Sandbox_GET_IO(self).view.obj != NULL)
+    {
+        PyBuffer_Release(&Sandbox_GET_IO(self).view);
+    }
+    Py_CLEAR(self->base);
     
     FUNC_RET("%d", 0);
 }
 
+static void
+Sandbox_stop_server(Sandbox * self)
+{
+    PROC_BEGIN("%p", self);
+    assert(self);
+    
+    server_t * server = self->server;
+    if (server == NULL)
+    {
+        PROC_END();
+    }
+    self->server = NULL;
+    
+    /* The master sandbox may consult its policy until the server is stopped,
+     * so the policy is released afterwards */
+    PyObject * policy = (PyObject *)server->sbox.ctrl.policy.data;
+    Py_BEGIN_ALLOW_THREADS
+    sandbox_server_fini(server);
+    Py_END_ALLOW_THREADS
+    free(server);
+    if (SandboxPolicy_Check(policy))
+    {
+        assert(SandboxPolicy_GET_STATE(policy).users > 0);
+        SandboxPolicy_GET_STATE(policy).users--;
+        Py_DECREF(policy);
+    }
+    
+    PROC_END();
+}
+
 static int
 Integer_Check(PyObject * o)
 {
@@ -899,99 +2170,208 @@ UTF8Bytes_FromObject(PyObject * o)
     FUNC_RET("%p", Py_NULL);
 }
 
-static int
-Sandbox_load_comm(PyObject * o, Sandbox * self)
+static PyObject *
+SandboxPolicy_Identity(PyObject * o)
 {
-    FUNC_BEGIN("%p,%p", o, self);
-    assert(o && self);
-    
-    command_t target;
-    memset(&target, 0, sizeof(command_t));
+    FUNC_BEGIN("%p", o);
+    assert(SandboxPolicy_Check(o));
     
-    size_t argc = 0;
-    size_t offset = 0;
-    if (PyBytes_Check(o) || PyUnicode_Check(o))
+    /* The cache_key attribute, or else the qualified name of the class, e.g.
+     * "module.Class" (or __name__ on Pythons without __qualname__) */
+    PyObject * key = NULL;
+    PyObject * attr = PyObject_GetAttrString(o, "cache_key");
+    if (attr != NULL)
     {
-        PyObject * pyutf8 = UTF8Bytes_FromObject(o);
-        if (pyutf8 == NULL)
+        key = UTF8Bytes_FromObject(attr);
+        Py_DECREF(attr);
+    }
+    else
+    {
+        PyErr_Clear();
+        PyObject * type = (PyObject *)Py_TYPE(o);
+        PyObject * mod = PyObject_GetAttrString(type, "__module__");
+        PyObject * name = PyObject_GetAttrString(type, "__qualname__");
+        if (name == NULL)
         {
-            FUNC_RET("%d", 0);
+            PyErr_Clear();
+            name = PyObject_GetAttrString(type, "__name__");
         }
-        size_t delta = PyBytes_GET_SIZE(pyutf8) + 1;
-        if (offset + delta < sizeof(target.buff))
+        PyObject * bmod = (mod != NULL) ? UTF8Bytes_FromObject(mod) : NULL;
+        PyObject * bname = (name != NULL) ? UTF8Bytes_FromObject(name) : NULL;
+        if ((bmod != NULL) && (bname != NULL))
         {
-            strcpy(target.buff, PyBytes_AS_STRING(pyutf8));
-            target.args[argc++] = offset;
-            offset += delta;
-            Py_DECREF(pyutf8);
+            key = PyBytes_FromFormat("%s.%s", PyBytes_AS_STRING(bmod), 
+                PyBytes_AS_STRING(bname));
         }
-        else
+        Py_XDECREF(bmod);
+        Py_XDECREF(bname);
+        Py_XDECREF(mod);
+        Py_XDECREF(name);
+    }
+    if (key == NULL)
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* Followed by the profile, or the native rules (if any) */
+    const void * data = NULL;
+    size_t size = 0;
+    const rule_table_t * rules = SandboxPolicy_GET_STATE(o).rules;
+    if (SandboxPolicy_GET_STATE(o).image != NULL)
+    {
+        data = SandboxPolicy_GET_STATE(o).image;
+        size = SandboxPolicy_GET_STATE(o).size;
+    }
+    else if (rules != NULL)
+    {
+        data = rules;
+        size = sizeof(rule_table_t) + rules->used * sizeof(pred_t);
+    }
+    
+    const Py_ssize_t len = PyBytes_GET_SIZE(key);
+    PyObject * result = PyBytes_FromStringAndSize(NULL, len + 1 + size);
+    if (result != NULL)
+    {
+        memcpy(PyBytes_AS_STRING(result), PyBytes_AS_STRING(key), len + 1);
+        if (size > 0)
         {
-            Py_DECREF(pyutf8);
-            PyErr_SetString(PyExc_OverflowError, MSG_ARGS_TOO_LONG);
-            FUNC_RET("%d", 0);
+            memcpy(PyBytes_AS_STRING(result) + len + 1, data, size);
         }
-        target.buff[offset] = '\0';
-        target.args[argc] = -1;
+    }
+    Py_DECREF(key);
+    
+    FUNC_RET("%p", result);
+}
+
+static PyObject *
+UTF8BytesList_FromObject(PyObject * o, const char * type_err, 
+                         const char * too_long)
+{
+    FUNC_BEGIN("%p,%p,%p", o, type_err, too_long);
+    assert(o && type_err && too_long);
+    
+    /* A str is a command line of its own, not a sequence of characters */
+    PyObject * seq = NULL;
+    if (PyBytes_Check(o) || PyUnicode_Check(o))
+    {
+        seq = Py_BuildValue("(O)", o);
     }
     else if (PySequence_Check(o))
     {
-        Py_ssize_t sz = PySequence_Size(o);
-        while ((sz > 0) && (argc < (size_t)sz))
+        seq = PySequence_Fast(o, type_err);
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, type_err);
+        FUNC_RET("%p", Py_NULL);
+    }
+    if (seq == NULL)
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    Py_ssize_t sz = PySequence_Fast_GET_SIZE(seq);
+    PyObject * list = PyList_New(sz);
+    if (list == NULL)
+    {
+        Py_DECREF(seq);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* All strings, including their terminators, should fit in the first 
+     * SBOX_ARG_MAX bytes, otherwise libsandbox would discard the excess */
+    size_t offset = 0;
+    Py_ssize_t i = 0;
+    for (i = 0; i < sz; i++)
+    {
+        PyObject * item = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyBytes_Check(item) && !PyUnicode_Check(item))
         {
-            PyObject * item = PySequence_GetItem(o, argc);
-            if (PyBytes_Check(item) || PyUnicode_Check(item))
-            {
-                item = UTF8Bytes_FromObject(item);
-                if (item == NULL)
-                {
-                    FUNC_RET("%d", 0);
-                    break;
-                }
-                size_t delta  = PyBytes_GET_SIZE(item) + 1;
-                if (offset + delta >= sizeof(target.buff))
-                {
-                    Py_DECREF(item);
-                    PyErr_SetString(PyExc_OverflowError, MSG_ARGS_TOO_LONG);
-                    FUNC_RET("%d", 0);
-                    break;
-                }
-                if (argc + 1 >= sizeof(target.args) / sizeof(int))
-                {
-                    Py_DECREF(item);
-                    PyErr_SetString(PyExc_OverflowError, MSG_ARGS_TOO_LONG);
-                    FUNC_RET("%d", 0);
-                    break;
-                }
-                strcpy(target.buff + offset, PyBytes_AS_STRING(item));
-                target.args[argc++] = offset;
-                offset += delta;
-                Py_DECREF(item);
-            }
-            else
-            {
-                PyErr_SetString(PyExc_TypeError, MSG_ARGS_TYPE_ERR);
-                FUNC_RET("%d", 0);
-            }
+            PyErr_SetString(PyExc_TypeError, type_err);
+            break;
+        }
+        item = UTF8Bytes_FromObject(item);
+        if (item == NULL)
+        {
+            break;
+        }
+        PyList_SET_ITEM(list, i, item);
+        offset += PyBytes_GET_SIZE(item) + 1;
+        if (offset >= SBOX_ARG_MAX)
+        {
+            PyErr_SetString(PyExc_OverflowError, too_long);
+            break;
         }
-        target.buff[offset] = '\0';
-        target.args[argc] = -1;
     }
-    else
+    Py_DECREF(seq);
+    
+    if (i < sz)
+    {
+        Py_DECREF(list);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    FUNC_RET("%p", list);
+}
+
+static const char **
+UTF8BytesList_AsArray(PyObject * list)
+{
+    FUNC_BEGIN("%p", list);
+    assert(list && PyList_Check(list));
+    
+    /* The returned array borrows the buffers of the bytes objects in list, it
+     * should be free()'d by the caller before list is released */
+    Py_ssize_t sz = PyList_GET_SIZE(list);
+    const char ** strv = (const char **)malloc((sz + 1) * sizeof(char *));
+    if (strv == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%p", NULL);
+    }
+    
+    Py_ssize_t i = 0;
+    for (i = 0; i < sz; i++)
+    {
+        strv[i] = PyBytes_AS_STRING(PyList_GET_ITEM(list, i));
+    }
+    strv[sz] = NULL;
+    
+    FUNC_RET("%p", strv);
+}
+
+static int
+Sandbox_load_comm(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    PyObject * list = UTF8BytesList_FromObject(o, MSG_ARGS_TYPE_ERR, 
+        MSG_ARGS_TOO_LONG);
+    if (list == NULL)
     {
-        PyErr_SetString(PyExc_TypeError, MSG_ARGS_TYPE_ERR);
         FUNC_RET("%d", 0);
     }
     
-    if (offset == 0)
+    if ((PyList_GET_SIZE(list) == 0) || 
+        (PyBytes_GET_SIZE(PyList_GET_ITEM(list, 0)) == 0))
     {
+        Py_DECREF(list);
         PyErr_SetString(PyExc_ValueError, MSG_ARGS_VAL_ERR);
         FUNC_RET("%d", 0);
     }
     
     struct stat s;
-    if ((stat(target.buff, &s) < 0) || !S_ISREG(s.st_mode))
+    const char * path = PyBytes_AS_STRING(PyList_GET_ITEM(list, 0));
+    if (Sandbox_GET_SBOX(self).task.image.prog[0] != '\0')
+    {
+        path = Sandbox_GET_SBOX(self).task.image.prog;
+    }
+    int res = (Sandbox_GET_SBOX(self).task.xfd >= 0) ? 
+        fstat(Sandbox_GET_SBOX(self).task.xfd, &s) : stat(path, &s);
+    if ((res < 0) || !S_ISREG(s.st_mode))
     {
+        Py_DECREF(list);
         PyErr_SetString(PyExc_ValueError, MSG_ARGS_INVALID);
         FUNC_RET("%d", 0);
     }
@@ -1000,100 +2380,264 @@ Sandbox_load_comm(PyObject * o, Sandbox * self)
         !((S_IXGRP & s.st_mode) && (s.st_gid == Sandbox_GET_SBOX(self).task.gid)) && 
         !(S_IXOTH & s.st_mode) && !(Sandbox_GET_SBOX(self).task.uid == (uid_t)0))
     {
+        Py_DECREF(list);
         PyErr_SetString(PyExc_ValueError, MSG_ARGS_INVALID);
         FUNC_RET("%d", 0);
     }
     
-    LOCK(&Sandbox_GET_SBOX(self), EX);
-    memcpy(&Sandbox_GET_SBOX(self).task.comm, &target, sizeof(command_t));
-    UNLOCK(&Sandbox_GET_SBOX(self));
+    const char ** argv = UTF8BytesList_AsArray(list);
+    if (argv == NULL)
+    {
+        Py_DECREF(list);
+        FUNC_RET("%d", 0);
+    }
+    
+    res = sandbox_command(&Sandbox_GET_SBOX(self), argv, NULL);
+    free(argv);
+    Py_DECREF(list);
+    
+    if (res != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%d", 0);
+    }
     
     FUNC_RET("%d", 1);
 }
 
 static int
-Sandbox_load_jail(PyObject * o, Sandbox * self)
+Sandbox_load_env(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
     
-    char target[SBOX_PATH_MAX] = {'/', '\0'};
-    
-    if (PyBytes_Check(o) || PyUnicode_Check(o))
+    PyObject * list = NULL;
+    if (PyDict_Check(o))
     {
-        PyObject * pyutf8 = UTF8Bytes_FromObject(o);
-        if (pyutf8 == NULL)
+        /* Flatten the mapping into a sequence of KEY=VALUE strings */
+        PyObject * seq = PyList_New(0);
+        if (seq == NULL)
         {
             FUNC_RET("%d", 0);
         }
-        if (PyBytes_GET_SIZE(pyutf8) + 1 < (Py_ssize_t)sizeof(target))
-        {
-            strcpy(target, PyBytes_AS_STRING(pyutf8));
-            Py_DECREF(pyutf8);
-        }
-        else
+        PyObject * key = NULL;
+        PyObject * val = NULL;
+        Py_ssize_t pos = 0;
+        while (PyDict_Next(o, &pos, &key, &val))
         {
-            Py_DECREF(pyutf8);
-            PyErr_SetString(PyExc_OverflowError, MSG_JAIL_TOO_LONG);
-            FUNC_RET("%d", 0);
+            PyObject * k = UTF8Bytes_FromObject(key);
+            PyObject * v = (k != NULL) ? UTF8Bytes_FromObject(val) : NULL;
+            PyObject * kv = (v != NULL) ? PyBytes_FromFormat("%s=%s", 
+                PyBytes_AS_STRING(k), PyBytes_AS_STRING(v)) : NULL;
+            Py_XDECREF(k);
+            Py_XDECREF(v);
+            if ((kv == NULL) || (PyList_Append(seq, kv) != 0))
+            {
+                Py_XDECREF(kv);
+                Py_DECREF(seq);
+                PyErr_Clear();
+                PyErr_SetString(PyExc_TypeError, MSG_ENV_TYPE_ERR);
+                FUNC_RET("%d", 0);
+            }
+            Py_DECREF(kv);
         }
+        list = UTF8BytesList_FromObject(seq, MSG_ENV_TYPE_ERR, 
+            MSG_ENV_TOO_LONG);
+        Py_DECREF(seq);
+    }
+    else if (PySequence_Check(o) && !PyBytes_Check(o) && !PyUnicode_Check(o))
+    {
+        list = UTF8BytesList_FromObject(o, MSG_ENV_TYPE_ERR, 
+            MSG_ENV_TOO_LONG);
     }
     else
     {
-        PyErr_SetString(PyExc_TypeError, MSG_JAIL_TYPE_ERR);
+        PyErr_SetString(PyExc_TypeError, MSG_ENV_TYPE_ERR);
+    }
+    if (list == NULL)
+    {
         FUNC_RET("%d", 0);
     }
     
-    if (strcmp(target, "/") != 0)
+    Py_ssize_t i = 0;
+    for (i = 0; i < PyList_GET_SIZE(list); i++)
     {
-        /* only super-user can chroot */
-        if (getuid() != (uid_t)0)
+        const char * kv = PyBytes_AS_STRING(PyList_GET_ITEM(list, i));
+        if ((kv[0] == '=') || (strchr(kv, '=') == NULL))
         {
-            PyErr_SetString(PyExc_AssertionError, MSG_JAIL_NOPERM);
+            Py_DECREF(list);
+            PyErr_SetString(PyExc_ValueError, MSG_ENV_VAL_ERR);
             FUNC_RET("%d", 0);
         }
-        
-        if (access(target, X_OK | R_OK) < 0)
+    }
+    
+    const char ** envp = UTF8BytesList_AsArray(list);
+    if (envp == NULL)
+    {
+        Py_DECREF(list);
+        FUNC_RET("%d", 0);
+    }
+    
+    int res = sandbox_command(&Sandbox_GET_SBOX(self), NULL, envp);
+    free(envp);
+    Py_DECREF(list);
+    
+    if (res != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%d", 0);
+    }
+    
+    FUNC_RET("%d", 1);
+}
+
+static task_t *
+Sandbox_template(Sandbox * base)
+{
+    FUNC_BEGIN("%p", base);
+    assert(base);
+    
+    /* The template of a sandbox is validated upon its first instantiation, 
+     * and shared by all subsequent instances */
+    if (base->tmpl == NULL)
+    {
+        task_t * tmpl = (task_t *)malloc(sizeof(task_t));
+        if (tmpl == NULL)
         {
-            PyErr_SetString(PyExc_ValueError, MSG_JAIL_INVALID);
-            FUNC_RET("%d", 0);
+            PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+            FUNC_RET("%p", (task_t *)NULL);
         }
-        
-        struct stat s;
-        if ((stat(target, &s) < 0) || !S_ISDIR(s.st_mode))
+        LOCK(&Sandbox_GET_SBOX(base), SH);
+        int res = sandbox_template_init(tmpl, &Sandbox_GET_SBOX(base).task);
+        UNLOCK(&Sandbox_GET_SBOX(base));
+        if (res != 0)
         {
-            PyErr_SetString(PyExc_ValueError, MSG_JAIL_INVALID);
-            FUNC_RET("%d", 0);
+            free(tmpl);
+            PyErr_SetString(PyExc_ValueError, MSG_TEMPLATE_INVALID);
+            FUNC_RET("%p", (task_t *)NULL);
         }
+        base->tmpl = tmpl;
     }
     
-    LOCK(&Sandbox_GET_SBOX(self), EX);
-    memcpy(Sandbox_GET_SBOX(self).task.jail, target, sizeof(target));
-    UNLOCK(&Sandbox_GET_SBOX(self));
-    
-    FUNC_RET("%d", 1);
+    FUNC_RET("%p", base->tmpl);
 }
 
 static int
-Sandbox_load_uid(PyObject * o, Sandbox * self)
+Sandbox_load_template(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
     
-    uid_t uid = getuid();
-
-    struct passwd * pw = NULL;
+    if (!Sandbox_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_TEMPLATE_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
     
-    if (PyBytes_Check(o) || PyUnicode_Check(o))
+    Sandbox * base = (Sandbox *)o;
+    task_t * tmpl = Sandbox_template(base);
+    if (tmpl == NULL)
     {
-        PyObject * pyutf8 = UTF8Bytes_FromObject(o);
-        if (pyutf8 == NULL)
-        {
-            FUNC_RET("%d", 0);
-        }
-        if ((pw = getpwnam(PyBytes_AS_STRING(pyutf8))) != NULL)
-        {
-            uid = pw->pw_uid;
+        FUNC_RET("%d", 0);
+    }
+    
+    if (sandbox_instantiate(&Sandbox_GET_SBOX(self), tmpl) != 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%d", 0);
+    }
+    
+    /* Instances keep their base alive, as well as its pool of helpers */
+    Py_INCREF(o);
+    Py_XDECREF(self->base);
+    self->base = o;
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_jail(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    char target[SBOX_PATH_MAX] = {'/', '\0'};
+    
+    if (PyBytes_Check(o) || PyUnicode_Check(o))
+    {
+        PyObject * pyutf8 = UTF8Bytes_FromObject(o);
+        if (pyutf8 == NULL)
+        {
+            FUNC_RET("%d", 0);
+        }
+        if (PyBytes_GET_SIZE(pyutf8) + 1 < (Py_ssize_t)sizeof(target))
+        {
+            strcpy(target, PyBytes_AS_STRING(pyutf8));
+            Py_DECREF(pyutf8);
+        }
+        else
+        {
+            Py_DECREF(pyutf8);
+            PyErr_SetString(PyExc_OverflowError, MSG_JAIL_TOO_LONG);
+            FUNC_RET("%d", 0);
+        }
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_JAIL_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    if (strcmp(target, "/") != 0)
+    {
+        /* only super-user can chroot */
+        if (getuid() != (uid_t)0)
+        {
+            PyErr_SetString(PyExc_AssertionError, MSG_JAIL_NOPERM);
+            FUNC_RET("%d", 0);
+        }
+        
+        if (access(target, X_OK | R_OK) < 0)
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_JAIL_INVALID);
+            FUNC_RET("%d", 0);
+        }
+        
+        struct stat s;
+        if ((stat(target, &s) < 0) || !S_ISDIR(s.st_mode))
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_JAIL_INVALID);
+            FUNC_RET("%d", 0);
+        }
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    memcpy(Sandbox_GET_SBOX(self).task.jail, target, sizeof(target));
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_uid(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    uid_t uid = getuid();
+
+    struct passwd * pw = NULL;
+    
+    if (PyBytes_Check(o) || PyUnicode_Check(o))
+    {
+        PyObject * pyutf8 = UTF8Bytes_FromObject(o);
+        if (pyutf8 == NULL)
+        {
+            FUNC_RET("%d", 0);
+        }
+        if ((pw = getpwnam(PyBytes_AS_STRING(pyutf8))) != NULL)
+        {
+            uid = pw->pw_uid;
             Py_DECREF(pyutf8);
         }
         else
@@ -1159,293 +2703,940 @@ Sandbox_load_gid(PyObject * o, Sandbox * self)
         }
         else
         {
-            Py_DECREF(pyutf8);
-            PyErr_SetString(PyExc_ValueError, MSG_GROUP_MISSING);
+            Py_DECREF(pyutf8);
+            PyErr_SetString(PyExc_ValueError, MSG_GROUP_MISSING);
+            FUNC_RET("%d", 0);
+        }
+    }
+    else if (Integer_Check(o))
+    {
+        PyObject * pylong = PyNumber_Long(o);
+        gid_t temp = (gid_t)PyLong_AsLong(pylong);
+        Py_XDECREF(pylong);
+        if ((gr = getgrgid(temp)) == NULL)
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_GROUP_MISSING);
+            FUNC_RET("%d", 0);
+        }
+        gid = gr->gr_gid;
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_GROUP_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    /* only super-user can setgid */
+    if ((getuid() != (uid_t)0) && (getgid() != gid))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_GROUP_NOPERM);
+        FUNC_RET("%d", 0);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.gid = gid;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_ifd(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    int ifd = PyObject_AsFileDescriptor(o);
+
+    if (PyErr_Occurred())
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    if (ifd < 0)
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_STDIN_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    struct stat s;
+    if ((fstat(ifd, &s) < 0) || !(S_ISCHR(s.st_mode) || 
+         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_STDIN_INVALID);
+        FUNC_RET("%d", 0);
+    }
+    
+    if (!((S_IRUSR & s.st_mode) && (s.st_uid == getuid())) && 
+        !((S_IRGRP & s.st_mode) && (s.st_gid == getgid())) && 
+        !(S_IROTH & s.st_mode) && !(getuid() == (uid_t)0))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_STDIN_INVALID);
+        FUNC_RET("%d", 0);
+    }
+    
+    Py_XDECREF(Sandbox_GET_IO(self).i);
+    Py_INCREF(Sandbox_GET_IO(self).i = o);
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.ifd = ifd;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_ofd(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    int ofd = PyObject_AsFileDescriptor(o);
+    
+    if (PyErr_Occurred())
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    if (ofd < 0)
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_STDOUT_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    struct stat s;
+    
+    if ((fstat(ofd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
+         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_STDOUT_INVALID);
+        FUNC_RET("%d", 0);
+    }
+    
+    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) &&
+        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) &&
+        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_STDOUT_INVALID);
+        FUNC_RET("%d", 0);
+    }
+    
+    Py_XDECREF(Sandbox_GET_IO(self).o);
+    Py_INCREF(Sandbox_GET_IO(self).o = o);
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.ofd = ofd;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_efd(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    int efd = PyObject_AsFileDescriptor(o);
+    
+    if (PyErr_Occurred())
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    if (efd < 0)
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_STDERR_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    struct stat s;
+    
+    if ((fstat(efd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
+         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_STDERR_INVALID);
+        FUNC_RET("%d", 0);
+    }
+    
+    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) &&
+        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) &&
+        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_STDERR_INVALID);
+        FUNC_RET("%d", 0);
+    }
+    
+    Py_XDECREF(Sandbox_GET_IO(self).e);
+    Py_INCREF(Sandbox_GET_IO(self).e = o);
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.efd = efd;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static res_t
+SandboxQuota_FromObject(PyObject * o)
+{
+    FUNC_BEGIN("%p", o);
+    
+    PyObject * pyval = NULL;
+    
+    if (Integer_Check(o))
+    {
+        pyval = PyNumber_Long(o);
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_QUOTA_TYPE_ERR);
+        FUNC_RET("%llu", (unsigned long long)RES_INFINITY);
+    }
+    
+    long long val = PyLong_AsLongLong(pyval);
+    
+    Py_XDECREF(pyval);
+    
+    if ((val > RES_INFINITY) || (val < 0))
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_QUOTA_VAL_ERR);
+        }
+        FUNC_RET("%llu", (unsigned long long)RES_INFINITY);
+    }
+    
+    FUNC_RET("%llu", (unsigned long long)(res_t)val);
+}
+
+static int
+Sandbox_load_quota(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    res_t quota[QUOTA_TOTAL];
+   
+    LOCK(&Sandbox_GET_SBOX(self), SH);
+    memcpy(quota, Sandbox_GET_SBOX(self).task.quota, sizeof(quota));
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    const char * keywords[] = 
+    {
+        "wallclock",
+        "cpu",
+        "memory",
+        "disk",
+        NULL                    /* Sentinel */
+    };
+    
+    Py_ssize_t t = 0;
+    
+    if (PyDict_Check(o))
+    {
+        for (t = 0; (t < QUOTA_TOTAL) && !PyErr_Occurred(); t++)
+        {
+            PyObject * value = NULL;
+            if ((value = PyDict_GetItemString(o, (char *)keywords[t])) == NULL)
+            {
+                /* keep this quota[t] intact */
+                continue;
+            }
+            quota[t] = SandboxQuota_FromObject(value);
+        }
+    }
+    else if (PySequence_Check(o))
+    {
+        for (t = 0; (t < QUOTA_TOTAL) && !PyErr_Occurred(); t++)
+        {
+            if (t >= PySequence_Size(o))
+            {
+                /* keep this quota[t] intact */
+                continue;
+            }
+            PyObject * value = NULL;
+            if ((value = PySequence_GetItem(o, t)) == NULL)
+            {
+                PyErr_SetString(PyExc_IndexError, MSG_QUOTA_INVALID);
+                break;
+            }
+            quota[t] = SandboxQuota_FromObject(value);
+        }
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_QUOTA_TYPE_ERR);
+    }
+    
+    if (PyErr_Occurred())
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    memcpy(Sandbox_GET_SBOX(self).task.quota, quota, sizeof(quota));
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_policy(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    if (Sandbox_set_policy(self, o, NULL) != 0)
+    {
+        FUNC_RET("%d", 0);
+    }
+    FUNC_RET("%d", 1);
+}
+
+static int
+SandboxPlacement_FromObject(PyObject * o)
+{
+    FUNC_BEGIN("%p", o);
+    assert(o);
+    
+    if (!Integer_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_PLACEMENT_TYPE_ERR);
+        FUNC_RET("%d", SBOX_CPU_ANY);
+    }
+    
+    PyObject * pyval = PyNumber_Long(o);
+    long val = PyLong_AsLong(pyval);
+    Py_XDECREF(pyval);
+    
+    if ((val < SBOX_CPU_AUTO) || (val > INT_MAX))
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_PLACEMENT_VAL_ERR);
+        }
+        FUNC_RET("%d", SBOX_CPU_ANY);
+    }
+    
+    FUNC_RET("%d", (int)val);
+}
+
+static int
+Sandbox_load_placement(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    placement_t cpu = {SBOX_CPU_ANY, SBOX_CPU_AUTO};
+    
+    /* A single cpu number places the prisoner process, and leaves the tracer
+     * threads to the sibling of the prisoner's cpu */
+    if (Integer_Check(o))
+    {
+        cpu.prisoner = SandboxPlacement_FromObject(o);
+    }
+    else if (PySequence_Check(o) && (PySequence_Size(o) == 2))
+    {
+        PyObject * value = NULL;
+        if ((value = PySequence_GetItem(o, 0)) != NULL)
+        {
+            cpu.prisoner = SandboxPlacement_FromObject(value);
+            Py_DECREF(value);
+        }
+        if (!PyErr_Occurred() && ((value = PySequence_GetItem(o, 1)) != NULL))
+        {
+            cpu.tracer = SandboxPlacement_FromObject(value);
+            Py_DECREF(value);
+        }
+    }
+    else
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_PLACEMENT_TYPE_ERR);
+    }
+    
+    if (PyErr_Occurred())
+    {
+        FUNC_RET("%d", 0);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.cpu = cpu;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_backend(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    if (!Integer_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_BACKEND_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    PyObject * pyval = PyNumber_Long(o);
+    long val = PyLong_AsLong(pyval);
+    Py_XDECREF(pyval);
+    
+    if ((val != S_BACKEND_PTRACE) && (val != S_BACKEND_NOTIFY))
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_BACKEND_VAL_ERR);
+        }
+        FUNC_RET("%d", 0);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).ctrl.backend = (backend_t)val;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_fs(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    filesys_t target;
+    memset(&target, 0, sizeof(target));
+    
+    if (!PySequence_Check(o) || PyBytes_Check(o) || PyUnicode_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_FS_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    Py_ssize_t n = PySequence_Size(o);
+    if (n > SBOX_FS_MAX)
+    {
+        PyErr_SetString(PyExc_OverflowError, MSG_FS_TOO_LONG);
+        FUNC_RET("%d", 0);
+    }
+    
+    size_t offset = 0;
+    Py_ssize_t i;
+    for (i = 0; i < n; i++)
+    {
+        PyObject * item = PySequence_GetItem(o, i);
+        PyObject * path = NULL;
+        PyObject * mode = NULL;
+        if ((item == NULL) || !PySequence_Check(item) || 
+            (PySequence_Size(item) != 2) || 
+            ((path = PySequence_GetItem(item, 0)) == NULL) || 
+            ((mode = PySequence_GetItem(item, 1)) == NULL) || 
+            !(PyBytes_Check(path) || PyUnicode_Check(path)) || 
+            !Integer_Check(mode))
+        {
+            Py_XDECREF(mode);
+            Py_XDECREF(path);
+            Py_XDECREF(item);
+            PyErr_SetString(PyExc_TypeError, MSG_FS_TYPE_ERR);
+            FUNC_RET("%d", 0);
+        }
+        Py_DECREF(item);
+        
+        long val = PyLong_AsLong(mode);
+        Py_DECREF(mode);
+        PyObject * pyutf8 = UTF8Bytes_FromObject(path);
+        Py_DECREF(path);
+        if (pyutf8 == NULL)
+        {
+            FUNC_RET("%d", 0);
+        }
+        
+        size_t delta = PyBytes_GET_SIZE(pyutf8) + 1;
+        if (offset + delta > sizeof(target.buff))
+        {
+            Py_DECREF(pyutf8);
+            PyErr_SetString(PyExc_OverflowError, MSG_FS_TOO_LONG);
+            FUNC_RET("%d", 0);
+        }
+        if ((PyBytes_AS_STRING(pyutf8)[0] != '/') || ((val != S_FS_NONE) && 
+            (val != S_FS_READ) && (val != S_FS_WRITE)))
+        {
+            Py_DECREF(pyutf8);
+            if (!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, MSG_FS_VAL_ERR);
+            }
+            FUNC_RET("%d", 0);
+        }
+        strcpy(target.buff + offset, PyBytes_AS_STRING(pyutf8));
+        Py_DECREF(pyutf8);
+        target.path[i] = offset;
+        target.access[i] = (fs_access_t)val;
+        offset += delta;
+    }
+    for (; i < SBOX_FS_MAX; i++)
+    {
+        target.path[i] = -1;
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    memcpy(&Sandbox_GET_SBOX(self).task.fs, &target, sizeof(filesys_t));
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_trust(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    if (!Integer_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_TRUST_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    PyObject * pyval = PyNumber_Long(o);
+    long val = PyLong_AsLong(pyval);
+    Py_XDECREF(pyval);
+    
+    if ((val != S_TRUST_NONE) && (val != S_TRUST_FULL))
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_TRUST_VAL_ERR);
+        }
+        FUNC_RET("%d", 0);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.trust = (trust_t)val;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_ns(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    if (!Integer_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_NS_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    PyObject * pyval = PyNumber_Long(o);
+    long val = PyLong_AsLong(pyval);
+    Py_XDECREF(pyval);
+    
+    if ((val < 0) || ((val & ~(long)S_NS_ALL) != 0))
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_NS_VAL_ERR);
+        }
+        FUNC_RET("%d", 0);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.ns = (int)val;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_image(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    image_t target;
+    memset(&target, 0, sizeof(target));
+    
+    if (!PyDict_Check(o))
+    {
+        PyErr_SetString(PyExc_TypeError, MSG_IMAGE_TYPE_ERR);
+        FUNC_RET("%d", 0);
+    }
+    
+    /* The jail image is read-only unless stated otherwise */
+    PyObject * value = PyDict_GetItemString(o, "readonly");
+    int readonly = (value != NULL) ? PyObject_IsTrue(value) : 1;
+    if (readonly < 0)
+    {
+        FUNC_RET("%d", 0);
+    }
+    target.readonly = (readonly != 0);
+    
+    const char * keys[] = {"prog", "scratch"};
+    char * buffs[] = {target.prog, target.scratch};
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        if ((value = PyDict_GetItemString(o, keys[i])) == NULL)
+        {
+            continue;
+        }
+        if (!(PyBytes_Check(value) || PyUnicode_Check(value)))
+        {
+            PyErr_SetString(PyExc_TypeError, MSG_IMAGE_TYPE_ERR);
+            FUNC_RET("%d", 0);
+        }
+        PyObject * pyutf8 = UTF8Bytes_FromObject(value);
+        if (pyutf8 == NULL)
+        {
             FUNC_RET("%d", 0);
         }
-    }
-    else if (Integer_Check(o))
-    {
-        PyObject * pylong = PyNumber_Long(o);
-        gid_t temp = (gid_t)PyLong_AsLong(pylong);
-        Py_XDECREF(pylong);
-        if ((gr = getgrgid(temp)) == NULL)
+        if (PyBytes_GET_SIZE(pyutf8) + 1 > SBOX_PATH_MAX)
         {
-            PyErr_SetString(PyExc_ValueError, MSG_GROUP_MISSING);
+            Py_DECREF(pyutf8);
+            PyErr_SetString(PyExc_OverflowError, MSG_IMAGE_TOO_LONG);
             FUNC_RET("%d", 0);
         }
-        gid = gr->gr_gid;
+        strcpy(buffs[i], PyBytes_AS_STRING(pyutf8));
+        Py_DECREF(pyutf8);
     }
-    else
+    if ((target.scratch[0] != '\0') && (target.scratch[0] != '/'))
     {
-        PyErr_SetString(PyExc_TypeError, MSG_GROUP_TYPE_ERR);
+        PyErr_SetString(PyExc_ValueError, MSG_IMAGE_VAL_ERR);
         FUNC_RET("%d", 0);
     }
     
-    /* only super-user can setgid */
-    if ((getuid() != (uid_t)0) && (getgid() != gid))
+    if ((value = PyDict_GetItemString(o, "size")) != NULL)
     {
-        PyErr_SetString(PyExc_AssertionError, MSG_GROUP_NOPERM);
-        FUNC_RET("%d", 0);
+        if (!Integer_Check(value))
+        {
+            PyErr_SetString(PyExc_TypeError, MSG_IMAGE_TYPE_ERR);
+            FUNC_RET("%d", 0);
+        }
+        PyObject * pyval = PyNumber_Long(value);
+        target.size = (res_t)PyLong_AsUnsignedLongLong(pyval);
+        Py_XDECREF(pyval);
+        if (PyErr_Occurred())
+        {
+            FUNC_RET("%d", 0);
+        }
     }
     
     LOCK(&Sandbox_GET_SBOX(self), EX);
-    Sandbox_GET_SBOX(self).task.gid = gid;
+    memcpy(&Sandbox_GET_SBOX(self).task.image, &target, sizeof(image_t));
     UNLOCK(&Sandbox_GET_SBOX(self));
     
     FUNC_RET("%d", 1);
 }
 
 static int
-Sandbox_load_ifd(PyObject * o, Sandbox * self)
+Sandbox_load_xfd(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
     
-    int ifd = PyObject_AsFileDescriptor(o);
-
+    int xfd = PyObject_AsFileDescriptor(o);
+    
     if (PyErr_Occurred())
     {
         FUNC_RET("%d", 0);
     }
     
-    if (ifd < 0)
+    /* The standard streams of the prisoner cannot double as its program */
+    if (xfd <= STDERR_FILENO)
     {
-        PyErr_SetString(PyExc_TypeError, MSG_STDIN_TYPE_ERR);
+        PyErr_SetString(PyExc_TypeError, MSG_EXE_TYPE_ERR);
         FUNC_RET("%d", 0);
     }
     
     struct stat s;
-    if ((fstat(ifd, &s) < 0) || !(S_ISCHR(s.st_mode) || 
-         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
-    {
-        PyErr_SetString(PyExc_AssertionError, MSG_STDIN_INVALID);
-        FUNC_RET("%d", 0);
-    }
-    
-    if (!((S_IRUSR & s.st_mode) && (s.st_uid == getuid())) && 
-        !((S_IRGRP & s.st_mode) && (s.st_gid == getgid())) && 
-        !(S_IROTH & s.st_mode) && !(getuid() == (uid_t)0))
+    if ((fstat(xfd, &s) < 0) || !S_ISREG(s.st_mode))
     {
-        PyErr_SetString(PyExc_AssertionError, MSG_STDIN_INVALID);
+        PyErr_SetString(PyExc_AssertionError, MSG_EXE_INVALID);
         FUNC_RET("%d", 0);
     }
     
-    Py_XDECREF(Sandbox_GET_IO(self).i);
-    Py_INCREF(Sandbox_GET_IO(self).i = o);
+    Py_XDECREF(Sandbox_GET_IO(self).x);
+    Py_INCREF(Sandbox_GET_IO(self).x = o);
     
     LOCK(&Sandbox_GET_SBOX(self), EX);
-    Sandbox_GET_SBOX(self).task.ifd = ifd;
+    Sandbox_GET_SBOX(self).task.xfd = xfd;
     UNLOCK(&Sandbox_GET_SBOX(self));
     
     FUNC_RET("%d", 1);
 }
 
 static int
-Sandbox_load_ofd(PyObject * o, Sandbox * self)
+Sandbox_load_answer(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
     
-    int ofd = PyObject_AsFileDescriptor(o);
+    int afd = PyObject_AsFileDescriptor(o);
     
     if (PyErr_Occurred())
     {
         FUNC_RET("%d", 0);
     }
     
-    if (ofd < 0)
+    if (afd < 0)
     {
-        PyErr_SetString(PyExc_TypeError, MSG_STDOUT_TYPE_ERR);
+        PyErr_SetString(PyExc_TypeError, MSG_ANSWER_TYPE_ERR);
         FUNC_RET("%d", 0);
     }
     
     struct stat s;
-    
-    if ((fstat(ofd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
-         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
-    {
-        PyErr_SetString(PyExc_AssertionError, MSG_STDOUT_INVALID);
-        FUNC_RET("%d", 0);
-    }
-    
-    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) &&
-        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) &&
-        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    if ((fstat(afd, &s) < 0) || !S_ISREG(s.st_mode) || 
+        ((fcntl(afd, F_GETFL) & O_ACCMODE) == O_WRONLY))
     {
-        PyErr_SetString(PyExc_AssertionError, MSG_STDOUT_INVALID);
+        PyErr_SetString(PyExc_AssertionError, MSG_ANSWER_INVALID);
         FUNC_RET("%d", 0);
     }
     
-    Py_XDECREF(Sandbox_GET_IO(self).o);
-    Py_INCREF(Sandbox_GET_IO(self).o = o);
+    Py_XDECREF(Sandbox_GET_IO(self).a);
+    Py_INCREF(Sandbox_GET_IO(self).a = o);
     
+    /* The output is compared byte-by-byte unless stated otherwise */
     LOCK(&Sandbox_GET_SBOX(self), EX);
-    Sandbox_GET_SBOX(self).task.ofd = ofd;
+    Sandbox_GET_SBOX(self).task.capture.enabled = true;
+    Sandbox_GET_SBOX(self).task.capture.answer = afd;
+    if (Sandbox_GET_SBOX(self).task.capture.compare == S_COMPARE_NONE)
+    {
+        Sandbox_GET_SBOX(self).task.capture.compare = S_COMPARE_BYTE;
+    }
     UNLOCK(&Sandbox_GET_SBOX(self));
     
     FUNC_RET("%d", 1);
 }
 
 static int
-Sandbox_load_efd(PyObject * o, Sandbox * self)
+Sandbox_load_compare(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
     
-    int efd = PyObject_AsFileDescriptor(o);
-    
-    if (PyErr_Occurred())
+    if (!Integer_Check(o))
     {
+        PyErr_SetString(PyExc_TypeError, MSG_COMPARE_TYPE_ERR);
         FUNC_RET("%d", 0);
     }
     
-    if (efd < 0)
+    PyObject * pyval = PyNumber_Long(o);
+    long val = PyLong_AsLong(pyval);
+    Py_XDECREF(pyval);
+    
+    if ((val != S_COMPARE_NONE) && (val != S_COMPARE_BYTE) && 
+        (val != S_COMPARE_TOKEN) && (val != S_COMPARE_NOCASE) && 
+        (val != S_COMPARE_FLOAT))
     {
-        PyErr_SetString(PyExc_TypeError, MSG_STDERR_TYPE_ERR);
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, MSG_COMPARE_VAL_ERR);
+        }
         FUNC_RET("%d", 0);
     }
     
-    struct stat s;
+    /* Output is captured even if not compared */
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.capture.enabled = true;
+    Sandbox_GET_SBOX(self).task.capture.compare = (compare_t)val;
+    UNLOCK(&Sandbox_GET_SBOX(self));
     
-    if ((fstat(efd, &s) < 0) || !(S_ISCHR(s.st_mode) ||
-         S_ISREG(s.st_mode) || S_ISFIFO(s.st_mode)))
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_epsilon(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    if (!PyNumber_Check(o))
     {
-        PyErr_SetString(PyExc_AssertionError, MSG_STDERR_INVALID);
+        PyErr_SetString(PyExc_TypeError, MSG_EPSILON_TYPE_ERR);
         FUNC_RET("%d", 0);
     }
     
-    if (!((S_IWUSR & s.st_mode) && (s.st_uid == getuid())) &&
-        !((S_IWGRP & s.st_mode) && (s.st_gid == getgid())) &&
-        !(S_IWOTH & s.st_mode) && !(getuid() == (uid_t)0))
+    double val = PyFloat_AsDouble(o);
+    
+    if (PyErr_Occurred())
     {
-        PyErr_SetString(PyExc_AssertionError, MSG_STDERR_INVALID);
         FUNC_RET("%d", 0);
     }
     
-    Py_XDECREF(Sandbox_GET_IO(self).e);
-    Py_INCREF(Sandbox_GET_IO(self).e = o);
+    /* Negation also rules out nan's */
+    if (!(val >= 0))
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_EPSILON_VAL_ERR);
+        FUNC_RET("%d", 0);
+    }
     
     LOCK(&Sandbox_GET_SBOX(self), EX);
-    Sandbox_GET_SBOX(self).task.efd = efd;
+    Sandbox_GET_SBOX(self).task.capture.epsilon = val;
     UNLOCK(&Sandbox_GET_SBOX(self));
     
     FUNC_RET("%d", 1);
 }
 
-static res_t
-SandboxQuota_FromObject(PyObject * o)
+static int
+Sandbox_load_input(PyObject * o, Sandbox * self)
 {
-    FUNC_BEGIN("%p", o);
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
     
-    PyObject * pyval = NULL;
+    feed_t feed = {NULL, -1, 0, -1, false};
+    Py_buffer view = {0};
     
-    if (Integer_Check(o))
+    /* A bytes-like object is fed from its own memory, which is held (and so
+     * cannot be resized) until the sandbox is released */
+    if (PyObject_CheckBuffer(o))
     {
-        pyval = PyNumber_Long(o);
+        if (PyObject_GetBuffer(o, &view, PyBUF_SIMPLE) != 0)
+        {
+            FUNC_RET("%d", 0);
+        }
+        feed.data = view.buf;
+        feed.size = (long long)view.len;
     }
     else
     {
-        PyErr_SetString(PyExc_TypeError, MSG_QUOTA_TYPE_ERR);
-        FUNC_RET("%llu", (unsigned long long)RES_INFINITY);
+        PyObject * file = o;
+        if (PyTuple_Check(o))
+        {
+            PyObject * offset = NULL;
+            PyObject * size = NULL;
+            if (!PyArg_ParseTuple(o, "OOO", &file, &offset, &size) || 
+                !Integer_Check(offset) || !Integer_Check(size))
+            {
+                PyErr_Clear();
+                PyErr_SetString(PyExc_TypeError, MSG_INPUT_TYPE_ERR);
+                FUNC_RET("%d", 0);
+            }
+            PyObject * pyval = PyNumber_Long(offset);
+            feed.offset = PyLong_AsLongLong(pyval);
+            Py_XDECREF(pyval);
+            pyval = PyNumber_Long(size);
+            feed.size = PyLong_AsLongLong(pyval);
+            Py_XDECREF(pyval);
+            if (PyErr_Occurred())
+            {
+                FUNC_RET("%d", 0);
+            }
+            if ((feed.offset < 0) || (feed.size < -1))
+            {
+                PyErr_SetString(PyExc_ValueError, MSG_INPUT_VAL_ERR);
+                FUNC_RET("%d", 0);
+            }
+        }
+        feed.fd = PyObject_AsFileDescriptor(file);
+        if (PyErr_Occurred())
+        {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError, MSG_INPUT_TYPE_ERR);
+            FUNC_RET("%d", 0);
+        }
+        struct stat s;
+        if ((fstat(feed.fd, &s) < 0) || !S_ISREG(s.st_mode) || 
+            ((fcntl(feed.fd, F_GETFL) & O_ACCMODE) == O_WRONLY))
+        {
+            PyErr_SetString(PyExc_AssertionError, MSG_INPUT_INVALID);
+            FUNC_RET("%d", 0);
+        }
     }
     
-    long long val = PyLong_AsLongLong(pyval);
-    
-    Py_XDECREF(pyval);
-    
-    if ((val > RES_INFINITY) || (val < 0))
+    if (Sandbox_GET_IO(self).view.obj != NULL)
     {
-        if (!PyErr_Occurred())
-        {
-            PyErr_SetString(PyExc_ValueError, MSG_QUOTA_VAL_ERR);
-        }
-        FUNC_RET("%llu", (unsigned long long)RES_INFINITY);
+        PyBuffer_Release(&Sandbox_GET_IO(self).view);
     }
+    Sandbox_GET_IO(self).view = view;
+    Py_XDECREF(Sandbox_GET_IO(self).f);
+    Py_INCREF(Sandbox_GET_IO(self).f = o);
     
-    FUNC_RET("%llu", (unsigned long long)(res_t)val);
+    /* Seekable or not is loaded separately */
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    feed.seekable = Sandbox_GET_SBOX(self).task.feed.seekable;
+    Sandbox_GET_SBOX(self).task.feed = feed;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%d", 1);
 }
 
 static int
-Sandbox_load_quota(PyObject * o, Sandbox * self)
+Sandbox_load_seekable(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
     
-    res_t quota[QUOTA_TOTAL];
-   
-    LOCK(&Sandbox_GET_SBOX(self), SH);
-    memcpy(quota, Sandbox_GET_SBOX(self).task.quota, sizeof(quota));
-    UNLOCK(&Sandbox_GET_SBOX(self));
+    int val = PyObject_IsTrue(o);
     
-    const char * keywords[] = 
+    if (val < 0)
     {
-        "wallclock",
-        "cpu",
-        "memory",
-        "disk",
-        NULL                    /* Sentinel */
-    };
+        FUNC_RET("%d", 0);
+    }
     
-    Py_ssize_t t = 0;
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.feed.seekable = (val != 0);
+    UNLOCK(&Sandbox_GET_SBOX(self));
     
-    if (PyDict_Check(o))
-    {
-        for (t = 0; (t < QUOTA_TOTAL) && !PyErr_Occurred(); t++)
-        {
-            PyObject * value = NULL;
-            if ((value = PyDict_GetItemString(o, (char *)keywords[t])) == NULL)
-            {
-                /* keep this quota[t] intact */
-                continue;
-            }
-            quota[t] = SandboxQuota_FromObject(value);
-        }
-    }
-    else if (PySequence_Check(o))
+    FUNC_RET("%d", 1);
+}
+
+static int
+Sandbox_load_cache(PyObject * o, Sandbox * self)
+{
+    FUNC_BEGIN("%p,%p", o, self);
+    assert(o && self);
+    
+    PyObject * path = UTF8Bytes_FromObject(o);
+    if (path == NULL)
     {
-        for (t = 0; (t < QUOTA_TOTAL) && !PyErr_Occurred(); t++)
-        {
-            if (t >= PySequence_Size(o))
-            {
-                /* keep this quota[t] intact */
-                continue;
-            }
-            PyObject * value = NULL;
-            if ((value = PySequence_GetItem(o, t)) == NULL)
-            {
-                PyErr_SetString(PyExc_IndexError, MSG_QUOTA_INVALID);
-                break;
-            }
-            quota[t] = SandboxQuota_FromObject(value);
-        }
+        FUNC_RET("%d", 0);
     }
-    else
+    
+    memo_t * memo = (memo_t *)malloc(sizeof(memo_t));
+    if (memo == NULL)
     {
-        PyErr_SetString(PyExc_TypeError, MSG_QUOTA_TYPE_ERR);
+        Py_DECREF(path);
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%d", 0);
     }
     
-    if (PyErr_Occurred())
+    int res = 0;
+    Py_BEGIN_ALLOW_THREADS
+    res = sandbox_memo_init(memo, PyBytes_AS_STRING(path), 0);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(path);
+    if (res != 0)
     {
+        free(memo);
+        PyErr_SetString(PyExc_ValueError, MSG_CACHE_INVALID);
         FUNC_RET("%d", 0);
     }
     
-    LOCK(&Sandbox_GET_SBOX(self), EX);
-    memcpy(Sandbox_GET_SBOX(self).task.quota, quota, sizeof(quota));
-    UNLOCK(&Sandbox_GET_SBOX(self));
+    self->memo = memo;
     
     FUNC_RET("%d", 1);
 }
 
 static int
-Sandbox_load_policy(PyObject * o, Sandbox * self)
+Sandbox_load_sha256(PyObject * o, Sandbox * self)
 {
     FUNC_BEGIN("%p,%p", o, self);
     assert(o && self);
-    if (Sandbox_set_policy(self, o, NULL) != 0)
+    
+    int val = PyObject_IsTrue(o);
+    
+    if (val < 0)
     {
         FUNC_RET("%d", 0);
     }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).task.capture.sha256 = (val != 0);
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
     FUNC_RET("%d", 1);
 }
 
@@ -1460,7 +3651,7 @@ Sandbox_get_task(Sandbox * self, void * closure)
     command_t * pcomm = &Sandbox_GET_SBOX(self).task.comm;
     
     size_t argc = 0;
-    while ((argc + 1 < SBOX_ARG_MAX) && (pcomm->args[argc] >= 0))
+    while ((pcomm->args != NULL) && (pcomm->args[argc] != NULL))
     {
         argc++;
     }
@@ -1480,7 +3671,7 @@ Sandbox_get_task(Sandbox * self, void * closure)
     for (i = 0; i < argc; i++)
     {
         PyTuple_SET_ITEM(tuple, i, 
-            Py_BuildValue("s", pcomm->buff + pcomm->args[i]));
+            Py_BuildValue("s", pcomm->args[i]));
     }
     
     UNLOCK(&Sandbox_GET_SBOX(self));
@@ -1614,12 +3805,83 @@ Sandbox_get_pid(Sandbox * self, void * closure)
     }
     else
     {
-        pid = Py_None;
-        Py_INCREF(pid);
+        pid = Py_None;
+        Py_INCREF(pid);
+    }
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%p", pid);
+}
+
+static PyObject *
+Sandbox_get_pool(Sandbox * self, void * closure)
+{
+    FUNC_BEGIN("%p,%p", self, closure);
+    assert(self);
+    
+    if (self->pool == NULL)
+    {
+        Py_INCREF(Py_None);
+        FUNC_RET("%p", Py_None);
+    }
+    
+    const int ready = sandbox_pool_ready(self->pool);
+    LOCK(self->pool, SH);
+    PyObject * o = Py_BuildValue("{s:i,s:i,s:k,s:k,s:k}", 
+        "size", self->pool->size, 
+        "ready", ready, 
+        "spawned", self->pool->stat.spawned, 
+        "hit", self->pool->stat.hit, 
+        "miss", self->pool->stat.miss);
+    UNLOCK(self->pool);
+    
+    FUNC_RET("%p", o);
+}
+
+static PyObject *
+Sandbox_get_cache(Sandbox * self, void * closure)
+{
+    FUNC_BEGIN("%p,%p", self, closure);
+    assert(self);
+    
+    if (self->memo == NULL)
+    {
+        Py_INCREF(Py_None);
+        FUNC_RET("%p", Py_None);
+    }
+    
+    LOCK(self->memo, SH);
+    PyObject * o = Py_BuildValue("{s:k,s:k,s:k,s:k}", 
+        "slots", self->memo->slots, 
+        "hit", self->memo->stat.hit, 
+        "miss", self->memo->stat.miss, 
+        "stored", self->memo->stat.stored);
+    UNLOCK(self->memo);
+    
+    FUNC_RET("%p", o);
+}
+
+static PyObject *
+Sandbox_get_server(Sandbox * self, void * closure)
+{
+    FUNC_BEGIN("%p,%p", self, closure);
+    assert(self);
+    
+    if (self->server == NULL)
+    {
+        Py_INCREF(Py_None);
+        FUNC_RET("%p", Py_None);
     }
-    UNLOCK(&Sandbox_GET_SBOX(self));
     
-    FUNC_RET("%p", pid);
+    const int ready = sandbox_server_ready(self->server);
+    LOCK(self->server, SH);
+    PyObject * o = Py_BuildValue("{s:i,s:k,s:k}", 
+        "ready", ready, 
+        "hit", self->server->stat.hit, 
+        "miss", self->server->stat.miss);
+    UNLOCK(self->server);
+    
+    FUNC_RET("%p", o);
 }
 
 static PyObject *
@@ -1723,6 +3985,49 @@ Sandbox_probe(Sandbox * self)
         o = Py_BuildValue("i", Sandbox_GET_SBOX(self).stat.exitcode));
     Py_DECREF(o);
     
+    PyDict_SetItemString(result, "placement", o = Py_BuildValue("(i,i)",
+        Sandbox_GET_SBOX(self).stat.placement.prisoner,
+        Sandbox_GET_SBOX(self).stat.placement.tracer));
+    Py_DECREF(o);
+    
+    PyDict_SetItemString(result, "cache_info", o = Py_BuildValue("(k,k)",
+        Sandbox_GET_SBOX(self).stat.cache.hit,
+        Sandbox_GET_SBOX(self).stat.cache.miss));
+    Py_DECREF(o);
+    
+    PyDict_SetItemString(result, "output_info", o = Py_BuildValue("(K,L)",
+        (unsigned long long)Sandbox_GET_SBOX(self).stat.output.bytes,
+        Sandbox_GET_SBOX(self).stat.output.mismatch));
+    Py_DECREF(o);
+    
+    /* The SHA-256 digest is reported in hex, if computed */
+    char hex[2 * sizeof(Sandbox_GET_SBOX(self).stat.output.sha256) + 1];
+    size_t i;
+    for (i = 0; i < sizeof(Sandbox_GET_SBOX(self).stat.output.sha256); i++)
+    {
+        snprintf(hex + 2 * i, 3, "%02x", 
+            Sandbox_GET_SBOX(self).stat.output.sha256[i]);
+    }
+    PyDict_SetItemString(result, "output_digest", o = Py_BuildValue("(K,s)",
+        Sandbox_GET_SBOX(self).stat.output.digest, 
+        Sandbox_GET_SBOX(self).task.capture.sha256 ? hex : NULL));
+    Py_DECREF(o);
+    
+    PyDict_SetItemString(result, "input_info", o = Py_BuildValue("(K,K)",
+        (unsigned long long)Sandbox_GET_SBOX(self).stat.input.bytes,
+        (unsigned long long)Sandbox_GET_SBOX(self).stat.input.consumed));
+    Py_DECREF(o);
+    
+    PyDict_SetItemString(result, "link_info", o = Py_BuildValue("(K,K,K)",
+        (unsigned long long)Sandbox_GET_SBOX(self).stat.link.sent,
+        (unsigned long long)Sandbox_GET_SBOX(self).stat.link.received,
+        (unsigned long long)Sandbox_GET_SBOX(self).stat.link.wait));
+    Py_DECREF(o);
+    
+    PyDict_SetItemString(result, "memoized", 
+        o = PyBool_FromLong(Sandbox_GET_SBOX(self).stat.memoized));
+    Py_DECREF(o);
+    
     /* The following fields are available from cpu_info and mem_info, and are
      * no longer maintained by the probe() method of the _sandbox.Sandbox class
      * in C module. For backward compatibility, sandbox.__init__.py provides a
@@ -1951,22 +4256,347 @@ Sandbox_dump(Sandbox * self, PyObject * args)
     FUNC_RET("%p", result);
 }
 
+static PyObject *
+Sandbox_prefork(Sandbox * self, PyObject * args, PyObject * kwds)
+{
+    FUNC_BEGIN("%p,%p,%p", self, args, kwds);
+    assert(self && args);
+    
+    static char * keywords[] = {"size", "refill", NULL};
+    
+    int size = 0;
+    PyObject * o = NULL;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|O:prefork", keywords, 
+        &size, &o))
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    const int refill = (o != NULL) ? PyObject_IsTrue(o) : 1;
+    if (refill < 0)
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    if ((size <= 0) || (size > SBOX_POOL_MAX))
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_POOL_SIZE_ERR);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    task_t * tmpl = Sandbox_template(self);
+    if (tmpl == NULL)
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* Replace the current pool of helpers, if any, unless running instances
+     * may still be taking helpers from it */
+    if ((self->pool != NULL) && (self->users > 0))
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_POOL_BUSY);
+        FUNC_RET("%p", Py_NULL);
+    }
+    pool_t * pool = self->pool;
+    if ((pool == NULL) && 
+        ((pool = (pool_t *)calloc(1, sizeof(pool_t))) == NULL))
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%p", Py_NULL);
+    }
+    self->pool = NULL;
+    
+    int res = 0;
+    Py_BEGIN_ALLOW_THREADS
+    if (pool->argv != NULL)
+    {
+        sandbox_pool_fini(pool);
+    }
+    res = sandbox_pool_init(pool, tmpl, size, refill);
+    Py_END_ALLOW_THREADS
+    
+    if (res != 0)
+    {
+        free(pool);
+        PyErr_SetString(PyExc_RuntimeError, MSG_POOL_FAILED);
+        FUNC_RET("%p", Py_NULL);
+    }
+    self->pool = pool;
+    
+    Py_INCREF(Py_None);
+    FUNC_RET("%p", Py_None);
+}
+
+static PyObject *
+Sandbox_forkserver(Sandbox * self)
+{
+    FUNC_BEGIN("%p", self);
+    assert(self);
+    
+    task_t * tmpl = Sandbox_template(self);
+    if (tmpl == NULL)
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* Replace the current fork server, if any */
+    Sandbox_stop_server(self);
+    server_t * server = (server_t *)calloc(1, sizeof(server_t));
+    if (server == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* The master sandbox keeps its own reference to the current policy */
+    LOCK(&Sandbox_GET_SBOX(self), SH);
+    const policy_t policy = Sandbox_GET_SBOX(self).ctrl.policy;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    PyObject * o = SandboxPolicy_Check((PyObject *)policy.data) ? 
+        (PyObject *)policy.data : NULL;
+    Py_XINCREF(o);
+    
+    int res = 0;
+    Py_BEGIN_ALLOW_THREADS
+    res = sandbox_server_init(server, tmpl, &policy);
+    Py_END_ALLOW_THREADS
+    
+    if (res != 0)
+    {
+        Py_XDECREF(o);
+        free(server);
+        PyErr_SetString(PyExc_RuntimeError, MSG_SERVER_FAILED);
+        FUNC_RET("%p", Py_NULL);
+    }
+    self->server = server;
+    if (o != NULL)
+    {
+        SandboxPolicy_GET_STATE(o).users++;
+    }
+    
+    Py_INCREF(Py_None);
+    FUNC_RET("%p", Py_None);
+}
+
+static void *
+Sandbox_attach(Sandbox * self)
+{
+    FUNC_BEGIN("%p", self);
+    assert(self);
+    
+    /* Since 0.3.6, native rules of the policy are also translated into a 
+     * system call filter, such that allowed system calls do not stop the 
+     * prisoner process for the watcher */
+    void * prog = NULL;
+    void * buffer = NULL;
+    int len = 0;
+    PyObject * policy = (PyObject *)Sandbox_GET_SBOX(self).ctrl.policy.data;
+#ifdef SECCOMP_RET_TRACE
+    if (SandboxPolicy_Check(policy) && 
+        (SandboxPolicy_GET_STATE(policy).image != NULL))
+    {
+        /* Policy profiles come with precomputed filters, which are copied 
+         * out of the shared mapping after checking their bounds again, such 
+         * that changes to the mapped file do not reach seccomp */
+        const char * image = 
+            (const char *)SandboxPolicy_GET_STATE(policy).image;
+        const size_t size = SandboxPolicy_GET_STATE(policy).size;
+        profile_t header;
+        memcpy(&header, image, sizeof(profile_t));
+        if ((header.filter <= size) && (header.nfilter <= BPF_MAXINSNS) && 
+            ((size - header.filter) / sizeof(struct sock_filter) >= 
+             header.nfilter) && (header.nfilter > 0) && ((buffer = 
+             PyMem_Malloc(header.nfilter * sizeof(struct sock_filter))) != 
+             NULL))
+        {
+            memcpy(buffer, image + header.filter, 
+                header.nfilter * sizeof(struct sock_filter));
+            prog = buffer;
+            len = header.nfilter;
+        }
+    }
+    else if (SandboxPolicy_Check(policy))
+    {
+        len = SandboxPolicy_filter(SandboxPolicy_GET_STATE(policy).rules, 
+            (struct sock_filter * *)&buffer);
+        prog = buffer;
+    }
+#endif /* SECCOMP_RET_TRACE */
+    
+    /* Instances are handed over to the pre-forked helpers of their base, and
+     * share the result cache of their base unless they have their own */
+    Sandbox * owner = (self->base != NULL) ? ((Sandbox *)self->base) : self;
+    memo_t * memo = (self->memo != NULL) ? self->memo : owner->memo;
+    owner->users++;
+    
+    /* Rules of the policy are read by the watcher without the GIL, and they
+     * are not changed (i.e. reallocated or unmapped) until the run is over */
+    if (SandboxPolicy_Check(policy))
+    {
+        SandboxPolicy_GET_STATE(policy).users++;
+        Py_INCREF(policy);
+        self->rules = policy;
+    }
+    
+    /* Since 0.3.6, runs under policies with a true deterministic attribute
+     * are cached, and the policy is identified by its cache_key attribute, 
+     * or else the qualified name of its class, followed by its profile or 
+     * its native rules (if any) */
+    const void * profile = NULL;
+    size_t size = 0;
+    if (SandboxPolicy_Check(policy) && (memo != NULL))
+    {
+        PyObject * o = PyObject_GetAttrString(policy, "deterministic");
+        const int deterministic = (o != NULL) ? PyObject_IsTrue(o) : 0;
+        Py_XDECREF(o);
+        PyErr_Clear();
+        if (deterministic > 0)
+        {
+            self->profile = SandboxPolicy_Identity(policy);
+            PyErr_Clear();
+        }
+        if (self->profile != NULL)
+        {
+            profile = PyBytes_AS_STRING(self->profile);
+            size = PyBytes_GET_SIZE(self->profile);
+        }
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).ctrl.filter = (filter_t){len, prog};
+    Sandbox_GET_SBOX(self).ctrl.pool = owner->pool;
+    Sandbox_GET_SBOX(self).ctrl.server = owner->server;
+    Sandbox_GET_SBOX(self).ctrl.memo = memo;
+    Sandbox_GET_SBOX(self).ctrl.profile.data = profile;
+    Sandbox_GET_SBOX(self).ctrl.profile.size = size;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    
+    FUNC_RET("%p", buffer);
+}
+
+static void
+Sandbox_detach(Sandbox * self, void * buffer)
+{
+    PROC_BEGIN("%p,%p", self, buffer);
+    assert(self);
+    
+    Sandbox * owner = (self->base != NULL) ? ((Sandbox *)self->base) : self;
+    assert(owner->users > 0);
+    owner->users--;
+    
+    if (self->rules != NULL)
+    {
+        assert(SandboxPolicy_GET_STATE(self->rules).users > 0);
+        SandboxPolicy_GET_STATE(self->rules).users--;
+        Py_CLEAR(self->rules);
+    }
+    
+    LOCK(&Sandbox_GET_SBOX(self), EX);
+    Sandbox_GET_SBOX(self).ctrl.filter = (filter_t){0, NULL};
+    Sandbox_GET_SBOX(self).ctrl.pool = NULL;
+    Sandbox_GET_SBOX(self).ctrl.server = NULL;
+    Sandbox_GET_SBOX(self).ctrl.memo = NULL;
+    Sandbox_GET_SBOX(self).ctrl.profile.data = NULL;
+    Sandbox_GET_SBOX(self).ctrl.profile.size = 0;
+    UNLOCK(&Sandbox_GET_SBOX(self));
+    PyMem_Free(buffer);
+    Py_CLEAR(self->profile);
+    
+    PROC_END();
+}
+
 static PyObject *
 Sandbox_run(Sandbox * self)
 {
     FUNC_BEGIN("%p", self);
     assert(self);
     
-    if (!sandbox_check(&Sandbox_GET_SBOX(self)))
+    void * buffer = Sandbox_attach(self);
+    
+    const bool checked = sandbox_check(&Sandbox_GET_SBOX(self));
+    if (checked)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        sandbox_execute(&Sandbox_GET_SBOX(self));
+        Py_END_ALLOW_THREADS
+    }
+    
+    Sandbox_detach(self, buffer);
+    
+    if (!checked)
     {
         PyErr_SetString(PyExc_AssertionError, MSG_SBOX_CHECK_FAILED);
         FUNC_RET("%p", Py_NULL);
     }
     
+    Py_INCREF(Py_None);
+    FUNC_RET("%p", Py_None);
+}
+
+static PyObject *
+Sandbox_interact(Sandbox * self, PyObject * args, PyObject * kwds)
+{
+    FUNC_BEGIN("%p,%p,%p", self, args, kwds);
+    assert(self && args);
+    
+    static char * keywords[] = {"peer", "grace", NULL};
+    
+    PyObject * peer = NULL;
+    PyObject * o = NULL;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O:interact", keywords, 
+        &sandboxType, &peer, &o))
+    {
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    if (peer == (PyObject *)self)
+    {
+        PyErr_SetString(PyExc_ValueError, MSG_PEER_VAL_ERR);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
+    /* Either sandbox is given a second to finish after the other */
+    res_t grace = 1000;
+    if (o == Py_None)
+    {
+        grace = SBOX_QUOTA_INF;
+    }
+    else if (o != NULL)
+    {
+        if (!Integer_Check(o))
+        {
+            PyErr_SetString(PyExc_TypeError, MSG_GRACE_TYPE_ERR);
+            FUNC_RET("%p", Py_NULL);
+        }
+        PyObject * pyval = PyNumber_Long(o);
+        grace = (res_t)PyLong_AsUnsignedLongLong(pyval);
+        Py_XDECREF(pyval);
+        if (PyErr_Occurred())
+        {
+            FUNC_RET("%p", Py_NULL);
+        }
+    }
+    
+    void * buffer = Sandbox_attach(self);
+    void * pbuffer = Sandbox_attach((Sandbox *)peer);
+    
+    int res = 0;
     Py_BEGIN_ALLOW_THREADS
-    sandbox_execute(&Sandbox_GET_SBOX(self));
+    res = sandbox_execute_linked(&Sandbox_GET_SBOX(self), 
+        &Sandbox_GET_SBOX(peer), grace);
     Py_END_ALLOW_THREADS
     
+    Sandbox_detach((Sandbox *)peer, pbuffer);
+    Sandbox_detach(self, buffer);
+    
+    if (res != 0)
+    {
+        PyErr_SetString(PyExc_AssertionError, MSG_SBOX_CHECK_FAILED);
+        FUNC_RET("%p", Py_NULL);
+    }
+    
     Py_INCREF(Py_None);
     FUNC_RET("%p", Py_None);
 }
@@ -2141,6 +4771,9 @@ MODULE_INIT(_sandbox)
     PyDict_SetItemString(eventType.tp_dict, "S_EVENT_QUOTA", 
         o = Py_BuildValue("i", S_EVENT_QUOTA));
     Py_DECREF(o);
+    PyDict_SetItemString(eventType.tp_dict, "S_EVENT_OUTPUT", 
+        o = Py_BuildValue("i", S_EVENT_OUTPUT));
+    Py_DECREF(o);
     
     /* Finalize the sandbox event type */
     eventType.tp_base = &anyType;
@@ -2188,6 +4821,32 @@ MODULE_INIT(_sandbox)
     PyDict_SetItemString(actionType.tp_dict, "S_ACTION_KILL", 
         o = Py_BuildValue("i", S_ACTION_KILL));
     Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_ACTION_CONT_NORET", 
+        o = Py_BuildValue("i", S_ACTION_CONT_NORET));
+    Py_DECREF(o);
+    
+    /* Wrapper items for constants in cache_key_t */
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_ARG1", 
+        o = Py_BuildValue("i", S_CACHE_ARG1));
+    Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_ARG2", 
+        o = Py_BuildValue("i", S_CACHE_ARG2));
+    Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_ARG3", 
+        o = Py_BuildValue("i", S_CACHE_ARG3));
+    Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_ARG4", 
+        o = Py_BuildValue("i", S_CACHE_ARG4));
+    Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_ARG5", 
+        o = Py_BuildValue("i", S_CACHE_ARG5));
+    Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_ARG6", 
+        o = Py_BuildValue("i", S_CACHE_ARG6));
+    Py_DECREF(o);
+    PyDict_SetItemString(actionType.tp_dict, "S_CACHE_SCINFO", 
+        o = Py_BuildValue("i", S_CACHE_SCINFO));
+    Py_DECREF(o);
     
     /* Finalize the sandbox action type */
     actionType.tp_base = &anyType;
@@ -2213,6 +4872,59 @@ MODULE_INIT(_sandbox)
     }
     DBUG("added actionType to module");
     
+    /* Prepare constant attributes for policyType */
+    policyType.tp_dict = PyDict_New();
+    if (policyType.tp_dict == NULL)
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_RuntimeError, MSG_ALLOC_FAILED);
+        }
+        Py_DECREF(module);
+        INIT_RET(Py_NULL);
+    }
+    
+    /* Wrapper items for constants of native rules */
+    PyDict_SetItemString(policyType.tp_dict, "S_RULE_DELEGATE", 
+        o = Py_BuildValue("i", S_RULE_DELEGATE));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_EQ", 
+        o = Py_BuildValue("i", S_PRED_EQ));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_NE", 
+        o = Py_BuildValue("i", S_PRED_NE));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_LT", 
+        o = Py_BuildValue("i", S_PRED_LT));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_LE", 
+        o = Py_BuildValue("i", S_PRED_LE));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_GT", 
+        o = Py_BuildValue("i", S_PRED_GT));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_GE", 
+        o = Py_BuildValue("i", S_PRED_GE));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_ALL", 
+        o = Py_BuildValue("i", S_PRED_ALL));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_NONE", 
+        o = Py_BuildValue("i", S_PRED_NONE));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_IN", 
+        o = Py_BuildValue("i", S_PRED_IN));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_NOT", 
+        o = Py_BuildValue("i", S_PRED_NOT));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_AND", 
+        o = Py_BuildValue("i", S_PRED_AND));
+    Py_DECREF(o);
+    PyDict_SetItemString(policyType.tp_dict, "S_PRED_OR", 
+        o = Py_BuildValue("i", S_PRED_OR));
+    Py_DECREF(o);
+    
     /* Finalize the sandbox policy type */
     policyType.tp_base = &anyType;
     if (PyType_Ready(&policyType) != 0)
@@ -2263,6 +4975,87 @@ MODULE_INIT(_sandbox)
         o = Py_BuildValue("i", S_QUOTA_DISK));
     Py_DECREF(o);
     
+    /* Wrapper items for constants in backend_t */
+    PyDict_SetItemString(sandboxType.tp_dict, "S_BACKEND_PTRACE", 
+        o = Py_BuildValue("i", S_BACKEND_PTRACE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_BACKEND_NOTIFY", 
+        o = Py_BuildValue("i", S_BACKEND_NOTIFY));
+    Py_DECREF(o);
+    
+    /* Wrapper items for constants in trust_t */
+    PyDict_SetItemString(sandboxType.tp_dict, "S_TRUST_NONE", 
+        o = Py_BuildValue("i", S_TRUST_NONE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_TRUST_FULL", 
+        o = Py_BuildValue("i", S_TRUST_FULL));
+    Py_DECREF(o);
+    
+    /* Wrapper items for constants in ns_type_t */
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_NONE", 
+        o = Py_BuildValue("i", S_NS_NONE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_USER", 
+        o = Py_BuildValue("i", S_NS_USER));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_PID", 
+        o = Py_BuildValue("i", S_NS_PID));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_MOUNT", 
+        o = Py_BuildValue("i", S_NS_MOUNT));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_NET", 
+        o = Py_BuildValue("i", S_NS_NET));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_IPC", 
+        o = Py_BuildValue("i", S_NS_IPC));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_UTS", 
+        o = Py_BuildValue("i", S_NS_UTS));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_NS_ALL", 
+        o = Py_BuildValue("i", S_NS_ALL));
+    Py_DECREF(o);
+    
+    /* Wrapper items for constants in compare_t */
+    PyDict_SetItemString(sandboxType.tp_dict, "S_COMPARE_NONE", 
+        o = Py_BuildValue("i", S_COMPARE_NONE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_COMPARE_BYTE", 
+        o = Py_BuildValue("i", S_COMPARE_BYTE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_COMPARE_TOKEN", 
+        o = Py_BuildValue("i", S_COMPARE_TOKEN));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_COMPARE_NOCASE", 
+        o = Py_BuildValue("i", S_COMPARE_NOCASE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_COMPARE_FLOAT", 
+        o = Py_BuildValue("i", S_COMPARE_FLOAT));
+    Py_DECREF(o);
+    
+    /* Wrapper items for constants in fs_access_t */
+    PyDict_SetItemString(sandboxType.tp_dict, "S_FS_NONE", 
+        o = Py_BuildValue("i", S_FS_NONE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_FS_READ", 
+        o = Py_BuildValue("i", S_FS_READ));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_FS_WRITE", 
+        o = Py_BuildValue("i", S_FS_WRITE));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_FS_ENFORCED", 
+        o = PyBool_FromLong(sandbox_fs_enforced()));
+    Py_DECREF(o);
+    
+    /* Wrapper items for special cpu numbers in placement_t */
+    PyDict_SetItemString(sandboxType.tp_dict, "S_CPU_ANY", 
+        o = Py_BuildValue("i", SBOX_CPU_ANY));
+    Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_CPU_AUTO", 
+        o = Py_BuildValue("i", SBOX_CPU_AUTO));
+    Py_DECREF(o);
+    
     /* Wrapper items for constants in status_t */
     PyDict_SetItemString(sandboxType.tp_dict, "S_STATUS_PRE", 
         o = Py_BuildValue("i", S_STATUS_PRE));
@@ -2329,6 +5122,9 @@ MODULE_INIT(_sandbox)
     PyDict_SetItemString(sandboxType.tp_dict, "S_RESULT_R5",
         o = Py_BuildValue("i", S_RESULT_R5));
     Py_DECREF(o);
+    PyDict_SetItemString(sandboxType.tp_dict, "S_RESULT_WA",
+        o = Py_BuildValue("i", S_RESULT_WA));
+    Py_DECREF(o);
 
     /* Wrapper items for constants in structmembers.h */
     PyDict_SetItemString(sandboxType.tp_dict, "T_BYTE",
@@ -67,6 +67,95 @@ extern "C"
 
 /* Native structures */
 
+/* Native rule tables (since 0.3.6) hold one entry for each system call of each
+ * supported mode (ABI), so that the watcher thread can look up the action of a
+ * SYSCALL / SYSRET event without acquiring the GIL. */
+
+#ifdef __x86_64__
+#define RULE_MODE_MAX                   (2)
+#else
+#define RULE_MODE_MAX                   (1)
+#endif /* __x86_64__ */
+
+#define RULE_SCNO_MAX                   (1024)
+
+typedef enum
+{
+    RULE_DEFAULT        = 0,    /* use the fallback rule of the table */
+    RULE_DELEGATE       = 1,    /* call the policy object (with the GIL) */
+    RULE_NATIVE         = 2,    /* take the stored action (without the GIL) */
+} rule_type_t;
+
+#define S_RULE_DELEGATE                 (-1)
+
+/* Argument predicates (since 0.3.6) are nested tuples of S_PRED_* operators, 
+ * they are compiled into postfix code, and evaluated with a small stack. */
+
+#define PRED_CODE_MAX                   (64)
+#define PRED_STACK_MAX                  (16)
+
+typedef enum
+{
+    S_PRED_EQ           = 0,    /* arg == value */
+    S_PRED_NE           = 1,    /* arg != value */
+    S_PRED_LT           = 2,    /* arg < value */
+    S_PRED_LE           = 3,    /* arg <= value */
+    S_PRED_GT           = 4,    /* arg > value */
+    S_PRED_GE           = 5,    /* arg >= value */
+    S_PRED_ALL          = 6,    /* (arg & value) == value */
+    S_PRED_NONE         = 7,    /* (arg & value) == 0 */
+    S_PRED_IN           = 8,    /* arg in (value, ...), compiled into EQ / OR */
+    S_PRED_NOT          = 9,    /* not p */
+    S_PRED_AND          = 10,   /* p and q and ... */
+    S_PRED_OR           = 11,   /* p or q or ... */
+} pred_op_t;
+
+typedef struct
+{
+    unsigned char op;           /* operator (S_PRED_*) */
+    unsigned char arg;          /* argument (1-6) tested by comparison */
+    long value;                 /* operand of comparison */
+} pred_t;
+
+typedef struct
+{
+    unsigned char type;         /* rule type (RULE_*) */
+    unsigned char action;       /* native action type (S_ACTION_*) */
+    unsigned char result;       /* result of S_ACTION_FINI / S_ACTION_KILL */
+    unsigned char len;          /* length of predicate code, or 0 if none */
+    unsigned int pc;            /* offset of predicate code in the pool */
+} rule_t;
+
+/* Rule tables are position independent, such that they can be mapped from 
+ * compiled policy profiles shared by multiple processes (since 0.3.6). */
+
+typedef struct
+{
+    rule_t fallback;
+    rule_t rule[RULE_MODE_MAX][RULE_SCNO_MAX];
+    unsigned int size;          /* capacity of the pool of predicate code */
+    unsigned int used;          /* length of the pool of predicate code */
+    pred_t code[];              /* pool of predicate code */
+} rule_table_t;
+
+#define PROFILE_MAGIC                   "SBOXPROF"
+#define PROFILE_VERSION                 (1)
+#define PROFILE_ALIGN                   (8)
+#define PROFILE_LAYOUT \
+    ((sizeof(long) << 24) | (RULE_MODE_MAX << 16) | (RULE_SCNO_MAX)) \
+/* PROFILE_LAYOUT */
+
+typedef struct
+{
+    char magic[8];              /* PROFILE_MAGIC */
+    unsigned int version;       /* PROFILE_VERSION */
+    unsigned int layout;        /* PROFILE_LAYOUT of the host */
+    unsigned int size;          /* size of the image */
+    unsigned int table;         /* offset of the rule table */
+    unsigned int filter;        /* offset of the seccomp filter program */
+    unsigned int nfilter;       /* length of the seccomp filter program */
+} profile_t;
+
 typedef struct
 {
     PyObject_HEAD
@@ -78,6 +167,10 @@ typedef struct
         {
             PyObject * e;
             PyObject * a;
+            rule_table_t * rules;
+            void * image;       /* mapped policy profile, or NULL */
+            size_t size;        /* size of the mapped policy profile */
+            unsigned int users; /* running sandboxes reading the rules */
         } policy;
     } raw;
 } Any;
@@ -116,7 +209,19 @@ typedef struct
         PyObject * i;
         PyObject * o;
         PyObject * e;
+        PyObject * x;
+        PyObject * a;
+        PyObject * f;
+        Py_buffer view;         /* view of the input fed, or view.obj NULL */
     } io;
+    task_t * tmpl;              /* validated template of the task, or NULL */
+    pool_t * pool;              /* pre-forked helpers, or NULL */
+    unsigned int users;         /* running instances attached, with the GIL */
+    server_t * server;          /* fork server, or NULL */
+    memo_t * memo;              /* result cache, or NULL */
+    PyObject * profile;         /* identity of the policy cached by, or NULL */
+    PyObject * rules;           /* policy whose rules are in use, or NULL */
+    PyObject * base;            /* sandbox instantiated from, or NULL */
 } Sandbox;
 
 #define Sandbox_GET_SBOX(o)             (((Sandbox *)(o))->sbox)
@@ -143,9 +248,15 @@ typedef struct
 #define MSG_ARGS_TOO_LONG       "command line is too long"
 #define MSG_ARGS_TYPE_ERR       "command line should be a " MSG_STR_OR_SEQ
 #define MSG_ARGS_VAL_ERR        "command line should be a " MSG_STR_OR_SEQ
+#define MSG_ARGS_MISSING        "command line or template is required"
 #define MSG_ARGS_INVALID        "command line should contain full path to an " \
                                 "executable"
 
+#define MSG_ENV_TOO_LONG        "environment is too long"
+#define MSG_ENV_TYPE_ERR        "environment should be a dict or sequence " \
+                                "of " MSG_STR_TYPES
+#define MSG_ENV_VAL_ERR         "environment should contain KEY=VALUE strings"
+
 #define MSG_JAIL_TOO_LONG       "program jail is too long"
 #define MSG_JAIL_TYPE_ERR       "program jail should be a " MSG_STR_OBJ
 #define MSG_JAIL_INVALID        "program jail should be a valid path"
@@ -173,11 +284,89 @@ typedef struct
 #define MSG_QUOTA_VAL_ERR       "quota value is invalid"
 #define MSG_QUOTA_INVALID       "failed to get quota value from list / tuple"
 
+#define MSG_PLACEMENT_TYPE_ERR  "placement should be a cpu number or a pair " \
+                                "of cpu numbers"
+#define MSG_PLACEMENT_VAL_ERR   "placement should be a cpu number or S_CPU_*"
+
+#define MSG_BACKEND_TYPE_ERR    "backend should be an integer"
+#define MSG_BACKEND_VAL_ERR     "backend should be one of S_BACKEND_*"
+
+#define MSG_TRUST_TYPE_ERR      "trust should be an integer"
+#define MSG_TRUST_VAL_ERR       "trust should be one of S_TRUST_*"
+
+#define MSG_NS_TYPE_ERR         "ns should be an integer"
+#define MSG_NS_VAL_ERR          "ns should be a combination of S_NS_*"
+
+#define MSG_IMAGE_TYPE_ERR      "image should be a dict of readonly, prog " \
+                                "(" MSG_STR_OBJ "), scratch (" MSG_STR_OBJ \
+                                ") and size (integer)"
+#define MSG_IMAGE_TOO_LONG      "path of jail image is too long"
+#define MSG_IMAGE_VAL_ERR       "scratch of jail image should be an absolute " \
+                                "path"
+
+#define MSG_EXE_TYPE_ERR        "executable should be an valid file object"
+#define MSG_EXE_INVALID         "executable should be a regular file"
+
+#define MSG_ANSWER_TYPE_ERR     "answer should be a valid file object"
+#define MSG_ANSWER_INVALID      "answer should be a readable regular file"
+
+#define MSG_COMPARE_TYPE_ERR    "compare should be an integer"
+#define MSG_COMPARE_VAL_ERR     "compare should be one of S_COMPARE_*"
+
+#define MSG_EPSILON_TYPE_ERR    "epsilon should be a number"
+#define MSG_EPSILON_VAL_ERR     "epsilon should be non-negative"
+
+#define MSG_INPUT_TYPE_ERR      "input should be a bytes-like object, a file " \
+                                "object, or a (file, offset, size) tuple"
+#define MSG_INPUT_INVALID       "input file should be a readable regular file"
+#define MSG_INPUT_VAL_ERR       "input offset should be non-negative, and " \
+                                "size should be non-negative or -1"
+
+#define MSG_CACHE_INVALID       "cache should be the path of a valid (or new) "\
+                                "index file of the result cache"
+
+#define MSG_PEER_VAL_ERR        "peer should be another sandbox"
+#define MSG_GRACE_TYPE_ERR      "grace should be a non-negative integer or None"
+
+#define MSG_FS_TOO_LONG         "filesystem allow-list is too long"
+#define MSG_FS_TYPE_ERR         "filesystem allow-list should be a sequence " \
+                                "of (path, access) pairs"
+#define MSG_FS_VAL_ERR          "filesystem allow-list should contain " \
+                                "absolute paths and S_FS_* access types"
+
+#define MSG_TEMPLATE_TYPE_ERR   "template should be an instance of Sandbox"
+#define MSG_TEMPLATE_INVALID    "template should be a valid sandbox"
+#define MSG_TEMPLATE_CONFLICT   "template cannot be combined with args, jail, " \
+                                "owner, group, env, fs, trust, ns, image " \
+                                "or executable"
+
+#define MSG_POOL_SIZE_ERR       "pool size should be a positive integer no " \
+                                "greater than SBOX_POOL_MAX"
+#define MSG_POOL_FAILED         "failed to start the pool of helpers"
+#define MSG_POOL_BUSY           "pool of helpers is in use by running " \
+                                "instances"
+#define MSG_SERVER_FAILED       "failed to start the fork server"
+
 #define MSG_POLICY_TYPE_ERR     "policy should be an instance of SandboxPolicy"
 #define MSG_POLICY_CALL_FAILED  "policy failed to determine action"
 #define MSG_POLICY_DEL_FORBID   "policy should not be deleted"
+#define MSG_RULE_SC_TYPE_ERR    "system call should be None, a number or a " \
+                                "pair of (number, mode)"
+#define MSG_RULE_SC_VAL_ERR     "system call number or mode is out of range"
+#define MSG_RULE_ACTION_ERR     "action should be S_ACTION_* or S_RULE_DELEGATE"
+#define MSG_RULE_RESULT_ERR     "result should be S_RESULT_*"
+#define MSG_RULE_PRED_TYPE_ERR  "predicate should be None, a tuple of " \
+                                "(arg, op, value), (S_PRED_NOT, p) or " \
+                                "(S_PRED_AND / S_PRED_OR, p, q, ...)"
+#define MSG_RULE_PRED_VAL_ERR   "predicate should test one of arguments 1-6 " \
+                                "with S_PRED_*"
+#define MSG_RULE_PRED_TOO_LONG  "predicate is too complex"
+#define MSG_PROFILE_NO_RULES    "policy has no native rules"
+#define MSG_PROFILE_INVALID     "invalid or incompatible policy profile"
 #define MSG_POLICY_SET_FORBID   "cannot change policy when the sandboxed "\
                                 "program is running"
+#define MSG_RULE_SET_FORBID     "cannot change rules when the policy is used "\
+                                "by running sandboxes"
 
 #define MSG_NO_IMPL             "method is not implemented"
 
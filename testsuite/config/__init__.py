@@ -74,6 +74,7 @@ def load_data(fn):
 
 CODE_HELLO_WORLD = load_data("hello.c")
 CODE_A_PLUS_B = load_data("a_plus_b.c")
+CODE_A_PLUS_B_ALARM = load_data("a_plus_b_alarm.c")
 CODE_EXIT1 = load_data("exit1.c")
 CODE_EXIT_GROUP1 = load_data("exit_group1.c")
 TMPL_FILE_READ = load_data("file_read.c.in")
@@ -0,0 +1,23 @@
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static void on_alarm(int signo)
+{
+    _exit(1); /* Not to be run outside the sandbox */
+}
+
+int main(int argc, char * argv[])
+{
+    long a, b;
+    signal(SIGALRM, on_alarm);
+    alarm(1);
+    while (!feof(stdin))
+    {
+        if (scanf("%ld %ld", &a, &b) != 2)
+            break;
+        printf("%ld\n", a + b);
+    }
+
+    return 0;
+}
@@ -31,7 +31,8 @@
 # POSSIBILITY OF SUCH DAMAGE.                                                  #
 ################################################################################
 
-__all__ = ['MinimalPolicy', 'AllowExitPolicy', 'AllowExecOncePolicy',
+__all__ = ['MinimalPolicy', 'NativeMinimalPolicy', 'NoReturnPolicy',
+           'CachingPolicy', 'AllowExitPolicy', 'AllowExecOncePolicy',
            'AllowPauseSleepPolicy', 'AllowSelfKillPolicy', 'AllowResLimitPolicy',
            'SelectiveOpenPolicy', 'KillerPolicy', ]
 
@@ -94,6 +95,71 @@ class MinimalPolicy(SandboxPolicy):
     pass
 
 
+class NativeMinimalPolicy(SandboxPolicy):
+
+    # same white list as MinimalPolicy, but enforced with native rules
+    def __init__(self):
+        super(NativeMinimalPolicy, self).__init__()
+        if machine() == 'x86_64':
+            for (mode, abi) in ((0, 'x86_64'), (1, 'i686'), ):
+                for scno in MinimalPolicy.sc_safe[abi]:
+                    self.rule((scno, mode), S_ACTION_CONT)
+        else:  # i686
+            for scno in MinimalPolicy.sc_safe[machine()]:
+                self.rule(scno, S_ACTION_CONT)
+        self.rule(None, S_ACTION_KILL, S_RESULT_RF)
+        # number of SYSCALL / SYSRET events delegated to __call__()
+        self.delegated = 0
+        pass
+
+    def __call__(self, e, a):
+        if e.type in (S_EVENT_SYSCALL, S_EVENT_SYSRET):
+            self.delegated += 1
+        return super(NativeMinimalPolicy, self).__call__(e, a)
+
+    pass
+
+
+class NoReturnPolicy(SandboxPolicy):
+
+    # allow system calls without asking for their returns
+    def __init__(self):
+        super(NoReturnPolicy, self).__init__()
+        # number of SYSRET events received
+        self.sysret = 0
+        pass
+
+    def __call__(self, e, a):
+        if e.type == S_EVENT_SYSCALL:
+            a.type = S_ACTION_CONT_NORET
+            return a
+        if e.type == S_EVENT_SYSRET:
+            self.sysret += 1
+        return super(NoReturnPolicy, self).__call__(e, a)
+
+    pass
+
+
+class CachingPolicy(SandboxPolicy):
+
+    # mark continued system calls as cacheable, keyed by the first argument
+    def __init__(self):
+        super(CachingPolicy, self).__init__()
+        # number of SYSCALL events received
+        self.syscall = 0
+        pass
+
+    def __call__(self, e, a):
+        a = super(CachingPolicy, self).__call__(e, a)
+        if e.type == S_EVENT_SYSCALL:
+            self.syscall += 1
+            if a.type == S_ACTION_CONT:
+                a.data = S_CACHE_SCINFO | S_CACHE_ARG1
+        return a
+
+    pass
+
+
 class AllowExitPolicy(MinimalPolicy):
 
     SC_exit = ((60, 0), (1, 1), ) if machine() == 'x86_64' else (1, )
@@ -36,10 +36,14 @@ from __future__ import with_statement
 
 __all__ = ['TestInputOutput', 'TestProfiling', ]
 
+import hashlib
 import os
 import sys
+import time
 
-from sandbox import Sandbox
+from platform import machine
+from sandbox import Sandbox, SandboxPolicy, S_ACTION_CONT, S_PRED_EQ, \
+    S_PRED_IN, S_PRED_NOT, S_PRED_AND, S_EVENT_SYSCALL
 from subprocess import Popen, PIPE
 
 try:
@@ -86,6 +90,247 @@ class TestInputOutput(unittest.TestCase):
         self.assertEqual(stdout, b"Hello World!\n")
         pass
 
+    def _answer(self, name, data):
+        f = open(os.path.join(config.TEMP_DIR, name), "w+b")
+        f.write(data)
+        f.flush()
+        return f
+
+    def test_answer_compare(self):
+        task = config.build("hello", config.CODE_HELLO_WORLD)
+        self.assertTrue(task is not None)
+        for data, compare, result, mismatch in (
+                (b"Hello World!\n", Sandbox.S_COMPARE_BYTE,
+                    Sandbox.S_RESULT_OK, -1),
+                (b"Hello World!", Sandbox.S_COMPARE_BYTE,
+                    Sandbox.S_RESULT_WA, 12),
+                (b"Hello World!\nBye", Sandbox.S_COMPARE_BYTE,
+                    Sandbox.S_RESULT_WA, 13),
+                (b"Hello  World!\n", Sandbox.S_COMPARE_BYTE,
+                    Sandbox.S_RESULT_WA, 6),
+                (b" Hello\tWorld! \n\n", Sandbox.S_COMPARE_TOKEN,
+                    Sandbox.S_RESULT_OK, -1),
+                (b"Hello World", Sandbox.S_COMPARE_TOKEN,
+                    Sandbox.S_RESULT_WA, 11),
+                (b"Hello World!!", Sandbox.S_COMPARE_TOKEN,
+                    Sandbox.S_RESULT_WA, 12), ):
+            a = self._answer("hello.ans", data)
+            s_wr = open("/dev/null", "wb")
+            s = Sandbox(task, stdout=s_wr, answer=a, compare=compare)
+            s.run()
+            s_wr.close()
+            a.close()
+            self.assertEqual(s.result, result)
+            self.assertEqual(s.probe(False)['output_info'], (13, mismatch))
+        pass
+
+    def test_answer_tolerance(self):
+        # /bin/cat < foo.in, compared with foo.ans
+        long = b"x" * 100
+        for data, ans, compare, kwds, result, mismatch in (
+                (b"Hello WORLD!\n", b"hello world!", Sandbox.S_COMPARE_NOCASE,
+                    dict(), Sandbox.S_RESULT_OK, -1),
+                (b"Hello World!\n", b"Hello World?", Sandbox.S_COMPARE_NOCASE,
+                    dict(), Sandbox.S_RESULT_WA, 11),
+                (b"3.14159265 2.5e-3 pi\n", b"3.1415927\n0.0025 pi",
+                    Sandbox.S_COMPARE_FLOAT, dict(), Sandbox.S_RESULT_OK, -1),
+                (b"3.14159265 2.5e-3 pi\n", b"3.1416 0.0025 pi",
+                    Sandbox.S_COMPARE_FLOAT, dict(), Sandbox.S_RESULT_WA, 0),
+                (b"3.14159265 2.5e-3 pi\n", b"3.1416 0.0025 pi",
+                    Sandbox.S_COMPARE_FLOAT, dict(epsilon=1e-4),
+                    Sandbox.S_RESULT_OK, -1),
+                (b"3.14159265 2.5e-3 pi\n", b"3.14159265 2.5e-3 PI",
+                    Sandbox.S_COMPARE_FLOAT, dict(), Sandbox.S_RESULT_WA, 18),
+                (b"1000000.5 -0\n", b"1e6 0", Sandbox.S_COMPARE_FLOAT,
+                    dict(), Sandbox.S_RESULT_OK, -1),
+                (long + b" 1\n", long + b" 1", Sandbox.S_COMPARE_FLOAT,
+                    dict(), Sandbox.S_RESULT_OK, -1),
+                (long + b" 1\n", long[:-1] + b"y 1", Sandbox.S_COMPARE_FLOAT,
+                    dict(), Sandbox.S_RESULT_WA, 0), ):
+            i = self._answer("cat.in", data)
+            i.seek(0)
+            a = self._answer("cat.ans", ans)
+            s_wr = open("/dev/null", "wb")
+            s = Sandbox("/bin/cat", stdin=i, stdout=s_wr, answer=a,
+                compare=compare, **kwds)
+            s.run()
+            s_wr.close()
+            i.close()
+            a.close()
+            self.assertEqual(s.result, result)
+            self.assertEqual(s.probe(False)['output_info'],
+                (len(data), mismatch))
+        pass
+
+    def test_fed_stdin(self):
+        # /bin/cat fed from memory, or from a region of a file
+        data = b"Hello World!\n" * 10000
+        i = self._answer("cat.in", b"#" * 7 + data + b"#")
+        a = self._answer("cat.ans", data)
+        for feed, seekable in (
+                (data, False),
+                (bytearray(data), True),
+                ((i, 7, len(data)), False),
+                ((i, 7, len(data)), True),
+                (a, False),
+                (a, True), ):
+            s_wr = open("/dev/null", "wb")
+            s = Sandbox("/bin/cat", input=feed, seekable=seekable,
+                stdout=s_wr, answer=a)
+            s.run()
+            s_wr.close()
+            self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+            d = s.probe(False)
+            self.assertEqual(d['output_info'], (len(data), -1))
+            self.assertEqual(d['input_info'], (len(data), len(data)))
+        # input not read by the program is not consumed
+        s = Sandbox("/bin/true", input=(i, 0, -1), seekable=True)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.probe(False)['input_info'], (len(data) + 8, 0))
+        i.close()
+        a.close()
+        pass
+
+    def test_interact(self):
+        # interactor and solution cross-connected through pipes
+        a = Sandbox(["/bin/sh", "-c", 'echo 6 7; read x; [ "$x" = 42 ]'],
+            quota=dict(wallclock=5000))
+        b = Sandbox(["/bin/sh", "-c", 'read x y; echo $((x * y))'],
+            quota=dict(wallclock=5000))
+        a.interact(b)
+        self.assertEqual(a.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(b.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(a.probe(False)['link_info'][:2], (4, 3))
+        self.assertEqual(b.probe(False)['link_info'][:2], (3, 4))
+        # the peer is killed once the grace time is over
+        a = Sandbox(["/bin/sh", "-c", 'echo 6 7'], quota=dict(wallclock=5000))
+        b = Sandbox(["/bin/sh", "-c", 'while :; do :; done'],
+            quota=dict(wallclock=5000))
+        a.interact(b, grace=200)
+        self.assertEqual(a.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(b.result, Sandbox.S_RESULT_TL)
+        self.assertTrue(b.probe(False)['elapsed'] < 2000)
+        pass
+
+    def test_cached_result(self):
+        # reruns under a deterministic policy are replayed from the cache
+        class DeterministicPolicy(SandboxPolicy):
+            deterministic = True
+            pass
+        path = os.path.join(config.TEMP_DIR, "cat.memo")
+        if os.path.exists(path):
+            os.remove(path)
+        data = b"Hello World!\n" * 1000
+        a = self._answer("cat.ans", data)
+        for feed, policy, memoized, result, mismatch in (
+                (data, DeterministicPolicy(), False, Sandbox.S_RESULT_OK, -1),
+                (data, DeterministicPolicy(), True, Sandbox.S_RESULT_OK, -1),
+                (data + b"?", DeterministicPolicy(), False,
+                    Sandbox.S_RESULT_WA, len(data)),
+                (data + b"?", DeterministicPolicy(), True,
+                    Sandbox.S_RESULT_WA, len(data)),
+                (data, SandboxPolicy(), False, Sandbox.S_RESULT_OK, -1), ):
+            s_wr = open("/dev/null", "wb")
+            s = Sandbox("/bin/cat", input=feed, stdout=s_wr, stderr=s_wr,
+                answer=a, policy=policy, cache=path)
+            s.run()
+            s_wr.close()
+            self.assertEqual(s.result, result)
+            d = s.probe(False)
+            self.assertEqual(d['memoized'], memoized)
+            self.assertEqual(d['output_info'], (len(feed), mismatch))
+            self.assertEqual(s.cache['hit'], 1 if memoized else 0)
+        # other policies are told apart, and output is never lost on a hit
+        class OtherPolicy(DeterministicPolicy):
+            pass
+        class KeyedPolicy(SandboxPolicy):
+            deterministic = True
+            cache_key = "cat"
+            pass
+        for policy, fn, memoized in (
+                (OtherPolicy(), "/dev/null", False),
+                (KeyedPolicy(), "/dev/null", False),
+                (KeyedPolicy(), "/dev/null", True),
+                (DeterministicPolicy(), os.path.join(config.TEMP_DIR,
+                    "cat.out"), False), ):
+            s_wr = open(fn, "wb")
+            s = Sandbox("/bin/cat", input=data, stdout=s_wr, stderr=s_wr,
+                answer=a, policy=policy, cache=path)
+            s.run()
+            s_wr.close()
+            self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+            self.assertEqual(s.probe(False)['memoized'], memoized)
+        with open(fn, "rb") as f:
+            self.assertEqual(f.read(), data)
+        a.close()
+        # verdicts subject to the load of the host are never replayed
+        task = config.build("loop", config.CODE_LOOP)
+        self.assertTrue(task is not None)
+        for i in range(2):
+            s_wr = open("/dev/null", "wb")
+            s = Sandbox(task, stdout=s_wr, stderr=s_wr, quota=dict(cpu=200),
+                policy=DeterministicPolicy(), cache=path)
+            s.run()
+            s_wr.close()
+            self.assertEqual(s.result, Sandbox.S_RESULT_TL)
+            self.assertEqual(s.probe(False)['memoized'], False)
+        pass
+
+    def test_output_digest(self):
+        # the captured output is fingerprinted while being drained
+        data = b"Hello World!\n" * 100000
+        for feed, sha256, xxh64 in (
+                (b"abc", True, 0x44bc2cf5ad770999),
+                (b"abc", False, 0x44bc2cf5ad770999),
+                (data, True, None), ):
+            s_wr = open("/dev/null", "wb")
+            s = Sandbox("/bin/cat", input=feed, stdout=s_wr, sha256=sha256,
+                compare=Sandbox.S_COMPARE_NONE)
+            s.run()
+            s_wr.close()
+            self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+            d = s.probe(False)
+            self.assertEqual(d['output_info'][0], len(feed))
+            if xxh64 is not None:
+                self.assertEqual(d['output_digest'][0], xxh64)
+            self.assertEqual(d['output_digest'][1],
+                hashlib.sha256(feed).hexdigest() if sha256 else None)
+        pass
+
+    def test_answer_early_stop(self):
+        # the mismatch is caught long before the wallclock quota
+        task = config.build("loop_print", config.CODE_LOOP_PRINT)
+        self.assertTrue(task is not None)
+        a = self._answer("loop_print.ans", b"Hello World!\nHello World?\n")
+        s_rd, s_wr = os.pipe()
+        s = Sandbox(task, quota=dict(wallclock=10000), stdout=s_wr, answer=a)
+        s.run()
+        os.close(s_wr)
+        a.close()
+        self.assertEqual(s.result, Sandbox.S_RESULT_WA)
+        d = s.probe(False)
+        self.assertTrue(d['elapsed'] < 5000)
+        self.assertEqual(d['output_info'][1], 24)
+        # captured output is forwarded to stdout
+        with os.fdopen(s_rd, 'rb') as f:
+            self.assertTrue(f.read(26) == b"Hello World!\nHello World!\n")
+        pass
+
+    def test_environ(self):
+        # env -i LANG=C /usr/bin/env
+        s_rd, s_wr = os.pipe()
+        s = Sandbox("/usr/bin/env", env=dict(LANG="C"), stdout=s_wr)
+        s.run()
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        # close the write-end of the pipe before reading from the read-end
+        os.fdopen(s_wr, 'wb').close()
+        with os.fdopen(s_rd, 'rb') as f:
+            self.assertEqual(f.read(), b"LANG=C\n")
+            f.close()
+        pass
+
     pass
 
 
@@ -97,6 +342,8 @@ class TestProfiling(unittest.TestCase):
         self.task.append(config.build("a_plus_b", config.CODE_A_PLUS_B))
         self.task.append(config.build("exit1", config.CODE_EXIT1))
         self.task.append(config.build("exit_group1", config.CODE_EXIT_GROUP1))
+        self.task.append(config.build("a_plus_b_alarm",
+                                      config.CODE_A_PLUS_B_ALARM))
         for t in self.task:
             self.assertTrue(t is not None)
         pass
@@ -117,6 +364,89 @@ class TestProfiling(unittest.TestCase):
         self.assertTrue(mem > 0)
         pass
 
+    @unittest.skipUnless(hasattr(os, 'memfd_create'), "test requires memfd_create")
+    def test_hello_world_memfd(self):
+        # the program only exists in memory, not in the filesystem
+        fd = os.memfd_create("hello")
+        with open(self.task[0], "rb") as f:
+            os.write(fd, f.read())
+        s_wr = open("/dev/null", "wb")
+        s = Sandbox(["/nonexistent/hello"], executable=fd, stdout=s_wr)
+        s.run()
+        s_wr.close()
+        os.close(fd)
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.probe(False)['exitcode'], 0)
+        pass
+
+    def _a_plus_b(self, base, a, b):
+        # run an instance of base with input "a b", and validate its output
+        i_rd, i_wr = os.pipe()
+        o_rd, o_wr = os.pipe()
+        os.write(i_wr, ("%d %d\n" % (a, b)).encode())
+        os.close(i_wr)
+        s = Sandbox(template=base, stdin=i_rd, stdout=o_wr)
+        s.run()
+        os.close(i_rd)
+        os.close(o_wr)
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        with os.fdopen(o_rd, 'rb') as f:
+            self.assertEqual(int(f.read()), a + b)
+            f.close()
+        return s
+
+    def _wait_until(self, cond):
+        # wait for helpers or master processes to park in the background
+        deadline = time.time() + 10
+        while not cond():
+            self.assertTrue(time.time() < deadline)
+            time.sleep(0.01)
+        pass
+
+    def test_a_plus_b_template(self):
+        base = Sandbox(self.task[1])
+        for a, b in ((1, 2), (30, 12)):
+            # static fields are instantiated from (and validated with) base
+            s = self._a_plus_b(base, a, b)
+            self.assertEqual(s.task, base.task)
+        self.assertRaises(TypeError, Sandbox, self.task[1], template=base)
+        pass
+
+    def test_a_plus_b_pool(self):
+        base = Sandbox(self.task[1])
+        base.prefork(2)
+        for a, b in ((1, 2), (30, 12)):
+            self._wait_until(lambda: base.pool['ready'] >= 1)
+            self._a_plus_b(base, a, b)
+        self.assertEqual(base.pool['hit'], 2)
+        self.assertRaises(ValueError, base.prefork, 0)
+        # idle pools are replaced, refill takes any truth value
+        base.prefork(1, refill=0)
+        self.assertEqual(base.pool['size'], 1)
+        pass
+
+    def test_a_plus_b_server(self):
+        base = Sandbox(self.task[1])
+        base.forkserver()
+        self._wait_until(lambda: base.server['ready'])
+        for a, b in ((1, 2), (30, 12)):
+            self._a_plus_b(base, a, b)
+        self.assertEqual(base.server['hit'], 2)
+        pass
+
+    def test_a_plus_b_server_alarm(self):
+        base = Sandbox(self.task[4])
+        base.forkserver()
+        self._wait_until(lambda: base.server['ready'])
+        # the alarm of the master process expires while parked, its handler
+        # should not run untraced (and quit the master process)
+        time.sleep(1.5)
+        self.assertTrue(base.server['ready'])
+        self._a_plus_b(base, 1, 2)
+        self.assertEqual(base.server['hit'], 1)
+        pass
+
     def test_a_plus_b(self):
         p_rd, p_wr = os.pipe()
         p = Popen(["/bin/echo", "1", "2"], close_fds=True, stdout=p_wr)
@@ -169,6 +499,194 @@ class TestProfiling(unittest.TestCase):
         self.assertTrue(mem > 0)
         pass
 
+    def test_exit_group1_native(self):
+        # startup system calls of recent C libraries, i.e. readlink,
+        # set_tid_address, set_robust_list, prlimit64, getrandom and rseq,
+        # on top of the white list with the KILL fallback
+        def native_minimal_policy():
+            p = NativeMinimalPolicy()
+            for sc in ((89, 0), (218, 0), (273, 0), (302, 0), (318, 0),
+                    (334, 0), ) if machine() == 'x86_64' else \
+                    (85, 258, 311, 340, 355, 386, ):
+                p.rule(sc, S_ACTION_CONT)
+            return p
+        s = Sandbox(self.task[3])
+        s.policy = native_minimal_policy()
+        s.run()
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        self.assertEqual(s.probe(False)['exitcode'], 1)
+        # ruled system calls never reach the policy object
+        self.assertEqual(s.policy.delegated, 0)
+        # unlisted system calls (i.e. fork) are killed by the fallback rule
+        task = config.build("fork", config.CODE_FORK)
+        self.assertTrue(task is not None)
+        s = Sandbox(task, policy=native_minimal_policy())
+        s.run()
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_RF)
+        self.assertEqual(s.policy.delegated, 0)
+        # failed predicates delegate system calls to the policy object
+        p = native_minimal_policy()
+        p.rule((231, 0) if machine() == 'x86_64' else 252, S_ACTION_CONT,
+            pred=(1, S_PRED_EQ, 0))
+        s = Sandbox(self.task[3], policy=p)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        self.assertEqual(p.delegated, 1)
+        pass
+
+    def test_exit_group1_rule_in_use(self):
+        # rules of a policy cannot be changed while it is in use
+        class RefiningPolicy(SandboxPolicy):
+            refused = 0
+            def __call__(self, e, a):
+                if e.type == S_EVENT_SYSCALL:
+                    try:
+                        self.rule(None, S_ACTION_CONT)
+                    except AssertionError:
+                        self.refused += 1
+                return super(RefiningPolicy, self).__call__(e, a)
+            pass
+        p = RefiningPolicy()
+        s = Sandbox(self.task[3], policy=p)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        self.assertTrue(p.refused > 0)
+        p.rule(None, S_ACTION_CONT)
+        pass
+
+    def test_exit_group1_profile(self):
+        p = NativeMinimalPolicy()
+        p.rule(None, S_ACTION_CONT)
+        fn = os.path.join(config.TEMP_DIR, "minimal.prof")
+        p.dump(fn)
+        # the loaded profile replaces the KILL fallback of the new policy
+        q = NativeMinimalPolicy()
+        q.load(fn)
+        s = Sandbox(self.task[3], policy=q)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        self.assertEqual(q.delegated, 0)
+        # dumping over a mapped profile replaces the file, not its content
+        NativeMinimalPolicy().dump(fn)
+        self.assertEqual([f for f in os.listdir(config.TEMP_DIR)
+            if f.startswith("minimal.prof.")], [])
+        s = Sandbox(self.task[3], policy=q)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        # loaded rules can still be refined
+        q.rule((231, 0) if machine() == 'x86_64' else 252, S_ACTION_CONT,
+            pred=(1, S_PRED_EQ, 0))
+        s = Sandbox(self.task[3], policy=q)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        self.assertEqual(q.delegated, 1)
+        # truncated profiles are rejected
+        with open(fn, "rb") as f:
+            data = f.read()
+        fn = config.touch("truncated.prof", data[:-1])
+        self.assertRaises(ValueError, q.load, fn)
+        pass
+
+    def test_hello_world_pred(self):
+        sc_write = (1, 0) if machine() == 'x86_64' else 4
+        # write(fd in (1, 2), buf, count != 0)
+        pred = (S_PRED_AND, (1, S_PRED_IN, (1, 2)),
+            (S_PRED_NOT, (3, S_PRED_EQ, 0)))
+        s_wr = open("/dev/null", "wb")
+        # the policy object sees both the entry and the return of the write()
+        # failing the predicate
+        for (pred, delegated) in ((pred, 0), ((S_PRED_NOT, pred), 2), ):
+            p = NativeMinimalPolicy()
+            p.rule(None, S_ACTION_CONT)
+            p.rule(sc_write, S_ACTION_CONT, pred=pred)
+            s = Sandbox(self.task[0], stdout=s_wr, policy=p)
+            s.run()
+            self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+            self.assertEqual(p.delegated, delegated)
+        s_wr.close()
+        # malformed predicates are rejected
+        p = NativeMinimalPolicy()
+        self.assertRaises(ValueError, p.rule, sc_write, S_ACTION_CONT,
+            pred=(7, S_PRED_EQ, 0))
+        self.assertRaises(TypeError, p.rule, sc_write, S_ACTION_CONT,
+            pred=(1, S_PRED_IN, ()))
+        self.assertRaises(TypeError, p.rule, sc_write, S_ACTION_CONT,
+            pred=(S_PRED_AND, (1, S_PRED_EQ, 1)))
+        pass
+
+    def test_hello_world_noret(self):
+        s_wr = open("/dev/null", "wb")
+        s = Sandbox(self.task[0], stdout=s_wr, policy=NoReturnPolicy())
+        s.run()
+        s_wr.close()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.policy.sysret, 0)
+        pass
+
+    def test_hello_world_notify(self):
+        s_wr = open("/dev/null", "wb")
+        s = Sandbox(self.task[0], stdout=s_wr, policy=NoReturnPolicy(),
+            backend=Sandbox.S_BACKEND_NOTIFY)
+        s.run()
+        s_wr.close()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.probe(False)['exitcode'], 0)
+        # system call returns are never reported without ptrace
+        self.assertEqual(s.policy.sysret, 0)
+        pass
+
+    def test_hello_world_trusted(self):
+        s_wr = open("/dev/null", "wb")
+        s = Sandbox(self.task[0], stdout=s_wr, policy=NoReturnPolicy(),
+            trust=Sandbox.S_TRUST_FULL)
+        s.run()
+        s_wr.close()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.probe(False)['exitcode'], 0)
+        # system calls of trusted programs are never reported
+        self.assertEqual(s.probe(False)['syscall_info'], (0, 0))
+        pass
+
+    def test_loop_print_cached(self):
+        task = config.build("loop_print", config.CODE_LOOP_PRINT)
+        self.assertTrue(task is not None)
+        s_wr = open(os.path.join(config.TEMP_DIR, "loop_print.cache"), "wb")
+        s = Sandbox(task, quota=dict(wallclock=60000, cpu=2000, disk=65536),
+            stdout=s_wr, policy=CachingPolicy())
+        s.run()
+        s_wr.close()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OL)
+        # repeated write(1, ...) calls are answered by the decision cache
+        hit, miss = s.probe(False)['cache_info']
+        self.assertEqual(miss, s.policy.syscall)
+        self.assertTrue(hit > 1000 > miss)
+        pass
+
+    @unittest.skipUnless(hasattr(os, 'sched_getaffinity'), "test requires sched_getaffinity")
+    def test_placement(self):
+        s_wr = open("/dev/null", "wb")
+        s = Sandbox(self.task[0], stdout=s_wr)
+        s.run()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.probe(False)['placement'],
+            (Sandbox.S_CPU_ANY, Sandbox.S_CPU_ANY))
+        # automatic placement pins the prisoner to one of the allowed cpu's
+        s = Sandbox(self.task[0], stdout=s_wr, placement=Sandbox.S_CPU_AUTO)
+        s.run()
+        s_wr.close()
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        prisoner, tracer = s.probe(False)['placement']
+        self.assertTrue(prisoner in os.sched_getaffinity(0))
+        self.assertNotEqual(prisoner, tracer)
+        # fixed cpu's outside of the affinity of this process are rejected
+        cpu = max(os.sched_getaffinity(0)) + 1
+        for placement in (cpu, (Sandbox.S_CPU_ANY, cpu)):
+            self.assertRaises(AssertionError, Sandbox, self.task[0],
+                placement=placement)
+        pass
+
     pass
 
 
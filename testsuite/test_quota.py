@@ -208,6 +208,21 @@ class TestOutputQuota(unittest.TestCase):
             f.close()
         pass
 
+    def test_ol_piped(self):
+        # output to pipes is counted towards the quota, and truncated
+        s_rd, s_wr = os.pipe()
+        s = Sandbox(self.task[1], quota=dict(wallclock=60000, cpu=2000, disk=5),
+                    stdout=s_wr, stderr=s_wr)
+        s.run()
+        os.close(s_wr)
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_OL)
+        self.assertLess(s.probe(False)['elapsed'], 5000)
+        with os.fdopen(s_rd, "rb") as f:
+            self.assertEqual(f.read(), b"Hello")
+            f.close()
+        pass
+
     pass
 
 
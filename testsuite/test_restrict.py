@@ -38,7 +38,7 @@ __all__ = ['TestSystemRestriction', ]
 
 import os
 
-from errno import EACCES
+from errno import EACCES, EROFS
 from posix import O_WRONLY, O_CREAT, O_TRUNC
 from pwd import getpwnam
 from sandbox import Sandbox
@@ -138,6 +138,61 @@ class TestSystemRestriction(unittest.TestCase):
             f.close()
         pass
 
+    @unittest.skipUnless(Sandbox.S_FS_ENFORCED, "test requires landlock")
+    def test_fs_allow_list(self):
+        nobody = getpwnam('nobody')
+        s = Sandbox(self.task[2], jail=self.prefix, owner=nobody.pw_uid, group=nobody.pw_gid,
+                    fs=[("/", Sandbox.S_FS_READ), ])
+        # file system calls are not inspected by the policy
+        s.policy = NoReturnPolicy()
+        s.run()
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_AT)
+        d = s.probe(False)
+        self.assertEqual(d['exitcode'], EACCES)
+        # make sure file content is not changed
+        with open(os.path.join(self.prefix, self.fout[2]), "rb") as f:
+            self.assertEqual(f.read(), self.secret)
+            f.close()
+        pass
+
+    @unittest.skipIf(Sandbox.S_FS_ENFORCED, "test requires no landlock")
+    def test_fs_not_enforced(self):
+        # allow-lists that cannot be enforced are rejected, not ignored
+        self.assertRaises(AssertionError, Sandbox, self.task[2],
+                          fs=[("/", Sandbox.S_FS_READ), ])
+        pass
+
+    @unittest.skipUnless(hasattr(Sandbox, 'S_NS_MOUNT'), "test requires namespaces")
+    def test_jail_image(self):
+        # an empty image, with the program bound into its scratch tmpfs
+        image = os.path.join(self.prefix, "image")
+        os.makedirs(os.path.join(image, "tmp"))
+        self.addCleanup(os.rmdir, image)
+        self.addCleanup(os.rmdir, os.path.join(image, "tmp"))
+        os.chmod(image, 0o755)
+        for fn, res, code in (("/tmp/file_write_3.out", Sandbox.S_RESULT_OK, 0),
+                              ("/file_write_4.out", Sandbox.S_RESULT_AT, EROFS)):
+            task = config.build(os.path.basename(fn), config.TMPL_FILE_WRITE.replace(
+                b"@FN@", ("\"%s\"" % fn).encode()))
+            self.assertTrue(task is not None)
+            s = Sandbox([image + "/tmp/prog", ], jail=image, policy=NoReturnPolicy(),
+                        ns=Sandbox.S_NS_MOUNT,
+                        image=dict(prog=task, scratch="/tmp", size=1 << 20))
+            s.run()
+            self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+            self.assertEqual(s.result, res)
+            self.assertEqual(s.probe(False)['exitcode'], code)
+        # missing mount points are only created in the scratch tmpfs
+        for fn in ("/prog", "/tmp/../prog", "/usr/prog"):
+            self.assertRaises(AssertionError, Sandbox, [image + fn, ],
+                              jail=image, ns=Sandbox.S_NS_MOUNT,
+                              image=dict(prog=task, scratch="/tmp"))
+        # neither the scratch writes nor the mounts are visible to the host
+        self.assertEqual(os.listdir(image), ["tmp", ])
+        self.assertEqual(os.listdir(os.path.join(image, "tmp")), [])
+        pass
+
     pass
 
 
@@ -85,6 +85,16 @@ class TestSignalSending(unittest.TestCase):
         self.assertTrue(sc in AllowSelfKillPolicy.SC_kill)
         pass
 
+    @unittest.skipUnless(hasattr(Sandbox, 'S_NS_ALL'), "test requires namespaces")
+    def test_kill_ppid_ns(self):
+        # the parent process is beyond reach from a fresh pid namespace
+        s = Sandbox(self.task[0], policy=NoReturnPolicy(), ns=Sandbox.S_NS_ALL)
+        s.run()
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_OK)
+        self.assertEqual(s.probe(False)['exitcode'], 0)
+        pass
+
     def test_assert_rf(self):
         s_wr = open("/dev/null", "wb")
         s = Sandbox(self.task[1], stderr=s_wr)
@@ -223,6 +223,15 @@ class TestMultiProcessing(unittest.TestCase):
         self.assertEqual(s.result, Sandbox.S_RESULT_RF)
         pass
 
+    def test_fork_native(self):
+        s = Sandbox(self.task[0])
+        s.policy = NativeMinimalPolicy()
+        s.run()
+        self.assertEqual(s.status, Sandbox.S_STATUS_FIN)
+        self.assertEqual(s.result, Sandbox.S_RESULT_RF)
+        self.assertEqual(s.policy.delegated, 0)
+        pass
+
     pass
 
 